@@ -0,0 +1,1016 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+/*
+Measures the throughput of the printers, the iostream-based printers they
+replaced, and of saving and loading snapshots, XML and JSON, on synthetic trees
+of several shapes. The printers write to the null device, to memory and to a
+file. Reports MB/s and ns per node, for the fastest of all iterations, as JSON,
+one object per line, or as CSV.
+
+Without options, a typical tree and trees with many devices, long extension
+lists and thousands of image formats per device are measured. Any of the shape
+options measures a single tree instead, which is the typical one changed
+accordingly. --devices is per platform, and --image-formats per image type.
+The temporary files are named after --file.
+
+Usage: OpenCLInfoPrinterBench [--platforms n] [--devices n] [--extensions n]
+	[--image-formats n] [--iterations n] [--file path] [--csv]
+*/
+
+#include <clInfo.h>
+
+#include "Printers.h"
+#include "Table.h"
+#include "Writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+
+#if _WIN32
+	#include <io.h>
+	#include <sys/stat.h>
+	#define NIV_NULL_DEVICE "NUL"
+#else
+	#include <unistd.h>
+	#define NIV_NULL_DEVICE "/dev/null"
+#endif
+
+namespace legacy {
+/*
+The printers as they were before niv::Writer, writing through std::ostream.
+Kept as the baseline to compare against. Note that legacy::JsonPrinter does
+not produce valid JSON.
+*/
+/**
+Dump tree to XML.
+
+The output is unformatted, that is, there is no whitespace between elements.
+*/
+struct XmlPrinter
+{
+public:
+	void Write (std::ostream& s, const cliNode* tree) const
+	{
+		OnNode (s, tree);
+	}
+
+private:
+	void OnNode (std::ostream& s, const cliNode* node) const
+	{
+		s << "<" << node->name;
+
+		if (node->kind) {
+			s << " Kind=\"" << node->kind << "\"";
+		}
+		s << ">";
+
+		for (auto p = node->firstProperty; p; p = p->next) {
+			OnProperty (s, p);
+		}
+
+		for (auto n = node->firstChild; n; n = n->next) {
+			OnNode (s, n);
+		}
+
+		s << "</" << node->name << ">";
+	}
+
+	void OnProperty (std::ostream& s, const cliProperty* p) const
+	{
+		const char* t = nullptr;
+		switch (p->type) {
+		case CLI_PropertyType_Bool: t = "bool"; break;
+		case CLI_PropertyType_Int64: t = "int64"; break;
+		case CLI_PropertyType_String: t = "string"; break;
+		}
+
+		s << "<Property Name=\"" << p->name << "\" Type=\"" << t << "\">";
+
+		for (auto v = p->value; v; v = v->next) {
+			s << "<Value>";
+
+			switch (p->type) {
+			case CLI_PropertyType_Bool:
+				if (v->b) {
+					s << "true";
+				} else {
+					s << "false";
+				}
+				break;
+
+
+			case CLI_PropertyType_Int64:
+				s << v->i;
+				break;
+
+			case CLI_PropertyType_String:
+				s << v->s;
+				break;
+			}
+
+			s << "</Value>";
+		}
+
+		s << "</Property>";
+	}
+};
+
+/**
+Dump tree to JSON.
+*/
+struct JsonPrinter
+{
+public:
+	void Write (std::ostream& s, const cliNode* tree) const
+	{
+		OnNode (s, tree);
+	}
+
+private:
+	void OnNode (std::ostream& s, const cliNode* node) const
+	{
+		s << "{ \"" << node->name << "\" : {";
+		s << "\"Properties\" : ";
+
+		if (node->firstProperty) {
+			for (auto p = node->firstProperty; p; p = p->next) {
+				OnProperty (s, p);
+				if (p->next) {
+					s << ",";
+				}
+			}
+		} else {
+			s << "{}";
+		}
+
+		s << ", \"Children\" : ";
+		if (node->firstChild) {
+			for (auto n = node->firstChild; n; n = n->next) {
+				OnNode (s, n);
+				if (n->next) {
+					s << ",";
+				}
+			}
+		} else {
+			s << "{}";
+		}
+
+		s << "}";
+	}
+
+	void OnProperty (std::ostream& s, const cliProperty* p) const
+	{
+		bool singleValue = (p->value && p->value->next == nullptr);
+
+		if (!singleValue) {
+			s << "\"" << p->name << "\" = [";
+		} else {
+			s << "\"" << p->name << "\" = ";
+		}
+
+		for (auto v = p->value; v; v = v->next) {
+			switch (p->type) {
+			case CLI_PropertyType_Bool:
+				if (v->b) {
+					s << "true";
+				} else {
+					s << "false";
+				}
+				break;
+
+
+			case CLI_PropertyType_Int64:
+				s << v->i;
+				break;
+
+			case CLI_PropertyType_String:
+				s << "\"" << v->s << "\"";
+				break;
+			}
+
+			if (v->next) {
+				s << ",";
+			}
+		}
+
+		if (! singleValue) {
+			s << "]";
+		}
+	}
+};
+
+/**
+Dump tree, formatted for reading on a console.
+
+The output is pretty-printed for consoles
+*/
+struct ConsolePrinter
+{
+public:
+	void Write (std::ostream& s, const cliNode* tree) const
+	{
+		OnNode (s, tree, 0);
+	}
+
+private:
+	static void Indent (std::ostream& s, const int indentation)
+	{
+		for (int i = 0; i < indentation; ++i) {
+			s << "  ";
+		}
+	}
+
+	void OnNode (std::ostream& s, const cliNode* node, const int indentation) const
+	{
+		Indent (s, indentation);
+		s << node->name << '\n';
+
+		std::size_t maxPropertyLength = 0;
+		for (auto p = node->firstProperty; p; p = p->next) {
+			maxPropertyLength = std::max (maxPropertyLength,
+				::strlen (p->name));
+		}
+
+		for (auto p = node->firstProperty; p; p = p->next) {
+			OnProperty (s, p, maxPropertyLength, indentation + 1);
+		}
+
+		for (auto n = node->firstChild; n; n = n->next) {
+			OnNode (s, n, indentation + 1);
+			s << '\n';
+		}
+	}
+
+	void OnProperty (std::ostream& s, const cliProperty* p,
+		const std::size_t fieldWidth, const int indentation) const
+	{
+		Indent (s, indentation);
+
+		s << std::left << std::setw (fieldWidth) << p->name << " : ";
+
+		for (auto v = p->value; v; v = v->next) {
+			switch (p->type) {
+			case CLI_PropertyType_Bool:
+				if (v->b) {
+					s << "true";
+				} else {
+					s << "false";
+				}
+				break;
+
+
+			case CLI_PropertyType_Int64:
+				s << v->i;
+				break;
+
+			case CLI_PropertyType_String:
+				s << v->s;
+				break;
+			}
+
+			if (v->next) {
+				s << ' ';
+			}
+		}
+
+		s << '\n';
+	}
+};
+}
+
+namespace {
+/**
+The shape of a synthetic tree. devices is per platform, imageFormats per
+image type.
+*/
+struct Shape
+{
+	const char*	name;
+	int			platforms;
+	int			devices;
+	int			extensions;
+	int			imageFormats;
+};
+
+/**
+Owns the nodes, properties, values and strings of a synthetic tree.
+*/
+class SyntheticTree
+{
+public:
+	/**
+	Build a tree resembling a gathered one: platforms with devices which have
+	a mix of integer, boolean, string and list properties, an extension list
+	and image formats for every image type. Some strings contain characters
+	which must be escaped.
+	*/
+	explicit SyntheticTree (const Shape& shape)
+	{
+		static const char* const imageTypes [] = {
+			"Image1D", "Image2D", "Image3D",
+			"Image1DBuffer", "Image1DArray", "Image2DArray"
+		};
+
+		static const char* const channelOrders [] = {
+			"R", "A", "RG", "RA", "RGB", "RGBA", "BGRA", "ARGB",
+			"INTENSITY", "LUMINANCE", "Rx", "RGx", "RGBx", "DEPTH", "sRGBA"
+		};
+
+		static const char* const channelDataTypes [] = {
+			"SNORM_INT8", "SNORM_INT16", "UNORM_INT8", "UNORM_INT16",
+			"UNORM_SHORT_565", "UNORM_SHORT_555", "UNORM_INT_101010",
+			"SIGNED_INT8", "SIGNED_INT16", "SIGNED_INT32", "UNSIGNED_INT8",
+			"UNSIGNED_INT16", "UNSIGNED_INT32", "HALF_FLOAT", "FLOAT"
+		};
+
+		// Shared by all platforms and devices
+		std::string extensionList;
+		for (int i = 0; i < shape.extensions; ++i) {
+			if (i > 0) {
+				extensionList += ' ';
+			}
+			extensionList += "cl_synthetic_extension_" + std::to_string (i);
+		}
+		const auto extensions = String (extensionList);
+
+		root_ = Node ("Platforms");
+
+		for (int p = 0; p < shape.platforms; ++p) {
+			auto platform = Node ("Platform", "Platform");
+			AddChild (root_, platform);
+
+			AddString (platform, "CL_PLATFORM_NAME", "Synthetic <Platform> \"" + std::to_string (p) + "\"");
+			AddString (platform, "CL_PLATFORM_VENDOR", "Vendor & Sons");
+			AddString (platform, "CL_PLATFORM_VERSION", "OpenCL 2.0 synthetic");
+			AddString (platform, "CL_PLATFORM_PROFILE", "FULL_PROFILE");
+			AddLiteral (platform, "CL_PLATFORM_EXTENSIONS", extensions);
+
+			auto devices = Node ("Devices");
+			AddChild (platform, devices);
+
+			for (int d = 0; d < shape.devices; ++d) {
+				auto device = Node ("Device", "Device");
+				AddChild (devices, device);
+
+				for (int i = 0; i < 40; ++i) {
+					AddInt (device, Name ("CL_DEVICE_INT_PROPERTY_", i),
+						static_cast<std::int64_t> (i) * 1048576 * (d + 1));
+				}
+
+				for (int i = 0; i < 15; ++i) {
+					AddBool (device, Name ("CL_DEVICE_BOOL_PROPERTY_", i), (i % 2) == 0);
+				}
+
+				for (int i = 0; i < 10; ++i) {
+					AddLiteral (device, Name ("CL_DEVICE_STRING_PROPERTY_", i),
+						"A fairly long driver string, like a version: OpenCL 2.0 (Build 1234.5)");
+				}
+
+				AddString (device, "CL_DEVICE_NAME", "Device \"" + std::to_string (d) + "\" <rev. A&B>");
+				AddLiteral (device, "CL_DEVICE_EXTENSIONS", extensions);
+				AddList (device, "CL_DEVICE_MAX_WORK_ITEM_SIZES", 3);
+
+				auto imageFormats = Node ("ImageFormats");
+				AddChild (device, imageFormats);
+
+				for (const auto imageType : imageTypes) {
+					auto objectType = Node ("ObjectType", imageType);
+					AddChild (imageFormats, objectType);
+
+					for (int f = 0; f < shape.imageFormats; ++f) {
+						auto format = Node ("Format");
+						AddChild (objectType, format);
+						AddLiteral (format, "ChannelOrder", channelOrders [f % 15]);
+						AddLiteral (format, "ChannelDataType", channelDataTypes [(f / 15) % 15]);
+					}
+				}
+			}
+		}
+	}
+
+	const cliNode* GetRoot () const
+	{
+		return root_;
+	}
+
+	std::size_t GetNodeCount () const
+	{
+		return nodes_.size ();
+	}
+
+	std::size_t GetPropertyCount () const
+	{
+		return properties_.size ();
+	}
+
+private:
+	const char* String (const std::string& s)
+	{
+		strings_.push_back (s);
+		return strings_.back ().c_str ();
+	}
+
+	const char* Name (const char* prefix, const int i)
+	{
+		return String (prefix + std::to_string (i));
+	}
+
+	cliNode* Node (const char* name, const char* kind = nullptr)
+	{
+		nodes_.emplace_back ();
+		auto node = &nodes_.back ();
+		std::memset (node, 0, sizeof (cliNode));
+		node->name = name;
+		node->kind = kind;
+		return node;
+	}
+
+	void AddChild (cliNode* parent, cliNode* child)
+	{
+		auto& last = lastChild_ [parent];
+		if (last) {
+			last->next = child;
+		} else {
+			parent->firstChild = child;
+		}
+		last = child;
+	}
+
+	cliProperty* Property (cliNode* node, const char* name, const cliPropertyType type)
+	{
+		properties_.emplace_back ();
+		auto property = &properties_.back ();
+		std::memset (property, 0, sizeof (cliProperty));
+		property->name = name;
+		property->type = type;
+
+		auto& last = lastProperty_ [node];
+		if (last) {
+			last->next = property;
+		} else {
+			node->firstProperty = property;
+		}
+		last = property;
+
+		return property;
+	}
+
+	cliValue* Value (cliProperty* property)
+	{
+		values_.emplace_back ();
+		auto value = &values_.back ();
+		std::memset (value, 0, sizeof (cliValue));
+
+		auto last = &property->value;
+		while (*last) {
+			last = &(*last)->next;
+		}
+		*last = value;
+
+		return value;
+	}
+
+	void AddInt (cliNode* node, const char* name, const std::int64_t i)
+	{
+		Value (Property (node, name, CLI_PropertyType_Int64))->i = i;
+	}
+
+	void AddBool (cliNode* node, const char* name, const bool b)
+	{
+		Value (Property (node, name, CLI_PropertyType_Bool))->b = b;
+	}
+
+	void AddString (cliNode* node, const char* name, const std::string& s)
+	{
+		AddLiteral (node, name, String (s));
+	}
+
+	/**
+	Add a string property without copying the string, which must outlive the
+	tree.
+	*/
+	void AddLiteral (cliNode* node, const char* name, const char* s)
+	{
+		Value (Property (node, name, CLI_PropertyType_String))->s = s;
+	}
+
+	void AddList (cliNode* node, const char* name, const int count)
+	{
+		auto property = Property (node, name, CLI_PropertyType_Int64);
+		for (int i = 0; i < count; ++i) {
+			Value (property)->i = 1024 >> i;
+		}
+	}
+
+	std::deque<cliNode>		nodes_;
+	std::deque<cliProperty>	properties_;
+	std::deque<cliValue>	values_;
+	std::deque<std::string>	strings_;
+	cliNode*				root_;
+
+	// The ends of the lists, so long lists are built in linear time
+	std::unordered_map<const cliNode*, cliNode*>		lastChild_;
+	std::unordered_map<const cliNode*, cliProperty*>	lastProperty_;
+};
+
+/**
+Counts the bytes written to it, so the throughput of the legacy printers can
+be computed.
+*/
+class CountingBuffer : public std::streambuf
+{
+public:
+	explicit CountingBuffer (std::streambuf* target)
+	: target_ (target)
+	{
+	}
+
+	std::size_t GetCount () const
+	{
+		return count_;
+	}
+
+protected:
+	int_type overflow (int_type c) override
+	{
+		if (c != traits_type::eof ()) {
+			++count_;
+			return target_->sputc (static_cast<char> (c));
+		}
+		return c;
+	}
+
+	std::streamsize xsputn (const char* s, std::streamsize n) override
+	{
+		count_ += static_cast<std::size_t> (n);
+		return target_->sputn (s, n);
+	}
+
+private:
+	std::streambuf*	target_;
+	std::size_t		count_ = 0;
+};
+
+/**
+Opens a file for writing, truncating it. Used for the null device as well.
+*/
+class OutputFile
+{
+public:
+	explicit OutputFile (const char* path)
+	{
+#if _WIN32
+		fd_ = ::_open (path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+			_S_IREAD | _S_IWRITE);
+#else
+		fd_ = ::open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+	}
+
+	~OutputFile ()
+	{
+#if _WIN32
+		::_close (fd_);
+#else
+		::close (fd_);
+#endif
+	}
+
+	OutputFile (const OutputFile&) = delete;
+	OutputFile& operator= (const OutputFile&) = delete;
+
+	int GetFd () const
+	{
+		return fd_;
+	}
+
+private:
+	int fd_;
+};
+
+enum Sink
+{
+	// The null device, so only formatting and buffering are measured
+	Sink_Null,
+	// A std::vector<char>, or a std::ostringstream for the legacy printers
+	Sink_Memory,
+	// A file, which ends up in the page cache, as nothing waits for the disk
+	Sink_File
+};
+
+const char* const sinkNames [] = { "null", "memory", "file" };
+
+/**
+The fastest of all iterations, and the bytes written or read by one.
+*/
+struct Result
+{
+	double		seconds;
+	std::size_t	bytes;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+////////////////////////////////////////////////////////////////////////////////
+double Seconds (const Clock::time_point start, const Clock::time_point end)
+{
+	return std::chrono::duration<double> (end - start).count ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename Printer>
+void Print (niv::Writer& w, const cliNode* root)
+{
+	Printer printer (w);
+	printer.Visit (root);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <niv::TableFormat Format>
+void PrintTable (niv::Writer& w, const cliNode* root)
+{
+	niv::WriteTable (w, root, Format);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename Printer>
+void PrintLegacy (std::ostream& s, const cliNode* root)
+{
+	Printer printer;
+	printer.Write (s, root);
+}
+
+typedef void (*PrintFunction) (niv::Writer& w, const cliNode* root);
+typedef void (*LegacyPrintFunction) (std::ostream& s, const cliNode* root);
+
+////////////////////////////////////////////////////////////////////////////////
+Result RunWriter (const PrintFunction print, const cliNode* root,
+	const Sink sink, const char* path, const int iterations)
+{
+	Result result = { 0, 0 };
+	std::vector<char> memory;
+
+	for (int i = 0; i < iterations; ++i) {
+		// Keeps the capacity, so only the first iteration grows the buffer
+		memory.clear ();
+
+		const auto start = Clock::now ();
+		std::uint64_t bytes = 0;
+
+		if (sink == Sink_Memory) {
+			niv::Writer w (memory);
+			print (w, root);
+			w.Flush ();
+			bytes = w.GetBytesWritten ();
+		} else {
+			OutputFile file (sink == Sink_Null ? NIV_NULL_DEVICE : path);
+			niv::Writer w (file.GetFd ());
+			print (w, root);
+			w.Flush ();
+			bytes = w.GetBytesWritten ();
+		}
+
+		const auto seconds = Seconds (start, Clock::now ());
+
+		if (i == 0 || seconds < result.seconds) {
+			result.seconds = seconds;
+		}
+		result.bytes = static_cast<std::size_t> (bytes);
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Result RunLegacy (const LegacyPrintFunction print, const cliNode* root,
+	const Sink sink, const char* path, const int iterations)
+{
+	Result result = { 0, 0 };
+
+	for (int i = 0; i < iterations; ++i) {
+		const auto start = Clock::now ();
+		std::size_t bytes = 0;
+
+		if (sink == Sink_Memory) {
+			std::ostringstream s;
+			CountingBuffer counter (s.rdbuf ());
+			std::ostream out (&counter);
+			print (out, root);
+			out.flush ();
+			bytes = counter.GetCount ();
+		} else {
+			std::ofstream file (sink == Sink_Null ? NIV_NULL_DEVICE : path);
+			CountingBuffer counter (file.rdbuf ());
+			std::ostream out (&counter);
+			print (out, root);
+			out.flush ();
+			bytes = counter.GetCount ();
+		}
+
+		const auto seconds = Seconds (start, Clock::now ());
+
+		if (i == 0 || seconds < result.seconds) {
+			result.seconds = seconds;
+		}
+		result.bytes = bytes;
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::size_t GetFileSize (const char* path)
+{
+	std::ifstream file (path, std::ios::binary | std::ios::ate);
+	return file ? static_cast<std::size_t> (file.tellg ()) : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Result RunSave (const cliInfo* info, const Sink sink, const char* path,
+	const int iterations)
+{
+	Result result = { 0, 0 };
+
+	for (int i = 0; i < iterations; ++i) {
+		const auto start = Clock::now ();
+
+		if (cliInfo_Save (info, nullptr,
+			sink == Sink_Null ? NIV_NULL_DEVICE : path) != CLI_Success) {
+			return { 0, 0 };
+		}
+
+		const auto seconds = Seconds (start, Clock::now ());
+
+		if (i == 0 || seconds < result.seconds) {
+			result.seconds = seconds;
+		}
+	}
+
+	result.bytes = GetFileSize (path);
+	return result;
+}
+
+typedef int (*LoadFunction) (cliInfo* info, const char* filename);
+
+////////////////////////////////////////////////////////////////////////////////
+int LoadSnapshot (cliInfo* info, const char* filename)
+{
+	return cliInfo_Load (info, nullptr, filename);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Result RunLoad (const LoadFunction load, const char* path, const int iterations)
+{
+	Result result = { 0, GetFileSize (path) };
+
+	for (int i = 0; i < iterations; ++i) {
+		cliInfo* info = nullptr;
+		cliInfo_Create (&info);
+
+		const auto start = Clock::now ();
+		const auto status = load (info, path);
+		const auto seconds = Seconds (start, Clock::now ());
+
+		// Destroying the tree is not part of loading it
+		cliInfo_Destroy (info);
+
+		if (status != CLI_Success) {
+			return { 0, 0 };
+		}
+
+		if (i == 0 || seconds < result.seconds) {
+			result.seconds = seconds;
+		}
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Report (const Shape& shape, const SyntheticTree& tree,
+	const char* format, const char* sink, const Result& r, const bool csv)
+{
+	const auto nodes = tree.GetNodeCount ();
+	const auto mbPerSecond = r.seconds > 0
+		? r.bytes / r.seconds / (1024 * 1024) : 0.0;
+	const auto nsPerNode = r.seconds * 1e9 / nodes;
+
+	if (csv) {
+		std::printf ("%s,%d,%d,%d,%d,%zu,%zu,%s,%s,%zu,%.6f,%.1f,%.1f\n",
+			shape.name, shape.platforms, shape.devices, shape.extensions,
+			shape.imageFormats, nodes, tree.GetPropertyCount (),
+			format, sink, r.bytes, r.seconds, mbPerSecond, nsPerNode);
+	} else {
+		std::printf ("{\"shape\":\"%s\",\"platforms\":%d,\"devices\":%d,"
+			"\"extensions\":%d,\"image_formats\":%d,\"nodes\":%zu,"
+			"\"properties\":%zu,\"format\":\"%s\",\"sink\":\"%s\","
+			"\"bytes\":%zu,\"seconds\":%.6f,\"mb_per_s\":%.1f,"
+			"\"ns_per_node\":%.1f}\n",
+			shape.name, shape.platforms, shape.devices, shape.extensions,
+			shape.imageFormats, nodes, tree.GetPropertyCount (),
+			format, sink, r.bytes, r.seconds, mbPerSecond, nsPerNode);
+	}
+
+	std::fflush (stdout);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Write the tree with all printers to all sinks, then save it as a snapshot and
+load it from all formats which can be loaded. Returns false if the snapshot
+could not be written or loaded.
+*/
+bool RunShape (const Shape& shape, const std::string& path,
+	const int iterations, const bool csv)
+{
+	static const struct
+	{
+		const char*		name;
+		PrintFunction	print;
+	} printers [] = {
+		{ "xml", Print<niv::XmlPrinter> },
+		{ "json", Print<niv::JsonPrinter> },
+		{ "console", Print<niv::ConsolePrinter> },
+		{ "cbor", Print<niv::CborPrinter> },
+		{ "csv", PrintTable<niv::TableFormat_Csv> },
+		{ "tsv", PrintTable<niv::TableFormat_Tsv> }
+	};
+
+	static const struct
+	{
+		const char*			name;
+		LegacyPrintFunction	print;
+	} legacyPrinters [] = {
+		{ "xml-iostream", PrintLegacy<legacy::XmlPrinter> },
+		{ "json-iostream", PrintLegacy<legacy::JsonPrinter> },
+		{ "console-iostream", PrintLegacy<legacy::ConsolePrinter> }
+	};
+
+	const SyntheticTree tree (shape);
+	const auto root = tree.GetRoot ();
+	const auto output = path + ".out";
+
+	for (const auto& printer : printers) {
+		for (int sink = 0; sink < 3; ++sink) {
+			Report (shape, tree, printer.name, sinkNames [sink],
+				RunWriter (printer.print, root, static_cast<Sink> (sink),
+					output.c_str (), iterations), csv);
+		}
+	}
+
+	for (const auto& printer : legacyPrinters) {
+		for (int sink = 0; sink < 3; ++sink) {
+			Report (shape, tree, printer.name, sinkNames [sink],
+				RunLegacy (printer.print, root, static_cast<Sink> (sink),
+					output.c_str (), iterations), csv);
+		}
+	}
+
+	std::remove (output.c_str ());
+
+	// The loaders need files, and the snapshot a cliInfo, which is loaded from
+	// the XML output
+	const auto xmlPath = path + ".xml";
+	const auto jsonPath = path + ".json";
+	const auto snapshotPath = path + ".snapshot";
+
+	RunWriter (Print<niv::XmlPrinter>, root, Sink_File, xmlPath.c_str (), 1);
+	RunWriter (Print<niv::JsonPrinter>, root, Sink_File, jsonPath.c_str (), 1);
+
+	cliInfo* info = nullptr;
+	cliInfo_Create (&info);
+
+	bool success = cliInfo_LoadXml (info, xmlPath.c_str ()) == CLI_Success;
+
+	if (success) {
+		const auto save = RunSave (info, Sink_File, snapshotPath.c_str (), iterations);
+		Report (shape, tree, "snapshot-save", sinkNames [Sink_File], save, csv);
+
+		// The size is taken from the file written before
+		Report (shape, tree, "snapshot-save", sinkNames [Sink_Null],
+			RunSave (info, Sink_Null, snapshotPath.c_str (), iterations), csv);
+
+		const struct
+		{
+			const char*		name;
+			LoadFunction	load;
+			std::string		path;
+		} loaders [] = {
+			{ "snapshot-load", LoadSnapshot, snapshotPath },
+			{ "xml-load", cliInfo_LoadXml, xmlPath },
+			{ "json-load", cliInfo_LoadJson, jsonPath }
+		};
+
+		for (const auto& loader : loaders) {
+			const auto result = RunLoad (loader.load, loader.path.c_str (), iterations);
+			success = success && result.bytes > 0;
+			Report (shape, tree, loader.name, sinkNames [Sink_File], result, csv);
+		}
+
+		success = success && save.bytes > 0;
+	}
+
+	cliInfo_Destroy (info);
+
+	std::remove (xmlPath.c_str ());
+	std::remove (jsonPath.c_str ());
+	std::remove (snapshotPath.c_str ());
+
+	return success;
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int argc, char* argv [])
+{
+	// Each stresses one part of the output: the number of nodes, long
+	// strings, and long lists of small nodes
+	Shape shapes [] = {
+		{ "typical", 4, 64, 64, 40 },
+		{ "many-devices", 8, 512, 16, 4 },
+		{ "long-extensions", 1, 64, 4000, 4 },
+		{ "image-formats", 1, 4, 32, 2000 }
+	};
+
+	Shape custom = shapes [0];
+	custom.name = "custom";
+	bool useCustom = false;
+
+	int iterations = 5;
+	bool csv = false;
+	std::string path = "OpenCLInfoPrinterBench.tmp";
+
+	for (int i = 1; i < argc; ++i) {
+		int* value = nullptr;
+
+		if (::strcmp (argv [i], "--platforms") == 0) {
+			value = &custom.platforms;
+		} else if (::strcmp (argv [i], "--devices") == 0) {
+			value = &custom.devices;
+		} else if (::strcmp (argv [i], "--extensions") == 0) {
+			value = &custom.extensions;
+		} else if (::strcmp (argv [i], "--image-formats") == 0) {
+			value = &custom.imageFormats;
+		} else if (::strcmp (argv [i], "--iterations") == 0) {
+			value = &iterations;
+		} else if (::strcmp (argv [i], "--file") == 0 && (i + 1) < argc) {
+			path = argv [++i];
+			continue;
+		} else if (::strcmp (argv [i], "--csv") == 0) {
+			csv = true;
+			continue;
+		} else {
+			std::cerr << "Unknown option '" << argv [i] << "'\n";
+			return 1;
+		}
+
+		if ((i + 1) >= argc || (*value = std::atoi (argv [++i])) < 0) {
+			std::cerr << "Invalid value for '" << argv [i - 1] << "'\n";
+			return 1;
+		}
+
+		useCustom = useCustom || value != &iterations;
+	}
+
+	iterations = std::max (1, iterations);
+
+	if (csv) {
+		std::printf ("shape,platforms,devices,extensions,image_formats,nodes,"
+			"properties,format,sink,bytes,seconds,mb_per_s,ns_per_node\n");
+	}
+
+	int result = 0;
+
+	if (useCustom) {
+		if (! RunShape (custom, path, iterations, csv)) {
+			result = 1;
+		}
+	} else {
+		for (const auto& shape : shapes) {
+			if (! RunShape (shape, path, iterations, csv)) {
+				result = 1;
+			}
+		}
+	}
+
+	if (result != 0) {
+		std::cerr << "Failed to save or load a snapshot\n";
+	}
+
+	return result;
+}
@@ -0,0 +1,72 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_DIFF_H_7E3A1C5B9D2F4E6A8C0B2D4F6A8E1C3B5D7F9A02
+#define NIV_OPENCLINFO_DIFF_H_7E3A1C5B9D2F4E6A8C0B2D4F6A8E1C3B5D7F9A02
+
+#include <clInfo.h>
+
+#include "Writer.h"
+
+#include <string>
+#include <vector>
+
+namespace niv {
+/**
+A difference between two trees.
+*/
+struct Change
+{
+	enum Type
+	{
+		Type_Added,
+		Type_Removed,
+		Type_Changed
+	};
+
+	Type		type;
+
+	// Path of the node which was added or removed, or which holds the
+	// property, made of the keys of the nodes, see DiffTrees
+	std::string	path;
+
+	// Null if a node was added or removed. Otherwise, before is null for added
+	// properties, and after is null for removed ones.
+	const cliProperty*	before;
+	const cliProperty*	after;
+};
+
+/**
+Compare two trees.
+
+Nodes are matched by their key, which is made of the name and kind of the
+node. Platforms additionally use their name and vendor, devices their name and
+vendor, and image formats all their properties, so reordered nodes are still
+matched. Nodes which have the same key are matched in order. Properties are
+matched by name.
+
+The runtime is linear in the size of the trees.
+*/
+std::vector<Change> DiffTrees (const cliNode* before, const cliNode* after);
+
+/**
+Write changes in a line-based format meant for reading, with one line per
+change prefixed by +, - or ~.
+*/
+void WriteChangesConsole (Writer& w, const std::vector<Change>& changes);
+
+/**
+Write changes as a JSON document:
+
+	{"Changes":[{"Type":"Added"|"Removed"|"Changed","Path":"...",
+		"Property":"...","Before":...,"After":...}]}
+
+Property, Before and After are only present for property changes, and follow
+the value format of JsonPrinter.
+*/
+void WriteChangesJson (Writer& w, const std::vector<Change>& changes);
+}
+
+#endif
@@ -0,0 +1,33 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_OPENMETRICS_H_2C8E4A6B0D1F4C3E9A7B5D3F1E0C8A6B4D2F0E19
+#define NIV_OPENCLINFO_OPENMETRICS_H_2C8E4A6B0D1F4C3E9A7B5D3F1E0C8A6B4D2F0E19
+
+#include <clInfo.h>
+
+#include "Writer.h"
+
+namespace niv {
+/**
+The properties used by WriteOpenMetrics, terminated by a null pointer. Can be
+passed as cliGatherOptions::properties, so nothing else is gathered.
+*/
+extern const char* const openMetricsProperties [];
+
+/**
+Write the numeric device properties and availability flags as gauges in the
+OpenMetrics text format, which is also understood by the Prometheus text
+parser, for instance in the textfile collector of node_exporter.
+
+Every sample is labelled with the platform and device name, and their index,
+which identifies the device if there are several identical ones. Booleans are
+written as 0 or 1. Additionally, opencl_device_info has the value 1, and the
+device type and versions as labels.
+*/
+void WriteOpenMetrics (Writer& w, const cliNode* root);
+}
+
+#endif
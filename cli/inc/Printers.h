@@ -0,0 +1,542 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_PRINTERS_H_8B2E5D1C7A4F4E0B9D3C6A2F1E8B5D7C0A9F4E26
+#define NIV_OPENCLINFO_PRINTERS_H_8B2E5D1C7A4F4E0B9D3C6A2F1E8B5D7C0A9F4E26
+
+#include <clInfo.h>
+
+#include "TreeVisitor.h"
+#include "Writer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace niv {
+/**
+Dump tree to XML.
+
+The output is unformatted, that is, there is no whitespace between elements.
+*/
+class XmlPrinter : public TreeVisitor<XmlPrinter>
+{
+public:
+	explicit XmlPrinter (Writer& w)
+	: w_ (w)
+	{
+	}
+
+	void BeginNode (const cliNode* node, const int, const int)
+	{
+		w_.Put ('<');
+		w_.Write (node->name);
+
+		if (node->kind) {
+			w_.WriteLiteral (" Kind=\"");
+			w_.WriteXmlEscaped (node->kind);
+			w_.Put ('"');
+		}
+		w_.Put ('>');
+	}
+
+	void BeginProperty (const cliProperty* p, const int)
+	{
+		const char* t = nullptr;
+		switch (p->type) {
+		case CLI_PropertyType_Bool: t = "bool"; break;
+		case CLI_PropertyType_Int64: t = "int64"; break;
+		case CLI_PropertyType_String: t = "string"; break;
+		}
+
+		w_.WriteLiteral ("<Property Name=\"");
+		w_.WriteXmlEscaped (p->name);
+		w_.WriteLiteral ("\" Type=\"");
+		w_.Write (t);
+		w_.WriteLiteral ("\">");
+	}
+
+	void OnBool (const bool value, const int)
+	{
+		if (value) {
+			w_.WriteLiteral ("<Value>true</Value>");
+		} else {
+			w_.WriteLiteral ("<Value>false</Value>");
+		}
+	}
+
+	void OnInt (const std::int64_t value, const int)
+	{
+		w_.WriteLiteral ("<Value>");
+		w_.WriteInt (value);
+		w_.WriteLiteral ("</Value>");
+	}
+
+	void OnString (const char* value, const int)
+	{
+		w_.WriteLiteral ("<Value>");
+		w_.WriteXmlEscaped (value);
+		w_.WriteLiteral ("</Value>");
+	}
+
+	void EndProperty (const cliProperty*)
+	{
+		w_.WriteLiteral ("</Property>");
+	}
+
+	void EndNode (const cliNode* node, const int)
+	{
+		w_.WriteLiteral ("</");
+		w_.Write (node->name);
+		w_.Put ('>');
+	}
+
+private:
+	Writer&	w_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Write the values of a property the same way as ConsolePrinter, separated by
+spaces.
+*/
+inline void WriteConsoleValues (Writer& w, const cliProperty* property)
+{
+	for (auto v = property->value; v; v = v->next) {
+		if (v != property->value) {
+			w.Put (' ');
+		}
+
+		switch (property->type) {
+		case CLI_PropertyType_Bool:
+			if (v->b) {
+				w.WriteLiteral ("true");
+			} else {
+				w.WriteLiteral ("false");
+			}
+			break;
+
+		case CLI_PropertyType_Int64:
+			w.WriteInt (v->i);
+			break;
+
+		case CLI_PropertyType_String:
+			w.Write (v->s);
+			break;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Write the values of a property the same way as JsonPrinter: a single value as
+is, and any other number of values as an array.
+*/
+inline void WriteJsonValues (Writer& w, const cliProperty* property)
+{
+	const bool single = property->value && property->value->next == nullptr;
+
+	if (! single) {
+		w.Put ('[');
+	}
+
+	for (auto v = property->value; v; v = v->next) {
+		if (v != property->value) {
+			w.Put (',');
+		}
+
+		switch (property->type) {
+		case CLI_PropertyType_Bool:
+			if (v->b) {
+				w.WriteLiteral ("true");
+			} else {
+				w.WriteLiteral ("false");
+			}
+			break;
+
+		case CLI_PropertyType_Int64:
+			w.WriteInt (v->i);
+			break;
+
+		case CLI_PropertyType_String:
+			w.Put ('"');
+			w.WriteJsonEscaped (v->s);
+			w.Put ('"');
+			break;
+		}
+	}
+
+	if (! single) {
+		w.Put (']');
+	}
+}
+
+/**
+Dump tree to JSON.
+
+Every node becomes an object with a single member named after the node, which
+holds the optional "Kind", the "Properties" object and the "Children" array.
+Properties with exactly one value are written as a scalar, all others as an
+array. The gather adds every property to a node at most once, so the names
+are unique within "Properties".
+*/
+class JsonPrinter : public TreeVisitor<JsonPrinter>
+{
+public:
+	explicit JsonPrinter (Writer& w)
+	: w_ (w)
+	{
+	}
+
+	void BeginNode (const cliNode* node, const int, const int index)
+	{
+		if (index > 0) {
+			w_.Put (',');
+		}
+
+		w_.WriteLiteral ("{\"");
+		w_.WriteJsonEscaped (node->name);
+		w_.WriteLiteral ("\":{");
+
+		if (node->kind) {
+			w_.WriteLiteral ("\"Kind\":\"");
+			w_.WriteJsonEscaped (node->kind);
+			w_.WriteLiteral ("\",");
+		}
+
+		w_.WriteLiteral ("\"Properties\":{");
+	}
+
+	void BeginProperty (const cliProperty* p, const int index)
+	{
+		if (index > 0) {
+			w_.Put (',');
+		}
+
+		w_.Put ('"');
+		w_.WriteJsonEscaped (p->name);
+		w_.WriteLiteral ("\":");
+
+		if (! IsSingleValue (p)) {
+			w_.Put ('[');
+		}
+	}
+
+	void OnBool (const bool value, const int index)
+	{
+		Separate (index);
+
+		if (value) {
+			w_.WriteLiteral ("true");
+		} else {
+			w_.WriteLiteral ("false");
+		}
+	}
+
+	void OnInt (const std::int64_t value, const int index)
+	{
+		Separate (index);
+		w_.WriteInt (value);
+	}
+
+	void OnString (const char* value, const int index)
+	{
+		Separate (index);
+		w_.Put ('"');
+		w_.WriteJsonEscaped (value);
+		w_.Put ('"');
+	}
+
+	void EndProperty (const cliProperty* p)
+	{
+		if (! IsSingleValue (p)) {
+			w_.Put (']');
+		}
+	}
+
+	void BeginChildren (const cliNode*, const int)
+	{
+		w_.WriteLiteral ("},\"Children\":[");
+	}
+
+	void EndNode (const cliNode*, const int)
+	{
+		w_.WriteLiteral ("]}}");
+	}
+
+private:
+	static bool IsSingleValue (const cliProperty* p)
+	{
+		return p->value && p->value->next == nullptr;
+	}
+
+	void Separate (const int index)
+	{
+		if (index > 0) {
+			w_.Put (',');
+		}
+	}
+
+	Writer&	w_;
+};
+
+/**
+Dump tree, formatted for reading on a console.
+
+The output is pretty-printed for consoles
+*/
+class ConsolePrinter : public TreeVisitor<ConsolePrinter>
+{
+public:
+	explicit ConsolePrinter (Writer& w)
+	: w_ (w)
+	{
+	}
+
+	void BeginNode (const cliNode* node, const int depth, const int)
+	{
+		Indent (depth);
+		w_.Write (node->name);
+
+		// The metrics of the Derived node are only told apart by their kind
+		if (node->kind && ::strcmp (node->name, "Metric") == 0) {
+			w_.WriteLiteral (" (");
+			w_.Write (node->kind);
+			w_.Put (')');
+		}
+
+		w_.Put ('\n');
+
+		// Properties are visited before any child, so this is not
+		// overwritten before it is used
+		fieldWidth_ = 0;
+		for (auto p = node->firstProperty; p; p = p->next) {
+			fieldWidth_ = std::max (fieldWidth_, ::strlen (p->name));
+		}
+
+		propertyIndentation_ = depth + 1;
+	}
+
+	void BeginProperty (const cliProperty* p, const int)
+	{
+		Indent (propertyIndentation_);
+
+		const auto length = ::strlen (p->name);
+		w_.Write (p->name, length);
+		w_.Fill (' ', fieldWidth_ - length);
+		w_.WriteLiteral (" : ");
+	}
+
+	void OnBool (const bool value, const int index)
+	{
+		Separate (index);
+
+		if (value) {
+			w_.WriteLiteral ("true");
+		} else {
+			w_.WriteLiteral ("false");
+		}
+	}
+
+	void OnInt (const std::int64_t value, const int index)
+	{
+		Separate (index);
+		w_.WriteInt (value);
+	}
+
+	void OnString (const char* value, const int index)
+	{
+		Separate (index);
+		w_.Write (value);
+	}
+
+	void EndProperty (const cliProperty*)
+	{
+		w_.Put ('\n');
+	}
+
+	void EndNode (const cliNode*, const int depth)
+	{
+		// Blank line after every child node
+		if (depth > 0) {
+			w_.Put ('\n');
+		}
+	}
+
+private:
+	void Indent (const int indentation)
+	{
+		w_.Fill (' ', static_cast<std::size_t> (indentation) * 2);
+	}
+
+	void Separate (const int index)
+	{
+		if (index > 0) {
+			w_.Put (' ');
+		}
+	}
+
+	Writer&		w_;
+	std::size_t	fieldWidth_ = 0;
+	int			propertyIndentation_ = 0;
+};
+/**
+Dump tree to CBOR (RFC 8949).
+
+The document has the same structure as the JSON output, so converting it to
+JSON yields the same document as JsonPrinter:
+
+	document	= tag 55799 (self-described CBOR), followed by a node
+	node		= map (1) { name: body }
+	body		= map (2 or 3) {
+					? "Kind": text,
+					"Properties": map (n) { name: value / [* value] },
+					"Children": array (n) [* node]
+				}
+	value		= bool / int / text
+
+Properties with exactly one value are written as the value itself, all others
+as an array. Integers are written in the smallest encoding which can hold
+them. All maps and arrays have a definite length, and the keys are written in
+the order above. The gather adds every property to a node at most once, so
+the "Properties" map has no duplicate keys, which RFC 8949 does not allow.
+*/
+class CborPrinter : public TreeVisitor<CborPrinter>
+{
+public:
+	explicit CborPrinter (Writer& w)
+	: w_ (w)
+	{
+	}
+
+	void BeginNode (const cliNode* node, const int depth, const int)
+	{
+		if (depth == 0) {
+			// Tag 55799, so the document can be recognized by its first bytes
+			w_.WriteLiteral ("\xD9\xD9\xF7");
+		}
+
+		WriteHead (MajorType_Map, 1);
+		WriteText (node->name);
+
+		WriteHead (MajorType_Map, node->kind ? 3 : 2);
+
+		if (node->kind) {
+			WriteText ("Kind", 4);
+			WriteText (node->kind);
+		}
+
+		std::uint64_t count = 0;
+		for (auto p = node->firstProperty; p; p = p->next) {
+			++count;
+		}
+
+		WriteText ("Properties", 10);
+		WriteHead (MajorType_Map, count);
+	}
+
+	void BeginProperty (const cliProperty* p, const int)
+	{
+		WriteText (p->name);
+
+		std::uint64_t count = 0;
+		for (auto v = p->value; v; v = v->next) {
+			++count;
+		}
+
+		if (count != 1) {
+			WriteHead (MajorType_Array, count);
+		}
+	}
+
+	void OnBool (const bool value, const int)
+	{
+		w_.Put (value ? '\xF5' : '\xF4');
+	}
+
+	void OnInt (const std::int64_t value, const int)
+	{
+		if (value < 0) {
+			// -1 - value, computed without overflow for the smallest value
+			WriteHead (MajorType_NegativeInt,
+				static_cast<std::uint64_t> (-(value + 1)));
+		} else {
+			WriteHead (MajorType_UnsignedInt, static_cast<std::uint64_t> (value));
+		}
+	}
+
+	void OnString (const char* value, const int)
+	{
+		WriteText (value);
+	}
+
+	void BeginChildren (const cliNode* node, const int)
+	{
+		std::uint64_t count = 0;
+		for (auto n = node->firstChild; n; n = n->next) {
+			++count;
+		}
+
+		WriteText ("Children", 8);
+		WriteHead (MajorType_Array, count);
+	}
+
+private:
+	enum MajorType
+	{
+		MajorType_UnsignedInt	= 0,
+		MajorType_NegativeInt	= 1,
+		MajorType_Text			= 3,
+		MajorType_Array			= 4,
+		MajorType_Map			= 5
+	};
+
+	void WriteHead (const MajorType type, const std::uint64_t value)
+	{
+		const auto major = static_cast<unsigned char> (type << 5);
+
+		if (value < 24) {
+			w_.Put (static_cast<char> (major | value));
+			return;
+		}
+
+		// Additional information 24 to 27 means 1, 2, 4 or 8 bytes follow
+		int size = 8;
+		unsigned char info = 27;
+		if (value <= 0xFF) {
+			size = 1;
+			info = 24;
+		} else if (value <= 0xFFFF) {
+			size = 2;
+			info = 25;
+		} else if (value <= 0xFFFFFFFF) {
+			size = 4;
+			info = 26;
+		}
+
+		char head [9];
+		head [0] = static_cast<char> (major | info);
+		for (int i = 0; i < size; ++i) {
+			head [size - i] = static_cast<char> ((value >> (i * 8)) & 0xFF);
+		}
+
+		w_.Write (head, static_cast<std::size_t> (size) + 1);
+	}
+
+	void WriteText (const char* s, const std::size_t length)
+	{
+		WriteHead (MajorType_Text, length);
+		w_.Write (s, length);
+	}
+
+	void WriteText (const char* s)
+	{
+		WriteText (s, ::strlen (s));
+	}
+
+	Writer&	w_;
+};
+}
+
+#endif
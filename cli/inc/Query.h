@@ -0,0 +1,102 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_QUERY_H_0D4B7E2A9C6F4B1E8A3D5C7F9E1B2D4A6C8E0F13
+#define NIV_OPENCLINFO_QUERY_H_0D4B7E2A9C6F4B1E8A3D5C7F9E1B2D4A6C8E0F13
+
+#include <clInfo.h>
+#include <clInfoPredicate.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace niv {
+/**
+A path query over the tree, for instance
+
+	Platform[*]/Devices/Device[CL_DEVICE_TYPE=GPU]/CL_DEVICE_GLOBAL_MEM_SIZE
+
+The path is made of steps separated by '/', starting at the root node. Each
+step selects the child nodes with the given name, or all children for '*'. The
+last step may also name a property of the nodes selected so far. A step can be
+followed by any number of predicates, which filter the selected nodes in
+order:
+
+	[*]					keeps all nodes
+	[n]					keeps the n-th node, counting from 0
+	[NAME]				keeps nodes with the property NAME; for booleans, it
+						must also be true
+	[NAME op value]		compares the values of the property NAME, where op is
+						one of = != < <= > >= and ~ (contains). Integers are
+						compared as numbers, and may end in K, M, G or T to
+						multiply them by powers of 1024. For strings, = also
+						accepts a value ending in '_' followed by value, so
+						CL_DEVICE_TYPE=GPU matches CL_DEVICE_TYPE_GPU. For
+						properties with several values, one of them has to
+						match, or none of them for !=.
+
+The query is analyzed when it is compiled, so it can restrict a gather to
+the properties, device types and nodes it needs using Restrict(). A query
+naming the Derived or Metric nodes turns on CLI_GatherFlag_Derived.
+*/
+class Query
+{
+public:
+	/**
+	Compile a query. Throws std::runtime_error if it is malformed.
+	*/
+	explicit Query (const char* text);
+
+	/**
+	A node or property selected by the query. property is null for nodes.
+	*/
+	struct Match
+	{
+		const cliNode*		node;
+		const cliProperty*	property;
+	};
+
+	std::vector<Match> Evaluate (const cliNode* root) const;
+
+	/**
+	Set up options so that only what this query needs is gathered. options
+	refers to memory owned by the query afterwards.
+	*/
+	void Restrict (cliGatherOptions& options) const;
+
+private:
+	struct Predicate
+	{
+		// Empty for index predicates
+		PropertyPredicate	condition;
+
+		// -1 selects all nodes
+		int					index;
+	};
+
+	struct Step
+	{
+		// Empty for '*'
+		std::string				name;
+		std::vector<Predicate>	predicates;
+	};
+
+	void Analyze ();
+
+	static bool Matches (const cliNode* node, const PropertyPredicate& condition);
+
+	std::vector<Step>	steps_;
+
+	bool						allProperties_ = false;
+	std::vector<std::string>	properties_;
+	std::vector<const char*>	propertyList_;
+	std::uint64_t				deviceTypes_ = 0;
+	bool						imageFormats_ = false;
+	bool						derived_ = false;
+};
+}
+
+#endif
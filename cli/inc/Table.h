@@ -0,0 +1,40 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_TABLE_H_5A9C3E7B1D4F4A2C8E6B0D9F3A5C7E1B4D8F2A63
+#define NIV_OPENCLINFO_TABLE_H_5A9C3E7B1D4F4A2C8E6B0D9F3A5C7E1B4D8F2A63
+
+#include <clInfo.h>
+
+#include "Writer.h"
+
+namespace niv {
+enum TableFormat
+{
+	// Comma separated, fields are quoted as described in RFC 4180 if needed
+	TableFormat_Csv,
+
+	// Tab separated, tabs, line breaks and backslashes in fields are escaped
+	// with a backslash, as \t, \n, \r and \\ respectively
+	TableFormat_Tsv
+};
+
+/**
+Write one row per device, and one column per property.
+
+The first row is the header. It starts with the Platform and Device columns,
+which hold the index of the platform and of the device within the platform.
+They are followed by the union of all platform properties, and then by the
+union of all device properties, each in the order in which they first occur
+in the tree. Properties which a device or its platform does not have are left
+empty. Multiple values are joined with ';'.
+
+The column names are collected in a first pass over the platform and device
+nodes, after which the rows are streamed.
+*/
+void WriteTable (Writer& w, const cliNode* root, TableFormat format);
+}
+
+#endif
@@ -0,0 +1,302 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_TREEVISITOR_H_5C9A2E7F1B3D4A6C8E0F2B4D6A8C0E2F4B6D8A1C
+#define NIV_OPENCLINFO_TREEVISITOR_H_5C9A2E7F1B3D4A6C8E0F2B4D6A8C0E2F4B6D8A1C
+
+#include <clInfo.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace niv {
+/**
+Walks a tree in depth-first order and calls the hooks of Derived.
+
+This uses the curiously recurring template pattern: Derived inherits from
+TreeVisitor<Derived> and hides the hooks it is interested in. All calls are
+resolved at compile time, so there is no virtual call per node or value. For
+each node, the hooks are called in this order:
+
+	BeginNode
+	for each property: BeginProperty, one value hook per value, EndProperty
+	BeginChildren
+	the children, recursively
+	EndNode
+
+index is the position of the node, property or value among its siblings,
+which is useful for separators. depth is 0 for the root.
+*/
+template <typename Derived>
+class TreeVisitor
+{
+public:
+	void Visit (const cliNode* root)
+	{
+		VisitNode (root, 0, 0);
+	}
+
+	void BeginNode (const cliNode* /* node */, const int /* depth */,
+		const int /* index */)
+	{
+	}
+
+	void BeginProperty (const cliProperty* /* property */, const int /* index */)
+	{
+	}
+
+	void OnBool (const bool /* value */, const int /* index */)
+	{
+	}
+
+	void OnInt (const std::int64_t /* value */, const int /* index */)
+	{
+	}
+
+	void OnString (const char* /* value */, const int /* index */)
+	{
+	}
+
+	void EndProperty (const cliProperty* /* property */)
+	{
+	}
+
+	void BeginChildren (const cliNode* /* node */, const int /* depth */)
+	{
+	}
+
+	void EndNode (const cliNode* /* node */, const int /* depth */)
+	{
+	}
+
+private:
+	Derived& Self ()
+	{
+		return static_cast<Derived&> (*this);
+	}
+
+	void VisitNode (const cliNode* node, const int depth, const int index)
+	{
+		Self ().BeginNode (node, depth, index);
+
+		int propertyIndex = 0;
+		for (auto p = node->firstProperty; p; p = p->next) {
+			Self ().BeginProperty (p, propertyIndex++);
+
+			int valueIndex = 0;
+			for (auto v = p->value; v; v = v->next) {
+				switch (p->type) {
+				case CLI_PropertyType_Bool:
+					Self ().OnBool (v->b, valueIndex);
+					break;
+
+				case CLI_PropertyType_Int64:
+					Self ().OnInt (v->i, valueIndex);
+					break;
+
+				case CLI_PropertyType_String:
+					Self ().OnString (v->s, valueIndex);
+					break;
+				}
+
+				++valueIndex;
+			}
+
+			Self ().EndProperty (p);
+		}
+
+		Self ().BeginChildren (node, depth);
+
+		int childIndex = 0;
+		for (auto n = node->firstChild; n; n = n->next) {
+			VisitNode (n, depth + 1, childIndex++);
+		}
+
+		Self ().EndNode (node, depth);
+	}
+};
+
+namespace detail {
+template <typename Visitor>
+struct VisitorTag
+{
+};
+
+/**
+Holds a list of visitors for each type in Visitors, and forwards every hook to
+all of them.
+*/
+template <typename... Visitors>
+class VisitorLists
+{
+public:
+	void Get (VisitorTag<void>);
+
+	void BeginNode (const cliNode*, const int, const int) {}
+	void BeginProperty (const cliProperty*, const int) {}
+	void OnBool (const bool, const int) {}
+	void OnInt (const std::int64_t, const int) {}
+	void OnString (const char*, const int) {}
+	void EndProperty (const cliProperty*) {}
+	void BeginChildren (const cliNode*, const int) {}
+	void EndNode (const cliNode*, const int) {}
+};
+
+template <typename Visitor, typename... Rest>
+class VisitorLists<Visitor, Rest...> : public VisitorLists<Rest...>
+{
+	typedef VisitorLists<Rest...> Base;
+
+public:
+	using Base::Get;
+
+	std::vector<Visitor>& Get (VisitorTag<Visitor>)
+	{
+		return visitors_;
+	}
+
+	void BeginNode (const cliNode* node, const int depth, const int index)
+	{
+		for (auto& v : visitors_) {
+			v.BeginNode (node, depth, index);
+		}
+
+		Base::BeginNode (node, depth, index);
+	}
+
+	void BeginProperty (const cliProperty* property, const int index)
+	{
+		for (auto& v : visitors_) {
+			v.BeginProperty (property, index);
+		}
+
+		Base::BeginProperty (property, index);
+	}
+
+	void OnBool (const bool value, const int index)
+	{
+		for (auto& v : visitors_) {
+			v.OnBool (value, index);
+		}
+
+		Base::OnBool (value, index);
+	}
+
+	void OnInt (const std::int64_t value, const int index)
+	{
+		for (auto& v : visitors_) {
+			v.OnInt (value, index);
+		}
+
+		Base::OnInt (value, index);
+	}
+
+	void OnString (const char* value, const int index)
+	{
+		for (auto& v : visitors_) {
+			v.OnString (value, index);
+		}
+
+		Base::OnString (value, index);
+	}
+
+	void EndProperty (const cliProperty* property)
+	{
+		for (auto& v : visitors_) {
+			v.EndProperty (property);
+		}
+
+		Base::EndProperty (property);
+	}
+
+	void BeginChildren (const cliNode* node, const int depth)
+	{
+		for (auto& v : visitors_) {
+			v.BeginChildren (node, depth);
+		}
+
+		Base::BeginChildren (node, depth);
+	}
+
+	void EndNode (const cliNode* node, const int depth)
+	{
+		for (auto& v : visitors_) {
+			v.EndNode (node, depth);
+		}
+
+		Base::EndNode (node, depth);
+	}
+
+private:
+	std::vector<Visitor>	visitors_;
+};
+}
+
+/**
+Runs any number of visitors in a single traversal of the tree.
+
+Visitors lists all visitor types which can be added. Each hook is forwarded to
+all added visitors of the first type, then the second type and so on, without
+any virtual calls.
+*/
+template <typename... Visitors>
+class FanoutVisitor : public TreeVisitor<FanoutVisitor<Visitors...>>
+{
+public:
+	template <typename Visitor, typename... Args>
+	Visitor& Add (Args&&... args)
+	{
+		auto& visitors = lists_.Get (detail::VisitorTag<Visitor> ());
+		visitors.emplace_back (std::forward<Args> (args)...);
+		return visitors.back ();
+	}
+
+	void BeginNode (const cliNode* node, const int depth, const int index)
+	{
+		lists_.BeginNode (node, depth, index);
+	}
+
+	void BeginProperty (const cliProperty* property, const int index)
+	{
+		lists_.BeginProperty (property, index);
+	}
+
+	void OnBool (const bool value, const int index)
+	{
+		lists_.OnBool (value, index);
+	}
+
+	void OnInt (const std::int64_t value, const int index)
+	{
+		lists_.OnInt (value, index);
+	}
+
+	void OnString (const char* value, const int index)
+	{
+		lists_.OnString (value, index);
+	}
+
+	void EndProperty (const cliProperty* property)
+	{
+		lists_.EndProperty (property);
+	}
+
+	void BeginChildren (const cliNode* node, const int depth)
+	{
+		lists_.BeginChildren (node, depth);
+	}
+
+	void EndNode (const cliNode* node, const int depth)
+	{
+		lists_.EndNode (node, depth);
+	}
+
+private:
+	detail::VisitorLists<Visitors...>	lists_;
+};
+}
+
+#endif
@@ -0,0 +1,148 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_WRITER_H_3F1B6C0A9E2D4F7B8C5A1D6E0F9B2C7A4E8D1F63
+#define NIV_OPENCLINFO_WRITER_H_3F1B6C0A9E2D4F7B8C5A1D6E0F9B2C7A4E8D1F63
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace niv {
+/**
+Buffered output to a file descriptor.
+
+Output is collected in a large buffer, which is passed to write(2) whenever it
+is full, and on Flush(). Integers are formatted without going through the
+locale machinery of iostreams, and strings which need to be escaped are
+scanned several bytes at a time.
+
+If backgroundFlush is set, the writer owns a thread which passes full buffers to
+the file descriptor, while the caller continues to format into a second
+buffer. This allows writing several outputs at the same time from a single
+thread, without waiting for each write(2) in turn.
+
+Errors are sticky: once a write has failed, further output is discarded and
+Failed() returns true.
+*/
+class Writer
+{
+public:
+	explicit Writer (int fd, std::size_t capacity = 1 << 16,
+		bool backgroundFlush = false);
+
+	/**
+	Append the output to target instead of a file descriptor, for instance to
+	send it elsewhere afterwards. Writing to memory cannot fail.
+	*/
+	explicit Writer (std::vector<char>& target, std::size_t capacity = 1 << 16);
+
+	~Writer ();
+
+	Writer (const Writer&) = delete;
+	Writer& operator= (const Writer&) = delete;
+
+	void Write (const char* s, std::size_t length)
+	{
+		if (length > capacity_ - size_) {
+			WriteSlow (s, length);
+			return;
+		}
+
+		::memcpy (buffer_.data () + size_, s, length);
+		size_ += length;
+	}
+
+	void Write (const char* s)
+	{
+		Write (s, ::strlen (s));
+	}
+
+	template <std::size_t N>
+	void WriteLiteral (const char (&s)[N])
+	{
+		Write (s, N - 1);
+	}
+
+	void Put (const char c)
+	{
+		if (size_ == capacity_) {
+			Submit ();
+		}
+
+		buffer_ [size_++] = c;
+	}
+
+	void Fill (const char c, std::size_t count);
+
+	void WriteInt (std::int64_t value);
+
+	/**
+	Write s as the contents of a JSON string, without the quotes.
+	*/
+	void WriteJsonEscaped (const char* s);
+
+	/**
+	Write s as XML character data, suitable for both elements and attribute
+	values. Characters which are not allowed in XML are dropped.
+	*/
+	void WriteXmlEscaped (const char* s);
+
+	/**
+	Pass all buffered output to the file descriptor, and wait until it has
+	been written. Returns false if writing failed at any point.
+	*/
+	bool Flush ();
+
+	bool Failed () const
+	{
+		return failed_;
+	}
+
+	/**
+	Number of bytes passed to the file descriptor so far.
+	*/
+	std::uint64_t GetBytesWritten () const
+	{
+		return bytesWritten_;
+	}
+
+private:
+	void WriteSlow (const char* s, std::size_t length);
+
+	/**
+	Hand the current buffer off for writing. With a background thread, this
+	only waits until the previous buffer has been written.
+	*/
+	void Submit ();
+	void WriteOut (const char* data, std::size_t size);
+	void Run ();
+
+	int							fd_;
+	std::vector<char>*			target_ = nullptr;
+	std::atomic<bool>			failed_ {false};
+	std::atomic<std::uint64_t>	bytesWritten_ {0};
+
+	std::vector<char>	buffer_;
+	std::size_t			size_ = 0;
+	std::size_t			capacity_;
+
+	// Used with backgroundFlush only: pending_ is owned by the background
+	// thread while pendingSize_ is non-zero
+	std::vector<char>		pending_;
+	std::size_t				pendingSize_ = 0;
+	bool					stop_ = false;
+	std::mutex				mutex_;
+	std::condition_variable	condition_;
+	std::thread				thread_;
+};
+}
+
+#endif
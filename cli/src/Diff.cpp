@@ -0,0 +1,352 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "Diff.h"
+#include "Printers.h"
+
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+namespace niv {
+namespace {
+const char* const platformKeyProperties [] = {
+	"CL_PLATFORM_NAME", "CL_PLATFORM_VENDOR"
+};
+
+const char* const deviceKeyProperties [] = {
+	"CL_DEVICE_NAME", "CL_DEVICE_VENDOR"
+};
+
+////////////////////////////////////////////////////////////////////////////////
+const cliProperty* FindProperty (const cliNode* node, const char* name)
+{
+	for (auto p = node->firstProperty; p; p = p->next) {
+		if (::strcmp (p->name, name) == 0) {
+			return p;
+		}
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AppendValues (std::string& s, const cliProperty* property)
+{
+	for (auto v = property->value; v; v = v->next) {
+		if (v != property->value) {
+			s += ',';
+		}
+
+		switch (property->type) {
+		case CLI_PropertyType_Bool:
+			s += v->b ? "true" : "false";
+			break;
+
+		case CLI_PropertyType_Int64:
+			s += std::to_string (v->i);
+			break;
+
+		case CLI_PropertyType_String:
+			s += v->s;
+			break;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool EqualValues (const cliProperty* a, const cliProperty* b)
+{
+	if (a->type != b->type) {
+		return false;
+	}
+
+	auto va = a->value;
+	auto vb = b->value;
+
+	for (; va && vb; va = va->next, vb = vb->next) {
+		switch (a->type) {
+		case CLI_PropertyType_Bool:
+			if (va->b != vb->b) {
+				return false;
+			}
+			break;
+
+		case CLI_PropertyType_Int64:
+			if (va->i != vb->i) {
+				return false;
+			}
+			break;
+
+		case CLI_PropertyType_String:
+			if (::strcmp (va->s, vb->s) != 0) {
+				return false;
+			}
+			break;
+		}
+	}
+
+	return va == nullptr && vb == nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string NodeKey (const cliNode* node)
+{
+	std::string identity = node->kind ? node->kind : "";
+
+	const auto addPart = [&identity] (const cliProperty* p) -> void {
+		if (! identity.empty ()) {
+			identity += '|';
+		}
+
+		AppendValues (identity, p);
+	};
+
+	if (::strcmp (node->name, "Platform") == 0) {
+		for (const auto name : platformKeyProperties) {
+			if (const auto p = FindProperty (node, name)) {
+				addPart (p);
+			}
+		}
+	} else if (::strcmp (node->name, "Device") == 0) {
+		for (const auto name : deviceKeyProperties) {
+			if (const auto p = FindProperty (node, name)) {
+				addPart (p);
+			}
+		}
+	} else if (::strcmp (node->name, "Format") == 0) {
+		// Formats have no identity apart from their contents
+		for (auto p = node->firstProperty; p; p = p->next) {
+			addPart (p);
+		}
+	}
+
+	std::string key = node->name;
+
+	if (! identity.empty ()) {
+		key += '[';
+		key += identity;
+		key += ']';
+	}
+
+	return key;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string PropertyKey (const cliProperty* property)
+{
+	return property->name;
+}
+
+/**
+The elements of a list with their keys. Elements with the same key are
+numbered in order, so the keys are unique.
+*/
+template <typename T>
+using KeyedList = std::vector<std::pair<std::string, const T*>>;
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+KeyedList<T> CreateKeyedList (const T* first, std::string (*key) (const T*))
+{
+	KeyedList<T> result;
+	std::unordered_map<std::string, int> occurrences;
+
+	for (auto element = first; element; element = element->next) {
+		auto k = key (element);
+		const auto n = occurrences [k]++;
+
+		if (n > 0) {
+			k += '#';
+			k += std::to_string (n);
+		}
+
+		result.emplace_back (std::move (k), element);
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Match the elements of two lists by key. matched is called for all pairs, and
+removed for elements of before without a match, both in the order of before.
+Afterwards, added is called for elements of after without a match.
+*/
+template <typename T, typename Matched, typename Removed, typename Added>
+void MatchLists (const KeyedList<T>& before, const KeyedList<T>& after,
+	Matched matched, Removed removed, Added added)
+{
+	std::unordered_map<std::string, std::size_t> index;
+	index.reserve (after.size ());
+
+	for (std::size_t i = 0; i < after.size (); ++i) {
+		index.emplace (after [i].first, i);
+	}
+
+	std::vector<bool> used (after.size (), false);
+
+	for (const auto& element : before) {
+		const auto it = index.find (element.first);
+
+		if (it == index.end ()) {
+			removed (element.first, element.second);
+		} else {
+			used [it->second] = true;
+			matched (element.first, element.second, after [it->second].second);
+		}
+	}
+
+	for (std::size_t i = 0; i < after.size (); ++i) {
+		if (! used [i]) {
+			added (after [i].first, after [i].second);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void DiffNodes (const cliNode* before, const cliNode* after,
+	const std::string& path, std::vector<Change>& changes)
+{
+	const auto change = [&changes] (const Change::Type type,
+		const std::string& p, const cliProperty* b, const cliProperty* a) -> void {
+		Change c;
+		c.type = type;
+		c.path = p;
+		c.before = b;
+		c.after = a;
+		changes.push_back (c);
+	};
+
+	MatchLists (CreateKeyedList (before->firstProperty, PropertyKey),
+		CreateKeyedList (after->firstProperty, PropertyKey),
+		[&] (const std::string&, const cliProperty* b, const cliProperty* a) -> void {
+			if (! EqualValues (b, a)) {
+				change (Change::Type_Changed, path, b, a);
+			}
+		},
+		[&] (const std::string&, const cliProperty* b) -> void {
+			change (Change::Type_Removed, path, b, nullptr);
+		},
+		[&] (const std::string&, const cliProperty* a) -> void {
+			change (Change::Type_Added, path, nullptr, a);
+		});
+
+	MatchLists (CreateKeyedList (before->firstChild, NodeKey),
+		CreateKeyedList (after->firstChild, NodeKey),
+		[&] (const std::string& key, const cliNode* b, const cliNode* a) -> void {
+			DiffNodes (b, a, path + '/' + key, changes);
+		},
+		[&] (const std::string& key, const cliNode*) -> void {
+			change (Change::Type_Removed, path + '/' + key, nullptr, nullptr);
+		},
+		[&] (const std::string& key, const cliNode*) -> void {
+			change (Change::Type_Added, path + '/' + key, nullptr, nullptr);
+		});
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::vector<Change> DiffTrees (const cliNode* before, const cliNode* after)
+{
+	std::vector<Change> changes;
+
+	const auto beforeKey = NodeKey (before);
+	const auto afterKey = NodeKey (after);
+
+	if (beforeKey != afterKey) {
+		Change removed = { Change::Type_Removed, beforeKey, nullptr, nullptr };
+		Change added = { Change::Type_Added, afterKey, nullptr, nullptr };
+		changes.push_back (removed);
+		changes.push_back (added);
+	} else {
+		DiffNodes (before, after, beforeKey, changes);
+	}
+
+	return changes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteChangesConsole (Writer& w, const std::vector<Change>& changes)
+{
+	for (const auto& change : changes) {
+		switch (change.type) {
+		case Change::Type_Added: w.WriteLiteral ("+ "); break;
+		case Change::Type_Removed: w.WriteLiteral ("- "); break;
+		case Change::Type_Changed: w.WriteLiteral ("~ "); break;
+		}
+
+		w.Write (change.path.data (), change.path.size ());
+
+		const auto property = change.before ? change.before : change.after;
+
+		if (property) {
+			w.Put ('/');
+			w.Write (property->name);
+			w.WriteLiteral (": ");
+
+			if (change.before) {
+				WriteConsoleValues (w, change.before);
+			}
+
+			if (change.before && change.after) {
+				w.WriteLiteral (" -> ");
+			}
+
+			if (change.after) {
+				WriteConsoleValues (w, change.after);
+			}
+		}
+
+		w.Put ('\n');
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteChangesJson (Writer& w, const std::vector<Change>& changes)
+{
+	w.WriteLiteral ("{\"Changes\":[");
+
+	for (std::size_t i = 0; i < changes.size (); ++i) {
+		const auto& change = changes [i];
+
+		if (i > 0) {
+			w.Put (',');
+		}
+
+		w.WriteLiteral ("{\"Type\":");
+
+		switch (change.type) {
+		case Change::Type_Added: w.WriteLiteral ("\"Added\""); break;
+		case Change::Type_Removed: w.WriteLiteral ("\"Removed\""); break;
+		case Change::Type_Changed: w.WriteLiteral ("\"Changed\""); break;
+		}
+
+		w.WriteLiteral (",\"Path\":\"");
+		w.WriteJsonEscaped (change.path.c_str ());
+		w.Put ('"');
+
+		const auto property = change.before ? change.before : change.after;
+
+		if (property) {
+			w.WriteLiteral (",\"Property\":\"");
+			w.WriteJsonEscaped (property->name);
+			w.Put ('"');
+		}
+
+		if (change.before) {
+			w.WriteLiteral (",\"Before\":");
+			WriteJsonValues (w, change.before);
+		}
+
+		if (change.after) {
+			w.WriteLiteral (",\"After\":");
+			WriteJsonValues (w, change.after);
+		}
+
+		w.Put ('}');
+	}
+
+	w.WriteLiteral ("]}\n");
+}
+}
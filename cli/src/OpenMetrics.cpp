@@ -0,0 +1,232 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "OpenMetrics.h"
+
+#include <cstring>
+#include <vector>
+
+namespace niv {
+namespace {
+struct Metric
+{
+	const char*		name;
+	const char*		property;
+	const char*		help;
+
+	// The first value of the property is multiplied by this
+	std::int64_t	scale;
+};
+
+const Metric metrics [] = {
+	{ "opencl_device_available", "CL_DEVICE_AVAILABLE",
+		"Whether the device is available.", 1 },
+	{ "opencl_device_compiler_available", "CL_DEVICE_COMPILER_AVAILABLE",
+		"Whether a compiler is available for the device.", 1 },
+	{ "opencl_device_global_mem_size_bytes", "CL_DEVICE_GLOBAL_MEM_SIZE",
+		"Size of global device memory in bytes.", 1 },
+	{ "opencl_device_global_free_memory_bytes", "CL_DEVICE_GLOBAL_FREE_MEMORY_AMD",
+		"Free global device memory in bytes, AMD devices only.", 1024 },
+	{ "opencl_device_max_mem_alloc_size_bytes", "CL_DEVICE_MAX_MEM_ALLOC_SIZE",
+		"Maximum size of a memory object allocation in bytes.", 1 },
+	{ "opencl_device_local_mem_size_bytes", "CL_DEVICE_LOCAL_MEM_SIZE",
+		"Size of local memory in bytes.", 1 },
+	{ "opencl_device_max_compute_units", "CL_DEVICE_MAX_COMPUTE_UNITS",
+		"Number of parallel compute units.", 1 },
+	{ "opencl_device_max_clock_frequency_megahertz", "CL_DEVICE_MAX_CLOCK_FREQUENCY",
+		"Maximum configured clock frequency in MHz.", 1 }
+};
+
+const struct
+{
+	const char*	label;
+	const char*	property;
+} infoLabels [] = {
+	{ "type", "CL_DEVICE_TYPE" },
+	{ "version", "CL_DEVICE_VERSION" },
+	{ "driver_version", "CL_DRIVER_VERSION" }
+};
+
+/**
+A device together with the labels identifying it.
+*/
+struct Device
+{
+	const cliNode*	platform;
+	const cliNode*	device;
+	int				platformIndex;
+	int				deviceIndex;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+const cliProperty* FindProperty (const cliNode* node, const char* name)
+{
+	for (auto p = node->firstProperty; p; p = p->next) {
+		if (::strcmp (p->name, name) == 0) {
+			return p;
+		}
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const cliNode* FindChild (const cliNode* node, const char* name)
+{
+	for (auto c = node->firstChild; c; c = c->next) {
+		if (::strcmp (c->name, name) == 0) {
+			return c;
+		}
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteLabelValue (Writer& w, const char* s)
+{
+	for (; *s; ++s) {
+		switch (*s) {
+		case '\\': w.WriteLiteral ("\\\\"); break;
+		case '"': w.WriteLiteral ("\\\""); break;
+		case '\n': w.WriteLiteral ("\\n"); break;
+		default: w.Put (*s); break;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Write the value of a string property as a label value, with multiple values
+separated by ','.
+*/
+void WriteLabelValue (Writer& w, const cliProperty* property)
+{
+	if (property == nullptr || property->type != CLI_PropertyType_String) {
+		return;
+	}
+
+	for (auto v = property->value; v; v = v->next) {
+		if (v != property->value) {
+			w.Put (',');
+		}
+
+		WriteLabelValue (w, v->s);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteLabels (Writer& w, const Device& device)
+{
+	w.WriteLiteral ("{platform=\"");
+	WriteLabelValue (w, FindProperty (device.platform, "CL_PLATFORM_NAME"));
+	w.WriteLiteral ("\",platform_index=\"");
+	w.WriteInt (device.platformIndex);
+	w.WriteLiteral ("\",device=\"");
+	WriteLabelValue (w, FindProperty (device.device, "CL_DEVICE_NAME"));
+	w.WriteLiteral ("\",device_index=\"");
+	w.WriteInt (device.deviceIndex);
+	w.Put ('"');
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteHeader (Writer& w, const char* name, const char* help)
+{
+	w.WriteLiteral ("# TYPE ");
+	w.Write (name);
+	w.WriteLiteral (" gauge\n# HELP ");
+	w.Write (name);
+	w.Put (' ');
+	w.Write (help);
+	w.Put ('\n');
+}
+}
+
+const char* const openMetricsProperties [] = {
+	"CL_PLATFORM_NAME",
+	"CL_DEVICE_NAME",
+	"CL_DEVICE_TYPE",
+	"CL_DEVICE_VERSION",
+	"CL_DRIVER_VERSION",
+	"CL_DEVICE_AVAILABLE",
+	"CL_DEVICE_COMPILER_AVAILABLE",
+	"CL_DEVICE_GLOBAL_MEM_SIZE",
+	"CL_DEVICE_GLOBAL_FREE_MEMORY_AMD",
+	"CL_DEVICE_MAX_MEM_ALLOC_SIZE",
+	"CL_DEVICE_LOCAL_MEM_SIZE",
+	"CL_DEVICE_MAX_COMPUTE_UNITS",
+	"CL_DEVICE_MAX_CLOCK_FREQUENCY",
+	nullptr
+};
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteOpenMetrics (Writer& w, const cliNode* root)
+{
+	std::vector<Device> devices;
+
+	int platformIndex = 0;
+	for (auto platform = root->firstChild; platform; platform = platform->next) {
+		if (const auto devicesNode = FindChild (platform, "Devices")) {
+			int deviceIndex = 0;
+			for (auto device = devicesNode->firstChild; device; device = device->next) {
+				Device d = { platform, device, platformIndex, deviceIndex++ };
+				devices.push_back (d);
+			}
+		}
+
+		++platformIndex;
+	}
+
+	WriteHeader (w, "opencl_device_info",
+		"Device information, the value is always 1.");
+
+	for (const auto& device : devices) {
+		w.WriteLiteral ("opencl_device_info");
+		WriteLabels (w, device);
+
+		for (const auto& label : infoLabels) {
+			w.Put (',');
+			w.Write (label.label);
+			w.WriteLiteral ("=\"");
+			WriteLabelValue (w, FindProperty (device.device, label.property));
+			w.Put ('"');
+		}
+
+		w.WriteLiteral ("} 1\n");
+	}
+
+	for (const auto& metric : metrics) {
+		bool headerWritten = false;
+
+		for (const auto& device : devices) {
+			const auto property = FindProperty (device.device, metric.property);
+
+			if (property == nullptr || property->value == nullptr ||
+				property->type == CLI_PropertyType_String) {
+				continue;
+			}
+
+			// Metrics only present on some vendors are left out completely
+			// if no device has them
+			if (! headerWritten) {
+				WriteHeader (w, metric.name, metric.help);
+				headerWritten = true;
+			}
+
+			w.Write (metric.name);
+			WriteLabels (w, device);
+			w.WriteLiteral ("} ");
+
+			if (property->type == CLI_PropertyType_Bool) {
+				w.Put (property->value->b ? '1' : '0');
+			} else {
+				w.WriteInt (property->value->i * metric.scale);
+			}
+
+			w.Put ('\n');
+		}
+	}
+
+	w.WriteLiteral ("# EOF\n");
+}
+}
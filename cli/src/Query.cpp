@@ -0,0 +1,320 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "Query.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace niv {
+namespace {
+// The names of all nodes in the tree; any other name is a property
+const char* const nodeNames [] = {
+	"Platforms", "Platform", "Devices", "Device",
+	"ImageFormats", "ObjectType", "Format", "Derived", "Metric"
+};
+
+const char* const imageFormatNodeNames [] = {
+	"ImageFormats", "ObjectType", "Format"
+};
+
+// Only present with CLI_GatherFlag_Derived
+const char* const derivedNodeNames [] = {
+	"Derived", "Metric"
+};
+
+// CL_DEVICE_TYPE_* bits from cl.h, which the command line tool does not use.
+// CL_DEVICE_TYPE_DEFAULT is not passed on, as clGetDeviceIDs returns only a
+// single device for it.
+const struct
+{
+	const char*		name;
+	std::uint64_t	bit;
+} deviceTypes [] = {
+	{ "CPU", 1 << 1 },
+	{ "GPU", 1 << 2 },
+	{ "ACCELERATOR", 1 << 3 },
+	{ "CUSTOM", 1 << 4 }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+template <std::size_t Size>
+bool Contains (const char* const (&names)[Size], const std::string& name)
+{
+	for (const auto n : names) {
+		if (name == n) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void SkipSpaces (const char*& p)
+{
+	while (*p == ' ' || *p == '\t') {
+		++p;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+[[noreturn]] void Fail (const char* message, const char* text, const char* p)
+{
+	throw std::runtime_error (std::string (message) + " at position " +
+		std::to_string (p - text) + " of '" + text + "'");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string ParseName (const char*& p)
+{
+	const auto start = p;
+	while (IsNameCharacter (*p)) {
+		++p;
+	}
+
+	return std::string (start, p);
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Query::Query (const char* text)
+{
+	const auto end = text + ::strlen (text);
+	auto p = text;
+
+	for (;;) {
+		SkipSpaces (p);
+
+		Step step;
+
+		if (*p == '*') {
+			++p;
+		} else {
+			step.name = ParseName (p);
+
+			if (step.name.empty ()) {
+				Fail ("Expected a name or '*'", text, p);
+			}
+		}
+
+		SkipSpaces (p);
+
+		while (*p == '[') {
+			++p;
+			SkipSpaces (p);
+
+			Predicate predicate;
+			predicate.index = -1;
+
+			if (*p == '*') {
+				++p;
+			} else if (std::isdigit (static_cast<unsigned char> (*p))) {
+				const auto start = p;
+				while (std::isdigit (static_cast<unsigned char> (*p))) {
+					++p;
+				}
+
+				predicate.index = std::atoi (std::string (start, p).c_str ());
+			} else if (IsNameCharacter (*p)) {
+				if (const auto message = ParsePredicate (p, end, "]",
+					predicate.condition)) {
+					Fail (message, text, p);
+				}
+			} else {
+				Fail ("Expected an index, '*' or a property name", text, p);
+			}
+
+			SkipSpaces (p);
+
+			if (*p != ']') {
+				Fail ("Expected ']'", text, p);
+			}
+
+			++p;
+			SkipSpaces (p);
+
+			step.predicates.push_back (predicate);
+		}
+
+		steps_.push_back (step);
+
+		if (*p == '\0') {
+			break;
+		} else if (*p == '/') {
+			++p;
+		} else {
+			Fail ("Expected '/' or '['", text, p);
+		}
+	}
+
+	Analyze ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Find out which properties, devices and nodes the query can possibly look at.
+*/
+void Query::Analyze ()
+{
+	bool wildcard = false;
+	bool imageFormats = false;
+
+	const auto addProperty = [this] (const std::string& name) -> void {
+		if (std::find (properties_.begin (), properties_.end (), name) ==
+			properties_.end ()) {
+			properties_.push_back (name);
+		}
+	};
+
+	for (const auto& step : steps_) {
+		if (step.name.empty ()) {
+			wildcard = true;
+		} else if (Contains (imageFormatNodeNames, step.name)) {
+			imageFormats = true;
+		} else if (Contains (derivedNodeNames, step.name)) {
+			derived_ = true;
+		}
+
+		bool indexed = false;
+
+		for (const auto& predicate : step.predicates) {
+			const auto& condition = predicate.condition;
+
+			if (condition.property.empty ()) {
+				indexed = indexed || predicate.index >= 0;
+				continue;
+			}
+
+			addProperty (condition.property);
+
+			// Devices can only be filtered by the driver if this does not
+			// change which device an index predicate refers to
+			if (step.name == "Device" && ! indexed && deviceTypes_ == 0 &&
+				condition.property == "CL_DEVICE_TYPE" &&
+				condition.op == PredicateOperator_Equal) {
+				for (const auto& type : deviceTypes) {
+					if (EqualsEnumValue ((std::string ("CL_DEVICE_TYPE_") +
+						type.name).c_str (), condition.value)) {
+						deviceTypes_ = type.bit;
+					}
+				}
+			}
+		}
+	}
+
+	const auto& last = steps_.back ();
+	const bool selectsNodes = last.name.empty () || ! last.predicates.empty () ||
+		Contains (nodeNames, last.name);
+
+	// Selected nodes are printed with all their properties and descendants
+	if (wildcard || selectsNodes) {
+		allProperties_ = true;
+	} else {
+		addProperty (last.name);
+	}
+
+	imageFormats_ = wildcard || imageFormats || selectsNodes;
+
+	for (const auto& property : properties_) {
+		propertyList_.push_back (property.c_str ());
+	}
+
+	propertyList_.push_back (nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Query::Matches (const cliNode* node, const PropertyPredicate& condition)
+{
+	for (auto p = node->firstProperty; p; p = p->next) {
+		if (condition.property == p->name) {
+			return MatchesPredicate (p, condition);
+		}
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::vector<Query::Match> Query::Evaluate (const cliNode* root) const
+{
+	std::vector<Match> result;
+	std::vector<const cliNode*> current (1, root);
+	std::vector<const cliNode*> next;
+	std::vector<const cliNode*> candidates;
+
+	for (std::size_t i = 0; i < steps_.size (); ++i) {
+		const auto& step = steps_ [i];
+		const bool last = (i + 1) == steps_.size ();
+
+		next.clear ();
+
+		for (const auto node : current) {
+			// Properties can only be selected by the last step
+			if (last && step.predicates.empty ()) {
+				for (auto p = node->firstProperty; p; p = p->next) {
+					if (step.name.empty () || step.name == p->name) {
+						Match match = { node, p };
+						result.push_back (match);
+					}
+				}
+			}
+
+			candidates.clear ();
+			for (auto c = node->firstChild; c; c = c->next) {
+				if (step.name.empty () || step.name == c->name) {
+					candidates.push_back (c);
+				}
+			}
+
+			for (const auto& predicate : step.predicates) {
+				if (! predicate.condition.property.empty ()) {
+					const auto& condition = predicate.condition;
+					candidates.erase (std::remove_if (candidates.begin (),
+						candidates.end (), [&condition] (const cliNode* n) -> bool {
+							return ! Matches (n, condition);
+						}), candidates.end ());
+				} else if (predicate.index >= 0) {
+					if (static_cast<std::size_t> (predicate.index) < candidates.size ()) {
+						candidates [0] = candidates [predicate.index];
+						candidates.resize (1);
+					} else {
+						candidates.clear ();
+					}
+				}
+			}
+
+			if (last) {
+				for (const auto c : candidates) {
+					Match match = { c, nullptr };
+					result.push_back (match);
+				}
+			} else {
+				next.insert (next.end (), candidates.begin (), candidates.end ());
+			}
+		}
+
+		current.swap (next);
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Query::Restrict (cliGatherOptions& options) const
+{
+	options.properties = allProperties_ ? nullptr : propertyList_.data ();
+	options.deviceTypes = deviceTypes_;
+
+	if (! imageFormats_) {
+		options.flags |= CLI_GatherFlag_SkipImageFormats;
+	}
+
+	if (derived_) {
+		options.flags |= CLI_GatherFlag_Derived;
+	}
+}
+}
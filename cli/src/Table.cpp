@@ -0,0 +1,275 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "Table.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace niv {
+namespace {
+/**
+The column names of a table, with a fast path for the common case that all
+nodes have their properties in the same order.
+*/
+class Columns
+{
+public:
+	/**
+	Find the column of a property, or -1. hint is the column which is
+	checked first.
+	*/
+	int Find (const char* name, const int hint) const
+	{
+		if (hint >= 0 && hint < Size () &&
+			::strcmp (names_ [hint], name) == 0) {
+			return hint;
+		}
+
+		const auto it = index_.find (name);
+		return it == index_.end () ? -1 : it->second;
+	}
+
+	int Add (const char* name)
+	{
+		const auto column = Size ();
+		names_.push_back (name);
+		index_.emplace (name, column);
+		return column;
+	}
+
+	int Size () const
+	{
+		return static_cast<int> (names_.size ());
+	}
+
+	const char* operator [] (const int column) const
+	{
+		return names_ [column];
+	}
+
+private:
+	std::vector<const char*>				names_;
+	std::unordered_map<std::string, int>	index_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+const cliNode* FindChild (const cliNode* node, const char* name)
+{
+	for (auto c = node->firstChild; c; c = c->next) {
+		if (::strcmp (c->name, name) == 0) {
+			return c;
+		}
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Add the properties of a node which are not a column yet.
+*/
+void AddColumns (Columns& columns, const cliNode* node)
+{
+	int hint = 0;
+
+	for (auto p = node->firstProperty; p; p = p->next) {
+		auto column = columns.Find (p->name, hint);
+
+		if (column < 0) {
+			column = columns.Add (p->name);
+		}
+
+		hint = column + 1;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Store the properties of a node in the slots of their columns.
+*/
+void FillSlots (const Columns& columns, const cliNode* node,
+	std::vector<const cliProperty*>& slots)
+{
+	int hint = 0;
+
+	for (auto p = node->firstProperty; p; p = p->next) {
+		const auto column = columns.Find (p->name, hint);
+		slots [column] = p;
+		hint = column + 1;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteField (Writer& w, const char* s, const TableFormat format)
+{
+	if (format == TableFormat_Tsv) {
+		// Runs without special characters are written at once
+		for (;;) {
+			const auto run = ::strcspn (s, "\t\n\r\\");
+			w.Write (s, run);
+			s += run;
+
+			switch (*s) {
+			case '\0': return;
+			case '\t': w.WriteLiteral ("\\t"); break;
+			case '\n': w.WriteLiteral ("\\n"); break;
+			case '\r': w.WriteLiteral ("\\r"); break;
+			case '\\': w.WriteLiteral ("\\\\"); break;
+			}
+
+			++s;
+		}
+	} else {
+		if (::strpbrk (s, ",\"\r\n") == nullptr) {
+			w.Write (s);
+			return;
+		}
+
+		w.Put ('"');
+		for (; *s; ++s) {
+			if (*s == '"') {
+				w.Put ('"');
+			}
+
+			w.Put (*s);
+		}
+		w.Put ('"');
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteCell (Writer& w, const cliProperty* property, const TableFormat format)
+{
+	if (property == nullptr) {
+		return;
+	}
+
+	// Only strings can contain characters which have to be quoted
+	bool quote = false;
+
+	if (format == TableFormat_Csv && property->type == CLI_PropertyType_String) {
+		for (auto v = property->value; v && ! quote; v = v->next) {
+			quote = ::strpbrk (v->s, ",\"\r\n") != nullptr;
+		}
+	}
+
+	if (quote) {
+		w.Put ('"');
+	}
+
+	for (auto v = property->value; v; v = v->next) {
+		if (v != property->value) {
+			w.Put (';');
+		}
+
+		switch (property->type) {
+		case CLI_PropertyType_Bool:
+			if (v->b) {
+				w.WriteLiteral ("true");
+			} else {
+				w.WriteLiteral ("false");
+			}
+			break;
+
+		case CLI_PropertyType_Int64:
+			w.WriteInt (v->i);
+			break;
+
+		case CLI_PropertyType_String:
+			if (quote) {
+				for (auto s = v->s; *s; ++s) {
+					if (*s == '"') {
+						w.Put ('"');
+					}
+
+					w.Put (*s);
+				}
+			} else {
+				WriteField (w, v->s, format);
+			}
+			break;
+		}
+	}
+
+	if (quote) {
+		w.Put ('"');
+	}
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteTable (Writer& w, const cliNode* root, const TableFormat format)
+{
+	const char separator = format == TableFormat_Csv ? ',' : '\t';
+
+	Columns platformColumns;
+	Columns deviceColumns;
+
+	for (auto platform = root->firstChild; platform; platform = platform->next) {
+		AddColumns (platformColumns, platform);
+
+		if (const auto devices = FindChild (platform, "Devices")) {
+			for (auto device = devices->firstChild; device; device = device->next) {
+				AddColumns (deviceColumns, device);
+			}
+		}
+	}
+
+	w.WriteLiteral ("Platform");
+	w.Put (separator);
+	w.WriteLiteral ("Device");
+
+	for (int i = 0; i < platformColumns.Size (); ++i) {
+		w.Put (separator);
+		WriteField (w, platformColumns [i], format);
+	}
+
+	for (int i = 0; i < deviceColumns.Size (); ++i) {
+		w.Put (separator);
+		WriteField (w, deviceColumns [i], format);
+	}
+
+	w.Put ('\n');
+
+	// The slots are reused for all rows, the platform part is only filled once
+	// per platform
+	std::vector<const cliProperty*> platformSlots (platformColumns.Size ());
+	std::vector<const cliProperty*> deviceSlots (deviceColumns.Size ());
+
+	int platformIndex = 0;
+	for (auto platform = root->firstChild; platform; platform = platform->next) {
+		std::fill (platformSlots.begin (), platformSlots.end (), nullptr);
+		FillSlots (platformColumns, platform, platformSlots);
+
+		if (const auto devices = FindChild (platform, "Devices")) {
+			int deviceIndex = 0;
+			for (auto device = devices->firstChild; device; device = device->next) {
+				std::fill (deviceSlots.begin (), deviceSlots.end (), nullptr);
+				FillSlots (deviceColumns, device, deviceSlots);
+
+				w.WriteInt (platformIndex);
+				w.Put (separator);
+				w.WriteInt (deviceIndex++);
+
+				for (const auto property : platformSlots) {
+					w.Put (separator);
+					WriteCell (w, property, format);
+				}
+
+				for (const auto property : deviceSlots) {
+					w.Put (separator);
+					WriteCell (w, property, format);
+				}
+
+				w.Put ('\n');
+			}
+		}
+
+		++platformIndex;
+	}
+}
+}
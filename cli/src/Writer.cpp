@@ -0,0 +1,443 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "Writer.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#if _WIN32
+	#include <io.h>
+	#include <intrin.h>
+#else
+	#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define NIV_HAVE_SSE2 1
+#endif
+
+namespace niv {
+namespace {
+const char digitPairs [] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+const std::uint64_t ones = 0x0101010101010101ULL;
+const std::uint64_t highBits = 0x8080808080808080ULL;
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Non-zero if any byte of v is less than n, for n <= 128.
+*/
+inline std::uint64_t HasLess (const std::uint64_t v, const std::uint64_t n)
+{
+	return (v - ones * n) & ~v & highBits;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline std::uint64_t HasByte (const std::uint64_t v, const unsigned char c)
+{
+	return HasLess (v ^ (ones * c), 1);
+}
+
+#if NIV_HAVE_SSE2
+////////////////////////////////////////////////////////////////////////////////
+inline int CountTrailingZeros (const unsigned int mask)
+{
+#if _MSC_VER
+	unsigned long index;
+	_BitScanForward (&index, mask);
+	return static_cast<int> (index);
+#else
+	return __builtin_ctz (mask);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Mask of all bytes which are control characters, that is, less than 0x20.
+*/
+inline __m128i ControlCharacters (const __m128i v)
+{
+	return _mm_cmpeq_epi8 (_mm_min_epu8 (v, _mm_set1_epi8 (0x1F)), v);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+inline bool IsJsonSpecial (const unsigned char c)
+{
+	return c < 0x20 || c == '"' || c == '\\';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline bool IsXmlSpecial (const unsigned char c)
+{
+	return c < 0x20 || c == '<' || c == '>' || c == '&' || c == '"' || c == '\'';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Return the index of the first character which must be escaped in JSON, or
+length if there is none. Checks 16 bytes at a time using SSE2 if available,
+and 8 bytes at a time otherwise.
+*/
+std::size_t FindJsonSpecial (const char* s, const std::size_t length)
+{
+	std::size_t i = 0;
+
+#if NIV_HAVE_SSE2
+	const auto quote = _mm_set1_epi8 ('"');
+	const auto backslash = _mm_set1_epi8 ('\\');
+
+	for (; i + 16 <= length; i += 16) {
+		const auto v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (s + i));
+		const auto special = _mm_or_si128 (ControlCharacters (v),
+			_mm_or_si128 (_mm_cmpeq_epi8 (v, quote), _mm_cmpeq_epi8 (v, backslash)));
+		const auto mask = static_cast<unsigned int> (_mm_movemask_epi8 (special));
+
+		if (mask) {
+			return i + CountTrailingZeros (mask);
+		}
+	}
+#endif
+
+	for (; i + 8 <= length; i += 8) {
+		std::uint64_t v;
+		::memcpy (&v, s + i, 8);
+
+		if (HasLess (v, 0x20) | HasByte (v, '"') | HasByte (v, '\\')) {
+			break;
+		}
+	}
+
+	for (; i < length; ++i) {
+		if (IsJsonSpecial (static_cast<unsigned char> (s [i]))) {
+			return i;
+		}
+	}
+
+	return length;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Same as FindJsonSpecial, for XML.
+*/
+std::size_t FindXmlSpecial (const char* s, const std::size_t length)
+{
+	std::size_t i = 0;
+
+#if NIV_HAVE_SSE2
+	const auto lt = _mm_set1_epi8 ('<');
+	const auto gt = _mm_set1_epi8 ('>');
+	const auto amp = _mm_set1_epi8 ('&');
+	const auto quote = _mm_set1_epi8 ('"');
+	const auto apostrophe = _mm_set1_epi8 ('\'');
+
+	for (; i + 16 <= length; i += 16) {
+		const auto v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (s + i));
+		const auto special = _mm_or_si128 (
+			_mm_or_si128 (ControlCharacters (v),
+				_mm_or_si128 (_mm_cmpeq_epi8 (v, lt), _mm_cmpeq_epi8 (v, gt))),
+			_mm_or_si128 (_mm_cmpeq_epi8 (v, amp),
+				_mm_or_si128 (_mm_cmpeq_epi8 (v, quote), _mm_cmpeq_epi8 (v, apostrophe))));
+		const auto mask = static_cast<unsigned int> (_mm_movemask_epi8 (special));
+
+		if (mask) {
+			return i + CountTrailingZeros (mask);
+		}
+	}
+#endif
+
+	for (; i + 8 <= length; i += 8) {
+		std::uint64_t v;
+		::memcpy (&v, s + i, 8);
+
+		if (HasLess (v, 0x20) | HasByte (v, '<') | HasByte (v, '>') |
+			HasByte (v, '&') | HasByte (v, '"') | HasByte (v, '\'')) {
+			break;
+		}
+	}
+
+	for (; i < length; ++i) {
+		if (IsXmlSpecial (static_cast<unsigned char> (s [i]))) {
+			return i;
+		}
+	}
+
+	return length;
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Writer::Writer (int fd, std::size_t capacity, bool backgroundFlush)
+: fd_ (fd)
+, buffer_ (capacity)
+, capacity_ (capacity)
+{
+	if (backgroundFlush) {
+		pending_.resize (capacity);
+		thread_ = std::thread ([this] () { Run (); });
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Writer::Writer (std::vector<char>& target, std::size_t capacity)
+: fd_ (-1)
+, target_ (&target)
+, buffer_ (capacity)
+, capacity_ (capacity)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Writer::~Writer ()
+{
+	Flush ();
+
+	if (thread_.joinable ()) {
+		{
+			std::lock_guard<std::mutex> lock (mutex_);
+			stop_ = true;
+		}
+
+		condition_.notify_all ();
+		thread_.join ();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Writer::Fill (const char c, std::size_t count)
+{
+	while (count > 0) {
+		if (size_ == capacity_) {
+			Submit ();
+		}
+
+		const auto n = std::min (count, capacity_ - size_);
+		::memset (buffer_.data () + size_, c, n);
+		size_ += n;
+		count -= n;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Writer::WriteInt (std::int64_t value)
+{
+	char buffer [24];
+	auto end = buffer + sizeof (buffer);
+	auto p = end;
+
+	// Negate as unsigned, which is well-defined for the smallest value too
+	std::uint64_t u = value < 0
+		? 0 - static_cast<std::uint64_t> (value)
+		: static_cast<std::uint64_t> (value);
+
+	while (u >= 100) {
+		const auto pair = static_cast<std::size_t> (u % 100) * 2;
+		u /= 100;
+		p -= 2;
+		::memcpy (p, digitPairs + pair, 2);
+	}
+
+	if (u >= 10) {
+		p -= 2;
+		::memcpy (p, digitPairs + u * 2, 2);
+	} else {
+		*--p = static_cast<char> ('0' + u);
+	}
+
+	if (value < 0) {
+		*--p = '-';
+	}
+
+	Write (p, static_cast<std::size_t> (end - p));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Writer::WriteJsonEscaped (const char* s)
+{
+	static const char hex [] = "0123456789abcdef";
+
+	auto length = ::strlen (s);
+
+	for (;;) {
+		const auto run = FindJsonSpecial (s, length);
+		Write (s, run);
+
+		if (run == length) {
+			return;
+		}
+
+		const auto c = static_cast<unsigned char> (s [run]);
+
+		switch (c) {
+		case '"': WriteLiteral ("\\\""); break;
+		case '\\': WriteLiteral ("\\\\"); break;
+		case '\n': WriteLiteral ("\\n"); break;
+		case '\r': WriteLiteral ("\\r"); break;
+		case '\t': WriteLiteral ("\\t"); break;
+		case '\b': WriteLiteral ("\\b"); break;
+		case '\f': WriteLiteral ("\\f"); break;
+		default:
+		{
+			const char escaped [] = { '\\', 'u', '0', '0', hex [c >> 4], hex [c & 0xF] };
+			Write (escaped, sizeof (escaped));
+			break;
+		}
+		}
+
+		s += run + 1;
+		length -= run + 1;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Writer::WriteXmlEscaped (const char* s)
+{
+	auto length = ::strlen (s);
+
+	for (;;) {
+		const auto run = FindXmlSpecial (s, length);
+		Write (s, run);
+
+		if (run == length) {
+			return;
+		}
+
+		switch (s [run]) {
+		case '<': WriteLiteral ("&lt;"); break;
+		case '>': WriteLiteral ("&gt;"); break;
+		case '&': WriteLiteral ("&amp;"); break;
+		case '"': WriteLiteral ("&quot;"); break;
+		case '\'': WriteLiteral ("&apos;"); break;
+		// Whitespace would be normalized in attribute values otherwise
+		case '\t': WriteLiteral ("&#9;"); break;
+		case '\n': WriteLiteral ("&#10;"); break;
+		case '\r': WriteLiteral ("&#13;"); break;
+		// Other control characters cannot be represented in XML 1.0
+		default: break;
+		}
+
+		s += run + 1;
+		length -= run + 1;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Writer::Flush ()
+{
+	Submit ();
+
+	if (thread_.joinable ()) {
+		std::unique_lock<std::mutex> lock (mutex_);
+		condition_.wait (lock, [this] () { return pendingSize_ == 0; });
+	}
+
+	return ! failed_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Writer::Submit ()
+{
+	if (! thread_.joinable ()) {
+		WriteOut (buffer_.data (), size_);
+		size_ = 0;
+		return;
+	}
+
+	if (size_ == 0) {
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock (mutex_);
+		condition_.wait (lock, [this] () { return pendingSize_ == 0; });
+
+		buffer_.swap (pending_);
+		pendingSize_ = size_;
+	}
+
+	condition_.notify_all ();
+	size_ = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Writer::WriteOut (const char* data, const std::size_t size)
+{
+	if (target_) {
+		target_->insert (target_->end (), data, data + size);
+		bytesWritten_ += static_cast<std::uint64_t> (size);
+		return;
+	}
+
+	std::size_t offset = 0;
+
+	while (offset < size && ! failed_) {
+#if _WIN32
+		const auto written = ::_write (fd_, data + offset,
+			static_cast<unsigned int> (size - offset));
+#else
+		const auto written = ::write (fd_, data + offset, size - offset);
+#endif
+
+		if (written < 0) {
+			if (errno != EINTR) {
+				failed_ = true;
+			}
+		} else {
+			offset += static_cast<std::size_t> (written);
+			bytesWritten_ += static_cast<std::uint64_t> (written);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Writer::Run ()
+{
+	std::unique_lock<std::mutex> lock (mutex_);
+
+	for (;;) {
+		condition_.wait (lock, [this] () { return pendingSize_ > 0 || stop_; });
+
+		if (pendingSize_ == 0) {
+			return;
+		}
+
+		// pending_ is not touched by the writing thread until pendingSize_ is
+		// reset, so the lock is not needed while writing
+		lock.unlock ();
+		WriteOut (pending_.data (), pendingSize_);
+		lock.lock ();
+
+		pendingSize_ = 0;
+		condition_.notify_all ();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Writer::WriteSlow (const char* s, std::size_t length)
+{
+	while (length > 0) {
+		if (size_ == capacity_) {
+			Submit ();
+		}
+
+		const auto n = std::min (length, capacity_ - size_);
+		::memcpy (buffer_.data () + size_, s, n);
+		size_ += n;
+		s += n;
+		length -= n;
+	}
+}
+}
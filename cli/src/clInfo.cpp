@@ -3,6 +3,13 @@
 
 #include <clInfo.h>
 
+#include "Diff.h"
+#include "OpenMetrics.h"
+#include "Printers.h"
+#include "Query.h"
+#include "Table.h"
+#include "Writer.h"
+
 #include <iostream>
 #include <iomanip>
 #include <vector>
@@ -16,291 +23,836 @@
 
 #include <cassert>
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#if _WIN32
+	#define NOMINMAX
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#include <fcntl.h>
+	#include <io.h>
+	#include <sys/stat.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
 
 namespace {
 /**
-Dump tree to XML.
+One output of the tool: a format, and the file it is written to.
+*/
+struct Sink
+{
+	char		format;
+
+	// nullptr for standard output
+	const char*	path;
+};
+
+typedef niv::FanoutVisitor<niv::XmlPrinter, niv::JsonPrinter,
+	niv::ConsolePrinter, niv::CborPrinter> Printers;
 
-The output is unformatted, that is, there is no whitespace between elements.
+////////////////////////////////////////////////////////////////////////////////
+/**
+Parse a sink given as format[:path]. If the path is missing or -, the output
+goes to standard output. Returns false if the format is unknown.
 */
-struct XmlPrinter
+bool ParseSink (const char* s, Sink& sink)
 {
-public:
-	void Write (std::ostream& s, const cliNode* tree) const
+	static const struct
 	{
-		OnNode (s, tree);
+		const char*	name;
+		char		format;
+	} formats [] = {
+		{ "console", 'c' },
+		{ "xml", 'x' },
+		{ "json", 'j' },
+		{ "cbor", 'b' },
+		{ "csv", 'v' },
+		{ "tsv", 't' }
+	};
+
+	const auto colon = ::strchr (s, ':');
+	const auto length = colon ? static_cast<std::size_t> (colon - s) : ::strlen (s);
+
+	for (const auto& f : formats) {
+		if (::strlen (f.name) == length && ::strncmp (f.name, s, length) == 0) {
+			sink.format = f.format;
+			sink.path = nullptr;
+
+			if (colon && colon [1] && ::strcmp (colon + 1, "-") != 0) {
+				sink.path = colon + 1;
+			}
+
+			return true;
+		}
 	}
 
-private:
-	void OnNode (std::ostream& s, const cliNode* node) const
-	{
-		s << "<" << node->name;
+	return false;
+}
 
-		if (node->kind) {
-			s << " Kind=\"" << node->kind << "\"";
-		}
-		s << ">";
+////////////////////////////////////////////////////////////////////////////////
+/**
+Parse the short form of a sink, -x, -j, -c or -b, optionally followed by
+=path. Returns false for anything else.
+*/
+bool ParseShortSink (const char* s, Sink& sink)
+{
+	if (s [0] != '-' || s [1] == '\0' || ::strchr ("xjcb", s [1]) == nullptr) {
+		return false;
+	}
+
+	if (s [2] == '\0') {
+		sink = Sink { s [1], nullptr };
+		return true;
+	}
+
+	if (s [2] == '=' && s [3] != '\0') {
+		sink = Sink { s [1], ::strcmp (s + 3, "-") == 0 ? nullptr : s + 3 };
+		return true;
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Add a sink. There can be only one sink writing to standard output, a later one
+replaces an earlier one.
+*/
+void AddSink (std::vector<Sink>& sinks, const Sink& sink)
+{
+	if (sink.path == nullptr) {
+		sinks.erase (std::remove_if (sinks.begin (), sinks.end (),
+			[] (const Sink& s) -> bool { return s.path == nullptr; }),
+			sinks.end ());
+	}
 
-		for (auto p = node->firstProperty; p; p = p->next) {
-			OnProperty (s, p);
+	sinks.push_back (sink);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int OpenOutput (const char* path)
+{
+#if _WIN32
+	return ::_open (path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+		_S_IREAD | _S_IWRITE);
+#else
+	return ::open (path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CloseOutput (const int fd)
+{
+#if _WIN32
+	::_close (fd);
+#else
+	::close (fd);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Write the tree to all sinks in a single traversal. Tables are written
+afterwards, as they need a pass of their own to find the columns. Every sink
+has its own writer, which flushes on a separate thread, so slow outputs do not
+hold up the others. Returns false if any sink could not be written.
+*/
+bool WriteSinks (const std::vector<Sink>& sinks, const cliNode* root)
+{
+	bool result = true;
+
+	std::vector<int> files;
+	std::vector<const Sink*> opened;
+	std::vector<std::unique_ptr<niv::Writer>> writers;
+	Printers printers;
+	std::vector<std::pair<niv::Writer*, niv::TableFormat>> tables;
+
+	for (const auto& sink : sinks) {
+		int fd = 1 /* stdout */;
+
+#if _WIN32
+		// Binary output must not have its line endings translated
+		if (sink.path == nullptr && sink.format == 'b') {
+			::_setmode (fd, _O_BINARY);
 		}
+#endif
 
-		for (auto n = node->firstChild; n; n = n->next) {
-			OnNode (s, n);
+		if (sink.path) {
+			fd = OpenOutput (sink.path);
+
+			if (fd < 0) {
+				std::cerr << "Could not open '" << sink.path << "' for writing\n";
+				result = false;
+				continue;
+			}
+
+			files.push_back (fd);
 		}
 
-		s << "</" << node->name << ">";
-	}
+		writers.emplace_back (new niv::Writer (fd, 1 << 16, true));
+		opened.push_back (&sink);
 
-	void OnProperty (std::ostream& s, const cliProperty* p) const
-	{
-		const char* t = nullptr;
-		switch (p->type) {
-		case CLI_PropertyType_Bool: t = "bool"; break;
-		case CLI_PropertyType_Int64: t = "int64"; break;
-		case CLI_PropertyType_String: t = "string"; break;
+		auto& w = *writers.back ();
+
+		switch (sink.format) {
+		case 'x':
+			printers.Add<niv::XmlPrinter> (w);
+			break;
+
+		case 'j':
+			printers.Add<niv::JsonPrinter> (w);
+			break;
+
+		case 'c':
+			printers.Add<niv::ConsolePrinter> (w);
+			break;
+
+		case 'b':
+			printers.Add<niv::CborPrinter> (w);
+			break;
+
+		case 'v':
+			tables.emplace_back (&w, niv::TableFormat_Csv);
+			break;
+
+		case 't':
+			tables.emplace_back (&w, niv::TableFormat_Tsv);
+			break;
 		}
+	}
 
-		s << "<Property Name=\"" << p->name << "\" Type=\"" << t << "\">";
+	printers.Visit (root);
 
-		for (auto v = p->value; v; v = v->next) {
-			s << "<Value>";
+	for (const auto& table : tables) {
+		niv::WriteTable (*table.first, root, table.second);
+	}
 
-			switch (p->type) {
-			case CLI_PropertyType_Bool:
-				if (v->b) {
-					s << "true";
-				} else {
-					s << "false";
-				}
-				break;
+	for (std::size_t i = 0; i < writers.size (); ++i) {
+		if (! writers [i]->Flush ()) {
+			std::cerr << "Error while writing '"
+				<< (opened [i]->path ? opened [i]->path : "stdout") << "'\n";
+			result = false;
+		}
+	}
 
+	writers.clear ();
 
-			case CLI_PropertyType_Int64:
-				s << v->i;
-				break;
+	for (const auto fd : files) {
+		CloseOutput (fd);
+	}
 
-			case CLI_PropertyType_String:
-				s << v->s;
-				break;
-			}
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Print the values of all properties matched by the query, one property per
+line, and the matched nodes in the console format. Returns false if nothing
+matched.
+*/
+bool WriteMatches (const niv::Query& query, const cliNode* root,
+	niv::Writer& out)
+{
+	const auto matches = query.Evaluate (root);
 
-			s << "</Value>";
+	for (const auto& match : matches) {
+		if (match.property == nullptr) {
+			niv::ConsolePrinter printer (out);
+			printer.Visit (match.node);
+			continue;
 		}
 
-		s << "</Property>";
+		niv::WriteConsoleValues (out, match.property);
+		out.Put ('\n');
 	}
-};
 
+	return ! matches.empty ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
 /**
-Dump tree to JSON.
+Print for every device whether it meets the requirements, and if not, the
+first one it fails. Returns false if no device meets them.
 */
-struct JsonPrinter
+bool WriteRequirements (const cliRequirements* requirements,
+	const cliInfo* info, niv::Writer& out)
 {
-public:
-	void Write (std::ostream& s, const cliNode* tree) const
-	{
-		OnNode (s, tree);
+	int count = 0;
+	cliRequirements_Evaluate (requirements, info, nullptr, &count);
+
+	std::vector<cliRequirementsResult> results (count);
+	if (count == 0 || cliRequirements_Evaluate (requirements, info,
+		results.data (), &count) != CLI_Success) {
+		return false;
 	}
 
-private:
-	void OnNode (std::ostream& s, const cliNode* node) const
-	{
-		s << "{ \"" << node->name << "\" : {";
-		s << "\"Properties\" : ";
-
-		if (node->firstProperty) {
-			for (auto p = node->firstProperty; p; p = p->next) {
-				OnProperty (s, p);
-				if (p->next) {
-					s << ",";
-				}
+	bool met = false;
+
+	for (const auto& result : results) {
+		out.WriteLiteral ("Platform ");
+		out.WriteInt (result.platformIndex);
+		out.WriteLiteral (" Device ");
+		out.WriteInt (result.deviceIndex);
+
+		for (auto p = result.device->firstProperty; p; p = p->next) {
+			if (::strcmp (p->name, "CL_DEVICE_NAME") == 0 && p->value) {
+				out.WriteLiteral (" (");
+				out.Write (p->value->s);
+				out.Put (')');
+				break;
 			}
-		} else {
-			s << "{}";
 		}
 
-		s << ", \"Children\" : ";
-		if (node->firstChild) {
-			for (auto n = node->firstChild; n; n = n->next) {
-				OnNode (s, n);
-				if (n->next) {
-					s << ",";
-				}
-			}
+		if (result.failedRequirement) {
+			out.WriteLiteral (": fails line ");
+			out.WriteInt (result.failedLine);
+			out.WriteLiteral (", ");
+			out.Write (result.failedRequirement);
+			out.Put ('\n');
 		} else {
-			s << "{}";
+			out.WriteLiteral (": OK\n");
+			met = true;
+		}
+	}
+
+	return met;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Write the metrics to a temporary file next to path, and rename it to path
+once complete, so readers never see a partially written file. If path is -,
+write to standard output instead.
+*/
+bool WriteMetricsFile (const char* path, const cliNode* root)
+{
+	if (::strcmp (path, "-") == 0) {
+		niv::Writer w (1 /* stdout */);
+		niv::WriteOpenMetrics (w, root);
+
+		if (! w.Flush ()) {
+			std::cerr << "Error while writing the output\n";
+			return false;
 		}
 
-		s << "}";
+		return true;
+	}
+
+	const auto temporary = std::string (path) + ".tmp";
+	const auto fd = OpenOutput (temporary.c_str ());
+
+	if (fd < 0) {
+		std::cerr << "Could not open '" << temporary << "' for writing\n";
+		return false;
 	}
 
-	void OnProperty (std::ostream& s, const cliProperty* p) const
+	bool written;
 	{
-		bool singleValue = (p->value && p->value->next == nullptr);
+		niv::Writer w (fd);
+		niv::WriteOpenMetrics (w, root);
+		written = w.Flush ();
+	}
 
-		if (!singleValue) {
-			s << "\"" << p->name << "\" = [";
-		} else {
-			s << "\"" << p->name << "\" = ";
-		}
+	CloseOutput (fd);
 
-		for (auto v = p->value; v; v = v->next) {
-			switch (p->type) {
-			case CLI_PropertyType_Bool:
-				if (v->b) {
-					s << "true";
-				} else {
-					s << "false";
-				}
-				break;
+	if (! written) {
+		std::cerr << "Error while writing '" << temporary << "'\n";
+		std::remove (temporary.c_str ());
+		return false;
+	}
 
+#if _WIN32
+	const bool renamed = ::MoveFileExA (temporary.c_str (), path,
+		MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	const bool renamed = std::rename (temporary.c_str (), path) == 0;
+#endif
 
-			case CLI_PropertyType_Int64:
-				s << v->i;
-				break;
+	if (! renamed) {
+		std::cerr << "Could not rename '" << temporary << "' to '" << path << "'\n";
+		std::remove (temporary.c_str ());
+	}
 
-			case CLI_PropertyType_String:
-				s << "\"" << v->s << "\"";
-				break;
-			}
+	return renamed;
+}
 
-			if (v->next) {
-				s << ",";
-			}
+////////////////////////////////////////////////////////////////////////////////
+/**
+Write the metrics once, or if interval is positive, every interval seconds
+forever, refreshing the dynamic properties in between. Returns false on
+errors.
+*/
+bool ExportOpenMetrics (cliInfo* info, const char* path, const int interval)
+{
+	auto next = std::chrono::steady_clock::now ();
+
+	for (;;) {
+		cliNode* root;
+		if (cliInfo_GetRoot (info, &root) != CLI_Success) {
+			return false;
 		}
 
-		if (! singleValue) {
-			s << "]";
+		// A failed write is retried with the next sample
+		const bool written = WriteMetricsFile (path, root);
+
+		if (interval <= 0) {
+			return written;
+		}
+
+		next += std::chrono::seconds (interval);
+		std::this_thread::sleep_until (next);
+
+		if (cliInfo_Refresh (info, nullptr) != CLI_Success) {
+			std::cerr << "Could not refresh the OpenCL information\n";
+			return false;
 		}
 	}
-};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::int64_t GetTimestamp ()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds> (
+		std::chrono::system_clock::now ().time_since_epoch ()).count ();
+}
 
+////////////////////////////////////////////////////////////////////////////////
 /**
-Dump tree, formatted for reading on a console.
+Write a single property of a device as a line of JSON.
+*/
+void WriteWatchLine (niv::Writer& w, const std::int64_t timestamp,
+	const cliPropertyChange& change)
+{
+	w.WriteLiteral ("{\"Time\":");
+	w.WriteInt (timestamp);
+	w.WriteLiteral (",\"Platform\":");
+	w.WriteInt (change.platformIndex);
+	w.WriteLiteral (",\"Device\":");
+	w.WriteInt (change.deviceIndex);
+
+	for (auto p = change.device->firstProperty; p; p = p->next) {
+		if (::strcmp (p->name, "CL_DEVICE_NAME") == 0) {
+			w.WriteLiteral (",\"Name\":");
+			niv::WriteJsonValues (w, p);
+			break;
+		}
+	}
+
+	w.WriteLiteral (",\"Property\":\"");
+	w.WriteJsonEscaped (change.property->name);
+	w.WriteLiteral ("\",\"Value\":");
+	niv::WriteJsonValues (w, change.property);
+	w.WriteLiteral ("}\n");
+}
 
-The output is pretty-printed for consoles
+////////////////////////////////////////////////////////////////////////////////
+/**
+Write the properties reported by cliInfo_GetChanges. After a gather, these
+are the current values of all volatile properties, as a baseline for the
+changes reported afterwards.
 */
-struct ConsolePrinter
+void WriteWatchChanges (niv::Writer& w, const std::int64_t timestamp,
+	const cliInfo* info)
 {
-public:
-	void Write (std::ostream& s, const cliNode* tree) const
-	{
-		OnNode (s, tree, 0);
+	const cliPropertyChange* changes;
+	int count;
+	if (cliInfo_GetChanges (info, &changes, &count) != CLI_Success) {
+		return;
 	}
 
-private:
-	static void Indent (std::ostream& s, const int indentation)
-	{
-		for (int i = 0; i < indentation; ++i) {
-			s << "  ";
-		}
+	for (int i = 0; i < count; ++i) {
+		WriteWatchLine (w, timestamp, changes [i]);
 	}
+}
 
-	void OnNode (std::ostream& s, const cliNode* node, const int indentation) const
-	{
-		Indent (s, indentation);
-		s << node->name << '\n';
+////////////////////////////////////////////////////////////////////////////////
+/**
+Refresh the information every interval seconds, and print the properties
+which changed as JSON Lines. Only returns on errors.
+*/
+bool Watch (cliInfo* info, const double interval)
+{
+	niv::Writer out (1 /* stdout */);
 
-		std::size_t maxPropertyLength = 0;
-		for (auto p = node->firstProperty; p; p = p->next) {
-			maxPropertyLength = std::max (maxPropertyLength,
-				::strlen (p->name));
-		}
+	WriteWatchChanges (out, GetTimestamp (), info);
+
+	const auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration> (
+		std::chrono::duration<double> (interval));
+	auto next = std::chrono::steady_clock::now ();
 
-		for (auto p = node->firstProperty; p; p = p->next) {
-			OnProperty (s, p, maxPropertyLength, indentation + 1);
+	while (out.Flush ()) {
+		next += step;
+		std::this_thread::sleep_until (next);
+
+		int topologyChanged = 0;
+		if (cliInfo_Refresh (info, &topologyChanged) != CLI_Success) {
+			std::cerr << "Could not refresh the OpenCL information\n";
+			return false;
 		}
 
-		for (auto n = node->firstChild; n; n = n->next) {
-			OnNode (s, n, indentation + 1);
-			s << '\n';
+		const auto timestamp = GetTimestamp ();
+
+		// All nodes are new, and the changes are a new baseline
+		if (topologyChanged) {
+			out.WriteLiteral ("{\"Time\":");
+			out.WriteInt (timestamp);
+			out.WriteLiteral (",\"TopologyChanged\":true}\n");
 		}
+
+		WriteWatchChanges (out, timestamp, info);
 	}
 
-	void OnProperty (std::ostream& s, const cliProperty* p,
-		const std::size_t fieldWidth, const int indentation) const
-	{
-		Indent (s, indentation);
-
-		s << std::left << std::setw (fieldWidth) << p->name << " : ";
-
-		for (auto v = p->value; v; v = v->next) {
-			switch (p->type) {
-			case CLI_PropertyType_Bool:
-				if (v->b) {
-					s << "true";
-				} else {
-					s << "false";
-				}
-				break;
+	std::cerr << "Error while writing the output\n";
+	return false;
+}
 
+////////////////////////////////////////////////////////////////////////////////
+/**
+Compare two snapshots. Returns 0 if they are equal, 1 if they differ and 2 on
+errors, like diff.
+*/
+int Diff (const char* const (&files)[2], const cliInfo* reference,
+	const bool json)
+{
+	cliInfo* infos [2] = {};
+	cliNode* roots [2] = {};
+	int result = 0;
 
-			case CLI_PropertyType_Int64:
-				s << v->i;
-				break;
+	for (int i = 0; i < 2; ++i) {
+		cliInfo_Create (&infos [i]);
 
-			case CLI_PropertyType_String:
-				s << v->s;
-				break;
-			}
+		if (cliInfo_LoadFile (infos [i], reference, files [i]) != CLI_Success ||
+			cliInfo_GetRoot (infos [i], &roots [i]) != CLI_Success) {
+			std::cerr << "Could not load snapshot '" << files [i] << "'\n";
+			result = 2;
+		}
+	}
 
-			if (v->next) {
-				s << ' ';
-			}
+	if (result == 0) {
+		const auto changes = niv::DiffTrees (roots [0], roots [1]);
+
+		niv::Writer out (1 /* stdout */);
+
+		if (json) {
+			niv::WriteChangesJson (out, changes);
+		} else {
+			niv::WriteChangesConsole (out, changes);
 		}
 
-		s << '\n';
+		if (! out.Flush ()) {
+			std::cerr << "Error while writing the output\n";
+			result = 2;
+		} else if (! changes.empty ()) {
+			result = 1;
+		}
 	}
-};
+
+	for (const auto info : infos) {
+		cliInfo_Destroy (info);
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void PrintUsage ()
+{
+	std::cerr <<
+		"Usage: OpenCLInfo [options]\n"
+		"       OpenCLInfo --diff a b [-j]\n"
+		"\n"
+		"Prints the OpenCL platforms and devices, on the console by default.\n"
+		"\n"
+		"  -c, -x, -j, -b          Write console, XML, JSON or CBOR output to\n"
+		"                          standard output, or with =file, to a file\n"
+		"  --format=format[:path]  Write console, xml, json, cbor, csv or tsv\n"
+		"                          output, to standard output without a path\n"
+		"  --csv, --tsv            Write a table with one row per device\n"
+		"  --save file             Save a binary snapshot\n"
+		"  --load file             Load a snapshot, XML or JSON instead of gathering\n"
+		"  --reference file        Reference for delta snapshots\n"
+		"  --query path            Print the properties or nodes selected by path\n"
+		"  --require file          Check the devices against a requirements file\n"
+		"  --openmetrics path      Write the device metrics for node_exporter\n"
+		"  --interval n            Rewrite the metrics every n seconds\n"
+		"  --watch=seconds         Print the changed properties periodically\n"
+		"  --isolate               Gather each platform in a child process\n"
+		"  --timeout ms            Time limit for the isolated platforms\n"
+		"  --direct-icd            Load the ICDs directly, bypassing the loader\n"
+		"  --parallel              Gather the platforms on several threads\n"
+		"  --derived               Add estimated metrics to every device\n"
+		"  --record file           Record the driver responses to file\n";
+}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 int main(int argc, char* argv[])
 {
+	std::vector<Sink> sinks;
+	const char* saveFile = nullptr;
+	const char* loadFile = nullptr;
+	const char* referenceFile = nullptr;
+	const char* queryText = nullptr;
+	const char* requirementsFile = nullptr;
+	const char* diffFiles [2] = {};
+	const char* openMetricsPath = nullptr;
+	int interval = 0;
+	double watchInterval = 0;
+
+	cliGatherOptions options = {};
+
+	// The sink parsed last
+	Sink sink;
+
+	for (int i = 1; i < argc; ++i) {
+		if (::strcmp (argv [i], "--save") == 0 && (i + 1) < argc) {
+			saveFile = argv [++i];
+		} else if (::strcmp (argv [i], "--load") == 0 && (i + 1) < argc) {
+			loadFile = argv [++i];
+		} else if (::strcmp (argv [i], "--reference") == 0 && (i + 1) < argc) {
+			referenceFile = argv [++i];
+		} else if (::strcmp (argv [i], "--diff") == 0 && (i + 2) < argc) {
+			diffFiles [0] = argv [++i];
+			diffFiles [1] = argv [++i];
+		} else if (::strcmp (argv [i], "--openmetrics") == 0 && (i + 1) < argc) {
+			openMetricsPath = argv [++i];
+		} else if (::strcmp (argv [i], "--interval") == 0 && (i + 1) < argc) {
+			interval = std::atoi (argv [++i]);
+		} else if (::strncmp (argv [i], "--watch=", 8) == 0) {
+			watchInterval = std::atof (argv [i] + 8);
+
+			if (watchInterval <= 0) {
+				std::cerr << "Invalid watch interval '" << argv [i] + 8 << "'\n";
+				return 1;
+			}
+		} else if (::strcmp (argv [i], "--query") == 0 && (i + 1) < argc) {
+			queryText = argv [++i];
+		} else if (::strcmp (argv [i], "--require") == 0 && (i + 1) < argc) {
+			requirementsFile = argv [++i];
+		} else if (::strcmp (argv [i], "--isolate") == 0) {
+			options.flags |= CLI_GatherFlag_Isolate;
+		} else if (::strcmp (argv [i], "--direct-icd") == 0) {
+			options.flags |= CLI_GatherFlag_DirectIcd;
+		} else if (::strcmp (argv [i], "--parallel") == 0) {
+			options.flags |= CLI_GatherFlag_Parallel;
+		} else if (::strcmp (argv [i], "--record") == 0 && (i + 1) < argc) {
+			options.recordFile = argv [++i];
+		} else if (::strcmp (argv [i], "--derived") == 0) {
+			options.flags |= CLI_GatherFlag_Derived;
+		} else if (::strcmp (argv [i], "--timeout") == 0 && (i + 1) < argc) {
+			options.timeout = std::atoi (argv [++i]);
+		} else if (::strncmp (argv [i], "--format=", 9) == 0) {
+			if (! ParseSink (argv [i] + 9, sink)) {
+				std::cerr << "Unknown output format '" << argv [i] + 9 << "'\n";
+				return 1;
+			}
+
+			AddSink (sinks, sink);
+		} else if (::strcmp (argv [i], "--csv") == 0) {
+			AddSink (sinks, Sink { 'v', nullptr });
+		} else if (::strcmp (argv [i], "--tsv") == 0) {
+			AddSink (sinks, Sink { 't', nullptr });
+		} else if (ParseShortSink (argv [i], sink)) {
+			AddSink (sinks, sink);
+		} else {
+			PrintUsage ();
+			return 1;
+		}
+	}
+
+	// The isolated platforms are gathered in child processes, which are not
+	// recorded
+	if (options.recordFile && (options.flags & CLI_GatherFlag_Isolate)) {
+		std::cerr << "--record cannot be combined with --isolate\n";
+		return 1;
+	}
+
+	// Only print if a format was requested explicitly, or there is no other
+	// output
+	if (sinks.empty () && saveFile == nullptr && queryText == nullptr &&
+		requirementsFile == nullptr && openMetricsPath == nullptr &&
+		watchInterval == 0) {
+		sinks.push_back (Sink { 'c', nullptr });
+	}
+
+	// The name of every device, and the properties refreshed by --watch
+	std::vector<const char*> watchProperties (1, "CL_DEVICE_NAME");
+	{
+		const char* const* volatileProperties;
+		int count;
+		if (cliInfo_GetVolatileProperties (&volatileProperties, &count) ==
+			CLI_Success) {
+			watchProperties.insert (watchProperties.end (), volatileProperties,
+				volatileProperties + count);
+		}
+
+		watchProperties.push_back (nullptr);
+	}
+
+	// If the metrics or the watched properties are the only output, gather
+	// just what they need
+	if (sinks.empty () && saveFile == nullptr && queryText == nullptr &&
+		requirementsFile == nullptr) {
+		if (openMetricsPath && watchInterval == 0) {
+			options.properties = niv::openMetricsProperties;
+			options.flags |= CLI_GatherFlag_SkipImageFormats;
+		} else if (watchInterval > 0 && openMetricsPath == nullptr) {
+			options.properties = watchProperties.data ();
+			options.flags |= CLI_GatherFlag_SkipImageFormats;
+		}
+	}
+
+	// Compile the query first, so only what it needs is gathered if it is the
+	// only output
+	std::unique_ptr<niv::Query> query;
+	if (queryText) {
+		try {
+			query.reset (new niv::Query (queryText));
+		} catch (const std::runtime_error& e) {
+			std::cerr << "Invalid query: " << e.what () << "\n";
+			return 1;
+		}
+
+		if (sinks.empty () && saveFile == nullptr &&
+			requirementsFile == nullptr && openMetricsPath == nullptr &&
+			watchInterval == 0) {
+			query->Restrict (options);
+		}
+	}
+
+	std::unique_ptr<cliRequirements, int (*) (cliRequirements*)> requirements (
+		nullptr, cliRequirements_Destroy);
+	if (requirementsFile) {
+		cliRequirements* compiled;
+		char error [256];
+
+		if (cliRequirements_CompileFile (requirementsFile, &compiled,
+			error, sizeof (error)) != CLI_Success) {
+			std::cerr << "Invalid requirements '" << requirementsFile << "': "
+				<< error << "\n";
+			return 1;
+		}
+
+		requirements.reset (compiled);
+	}
+
 	try {
+		struct cliInfo* reference = nullptr;
+
+		if (referenceFile) {
+			cliInfo_Create (&reference);
+
+			if (cliInfo_Load (reference, nullptr, referenceFile) != CLI_Success) {
+				std::cerr << "Could not load reference snapshot '" << referenceFile << "'\n";
+				cliInfo_Destroy (reference);
+				return 1;
+			}
+		}
+
+		if (diffFiles [0]) {
+			const bool json = std::any_of (sinks.begin (), sinks.end (),
+				[] (const Sink& s) -> bool { return s.format == 'j'; });
+			const auto result = Diff (diffFiles, reference, json);
+
+			if (reference) {
+				cliInfo_Destroy (reference);
+			}
+
+			return result;
+		}
+
 		struct cliInfo* info;
 		cliInfo_Create (&info);
-		cliInfo_Gather (info);
 
-		struct cliNode* root;
-		cliInfo_GetRoot (info, &root);
-
-		if (argc == 2) {
-			if (argv [1][0] == '-') {
-				switch (argv [1][1]) {
-				case 'x':
-				{
-					XmlPrinter xmlPrinter;
-					xmlPrinter.Write (std::cout, root);
-					break;
-				}
-
-				case 'j':
-				{
-					JsonPrinter jsonPrinter;
-					jsonPrinter.Write (std::cout, root);
-					break;
-				}
-
-				case 'c':
-				{
-					ConsolePrinter consolePrinter;
-					consolePrinter.Write (std::cout, root);
-					break;
-				}
-				}
+		if (loadFile) {
+			if (cliInfo_LoadFile (info, reference, loadFile) != CLI_Success) {
+				std::cerr << "Could not load snapshot '" << loadFile << "'\n";
 			}
 		} else {
-			ConsolePrinter consolePrinter;
-			consolePrinter.Write (std::cout, root);
+			cliInfo_GatherWithOptions (info, &options);
+		}
+
+		struct cliNode* root;
+		if (cliInfo_GetRoot (info, &root) != CLI_Success) {
+			std::cerr << "No OpenCL information available\n";
+			cliInfo_Destroy (info);
+
+			if (reference) {
+				cliInfo_Destroy (reference);
+			}
+
+			return 1;
+		}
+
+		int result = 0;
+
+		if (saveFile) {
+			if (cliInfo_Save (info, reference, saveFile) != CLI_Success) {
+				std::cerr << "Could not save snapshot '" << saveFile << "'\n";
+				result = 1;
+			}
+		}
+
+		if (! WriteSinks (sinks, root)) {
+			result = 1;
+		}
+
+		if (openMetricsPath) {
+			if (! ExportOpenMetrics (info, openMetricsPath, interval)) {
+				result = 1;
+			}
+		}
+
+		if (watchInterval > 0) {
+			if (! Watch (info, watchInterval)) {
+				result = 1;
+			}
+		}
+
+		if (query) {
+			niv::Writer out (1 /* stdout */);
+
+			// Health checks can use the exit code to test for a match
+			if (! WriteMatches (*query, root, out)) {
+				result = 1;
+			}
+
+			if (! out.Flush ()) {
+				std::cerr << "Error while writing the output\n";
+				result = 1;
+			}
+		}
+
+		if (requirements) {
+			niv::Writer out (1 /* stdout */);
+
+			// Like queries, the exit code tells if any device qualifies
+			if (! WriteRequirements (requirements.get (), info, out)) {
+				result = 1;
+			}
+
+			if (! out.Flush ()) {
+				std::cerr << "Error while writing the output\n";
+				result = 1;
+			}
 		}
 
 		cliInfo_Destroy (info);
+
+		if (reference) {
+			cliInfo_Destroy (reference);
+		}
+
+		return result;
 	} catch (...) {
 		std::cerr << "Error while obtaining OpenCL diagnostic information\n";
 		return 1;
 	}
-
-	return 0;
 }
@@ -0,0 +1,127 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_AGGREGATOR_H_6C0A4E8B2D5F4C7A9E1B3D5F7A0C2E4B6D8F1A37
+#define NIV_OPENCLINFO_AGGREGATOR_H_6C0A4E8B2D5F4C7A9E1B3D5F7A0C2E4B6D8F1A37
+
+#include <clInfo.h>
+
+#include "StringTable.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace niv {
+/**
+The properties of a device together with the ones of its platform. Every entry
+holds the id of the property name in the upper, and the id of the value in the
+lower 32 bit, so sorting the entries sorts them by name.
+*/
+typedef std::vector<std::uint64_t> Configuration;
+
+/**
+All devices with the same configuration.
+*/
+struct ConfigurationGroup
+{
+	// Number of devices
+	std::uint64_t				count = 0;
+
+	// Ids of the hosts the devices belong to, every host is listed once
+	std::vector<std::uint32_t>	hosts;
+};
+
+/**
+Groups the devices of many hosts by their configuration.
+
+Names and values are interned, and every distinct configuration is stored only
+once, so memory grows with the number of distinct configurations rather than
+the number of devices. Values are stored as text, with multiple values
+separated by spaces like in the console output.
+
+An aggregator is not thread-safe. Use one per thread, and merge them at the
+end.
+*/
+class FleetAggregator
+{
+public:
+	struct ConfigurationHash
+	{
+		std::size_t operator () (const Configuration& c) const;
+	};
+
+	typedef std::unordered_map<Configuration, ConfigurationGroup,
+		ConfigurationHash> GroupMap;
+
+	/**
+	ignored are the names of properties which are left out of configurations,
+	as they differ between otherwise identical devices, for instance the free
+	memory.
+	*/
+	explicit FleetAggregator (const std::vector<std::string>& ignored);
+
+	FleetAggregator (const FleetAggregator&) = delete;
+	FleetAggregator& operator= (const FleetAggregator&) = delete;
+
+	/**
+	Add all devices of a host.
+	*/
+	void Add (const char* host, const cliNode* root);
+
+	/**
+	Add everything from another aggregator.
+	*/
+	void Merge (const FleetAggregator& other);
+
+	const StringTable& GetStrings () const
+	{
+		return strings_;
+	}
+
+	/**
+	Map from each distinct configuration to its group.
+	*/
+	const GroupMap& GetGroups () const
+	{
+		return groups_;
+	}
+
+	const char* GetHost (const std::uint32_t host) const
+	{
+		return strings_.Get (hosts_ [host]);
+	}
+
+	std::size_t GetHostCount () const
+	{
+		return hosts_.size ();
+	}
+
+	std::uint64_t GetDeviceCount () const
+	{
+		return deviceCount_;
+	}
+
+private:
+	void AddProperties (const cliNode* node);
+	bool IsIgnored (std::uint32_t name) const;
+
+	StringTable					strings_;
+	std::vector<std::uint32_t>	ignored_;
+
+	// Host ids map to their interned name
+	std::vector<std::uint32_t>	hosts_;
+	std::uint64_t				deviceCount_ = 0;
+
+	GroupMap					groups_;
+
+	// Reused while adding devices
+	Configuration				scratch_;
+	std::string					value_;
+};
+}
+
+#endif
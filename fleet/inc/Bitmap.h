@@ -0,0 +1,131 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_BITMAP_H_4E8A2C6F0B3D4E9A1C7F5B3D9E1A6C4F2B8D0E75
+#define NIV_OPENCLINFO_BITMAP_H_4E8A2C6F0B3D4E9A1C7F5B3D9E1A6C4F2B8D0E75
+
+#include <cstdint>
+#include <vector>
+
+namespace niv {
+/**
+A compressed set of 32 bit integers.
+
+The values are split into chunks of 65536 by their upper 16 bit. Each chunk
+stores the lower 16 bit either as a sorted array, if it holds at most 4096
+values, or as a bitset of 65536 bits otherwise, so no chunk takes more than
+8 KiB, and sparse chunks take 2 byte per value. This is the layout used by
+Roaring bitmaps.
+*/
+class Bitmap
+{
+public:
+	/**
+	Add a value. Adding values in increasing order is the fastest.
+	*/
+	void Add (std::uint32_t value);
+
+	bool Contains (std::uint32_t value) const;
+
+	std::uint64_t GetCount () const;
+
+	/**
+	The largest value. The bitmap must not be empty.
+	*/
+	std::uint32_t GetMaximum () const;
+
+	bool IsEmpty () const
+	{
+		return containers_.empty ();
+	}
+
+	Bitmap& operator|= (const Bitmap& other);
+
+	static Bitmap And (const Bitmap& a, const Bitmap& b);
+	static Bitmap AndNot (const Bitmap& a, const Bitmap& b);
+
+	/**
+	Call f (value) for all values, in increasing order.
+	*/
+	template <typename F>
+	void ForEach (F f) const
+	{
+		for (const auto& c : containers_) {
+			const std::uint32_t high = static_cast<std::uint32_t> (c.key) << 16;
+
+			if (c.bits.empty ()) {
+				for (const auto low : c.values) {
+					f (high | low);
+				}
+			} else {
+				for (std::uint32_t word = 0; word < c.bits.size (); ++word) {
+					auto w = c.bits [word];
+
+					while (w) {
+						const auto bit = CountTrailingZeros (w);
+						f (high | (word * 64 + bit));
+						w &= w - 1;
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	Append the serialized bitmap to data.
+	*/
+	void Write (std::vector<unsigned char>& data) const;
+
+	/**
+	Read a bitmap written by Write. Returns false if the data is malformed.
+	*/
+	bool Read (const unsigned char*& data, const unsigned char* end);
+
+private:
+	struct Container
+	{
+		std::uint16_t				key = 0;
+		std::uint32_t				count = 0;
+
+		// Either the sorted values, or, if not empty, 1024 words of bits
+		std::vector<std::uint16_t>	values;
+		std::vector<std::uint64_t>	bits;
+	};
+
+	static const std::uint32_t MaxArraySize = 4096;
+
+	static std::uint32_t CountTrailingZeros (std::uint64_t w);
+	static std::uint32_t CountBits (std::uint64_t w);
+
+	static void ToBits (const Container& c, std::vector<std::uint64_t>& bits);
+	static Container FromBits (std::uint16_t key, const std::vector<std::uint64_t>& bits);
+
+	enum Operation
+	{
+		Operation_Or,
+		Operation_And,
+		Operation_AndNot
+	};
+
+	static Container Combine (const Container& a, const Container& b,
+		Operation operation);
+
+	std::vector<Container>	containers_;
+};
+
+/**
+Append v to data in 7 bit groups, least significant first, where the high bit
+is set on all but the last byte.
+*/
+void WriteVarint (std::vector<unsigned char>& data, std::uint64_t v);
+
+/**
+Read a value written by WriteVarint. Returns false if data ends early.
+*/
+bool ReadVarint (const unsigned char*& data, const unsigned char* end,
+	std::uint64_t& v);
+}
+
+#endif
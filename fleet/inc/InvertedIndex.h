@@ -0,0 +1,183 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_INVERTEDINDEX_H_8D2F6B0A4C9E4A7D1B3F5E7C9A0D2B4F6E8C1A59
+#define NIV_OPENCLINFO_INVERTEDINDEX_H_8D2F6B0A4C9E4A7D1B3F5E7C9A0D2B4F6E8C1A59
+
+#include <clInfo.h>
+#include <clInfoPredicate.h>
+
+#include "Bitmap.h"
+#include "StringTable.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace niv {
+/**
+Maps every property value of a fleet to the devices which have it.
+
+Every device gets an id, and for each property, every distinct value has a
+bitmap of the ids of the devices with this value. Platform properties are
+indexed for all devices of the platform. A query then only combines the
+bitmaps of the values it is interested in, and never looks at the snapshots.
+
+Adding a host which is in the index already replaces its devices. The old ones
+keep their ids, but are marked as deleted until the index is compacted, so an
+update only touches the bitmaps of the values of the new devices.
+
+Like the aggregator, an index is not thread-safe. Use one per thread, and merge
+them at the end.
+*/
+class InvertedIndex
+{
+public:
+	struct Device
+	{
+		std::uint32_t	host;
+
+		// Index of the platform, and of the device within the platform
+		std::uint16_t	platform;
+		std::uint16_t	device;
+	};
+
+	/**
+	ignored are the names of properties which are not indexed.
+	*/
+	explicit InvertedIndex (const std::vector<std::string>& ignored);
+
+	InvertedIndex (const InvertedIndex&) = delete;
+	InvertedIndex& operator= (const InvertedIndex&) = delete;
+
+	/**
+	Add all devices of a host. If the host is in the index already, it is
+	replaced, unless its sequence number is larger than sequence, so the
+	newest snapshot wins regardless of the order in which they are added.
+	*/
+	void Add (const char* host, const cliNode* root, std::uint64_t sequence);
+
+	/**
+	Add all hosts of another index, as if they were added one by one.
+	*/
+	void Merge (const InvertedIndex& other);
+
+	/**
+	Remove deleted devices, and assign consecutive ids to the rest.
+	*/
+	void Compact ();
+
+	/**
+	Find all devices matching a query, for instance
+
+		CL_DEVICE_TYPE=GPU cl_khr_fp64 CL_DEVICE_GLOBAL_MEM_SIZE>=16G
+
+	The query is a list of terms separated by spaces, all of which have to
+	match. Terms are written like the predicates of Query, that is NAME or
+	NAME op value. A name which is not indexed as a property is taken to be an
+	extension, which matches devices listing it in CL_DEVICE_EXTENSIONS or
+	CL_PLATFORM_EXTENSIONS. Integers can end in K, M, G or T, which multiply
+	them by powers of 1024. Values containing spaces must be quoted.
+
+	Throws std::runtime_error if the query is malformed.
+	*/
+	Bitmap Find (const char* query) const;
+
+	/**
+	Load an index written by Save into this one, which must be empty. Returns
+	false if the file cannot be read or is not a valid index.
+	*/
+	bool Load (const char* path);
+
+	/**
+	Write the index to a temporary file next to path, and rename it to path
+	once complete, so an interrupted update leaves the old index intact.
+	*/
+	bool Save (const char* path) const;
+
+	const Device& GetDevice (const std::uint32_t device) const
+	{
+		return devices_ [device];
+	}
+
+	const char* GetHost (const std::uint32_t host) const
+	{
+		return strings_.Get (hosts_ [host].name);
+	}
+
+	std::size_t GetHostCount () const
+	{
+		return hosts_.size ();
+	}
+
+	/**
+	Number of devices which are not deleted.
+	*/
+	std::uint64_t GetDeviceCount () const
+	{
+		return devices_.size () - deleted_.GetCount ();
+	}
+
+	/**
+	The largest sequence number added so far.
+	*/
+	std::uint64_t GetSequence () const
+	{
+		return sequence_;
+	}
+
+private:
+	struct Host
+	{
+		std::uint32_t	name;
+		std::uint64_t	sequence;
+
+		// The devices of a host have consecutive ids
+		std::uint32_t	firstDevice;
+		std::uint32_t	deviceCount;
+	};
+
+	/**
+	The bitmaps of all values of a property.
+	*/
+	struct Postings
+	{
+		Bitmap	isTrue;
+		Bitmap	isFalse;
+
+		std::map<std::int64_t, Bitmap>				numbers;
+
+		// Keyed by the id of the string
+		std::unordered_map<std::uint32_t, Bitmap>	strings;
+	};
+
+	std::uint32_t BeginHost (std::uint32_t name, std::uint64_t sequence,
+		bool& accepted);
+	void AddProperties (const cliNode* node, std::uint32_t device);
+	bool IsIgnored (std::uint32_t name) const;
+
+	static std::vector<PropertyPredicate> Parse (const char* query);
+	Bitmap Evaluate (const PropertyPredicate& term) const;
+	Bitmap GetExtension (const char* property, const std::string& name) const;
+
+	StringTable					strings_;
+	std::vector<std::uint32_t>	ignored_;
+
+	std::vector<Host>			hosts_;
+	std::unordered_map<std::uint32_t, std::uint32_t>	hostIds_;
+
+	std::vector<Device>			devices_;
+	Bitmap						deleted_;
+
+	// Keyed by the id of the property name
+	std::unordered_map<std::uint32_t, Postings>	properties_;
+
+	std::uint64_t				sequence_ = 0;
+};
+}
+
+#endif
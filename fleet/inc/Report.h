@@ -0,0 +1,118 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_REPORT_H_1F5B9D3E7A0C4F2B8D6E0A4C2F8B1D5E9A3C7F60
+#define NIV_OPENCLINFO_REPORT_H_1F5B9D3E7A0C4F2B8D6E0A4C2F8B1D5E9A3C7F60
+
+#include "Aggregator.h"
+#include "Writer.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace niv {
+struct FleetReportOptions
+{
+	// Number of configurations, and of values per property, which are listed
+	int		configurations = 20;
+	int		values = 10;
+
+	// Number of hosts listed per configuration and outlier
+	int		hosts = 5;
+
+	// A value is an outlier if less than this share of the devices with the
+	// same platform and device name have it
+	double	outlierShare = 0.05;
+};
+
+/**
+Summary of an aggregated fleet.
+*/
+struct FleetReport
+{
+	struct Configuration
+	{
+		std::uint64_t				count;
+		std::size_t					hostCount;
+
+		// The identifying properties, null if the devices do not have them
+		const char*					platform;
+		const char*					device;
+		const char*					driver;
+
+		// The first hosts, ordered by name
+		std::vector<const char*>	hosts;
+	};
+
+	struct Value
+	{
+		// Null for devices without the property
+		const char*		value;
+		std::uint64_t	count;
+	};
+
+	/**
+	The values of a property which is not the same on all devices, the most
+	common first.
+	*/
+	struct Distribution
+	{
+		const char*			property;
+		std::size_t			valueCount;
+		std::vector<Value>	values;
+	};
+
+	struct Outlier
+	{
+		const char*		platform;
+		const char*		device;
+		const char*		property;
+		const char*		value;
+
+		// Devices with this value, out of the devices of the same model
+		std::uint64_t	count;
+		std::uint64_t	modelCount;
+
+		std::size_t					hostCount;
+		std::vector<const char*>	hosts;
+	};
+
+	std::size_t		hosts = 0;
+	std::size_t		failedFiles = 0;
+	std::uint64_t	devices = 0;
+	std::size_t		configurationCount = 0;
+
+	// Number of properties which are the same on all devices
+	std::size_t		uniformProperties = 0;
+
+	// The most common configurations first
+	std::vector<Configuration>	configurations;
+	std::vector<Distribution>	distributions;
+	std::vector<Outlier>		outliers;
+};
+
+/**
+Create the report for everything added to an aggregator.
+
+Distributions are computed from the configuration groups, so the runtime
+depends on the number of distinct configurations, not on the number of
+devices.
+*/
+FleetReport CreateFleetReport (const FleetAggregator& aggregator,
+	const FleetReportOptions& options);
+
+/**
+Write the report in a format meant for reading.
+*/
+void WriteFleetReportConsole (Writer& w, const FleetReport& report);
+
+/**
+Write the report as a JSON document, with the members named like the ones of
+FleetReport, starting with an uppercase letter.
+*/
+void WriteFleetReportJson (Writer& w, const FleetReport& report);
+}
+
+#endif
@@ -0,0 +1,127 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_STRINGTABLE_H_9B1E5C3A7D0F4B6E8A2C4E6B0D8F1A3C5E7B9D16
+#define NIV_OPENCLINFO_STRINGTABLE_H_9B1E5C3A7D0F4B6E8A2C4E6B0D8F1A3C5E7B9D16
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace niv {
+/**
+Interns strings, and assigns them consecutive ids.
+
+The strings are copied into large blocks, and looked up by pointer without
+creating temporaries, so interning a string which is known already does not
+allocate.
+*/
+class StringTable
+{
+public:
+	static const std::uint32_t Invalid = 0xFFFFFFFF;
+
+	StringTable () = default;
+	StringTable (const StringTable&) = delete;
+	StringTable& operator= (const StringTable&) = delete;
+
+	std::uint32_t Intern (const char* s)
+	{
+		const auto it = ids_.find (s);
+
+		if (it != ids_.end ()) {
+			return it->second;
+		}
+
+		const auto copy = Copy (s);
+		const auto id = static_cast<std::uint32_t> (strings_.size ());
+
+		strings_.push_back (copy);
+		ids_.emplace (copy, id);
+
+		return id;
+	}
+
+	/**
+	Get the id of s, or Invalid if it was not interned.
+	*/
+	std::uint32_t Find (const char* s) const
+	{
+		const auto it = ids_.find (s);
+		return it == ids_.end () ? Invalid : it->second;
+	}
+
+	const char* Get (const std::uint32_t id) const
+	{
+		return strings_ [id];
+	}
+
+	std::size_t GetCount () const
+	{
+		return strings_.size ();
+	}
+
+private:
+	struct Hash
+	{
+		std::size_t operator () (const char* s) const
+		{
+			// FNV-1a
+			std::uint64_t hash = 14695981039346656037ull;
+
+			for (; *s; ++s) {
+				hash ^= static_cast<unsigned char> (*s);
+				hash *= 1099511628211ull;
+			}
+
+			return static_cast<std::size_t> (hash);
+		}
+	};
+
+	struct Equal
+	{
+		bool operator () (const char* a, const char* b) const
+		{
+			return ::strcmp (a, b) == 0;
+		}
+	};
+
+	const char* Copy (const char* s)
+	{
+		const auto size = ::strlen (s) + 1;
+
+		// Large strings get a block of their own
+		if (size > blockSize_ / 4) {
+			large_.emplace_back (new char [size]);
+			::memcpy (large_.back ().get (), s, size);
+			return large_.back ().get ();
+		}
+
+		if (blockOffset_ + size > blockSize_) {
+			blocks_.emplace_back (new char [blockSize_]);
+			blockOffset_ = 0;
+		}
+
+		const auto result = blocks_.back ().get () + blockOffset_;
+		::memcpy (result, s, size);
+		blockOffset_ += size;
+
+		return result;
+	}
+
+	static const std::size_t blockSize_ = 65536;
+
+	std::vector<std::unique_ptr<char []>>	blocks_;
+	std::size_t								blockOffset_ = blockSize_;
+	std::vector<std::unique_ptr<char []>>	large_;
+
+	std::vector<const char*>	strings_;
+	std::unordered_map<const char*, std::uint32_t, Hash, Equal>	ids_;
+};
+}
+
+#endif
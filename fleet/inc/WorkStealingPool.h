@@ -0,0 +1,57 @@
+/**
+@author: Matthaeus G. "Anteru" Chajdas
+Licensed under the 3-clause BSD license
+*/
+
+#ifndef NIV_OPENCLINFO_WORKSTEALINGPOOL_H_3D7F1B9E5C2A4E8D0F6B4A2C8E1D7F3B9A5C0E48
+#define NIV_OPENCLINFO_WORKSTEALINGPOOL_H_3D7F1B9E5C2A4E8D0F6B4A2C8E1D7F3B9A5C0E48
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace niv {
+/**
+Runs a number of work items on several threads.
+
+The items are split into one contiguous range per thread, which the thread
+works through from the front. A thread which runs out of work steals the back
+half of the largest range left, so a few expensive items, like large files,
+do not keep the other threads idle.
+*/
+class WorkStealingPool
+{
+public:
+	explicit WorkStealingPool (int threadCount);
+
+	int GetThreadCount () const
+	{
+		return static_cast<int> (ranges_.size ());
+	}
+
+	/**
+	Call work (thread, item) for every item in [0, count), and return once all
+	are done. thread is in [0, GetThreadCount ()), and identifies the calling
+	thread, so work can use per-thread state without locking.
+	*/
+	void Run (std::size_t count,
+		const std::function<void (int thread, std::size_t item)>& work);
+
+private:
+	struct Range
+	{
+		std::mutex	mutex;
+		std::size_t	begin = 0;
+		std::size_t	end = 0;
+	};
+
+	bool Pop (Range& range, std::size_t& item);
+	bool Steal (int thread);
+
+	std::vector<std::unique_ptr<Range>>	ranges_;
+};
+}
+
+#endif
@@ -0,0 +1,177 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "Aggregator.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+namespace niv {
+// Bound to const references by std::vector, so it needs a definition
+const std::uint32_t StringTable::Invalid;
+
+namespace {
+////////////////////////////////////////////////////////////////////////////////
+const cliNode* FindChild (const cliNode* node, const char* name)
+{
+	for (auto c = node->firstChild; c; c = c->next) {
+		if (::strcmp (c->name, name) == 0) {
+			return c;
+		}
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FormatValues (std::string& s, const cliProperty* property)
+{
+	s.clear ();
+
+	for (auto v = property->value; v; v = v->next) {
+		if (v != property->value) {
+			s += ' ';
+		}
+
+		switch (property->type) {
+		case CLI_PropertyType_Bool:
+			s += v->b ? "true" : "false";
+			break;
+
+		case CLI_PropertyType_Int64:
+			{
+				char buffer [32];
+				std::snprintf (buffer, sizeof (buffer), "%" PRId64, v->i);
+				s += buffer;
+			}
+			break;
+
+		case CLI_PropertyType_String:
+			s += v->s;
+			break;
+		}
+	}
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::size_t FleetAggregator::ConfigurationHash::operator () (
+	const Configuration& c) const
+{
+	std::uint64_t hash = c.size ();
+
+	for (const auto entry : c) {
+		hash ^= entry + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+	}
+
+	return static_cast<std::size_t> (hash);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FleetAggregator::FleetAggregator (const std::vector<std::string>& ignored)
+{
+	for (const auto& name : ignored) {
+		ignored_.push_back (strings_.Intern (name.c_str ()));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool FleetAggregator::IsIgnored (const std::uint32_t name) const
+{
+	return std::find (ignored_.begin (), ignored_.end (), name) != ignored_.end ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FleetAggregator::AddProperties (const cliNode* node)
+{
+	for (auto p = node->firstProperty; p; p = p->next) {
+		const auto name = strings_.Intern (p->name);
+
+		if (IsIgnored (name)) {
+			continue;
+		}
+
+		FormatValues (value_, p);
+		const auto value = strings_.Intern (value_.c_str ());
+
+		scratch_.push_back ((static_cast<std::uint64_t> (name) << 32) | value);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FleetAggregator::Add (const char* host, const cliNode* root)
+{
+	const auto hostId = static_cast<std::uint32_t> (hosts_.size ());
+	hosts_.push_back (strings_.Intern (host));
+
+	for (auto platform = root->firstChild; platform; platform = platform->next) {
+		const auto devices = FindChild (platform, "Devices");
+
+		if (devices == nullptr) {
+			continue;
+		}
+
+		for (auto device = devices->firstChild; device; device = device->next) {
+			scratch_.clear ();
+			AddProperties (platform);
+			AddProperties (device);
+			std::sort (scratch_.begin (), scratch_.end ());
+
+			auto& group = groups_ [scratch_];
+			++group.count;
+
+			// Devices of a host are added one after the other
+			if (group.hosts.empty () || group.hosts.back () != hostId) {
+				group.hosts.push_back (hostId);
+			}
+
+			++deviceCount_;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void FleetAggregator::Merge (const FleetAggregator& other)
+{
+	// Ids of the other aggregator mapped to the ones of this one, filled in
+	// on first use
+	std::vector<std::uint32_t> ids (other.strings_.GetCount (), StringTable::Invalid);
+
+	const auto translate = [this, &other, &ids] (const std::uint32_t id) -> std::uint32_t {
+		if (ids [id] == StringTable::Invalid) {
+			ids [id] = strings_.Intern (other.strings_.Get (id));
+		}
+
+		return ids [id];
+	};
+
+	const auto hostOffset = static_cast<std::uint32_t> (hosts_.size ());
+
+	for (const auto host : other.hosts_) {
+		hosts_.push_back (translate (host));
+	}
+
+	for (const auto& entry : other.groups_) {
+		scratch_.clear ();
+
+		for (const auto e : entry.first) {
+			const auto name = translate (static_cast<std::uint32_t> (e >> 32));
+			const auto value = translate (static_cast<std::uint32_t> (e));
+			scratch_.push_back ((static_cast<std::uint64_t> (name) << 32) | value);
+		}
+
+		std::sort (scratch_.begin (), scratch_.end ());
+
+		auto& group = groups_ [scratch_];
+		group.count += entry.second.count;
+
+		for (const auto host : entry.second.hosts) {
+			group.hosts.push_back (host + hostOffset);
+		}
+	}
+
+	deviceCount_ += other.deviceCount_;
+}
+}
@@ -0,0 +1,470 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "Bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+#if _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace niv {
+namespace {
+const std::uint32_t WordCount = 65536 / 64;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteVarint (std::vector<unsigned char>& data, std::uint64_t v)
+{
+	while (v >= 0x80) {
+		data.push_back (static_cast<unsigned char> (v | 0x80));
+		v >>= 7;
+	}
+
+	data.push_back (static_cast<unsigned char> (v));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool ReadVarint (const unsigned char*& data, const unsigned char* end,
+	std::uint64_t& v)
+{
+	v = 0;
+
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (data == end) {
+			return false;
+		}
+
+		const auto b = *data++;
+		v |= static_cast<std::uint64_t> (b & 0x7F) << shift;
+
+		if ((b & 0x80) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::uint32_t Bitmap::CountTrailingZeros (const std::uint64_t w)
+{
+#if _MSC_VER
+	unsigned long index;
+	_BitScanForward64 (&index, w);
+	return index;
+#else
+	return static_cast<std::uint32_t> (__builtin_ctzll (w));
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::uint32_t Bitmap::CountBits (const std::uint64_t w)
+{
+#if _MSC_VER
+	return static_cast<std::uint32_t> (__popcnt64 (w));
+#else
+	return static_cast<std::uint32_t> (__builtin_popcountll (w));
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Bitmap::ToBits (const Container& c, std::vector<std::uint64_t>& bits)
+{
+	if (! c.bits.empty ()) {
+		bits = c.bits;
+		return;
+	}
+
+	bits.assign (WordCount, 0);
+
+	for (const auto v : c.values) {
+		bits [v / 64] |= 1ull << (v % 64);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Bitmap::Container Bitmap::FromBits (const std::uint16_t key,
+	const std::vector<std::uint64_t>& bits)
+{
+	Container result;
+	result.key = key;
+
+	for (const auto w : bits) {
+		result.count += CountBits (w);
+	}
+
+	if (result.count > MaxArraySize) {
+		result.bits = bits;
+		return result;
+	}
+
+	result.values.reserve (result.count);
+
+	for (std::uint32_t word = 0; word < WordCount; ++word) {
+		auto w = bits [word];
+
+		while (w) {
+			result.values.push_back (static_cast<std::uint16_t> (
+				word * 64 + CountTrailingZeros (w)));
+			w &= w - 1;
+		}
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Bitmap::Add (const std::uint32_t value)
+{
+	const auto key = static_cast<std::uint16_t> (value >> 16);
+	const auto low = static_cast<std::uint16_t> (value);
+
+	auto it = containers_.end ();
+
+	if (containers_.empty () || containers_.back ().key < key) {
+		containers_.emplace_back ();
+		containers_.back ().key = key;
+		it = containers_.end () - 1;
+	} else if (containers_.back ().key == key) {
+		it = containers_.end () - 1;
+	} else {
+		it = std::lower_bound (containers_.begin (), containers_.end (), key,
+			[] (const Container& c, const std::uint16_t k) -> bool {
+				return c.key < k;
+		});
+
+		if (it->key != key) {
+			it = containers_.emplace (it);
+			it->key = key;
+		}
+	}
+
+	auto& c = *it;
+
+	if (! c.bits.empty ()) {
+		auto& word = c.bits [low / 64];
+		const auto bit = 1ull << (low % 64);
+
+		if ((word & bit) == 0) {
+			word |= bit;
+			++c.count;
+		}
+
+		return;
+	}
+
+	if (c.values.empty () || c.values.back () < low) {
+		c.values.push_back (low);
+	} else {
+		const auto pos = std::lower_bound (c.values.begin (), c.values.end (), low);
+
+		if (*pos == low) {
+			return;
+		}
+
+		c.values.insert (pos, low);
+	}
+
+	++c.count;
+
+	if (c.count > MaxArraySize) {
+		std::vector<std::uint64_t> bits;
+		ToBits (c, bits);
+		c.bits.swap (bits);
+		c.values = std::vector<std::uint16_t> ();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Bitmap::Contains (const std::uint32_t value) const
+{
+	const auto key = static_cast<std::uint16_t> (value >> 16);
+	const auto low = static_cast<std::uint16_t> (value);
+
+	const auto it = std::lower_bound (containers_.begin (), containers_.end (), key,
+		[] (const Container& c, const std::uint16_t k) -> bool {
+			return c.key < k;
+	});
+
+	if (it == containers_.end () || it->key != key) {
+		return false;
+	}
+
+	if (! it->bits.empty ()) {
+		return (it->bits [low / 64] & (1ull << (low % 64))) != 0;
+	}
+
+	return std::binary_search (it->values.begin (), it->values.end (), low);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::uint64_t Bitmap::GetCount () const
+{
+	std::uint64_t count = 0;
+
+	for (const auto& c : containers_) {
+		count += c.count;
+	}
+
+	return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::uint32_t Bitmap::GetMaximum () const
+{
+	const auto& c = containers_.back ();
+	const std::uint32_t high = static_cast<std::uint32_t> (c.key) << 16;
+
+	if (c.bits.empty ()) {
+		return high | c.values.back ();
+	}
+
+	for (auto word = c.bits.size (); word > 0; --word) {
+		if (const auto w = c.bits [word - 1]) {
+			std::uint32_t bit = 63;
+			while ((w >> bit) == 0) {
+				--bit;
+			}
+
+			return high | static_cast<std::uint32_t> ((word - 1) * 64 + bit);
+		}
+	}
+
+	return high;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Bitmap::Container Bitmap::Combine (const Container& a, const Container& b,
+	const Operation operation)
+{
+	if (a.bits.empty () && b.bits.empty ()) {
+		Container result;
+		result.key = a.key;
+
+		const auto out = std::back_inserter (result.values);
+
+		switch (operation) {
+		case Operation_Or:
+			std::set_union (a.values.begin (), a.values.end (),
+				b.values.begin (), b.values.end (), out);
+			break;
+
+		case Operation_And:
+			std::set_intersection (a.values.begin (), a.values.end (),
+				b.values.begin (), b.values.end (), out);
+			break;
+
+		case Operation_AndNot:
+			std::set_difference (a.values.begin (), a.values.end (),
+				b.values.begin (), b.values.end (), out);
+			break;
+		}
+
+		result.count = static_cast<std::uint32_t> (result.values.size ());
+
+		if (result.count <= MaxArraySize) {
+			return result;
+		}
+
+		std::vector<std::uint64_t> bits;
+		ToBits (result, bits);
+		return FromBits (a.key, bits);
+	}
+
+	std::vector<std::uint64_t> bits, other;
+	ToBits (a, bits);
+	ToBits (b, other);
+
+	for (std::uint32_t i = 0; i < WordCount; ++i) {
+		switch (operation) {
+		case Operation_Or:		bits [i] |= other [i]; break;
+		case Operation_And:		bits [i] &= other [i]; break;
+		case Operation_AndNot:	bits [i] &= ~other [i]; break;
+		}
+	}
+
+	return FromBits (a.key, bits);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Bitmap& Bitmap::operator|= (const Bitmap& other)
+{
+	std::vector<Container> result;
+	result.reserve (containers_.size () + other.containers_.size ());
+
+	auto a = containers_.begin ();
+	auto b = other.containers_.begin ();
+
+	while (a != containers_.end () || b != other.containers_.end ()) {
+		if (b == other.containers_.end () ||
+			(a != containers_.end () && a->key < b->key)) {
+			result.push_back (std::move (*a++));
+		} else if (a == containers_.end () || b->key < a->key) {
+			result.push_back (*b++);
+		} else {
+			result.push_back (Combine (*a++, *b++, Operation_Or));
+		}
+	}
+
+	containers_.swap (result);
+	return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Bitmap Bitmap::And (const Bitmap& a, const Bitmap& b)
+{
+	Bitmap result;
+
+	auto i = a.containers_.begin ();
+	auto j = b.containers_.begin ();
+
+	while (i != a.containers_.end () && j != b.containers_.end ()) {
+		if (i->key < j->key) {
+			++i;
+		} else if (j->key < i->key) {
+			++j;
+		} else {
+			auto c = Combine (*i++, *j++, Operation_And);
+
+			if (c.count > 0) {
+				result.containers_.push_back (std::move (c));
+			}
+		}
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Bitmap Bitmap::AndNot (const Bitmap& a, const Bitmap& b)
+{
+	Bitmap result;
+
+	auto j = b.containers_.begin ();
+
+	for (const auto& c : a.containers_) {
+		while (j != b.containers_.end () && j->key < c.key) {
+			++j;
+		}
+
+		if (j == b.containers_.end () || j->key != c.key) {
+			result.containers_.push_back (c);
+			continue;
+		}
+
+		auto d = Combine (c, *j, Operation_AndNot);
+
+		if (d.count > 0) {
+			result.containers_.push_back (std::move (d));
+		}
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+The container count, followed by the key and value count of each container.
+Array containers store the differences between consecutive values as varints,
+bitset containers store their 1024 words in little endian.
+*/
+void Bitmap::Write (std::vector<unsigned char>& data) const
+{
+	WriteVarint (data, containers_.size ());
+
+	for (const auto& c : containers_) {
+		WriteVarint (data, c.key);
+		WriteVarint (data, c.count);
+
+		if (c.bits.empty ()) {
+			std::uint32_t previous = 0;
+
+			for (const auto v : c.values) {
+				WriteVarint (data, v - previous);
+				previous = v;
+			}
+		} else {
+			for (const auto w : c.bits) {
+				for (int i = 0; i < 64; i += 8) {
+					data.push_back (static_cast<unsigned char> (w >> i));
+				}
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Bitmap::Read (const unsigned char*& data, const unsigned char* end)
+{
+	containers_.clear ();
+
+	std::uint64_t count;
+	if (! ReadVarint (data, end, count)) {
+		return false;
+	}
+
+	for (std::uint64_t i = 0; i < count; ++i) {
+		std::uint64_t key, size;
+
+		if (! ReadVarint (data, end, key) || ! ReadVarint (data, end, size) ||
+			key > 0xFFFF || size == 0 || size > 65536) {
+			return false;
+		}
+
+		if (! containers_.empty () && containers_.back ().key >= key) {
+			return false;
+		}
+
+		containers_.emplace_back ();
+		auto& c = containers_.back ();
+		c.key = static_cast<std::uint16_t> (key);
+		c.count = static_cast<std::uint32_t> (size);
+
+		if (size <= MaxArraySize) {
+			c.values.reserve (size);
+			std::uint64_t value = 0;
+
+			for (std::uint64_t j = 0; j < size; ++j) {
+				std::uint64_t delta;
+				if (! ReadVarint (data, end, delta)) {
+					return false;
+				}
+
+				value += delta;
+
+				if (value > 0xFFFF || (j > 0 && delta == 0)) {
+					return false;
+				}
+
+				c.values.push_back (static_cast<std::uint16_t> (value));
+			}
+		} else {
+			if (static_cast<std::size_t> (end - data) < WordCount * 8) {
+				return false;
+			}
+
+			c.bits.resize (WordCount);
+			std::uint64_t bitCount = 0;
+
+			for (auto& w : c.bits) {
+				w = 0;
+
+				for (int b = 0; b < 64; b += 8) {
+					w |= static_cast<std::uint64_t> (*data++) << b;
+				}
+
+				bitCount += CountBits (w);
+			}
+
+			if (bitCount != size) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+}
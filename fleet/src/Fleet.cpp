@@ -0,0 +1,484 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include <clInfo.h>
+
+#include "Aggregator.h"
+#include "InvertedIndex.h"
+#include "Report.h"
+#include "WorkStealingPool.h"
+#include "Writer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+// Properties which differ between otherwise identical devices
+const char* const defaultIgnoredProperties [] = {
+	"CL_DEVICE_GLOBAL_FREE_MEMORY_AMD"
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+The host name of a snapshot is its file name without directory and extension.
+*/
+std::string GetHostName (const std::string& path)
+{
+	const auto slash = path.find_last_of ("/\\");
+	auto name = slash == std::string::npos ? path : path.substr (slash + 1);
+
+	const auto dot = name.find_last_of ('.');
+	if (dot != std::string::npos && dot > 0) {
+		name.resize (dot);
+	}
+
+	return name;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Read file names from a list, one per line. - reads the list from standard
+input.
+*/
+bool ReadList (const char* list, std::vector<std::string>& files)
+{
+	std::ifstream file;
+	std::istream* input = &std::cin;
+
+	if (::strcmp (list, "-") != 0) {
+		file.open (list);
+
+		if (! file) {
+			return false;
+		}
+
+		input = &file;
+	}
+
+	std::string line;
+	while (std::getline (*input, line)) {
+		if (! line.empty () && line.back () == '\r') {
+			line.pop_back ();
+		}
+
+		if (! line.empty ()) {
+			files.push_back (line);
+		}
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Load all files on the threads of the pool, and call f (thread, item, root) for
+each one which could be loaded. Returns the number of files which could not be
+loaded.
+*/
+template <typename F>
+std::size_t LoadFiles (niv::WorkStealingPool& pool,
+	const std::vector<std::string>& files, cliInfo* reference, F f)
+{
+	std::atomic<std::size_t> failed {0};
+
+	pool.Run (files.size (), [&] (const int thread, const std::size_t item) -> void {
+		cliInfo* info;
+		cliInfo_Create (&info);
+
+		cliNode* root;
+		if (cliInfo_LoadFile (info, reference, files [item].c_str ()) == CLI_Success &&
+			cliInfo_GetRoot (info, &root) == CLI_Success) {
+			f (thread, item, root);
+		} else {
+			++failed;
+		}
+
+		cliInfo_Destroy (info);
+	});
+
+	return failed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int Aggregate (const std::vector<std::string>& files,
+	const std::vector<std::string>& ignored, cliInfo* reference,
+	const int threadCount, const niv::FleetReportOptions& options,
+	const bool json)
+{
+	const auto start = std::chrono::steady_clock::now ();
+
+	niv::WorkStealingPool pool (threadCount);
+
+	std::vector<std::unique_ptr<niv::FleetAggregator>> aggregators;
+	for (int i = 0; i < pool.GetThreadCount (); ++i) {
+		aggregators.emplace_back (new niv::FleetAggregator (ignored));
+	}
+
+	const auto failed = LoadFiles (pool, files, reference,
+		[&] (const int thread, const std::size_t item, const cliNode* root) -> void {
+			aggregators [thread]->Add (GetHostName (files [item]).c_str (), root);
+	});
+
+	for (std::size_t i = 1; i < aggregators.size (); ++i) {
+		aggregators [0]->Merge (*aggregators [i]);
+		aggregators [i].reset ();
+	}
+
+	auto report = niv::CreateFleetReport (*aggregators [0], options);
+	report.failedFiles = failed;
+
+	const auto elapsed = std::chrono::duration<double> (
+		std::chrono::steady_clock::now () - start).count ();
+
+	std::cerr << "Aggregated " << files.size () << " files on "
+		<< pool.GetThreadCount () << " threads in " << elapsed << " s\n";
+
+	niv::Writer out (1 /* stdout */);
+
+	if (json) {
+		niv::WriteFleetReportJson (out, report);
+	} else {
+		niv::WriteFleetReportConsole (out, report);
+	}
+
+	if (! out.Flush ()) {
+		std::cerr << "Error while writing the report\n";
+		return 1;
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Add the files to the index. A file replaces the ones of the same host which
+were added before, in this or in an earlier update.
+*/
+void UpdateIndex (niv::InvertedIndex& index,
+	const std::vector<std::string>& files,
+	const std::vector<std::string>& ignored, cliInfo* reference,
+	const int threadCount)
+{
+	const auto start = std::chrono::steady_clock::now ();
+
+	niv::WorkStealingPool pool (threadCount);
+
+	std::vector<std::unique_ptr<niv::InvertedIndex>> indices;
+	for (int i = 0; i < pool.GetThreadCount (); ++i) {
+		indices.emplace_back (new niv::InvertedIndex (ignored));
+	}
+
+	// Every update gets the next 2^32 sequence numbers, in the order of the
+	// files, so the thread which loads a file does not matter
+	const auto first = ((index.GetSequence () >> 32) + 1) << 32;
+
+	const auto failed = LoadFiles (pool, files, reference,
+		[&] (const int thread, const std::size_t item, const cliNode* root) -> void {
+			indices [thread]->Add (GetHostName (files [item]).c_str (), root,
+				first + item);
+	});
+
+	for (const auto& i : indices) {
+		index.Merge (*i);
+	}
+
+	const auto elapsed = std::chrono::duration<double> (
+		std::chrono::steady_clock::now () - start).count ();
+
+	std::cerr << "Indexed " << (files.size () - failed) << " files on "
+		<< pool.GetThreadCount () << " threads in " << elapsed << " s";
+
+	if (failed > 0) {
+		std::cerr << ", " << failed << " could not be loaded";
+	}
+
+	std::cerr << '\n';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Write the hosts with matching devices, ordered by name, and if devices is set,
+the matching devices of each.
+*/
+bool WriteMatches (const niv::InvertedIndex& index, const niv::Bitmap& matches,
+	const bool devices, const bool json)
+{
+	// The devices of a host have consecutive ids
+	struct HostMatches
+	{
+		std::uint32_t				host;
+		std::vector<std::uint32_t>	devices;
+	};
+
+	std::vector<HostMatches> hosts;
+
+	matches.ForEach ([&index, &hosts] (const std::uint32_t device) -> void {
+		const auto host = index.GetDevice (device).host;
+
+		if (hosts.empty () || hosts.back ().host != host) {
+			hosts.push_back (HostMatches ());
+			hosts.back ().host = host;
+		}
+
+		hosts.back ().devices.push_back (device);
+	});
+
+	std::sort (hosts.begin (), hosts.end (),
+		[&index] (const HostMatches& a, const HostMatches& b) -> bool {
+			return ::strcmp (index.GetHost (a.host), index.GetHost (b.host)) < 0;
+	});
+
+	niv::Writer out (1 /* stdout */);
+
+	if (json) {
+		out.WriteLiteral ("{\"Devices\":");
+		out.WriteInt (static_cast<std::int64_t> (matches.GetCount ()));
+		out.WriteLiteral (",\"Hosts\":[");
+	}
+
+	for (std::size_t i = 0; i < hosts.size (); ++i) {
+		const auto name = index.GetHost (hosts [i].host);
+
+		if (json) {
+			if (i > 0) {
+				out.Put (',');
+			}
+
+			out.WriteLiteral ("{\"Name\":\"");
+			out.WriteJsonEscaped (name);
+			out.WriteLiteral ("\",\"Devices\":[");
+		} else if (! devices) {
+			out.Write (name);
+			out.Put ('\n');
+			continue;
+		}
+
+		for (std::size_t j = 0; j < hosts [i].devices.size (); ++j) {
+			const auto& device = index.GetDevice (hosts [i].devices [j]);
+
+			if (json) {
+				if (j > 0) {
+					out.Put (',');
+				}
+
+				out.WriteLiteral ("{\"Platform\":");
+				out.WriteInt (device.platform);
+				out.WriteLiteral (",\"Device\":");
+				out.WriteInt (device.device);
+				out.Put ('}');
+			} else {
+				out.Write (name);
+				out.WriteLiteral (" Platform ");
+				out.WriteInt (device.platform);
+				out.WriteLiteral (" Device ");
+				out.WriteInt (device.device);
+				out.Put ('\n');
+			}
+		}
+
+		if (json) {
+			out.WriteLiteral ("]}");
+		}
+	}
+
+	if (json) {
+		out.WriteLiteral ("]}\n");
+	}
+
+	return out.Flush ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Update the index with the files, if any, and run the query on it.
+*/
+int Index (const char* indexFile, const std::vector<std::string>& files,
+	const std::vector<std::string>& ignored, cliInfo* reference,
+	const int threadCount, const bool compact, const char* query,
+	const bool devices, const bool json)
+{
+	niv::InvertedIndex index (ignored);
+
+	if (std::ifstream (indexFile) && ! index.Load (indexFile)) {
+		std::cerr << "Could not load the index '" << indexFile << "'\n";
+		return 1;
+	}
+
+	if (! files.empty () || compact) {
+		if (! files.empty ()) {
+			UpdateIndex (index, files, ignored, reference, threadCount);
+		}
+
+		if (compact) {
+			index.Compact ();
+		}
+
+		if (! index.Save (indexFile)) {
+			std::cerr << "Could not write the index '" << indexFile << "'\n";
+			return 1;
+		}
+
+		std::cerr << "The index has " << index.GetHostCount () << " hosts with "
+			<< index.GetDeviceCount () << " devices\n";
+	}
+
+	if (query == nullptr) {
+		return 0;
+	}
+
+	const auto start = std::chrono::steady_clock::now ();
+
+	niv::Bitmap matches;
+
+	try {
+		matches = index.Find (query);
+	} catch (const std::runtime_error& e) {
+		std::cerr << e.what () << '\n';
+		return 1;
+	}
+
+	const auto elapsed = std::chrono::duration<double, std::milli> (
+		std::chrono::steady_clock::now () - start).count ();
+
+	std::cerr << matches.GetCount () << " devices match, found in "
+		<< elapsed << " ms\n";
+
+	if (! WriteMatches (index, matches, devices, json)) {
+		std::cerr << "Error while writing the output\n";
+		return 1;
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void PrintUsage ()
+{
+	std::cerr <<
+		"Usage: OpenCLInfoFleet [options] files...\n"
+		"       OpenCLInfoFleet --index file [--find query] [options] [files...]\n"
+		"\n"
+		"Aggregates snapshots, or the XML or JSON output of OpenCLInfo, of many\n"
+		"hosts. The host name is the file name without the extension.\n"
+		"\n"
+		"  --list file          Read further file names from file, - for stdin\n"
+		"  --reference file     Reference used to save delta snapshots\n"
+		"  --threads n          Number of threads, default: all cores\n"
+		"  --ignore name        Leave a property out of the configurations\n"
+		"  --top n              Number of configurations listed, default: 20\n"
+		"  --values n           Number of values listed per property, default: 10\n"
+		"  --hosts n            Number of hosts listed per entry, default: 5\n"
+		"  --outlier-share x    Share below which a value is an outlier among the\n"
+		"                       devices of the same model, default: 0.05\n"
+		"  -j                   Write the report as JSON\n"
+		"\n"
+		"  --index file         Add the files to an index instead, which is created\n"
+		"                       if it does not exist. A file replaces the devices of\n"
+		"                       its host added before.\n"
+		"  --find query         Print the hosts in the index with a device matching\n"
+		"                       all terms of the query, for instance\n"
+		"                       \"CL_DEVICE_TYPE=GPU cl_khr_fp64\n"
+		"                       CL_DEVICE_GLOBAL_MEM_SIZE>=16G\"\n"
+		"  --devices            Print the matching devices of each host\n"
+		"  --compact            Remove replaced devices from the index\n";
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int argc, char* argv [])
+{
+	std::vector<std::string> files;
+	std::vector<std::string> ignored (std::begin (defaultIgnoredProperties),
+		std::end (defaultIgnoredProperties));
+	const char* referenceFile = nullptr;
+	const char* indexFile = nullptr;
+	const char* query = nullptr;
+	int threadCount = static_cast<int> (std::thread::hardware_concurrency ());
+	bool json = false;
+	bool devices = false;
+	bool compact = false;
+
+	niv::FleetReportOptions options;
+
+	for (int i = 1; i < argc; ++i) {
+		const bool hasArgument = (i + 1) < argc;
+
+		if (::strcmp (argv [i], "--list") == 0 && hasArgument) {
+			if (! ReadList (argv [++i], files)) {
+				std::cerr << "Could not read the list '" << argv [i] << "'\n";
+				return 1;
+			}
+		} else if (::strcmp (argv [i], "--reference") == 0 && hasArgument) {
+			referenceFile = argv [++i];
+		} else if (::strcmp (argv [i], "--threads") == 0 && hasArgument) {
+			threadCount = std::atoi (argv [++i]);
+		} else if (::strcmp (argv [i], "--ignore") == 0 && hasArgument) {
+			ignored.push_back (argv [++i]);
+		} else if (::strcmp (argv [i], "--top") == 0 && hasArgument) {
+			options.configurations = std::atoi (argv [++i]);
+		} else if (::strcmp (argv [i], "--values") == 0 && hasArgument) {
+			options.values = std::atoi (argv [++i]);
+		} else if (::strcmp (argv [i], "--hosts") == 0 && hasArgument) {
+			options.hosts = std::atoi (argv [++i]);
+		} else if (::strcmp (argv [i], "--outlier-share") == 0 && hasArgument) {
+			options.outlierShare = std::atof (argv [++i]);
+		} else if (::strcmp (argv [i], "-j") == 0) {
+			json = true;
+		} else if (::strcmp (argv [i], "--index") == 0 && hasArgument) {
+			indexFile = argv [++i];
+		} else if (::strcmp (argv [i], "--find") == 0 && hasArgument) {
+			query = argv [++i];
+		} else if (::strcmp (argv [i], "--devices") == 0) {
+			devices = true;
+		} else if (::strcmp (argv [i], "--compact") == 0) {
+			compact = true;
+		} else if (argv [i][0] == '-') {
+			PrintUsage ();
+			return 1;
+		} else {
+			files.push_back (argv [i]);
+		}
+	}
+
+	const bool valid = indexFile
+		? (! files.empty () || query || compact)
+		: (! files.empty () && ! query);
+
+	if (! valid) {
+		PrintUsage ();
+		return 1;
+	}
+
+	cliInfo* reference = nullptr;
+
+	if (referenceFile) {
+		cliInfo_Create (&reference);
+
+		if (cliInfo_LoadFile (reference, nullptr, referenceFile) != CLI_Success) {
+			std::cerr << "Could not load reference '" << referenceFile << "'\n";
+			cliInfo_Destroy (reference);
+			return 1;
+		}
+	}
+
+	const int result = indexFile
+		? Index (indexFile, files, ignored, reference, threadCount, compact,
+			query, devices, json)
+		: Aggregate (files, ignored, reference, threadCount, options, json);
+
+	if (reference) {
+		cliInfo_Destroy (reference);
+	}
+
+	return result;
+}
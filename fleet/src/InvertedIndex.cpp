@@ -0,0 +1,761 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "InvertedIndex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#if _WIN32
+#include <Windows.h>
+#endif
+
+namespace niv {
+namespace {
+const char magic [4] = { 'C', 'L', 'I', 'X' };
+const std::uint64_t version = 1;
+
+////////////////////////////////////////////////////////////////////////////////
+const cliNode* FindChild (const cliNode* node, const char* name)
+{
+	for (auto c = node->firstChild; c; c = c->next) {
+		if (::strcmp (c->name, name) == 0) {
+			return c;
+		}
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void SkipSpaces (const char*& p)
+{
+	while (*p == ' ' || *p == '\t') {
+		++p;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+[[noreturn]] void Fail (const char* message, const char* text, const char* p)
+{
+	throw std::runtime_error (std::string (message) + " at position " +
+		std::to_string (p - text) + " of '" + text + "'");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::uint64_t ZigZag (const std::int64_t v)
+{
+	return (static_cast<std::uint64_t> (v) << 1) ^
+		static_cast<std::uint64_t> (v >> 63);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::int64_t UnZigZag (const std::uint64_t v)
+{
+	return static_cast<std::int64_t> (v >> 1) ^ -static_cast<std::int64_t> (v & 1);
+}
+
+/**
+Reads the index file, and throws if it is malformed.
+*/
+class Reader
+{
+public:
+	Reader (const unsigned char* data, const unsigned char* end)
+		: data_ (data), end_ (end)
+	{
+	}
+
+	std::uint64_t Read (const std::uint64_t limit)
+	{
+		std::uint64_t v;
+		if (! ReadVarint (data_, end_, v) || v > limit) {
+			throw std::runtime_error ("Malformed index");
+		}
+
+		return v;
+	}
+
+	std::string ReadString ()
+	{
+		const auto length = Read (static_cast<std::uint64_t> (end_ - data_));
+		std::string result (reinterpret_cast<const char*> (data_),
+			static_cast<std::size_t> (length));
+		data_ += length;
+
+		return result;
+	}
+
+	/**
+	Read a bitmap with values less than limit.
+	*/
+	void Read (Bitmap& bitmap, const std::uint64_t limit)
+	{
+		if (! bitmap.Read (data_, end_) ||
+			(! bitmap.IsEmpty () && bitmap.GetMaximum () >= limit)) {
+			throw std::runtime_error ("Malformed index");
+		}
+	}
+
+	bool IsAtEnd () const
+	{
+		return data_ == end_;
+	}
+
+private:
+	const unsigned char*	data_;
+	const unsigned char*	end_;
+};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+InvertedIndex::InvertedIndex (const std::vector<std::string>& ignored)
+{
+	for (const auto& name : ignored) {
+		ignored_.push_back (strings_.Intern (name.c_str ()));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool InvertedIndex::IsIgnored (const std::uint32_t name) const
+{
+	return std::find (ignored_.begin (), ignored_.end (), name) != ignored_.end ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Find or create the host name, and prepare it for getting new devices, which
+have to be added right after. accepted is false if the host has a larger
+sequence number already, in which case its devices must not be added.
+*/
+std::uint32_t InvertedIndex::BeginHost (const std::uint32_t name,
+	const std::uint64_t sequence, bool& accepted)
+{
+	sequence_ = std::max (sequence_, sequence);
+
+	const auto first = static_cast<std::uint32_t> (devices_.size ());
+	const auto it = hostIds_.find (name);
+
+	if (it == hostIds_.end ()) {
+		const auto id = static_cast<std::uint32_t> (hosts_.size ());
+		const Host host = { name, sequence, first, 0 };
+
+		hosts_.push_back (host);
+		hostIds_.emplace (name, id);
+
+		accepted = true;
+		return id;
+	}
+
+	auto& host = hosts_ [it->second];
+
+	if (host.sequence > sequence) {
+		accepted = false;
+		return it->second;
+	}
+
+	for (std::uint32_t i = 0; i < host.deviceCount; ++i) {
+		deleted_.Add (host.firstDevice + i);
+	}
+
+	host.sequence = sequence;
+	host.firstDevice = first;
+	host.deviceCount = 0;
+
+	accepted = true;
+	return it->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void InvertedIndex::AddProperties (const cliNode* node, const std::uint32_t device)
+{
+	for (auto p = node->firstProperty; p; p = p->next) {
+		const auto name = strings_.Intern (p->name);
+
+		if (IsIgnored (name)) {
+			continue;
+		}
+
+		auto& postings = properties_ [name];
+
+		for (auto v = p->value; v; v = v->next) {
+			switch (p->type) {
+			case CLI_PropertyType_Bool:
+				(v->b ? postings.isTrue : postings.isFalse).Add (device);
+				break;
+
+			case CLI_PropertyType_Int64:
+				postings.numbers [v->i].Add (device);
+				break;
+
+			case CLI_PropertyType_String:
+				postings.strings [strings_.Intern (v->s)].Add (device);
+				break;
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void InvertedIndex::Add (const char* host, const cliNode* root,
+	const std::uint64_t sequence)
+{
+	bool accepted;
+	const auto hostId = BeginHost (strings_.Intern (host), sequence, accepted);
+
+	if (! accepted) {
+		return;
+	}
+
+	const auto first = devices_.size ();
+
+	std::uint16_t platformIndex = 0;
+	for (auto platform = root->firstChild; platform;
+		platform = platform->next, ++platformIndex) {
+		const auto devices = FindChild (platform, "Devices");
+
+		if (devices == nullptr) {
+			continue;
+		}
+
+		std::uint16_t deviceIndex = 0;
+		for (auto device = devices->firstChild; device;
+			device = device->next, ++deviceIndex) {
+			const auto id = static_cast<std::uint32_t> (devices_.size ());
+			const Device d = { hostId, platformIndex, deviceIndex };
+			devices_.push_back (d);
+
+			AddProperties (platform, id);
+			AddProperties (device, id);
+		}
+	}
+
+	hosts_ [hostId].deviceCount = static_cast<std::uint32_t> (
+		devices_.size () - first);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void InvertedIndex::Merge (const InvertedIndex& other)
+{
+	std::vector<std::uint32_t> ids (other.strings_.GetCount (), StringTable::Invalid);
+
+	const auto translate = [this, &other, &ids] (const std::uint32_t id) -> std::uint32_t {
+		if (ids [id] == StringTable::Invalid) {
+			ids [id] = strings_.Intern (other.strings_.Get (id));
+		}
+
+		return ids [id];
+	};
+
+	// Taking over the hosts in the order of their devices keeps the new device
+	// ids in the same order as the old ones, so the bitmaps are only appended
+	// to below
+	std::vector<std::uint32_t> order (other.hosts_.size ());
+	for (std::uint32_t i = 0; i < order.size (); ++i) {
+		order [i] = i;
+	}
+
+	std::sort (order.begin (), order.end (),
+		[&other] (const std::uint32_t a, const std::uint32_t b) -> bool {
+			return other.hosts_ [a].firstDevice < other.hosts_ [b].firstDevice;
+	});
+
+	std::vector<std::uint32_t> deviceIds (other.devices_.size (),
+		StringTable::Invalid);
+
+	for (const auto i : order) {
+		const auto& host = other.hosts_ [i];
+
+		bool accepted;
+		const auto hostId = BeginHost (translate (host.name), host.sequence,
+			accepted);
+
+		if (! accepted) {
+			continue;
+		}
+
+		for (std::uint32_t j = 0; j < host.deviceCount; ++j) {
+			auto device = other.devices_ [host.firstDevice + j];
+			device.host = hostId;
+
+			deviceIds [host.firstDevice + j] =
+				static_cast<std::uint32_t> (devices_.size ());
+			devices_.push_back (device);
+		}
+
+		hosts_ [hostId].deviceCount = host.deviceCount;
+	}
+
+	sequence_ = std::max (sequence_, other.sequence_);
+
+	const auto copy = [&deviceIds] (const Bitmap& from, Bitmap& to) -> void {
+		from.ForEach ([&deviceIds, &to] (const std::uint32_t device) -> void {
+			if (deviceIds [device] != StringTable::Invalid) {
+				to.Add (deviceIds [device]);
+			}
+		});
+	};
+
+	for (const auto& property : other.properties_) {
+		auto& postings = properties_ [translate (property.first)];
+
+		copy (property.second.isTrue, postings.isTrue);
+		copy (property.second.isFalse, postings.isFalse);
+
+		for (const auto& entry : property.second.numbers) {
+			copy (entry.second, postings.numbers [entry.first]);
+		}
+
+		for (const auto& entry : property.second.strings) {
+			copy (entry.second, postings.strings [translate (entry.first)]);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void InvertedIndex::Compact ()
+{
+	if (deleted_.IsEmpty ()) {
+		return;
+	}
+
+	std::vector<std::uint32_t> ids (devices_.size (), StringTable::Invalid);
+	std::vector<Device> devices;
+
+	for (std::uint32_t i = 0; i < devices_.size (); ++i) {
+		if (! deleted_.Contains (i)) {
+			ids [i] = static_cast<std::uint32_t> (devices.size ());
+			devices.push_back (devices_ [i]);
+		}
+	}
+
+	for (auto& host : hosts_) {
+		host.firstDevice = host.deviceCount > 0 ? ids [host.firstDevice] : 0;
+	}
+
+	const auto remap = [&ids] (Bitmap& bitmap) -> void {
+		Bitmap result;
+
+		bitmap.ForEach ([&ids, &result] (const std::uint32_t device) -> void {
+			if (ids [device] != StringTable::Invalid) {
+				result.Add (ids [device]);
+			}
+		});
+
+		bitmap = std::move (result);
+	};
+
+	for (auto& property : properties_) {
+		auto& postings = property.second;
+
+		remap (postings.isTrue);
+		remap (postings.isFalse);
+
+		for (auto it = postings.numbers.begin (); it != postings.numbers.end (); ) {
+			remap (it->second);
+			it = it->second.IsEmpty () ? postings.numbers.erase (it) : std::next (it);
+		}
+
+		for (auto it = postings.strings.begin (); it != postings.strings.end (); ) {
+			remap (it->second);
+			it = it->second.IsEmpty () ? postings.strings.erase (it) : std::next (it);
+		}
+	}
+
+	devices_.swap (devices);
+	deleted_ = Bitmap ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::vector<PropertyPredicate> InvertedIndex::Parse (const char* query)
+{
+	std::vector<PropertyPredicate> terms;
+	const auto end = query + ::strlen (query);
+	auto p = query;
+
+	for (;;) {
+		SkipSpaces (p);
+
+		if (*p == '\0') {
+			break;
+		}
+
+		if (! IsNameCharacter (*p)) {
+			Fail ("Expected a property or extension name", query, p);
+		}
+
+		PropertyPredicate term;
+
+		if (const auto message = ParsePredicate (p, end, " \t", term)) {
+			Fail (message, query, p);
+		}
+
+		if (term.op == PredicateOperator_Exists && *p != '\0' &&
+			! IsNameCharacter (*p)) {
+			Fail ("Expected an operator", query, p);
+		}
+
+		terms.push_back (term);
+	}
+
+	if (terms.empty ()) {
+		Fail ("Expected a term", query, p);
+	}
+
+	return terms;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Bitmap InvertedIndex::GetExtension (const char* property,
+	const std::string& name) const
+{
+	const auto propertyId = strings_.Find (property);
+	const auto nameId = strings_.Find (name.c_str ());
+
+	if (propertyId == StringTable::Invalid || nameId == StringTable::Invalid) {
+		return Bitmap ();
+	}
+
+	const auto postings = properties_.find (propertyId);
+	if (postings == properties_.end ()) {
+		return Bitmap ();
+	}
+
+	const auto it = postings->second.strings.find (nameId);
+	return it == postings->second.strings.end () ? Bitmap () : it->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Find the devices matching a single term, with the same rules as
+MatchesPredicate.
+*/
+Bitmap InvertedIndex::Evaluate (const PropertyPredicate& term) const
+{
+	const auto name = strings_.Find (term.property.c_str ());
+	const auto it = name == StringTable::Invalid
+		? properties_.end () : properties_.find (name);
+
+	if (it == properties_.end ()) {
+		if (term.op != PredicateOperator_Exists) {
+			return Bitmap ();
+		}
+
+		auto result = GetExtension ("CL_DEVICE_EXTENSIONS", term.property);
+		result |= GetExtension ("CL_PLATFORM_EXTENSIONS", term.property);
+		return result;
+	}
+
+	const auto& postings = it->second;
+
+	// All devices with the property, except for booleans which are false
+	Bitmap all = postings.isTrue;
+
+	for (const auto& entry : postings.numbers) {
+		all |= entry.second;
+	}
+
+	for (const auto& entry : postings.strings) {
+		all |= entry.second;
+	}
+
+	if (term.op == PredicateOperator_Exists) {
+		return all;
+	}
+
+	// != holds if no value is equal
+	const auto op = term.op == PredicateOperator_NotEqual
+		? PredicateOperator_Equal : term.op;
+
+	Bitmap found;
+
+	if (term.isNumber && op != PredicateOperator_Contains) {
+		auto begin = postings.numbers.begin ();
+		auto end = postings.numbers.end ();
+
+		switch (op) {
+		case PredicateOperator_Equal:
+			begin = postings.numbers.lower_bound (term.number);
+			end = postings.numbers.upper_bound (term.number);
+			break;
+
+		case PredicateOperator_Less:
+			end = postings.numbers.lower_bound (term.number);
+			break;
+
+		case PredicateOperator_LessEqual:
+			end = postings.numbers.upper_bound (term.number);
+			break;
+
+		case PredicateOperator_Greater:
+			begin = postings.numbers.upper_bound (term.number);
+			break;
+
+		case PredicateOperator_GreaterEqual:
+			begin = postings.numbers.lower_bound (term.number);
+			break;
+
+		default:
+			break;
+		}
+
+		for (; begin != end; ++begin) {
+			found |= begin->second;
+		}
+	}
+
+	if (op == PredicateOperator_Equal) {
+		if (term.value == "true") {
+			found |= postings.isTrue;
+		} else if (term.value == "false") {
+			found |= postings.isFalse;
+		}
+	}
+
+	for (const auto& entry : postings.strings) {
+		const auto value = strings_.Get (entry.first);
+		bool matches;
+
+		switch (op) {
+		case PredicateOperator_Equal:
+			matches = EqualsEnumValue (value, term.value);
+			break;
+
+		case PredicateOperator_Contains:
+			matches = ::strstr (value, term.value.c_str ()) != nullptr;
+			break;
+
+		default:
+			matches = ApplyOperator (::strcmp (value, term.value.c_str ()), op);
+			break;
+		}
+
+		if (matches) {
+			found |= entry.second;
+		}
+	}
+
+	if (term.op != PredicateOperator_NotEqual) {
+		return found;
+	}
+
+	all |= postings.isFalse;
+	return Bitmap::AndNot (all, found);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Bitmap InvertedIndex::Find (const char* query) const
+{
+	const auto terms = Parse (query);
+
+	auto result = Evaluate (terms [0]);
+
+	for (std::size_t i = 1; i < terms.size () && ! result.IsEmpty (); ++i) {
+		result = Bitmap::And (result, Evaluate (terms [i]));
+	}
+
+	return Bitmap::AndNot (result, deleted_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+The file starts with "CLIX" and the version, followed by the largest sequence
+number, the strings, the hosts, the devices and the deleted devices. Then, for
+each property, its name and the bitmaps of its values follow. All integers are
+stored as varints, and strings are referred to by their index.
+*/
+bool InvertedIndex::Save (const char* path) const
+{
+	std::vector<unsigned char> data (std::begin (magic), std::end (magic));
+
+	WriteVarint (data, version);
+	WriteVarint (data, sequence_);
+
+	WriteVarint (data, strings_.GetCount ());
+	for (std::uint32_t i = 0; i < strings_.GetCount (); ++i) {
+		const auto s = strings_.Get (i);
+		const auto length = ::strlen (s);
+
+		WriteVarint (data, length);
+		data.insert (data.end (), s, s + length);
+	}
+
+	WriteVarint (data, hosts_.size ());
+	for (const auto& host : hosts_) {
+		WriteVarint (data, host.name);
+		WriteVarint (data, host.sequence);
+		WriteVarint (data, host.firstDevice);
+		WriteVarint (data, host.deviceCount);
+	}
+
+	WriteVarint (data, devices_.size ());
+	for (const auto& device : devices_) {
+		WriteVarint (data, device.host);
+		WriteVarint (data, device.platform);
+		WriteVarint (data, device.device);
+	}
+
+	deleted_.Write (data);
+
+	WriteVarint (data, properties_.size ());
+	for (const auto& property : properties_) {
+		const auto& postings = property.second;
+
+		WriteVarint (data, property.first);
+		postings.isTrue.Write (data);
+		postings.isFalse.Write (data);
+
+		WriteVarint (data, postings.numbers.size ());
+		for (const auto& entry : postings.numbers) {
+			WriteVarint (data, ZigZag (entry.first));
+			entry.second.Write (data);
+		}
+
+		WriteVarint (data, postings.strings.size ());
+		for (const auto& entry : postings.strings) {
+			WriteVarint (data, entry.first);
+			entry.second.Write (data);
+		}
+	}
+
+	const auto temporary = std::string (path) + ".tmp";
+
+	{
+		std::ofstream file (temporary, std::ios::binary | std::ios::trunc);
+		file.write (reinterpret_cast<const char*> (data.data ()),
+			static_cast<std::streamsize> (data.size ()));
+		file.close ();
+
+		if (! file) {
+			std::remove (temporary.c_str ());
+			return false;
+		}
+	}
+
+#if _WIN32
+	const bool renamed = ::MoveFileExA (temporary.c_str (), path,
+		MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	const bool renamed = std::rename (temporary.c_str (), path) == 0;
+#endif
+
+	if (! renamed) {
+		std::remove (temporary.c_str ());
+	}
+
+	return renamed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool InvertedIndex::Load (const char* path)
+{
+	std::ifstream file (path, std::ios::binary);
+
+	if (! file) {
+		return false;
+	}
+
+	const std::vector<unsigned char> data (
+		(std::istreambuf_iterator<char> (file)), std::istreambuf_iterator<char> ());
+
+	if (data.size () < sizeof (magic) ||
+		::memcmp (data.data (), magic, sizeof (magic)) != 0) {
+		return false;
+	}
+
+	Reader reader (data.data () + sizeof (magic), data.data () + data.size ());
+	const auto any = std::numeric_limits<std::uint64_t>::max ();
+	const auto any32 = std::numeric_limits<std::uint32_t>::max ();
+
+	try {
+		if (reader.Read (any) != version) {
+			return false;
+		}
+
+		sequence_ = reader.Read (any);
+
+		// The ignored properties are interned already, so the ids in the file
+		// have to be mapped
+		std::vector<std::uint32_t> ids (
+			static_cast<std::size_t> (reader.Read (any32)));
+
+		for (auto& id : ids) {
+			id = strings_.Intern (reader.ReadString ().c_str ());
+		}
+
+		const auto string = [&reader, &ids, any] () -> std::uint32_t {
+			const auto id = reader.Read (any);
+
+			if (id >= ids.size ()) {
+				throw std::runtime_error ("Malformed string");
+			}
+
+			return ids [static_cast<std::size_t> (id)];
+		};
+
+		hosts_.resize (static_cast<std::size_t> (reader.Read (any32)));
+		for (std::uint32_t i = 0; i < hosts_.size (); ++i) {
+			auto& host = hosts_ [i];
+
+			host.name = string ();
+			host.sequence = reader.Read (any);
+			host.firstDevice = static_cast<std::uint32_t> (reader.Read (any32));
+			host.deviceCount = static_cast<std::uint32_t> (reader.Read (any32));
+
+			if (! hostIds_.emplace (host.name, i).second) {
+				throw std::runtime_error ("Duplicate host");
+			}
+		}
+
+		devices_.resize (static_cast<std::size_t> (reader.Read (any32)));
+		for (auto& device : devices_) {
+			device.host = static_cast<std::uint32_t> (reader.Read (any32));
+			device.platform = static_cast<std::uint16_t> (reader.Read (0xFFFF));
+			device.device = static_cast<std::uint16_t> (reader.Read (0xFFFF));
+
+			if (device.host >= hosts_.size ()) {
+				throw std::runtime_error ("Malformed device");
+			}
+		}
+
+		for (const auto& host : hosts_) {
+			if (static_cast<std::uint64_t> (host.firstDevice) + host.deviceCount >
+				devices_.size ()) {
+				throw std::runtime_error ("Malformed host");
+			}
+		}
+
+		reader.Read (deleted_, devices_.size ());
+
+		const auto propertyCount = reader.Read (any32);
+		for (std::uint64_t i = 0; i < propertyCount; ++i) {
+			auto& postings = properties_ [string ()];
+
+			reader.Read (postings.isTrue, devices_.size ());
+			reader.Read (postings.isFalse, devices_.size ());
+
+			const auto numberCount = reader.Read (any);
+			for (std::uint64_t j = 0; j < numberCount; ++j) {
+				const auto value = UnZigZag (reader.Read (any));
+				reader.Read (postings.numbers [value], devices_.size ());
+			}
+
+			const auto stringCount = reader.Read (any);
+			for (std::uint64_t j = 0; j < stringCount; ++j) {
+				const auto value = string ();
+				reader.Read (postings.strings [value], devices_.size ());
+			}
+		}
+
+		return reader.IsAtEnd ();
+	} catch (const std::runtime_error&) {
+		return false;
+	}
+}
+}
@@ -0,0 +1,534 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "Report.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+
+namespace niv {
+namespace {
+/**
+The value of a property for a model, with the groups which have it.
+*/
+struct ModelValue
+{
+	std::uint64_t	count = 0;
+	std::vector<const ConfigurationGroup*>	groups;
+};
+
+/**
+All devices with the same platform and device name.
+*/
+struct Model
+{
+	const char*		platform = nullptr;
+	const char*		device = nullptr;
+	std::uint64_t	count = 0;
+
+	// Property name id to value id to value
+	std::map<std::uint32_t, std::map<std::uint32_t, ModelValue>>	properties;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Find the value id of a property in a configuration, or StringTable::Invalid.
+*/
+std::uint32_t FindValue (const Configuration& configuration,
+	const std::uint32_t name)
+{
+	if (name == StringTable::Invalid) {
+		return StringTable::Invalid;
+	}
+
+	const auto it = std::lower_bound (configuration.begin (), configuration.end (),
+		static_cast<std::uint64_t> (name) << 32);
+
+	if (it == configuration.end () || (*it >> 32) != name) {
+		return StringTable::Invalid;
+	}
+
+	return static_cast<std::uint32_t> (*it);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Less (const char* a, const char* b)
+{
+	if (a == nullptr || b == nullptr) {
+		return a == nullptr && b != nullptr;
+	}
+
+	return ::strcmp (a, b) < 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Get the first hosts of some groups, ordered by name.
+*/
+std::vector<const char*> GetHosts (const FleetAggregator& aggregator,
+	const std::vector<const ConfigurationGroup*>& groups, const int limit,
+	std::size_t* count)
+{
+	std::vector<const char*> hosts;
+
+	for (const auto group : groups) {
+		for (const auto host : group->hosts) {
+			hosts.push_back (aggregator.GetHost (host));
+		}
+	}
+
+	std::sort (hosts.begin (), hosts.end (), Less);
+
+	// The same host can have devices in several groups
+	hosts.erase (std::unique (hosts.begin (), hosts.end (),
+		[] (const char* a, const char* b) -> bool {
+			return ::strcmp (a, b) == 0;
+		}), hosts.end ());
+
+	if (count) {
+		*count = hosts.size ();
+	}
+
+	if (hosts.size () > static_cast<std::size_t> (limit)) {
+		hosts.resize (limit);
+	}
+
+	return hosts;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WritePercentage (Writer& w, const std::uint64_t count,
+	const std::uint64_t total)
+{
+	char buffer [32];
+	std::snprintf (buffer, sizeof (buffer), "%5.1f%%",
+		total ? 100.0 * static_cast<double> (count) / static_cast<double> (total) : 0.0);
+	w.Write (buffer);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteCount (Writer& w, const std::uint64_t count)
+{
+	char buffer [32];
+	std::snprintf (buffer, sizeof (buffer), "%8llu",
+		static_cast<unsigned long long> (count));
+	w.Write (buffer);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteHosts (Writer& w, const std::vector<const char*>& hosts,
+	const std::size_t count)
+{
+	w.WriteLiteral (" (");
+
+	for (std::size_t i = 0; i < hosts.size (); ++i) {
+		if (i > 0) {
+			w.WriteLiteral (", ");
+		}
+
+		w.Write (hosts [i]);
+	}
+
+	if (count > hosts.size ()) {
+		w.WriteLiteral (", ...");
+	}
+
+	w.Put (')');
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteJsonString (Writer& w, const char* s)
+{
+	if (s == nullptr) {
+		w.WriteLiteral ("null");
+		return;
+	}
+
+	w.Put ('"');
+	w.WriteJsonEscaped (s);
+	w.Put ('"');
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteJsonHosts (Writer& w, const std::vector<const char*>& hosts)
+{
+	w.WriteLiteral (",\"Hosts\":[");
+
+	for (std::size_t i = 0; i < hosts.size (); ++i) {
+		if (i > 0) {
+			w.Put (',');
+		}
+
+		WriteJsonString (w, hosts [i]);
+	}
+
+	w.Put (']');
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+FleetReport CreateFleetReport (const FleetAggregator& aggregator,
+	const FleetReportOptions& options)
+{
+	const auto& strings = aggregator.GetStrings ();
+	const auto& groups = aggregator.GetGroups ();
+
+	const auto platformName = strings.Find ("CL_PLATFORM_NAME");
+	const auto deviceName = strings.Find ("CL_DEVICE_NAME");
+	const auto driverVersion = strings.Find ("CL_DRIVER_VERSION");
+
+	const auto get = [&strings] (const std::uint32_t id) -> const char* {
+		return id == StringTable::Invalid ? nullptr : strings.Get (id);
+	};
+
+	FleetReport report;
+	report.hosts = aggregator.GetHostCount ();
+	report.devices = aggregator.GetDeviceCount ();
+	report.configurationCount = groups.size ();
+
+	// Configurations, the most common ones first. The ids depend on the order
+	// in which the files were loaded, so ties are ordered by name
+	for (const auto& entry : groups) {
+		FleetReport::Configuration c;
+		c.count = entry.second.count;
+		c.platform = get (FindValue (entry.first, platformName));
+		c.device = get (FindValue (entry.first, deviceName));
+		c.driver = get (FindValue (entry.first, driverVersion));
+
+		const std::vector<const ConfigurationGroup*> group (1, &entry.second);
+		c.hosts = GetHosts (aggregator, group, options.hosts, &c.hostCount);
+
+		report.configurations.push_back (std::move (c));
+	}
+
+	std::sort (report.configurations.begin (), report.configurations.end (),
+		[] (const FleetReport::Configuration& a, const FleetReport::Configuration& b) -> bool {
+			if (a.count != b.count) {
+				return a.count > b.count;
+			}
+
+			const char* const keys [][2] = {
+				{ a.hosts.empty () ? nullptr : a.hosts.front (),
+					b.hosts.empty () ? nullptr : b.hosts.front () },
+				{ a.platform, b.platform },
+				{ a.device, b.device },
+				{ a.driver, b.driver }
+			};
+
+			for (const auto& key : keys) {
+				if (Less (key [0], key [1]) || Less (key [1], key [0])) {
+					return Less (key [0], key [1]);
+				}
+			}
+
+			return false;
+		});
+
+	if (report.configurations.size () > static_cast<std::size_t> (options.configurations)) {
+		report.configurations.resize (options.configurations);
+	}
+
+	// Distributions of all properties, and the values per model
+	std::map<std::uint32_t, std::unordered_map<std::uint32_t, std::uint64_t>> distributions;
+	std::map<std::uint64_t, Model> models;
+
+	for (const auto& entry : groups) {
+		const auto& configuration = entry.first;
+		const auto& group = entry.second;
+
+		const auto platform = FindValue (configuration, platformName);
+		const auto device = FindValue (configuration, deviceName);
+
+		auto& model = models [(static_cast<std::uint64_t> (platform) << 32) | device];
+		model.platform = get (platform);
+		model.device = get (device);
+		model.count += group.count;
+
+		for (const auto e : configuration) {
+			const auto name = static_cast<std::uint32_t> (e >> 32);
+			const auto value = static_cast<std::uint32_t> (e);
+
+			distributions [name][value] += group.count;
+
+			auto& modelValue = model.properties [name][value];
+			modelValue.count += group.count;
+			modelValue.groups.push_back (&group);
+		}
+	}
+
+	for (const auto& property : distributions) {
+		std::vector<FleetReport::Value> values;
+		std::uint64_t total = 0;
+
+		for (const auto& value : property.second) {
+			FleetReport::Value v = { strings.Get (value.first), value.second };
+			values.push_back (v);
+			total += value.second;
+		}
+
+		if (total < report.devices) {
+			FleetReport::Value missing = { nullptr, report.devices - total };
+			values.push_back (missing);
+		}
+
+		if (values.size () == 1) {
+			++report.uniformProperties;
+			continue;
+		}
+
+		std::sort (values.begin (), values.end (),
+			[] (const FleetReport::Value& a, const FleetReport::Value& b) -> bool {
+				if (a.count != b.count) {
+					return a.count > b.count;
+				}
+
+				return Less (a.value, b.value);
+			});
+
+		FleetReport::Distribution d;
+		d.property = strings.Get (property.first);
+		d.valueCount = values.size ();
+
+		if (values.size () > static_cast<std::size_t> (options.values)) {
+			values.resize (options.values);
+		}
+
+		d.values = std::move (values);
+		report.distributions.push_back (std::move (d));
+	}
+
+	std::sort (report.distributions.begin (), report.distributions.end (),
+		[] (const FleetReport::Distribution& a, const FleetReport::Distribution& b) -> bool {
+			return ::strcmp (a.property, b.property) < 0;
+		});
+
+	// Values which are rare among devices of the same model
+	for (const auto& entry : models) {
+		const auto& model = entry.second;
+
+		for (const auto& property : model.properties) {
+			for (const auto& value : property.second) {
+				if (static_cast<double> (value.second.count) >=
+					options.outlierShare * static_cast<double> (model.count)) {
+					continue;
+				}
+
+				FleetReport::Outlier o;
+				o.platform = model.platform;
+				o.device = model.device;
+				o.property = strings.Get (property.first);
+				o.value = strings.Get (value.first);
+				o.count = value.second.count;
+				o.modelCount = model.count;
+				o.hosts = GetHosts (aggregator, value.second.groups, options.hosts,
+					&o.hostCount);
+
+				report.outliers.push_back (std::move (o));
+			}
+		}
+	}
+
+	std::sort (report.outliers.begin (), report.outliers.end (),
+		[] (const FleetReport::Outlier& a, const FleetReport::Outlier& b) -> bool {
+			if (Less (a.platform, b.platform) || Less (b.platform, a.platform)) {
+				return Less (a.platform, b.platform);
+			}
+
+			if (Less (a.device, b.device) || Less (b.device, a.device)) {
+				return Less (a.device, b.device);
+			}
+
+			const auto order = ::strcmp (a.property, b.property);
+			if (order != 0) {
+				return order < 0;
+			}
+
+			return ::strcmp (a.value, b.value) < 0;
+		});
+
+	return report;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteFleetReportConsole (Writer& w, const FleetReport& report)
+{
+	w.WriteLiteral ("Hosts: ");
+	w.WriteInt (report.hosts);
+
+	if (report.failedFiles) {
+		w.WriteLiteral (" (");
+		w.WriteInt (report.failedFiles);
+		w.WriteLiteral (" files could not be loaded)");
+	}
+
+	w.WriteLiteral ("\nDevices: ");
+	w.WriteInt (report.devices);
+	w.WriteLiteral ("\nDistinct configurations: ");
+	w.WriteInt (report.configurationCount);
+	w.WriteLiteral ("\n\nConfigurations\n");
+
+	for (const auto& c : report.configurations) {
+		WriteCount (w, c.count);
+		w.Put (' ');
+		WritePercentage (w, c.count, report.devices);
+		w.WriteLiteral ("  ");
+		w.Write (c.platform ? c.platform : "?");
+		w.WriteLiteral (" / ");
+		w.Write (c.device ? c.device : "?");
+
+		if (c.driver) {
+			w.WriteLiteral (" / ");
+			w.Write (c.driver);
+		}
+
+		WriteHosts (w, c.hosts, c.hostCount);
+		w.Put ('\n');
+	}
+
+	if (report.configurations.size () < report.configurationCount) {
+		w.WriteLiteral ("     ... ");
+		w.WriteInt (report.configurationCount - report.configurations.size ());
+		w.WriteLiteral (" more\n");
+	}
+
+	w.WriteLiteral ("\nDistributions (");
+	w.WriteInt (report.uniformProperties);
+	w.WriteLiteral (" properties are the same on all devices)\n");
+
+	for (const auto& d : report.distributions) {
+		w.WriteLiteral ("  ");
+		w.Write (d.property);
+		w.Put ('\n');
+
+		for (const auto& v : d.values) {
+			WriteCount (w, v.count);
+			w.Put (' ');
+			WritePercentage (w, v.count, report.devices);
+			w.WriteLiteral ("  ");
+			w.Write (v.value ? v.value : "(not present)");
+			w.Put ('\n');
+		}
+
+		if (d.values.size () < d.valueCount) {
+			w.WriteLiteral ("     ... ");
+			w.WriteInt (d.valueCount - d.values.size ());
+			w.WriteLiteral (" more\n");
+		}
+	}
+
+	w.WriteLiteral ("\nOutliers\n");
+
+	for (const auto& o : report.outliers) {
+		w.WriteLiteral ("  ");
+		w.Write (o.platform ? o.platform : "?");
+		w.WriteLiteral (" / ");
+		w.Write (o.device ? o.device : "?");
+		w.WriteLiteral (": ");
+		w.Write (o.property);
+		w.WriteLiteral (" = ");
+		w.Write (o.value);
+		w.WriteLiteral (" on ");
+		w.WriteInt (o.count);
+		w.WriteLiteral (" of ");
+		w.WriteInt (o.modelCount);
+		w.WriteLiteral (" devices");
+		WriteHosts (w, o.hosts, o.hostCount);
+		w.Put ('\n');
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WriteFleetReportJson (Writer& w, const FleetReport& report)
+{
+	w.WriteLiteral ("{\"Hosts\":");
+	w.WriteInt (report.hosts);
+	w.WriteLiteral (",\"FailedFiles\":");
+	w.WriteInt (report.failedFiles);
+	w.WriteLiteral (",\"Devices\":");
+	w.WriteInt (report.devices);
+	w.WriteLiteral (",\"ConfigurationCount\":");
+	w.WriteInt (report.configurationCount);
+	w.WriteLiteral (",\"UniformProperties\":");
+	w.WriteInt (report.uniformProperties);
+
+	w.WriteLiteral (",\"Configurations\":[");
+	for (std::size_t i = 0; i < report.configurations.size (); ++i) {
+		const auto& c = report.configurations [i];
+
+		if (i > 0) {
+			w.Put (',');
+		}
+
+		w.WriteLiteral ("{\"Count\":");
+		w.WriteInt (c.count);
+		w.WriteLiteral (",\"HostCount\":");
+		w.WriteInt (c.hostCount);
+		w.WriteLiteral (",\"Platform\":");
+		WriteJsonString (w, c.platform);
+		w.WriteLiteral (",\"Device\":");
+		WriteJsonString (w, c.device);
+		w.WriteLiteral (",\"Driver\":");
+		WriteJsonString (w, c.driver);
+		WriteJsonHosts (w, c.hosts);
+		w.Put ('}');
+	}
+
+	w.WriteLiteral ("],\"Distributions\":[");
+	for (std::size_t i = 0; i < report.distributions.size (); ++i) {
+		const auto& d = report.distributions [i];
+
+		if (i > 0) {
+			w.Put (',');
+		}
+
+		w.WriteLiteral ("{\"Property\":");
+		WriteJsonString (w, d.property);
+		w.WriteLiteral (",\"ValueCount\":");
+		w.WriteInt (d.valueCount);
+		w.WriteLiteral (",\"Values\":[");
+
+		for (std::size_t j = 0; j < d.values.size (); ++j) {
+			if (j > 0) {
+				w.Put (',');
+			}
+
+			w.WriteLiteral ("{\"Value\":");
+			WriteJsonString (w, d.values [j].value);
+			w.WriteLiteral (",\"Count\":");
+			w.WriteInt (d.values [j].count);
+			w.Put ('}');
+		}
+
+		w.WriteLiteral ("]}");
+	}
+
+	w.WriteLiteral ("],\"Outliers\":[");
+	for (std::size_t i = 0; i < report.outliers.size (); ++i) {
+		const auto& o = report.outliers [i];
+
+		if (i > 0) {
+			w.Put (',');
+		}
+
+		w.WriteLiteral ("{\"Platform\":");
+		WriteJsonString (w, o.platform);
+		w.WriteLiteral (",\"Device\":");
+		WriteJsonString (w, o.device);
+		w.WriteLiteral (",\"Property\":");
+		WriteJsonString (w, o.property);
+		w.WriteLiteral (",\"Value\":");
+		WriteJsonString (w, o.value);
+		w.WriteLiteral (",\"Count\":");
+		w.WriteInt (o.count);
+		w.WriteLiteral (",\"ModelCount\":");
+		w.WriteInt (o.modelCount);
+		WriteJsonHosts (w, o.hosts);
+		w.Put ('}');
+	}
+
+	w.WriteLiteral ("]}\n");
+}
+}
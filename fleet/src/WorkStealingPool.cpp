@@ -0,0 +1,120 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace niv {
+////////////////////////////////////////////////////////////////////////////////
+WorkStealingPool::WorkStealingPool (const int threadCount)
+{
+	for (int i = 0; i < std::max (threadCount, 1); ++i) {
+		ranges_.emplace_back (new Range);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void WorkStealingPool::Run (const std::size_t count,
+	const std::function<void (int, std::size_t)>& work)
+{
+	const auto threadCount = ranges_.size ();
+
+	for (std::size_t i = 0; i < threadCount; ++i) {
+		ranges_ [i]->begin = count * i / threadCount;
+		ranges_ [i]->end = count * (i + 1) / threadCount;
+	}
+
+	const auto worker = [this, &work] (const int thread) -> void {
+		std::size_t item;
+
+		for (;;) {
+			if (Pop (*ranges_ [thread], item)) {
+				work (thread, item);
+			} else if (! Steal (thread)) {
+				return;
+			}
+		}
+	};
+
+	// The calling thread works as well
+	std::vector<std::thread> threads;
+	for (std::size_t i = 1; i < threadCount; ++i) {
+		threads.emplace_back (worker, static_cast<int> (i));
+	}
+
+	worker (0);
+
+	for (auto& thread : threads) {
+		thread.join ();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool WorkStealingPool::Pop (Range& range, std::size_t& item)
+{
+	std::lock_guard<std::mutex> lock (range.mutex);
+
+	if (range.begin == range.end) {
+		return false;
+	}
+
+	item = range.begin++;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Move the back half of the largest range of another thread to the range of
+thread. Returns false if there is nothing left to steal. Only one lock is held
+at a time, so threads stealing from each other cannot deadlock.
+*/
+bool WorkStealingPool::Steal (const int thread)
+{
+	for (;;) {
+		Range* victim = nullptr;
+		std::size_t largest = 0;
+
+		for (std::size_t i = 0; i < ranges_.size (); ++i) {
+			if (static_cast<int> (i) == thread) {
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock (ranges_ [i]->mutex);
+			const auto size = ranges_ [i]->end - ranges_ [i]->begin;
+
+			if (size > largest) {
+				largest = size;
+				victim = ranges_ [i].get ();
+			}
+		}
+
+		if (victim == nullptr) {
+			return false;
+		}
+
+		std::size_t begin, end;
+
+		{
+			std::lock_guard<std::mutex> lock (victim->mutex);
+
+			// The victim may have worked through its range in the meantime
+			if (victim->begin == victim->end) {
+				continue;
+			}
+
+			end = victim->end;
+			begin = victim->end - (victim->end - victim->begin + 1) / 2;
+			victim->end = begin;
+		}
+
+		auto& own = *ranges_ [thread];
+		std::lock_guard<std::mutex> lock (own.mutex);
+		own.begin = begin;
+		own.end = end;
+
+		return true;
+	}
+}
+}
@@ -0,0 +1,528 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+/*
+Measures cliInfo_Gather against the FakeOpenCL implementation in tools: the
+wall time, the driver calls per device, the heap allocations and the memory
+used by the tree, for a range of platform and device counts, numbers of
+selected properties and driver latencies.
+
+Every configuration is gathered in a child process, as the ICD loader only
+reads the ICDs once. The child gathers once to load the fake ICD, then
+measures the given number of gathers. Each configuration is gathered in three
+modes: sequential, parallel, with CLI_GatherFlag_Parallel, and selective,
+which only gathers the first properties of a fixed list and skips the image
+formats.
+
+Without options, each parameter is swept separately, keeping the others at
+2 platforms, 8 devices, 8 properties and no latency. If any of the lists is
+given, all combinations of the given lists and the defaults for the other
+parameters are gathered instead.
+
+The results are written as JSON, one object per line, or as CSV.
+
+Usage: clInfoBench [--platforms 1,2,...] [--devices 1,8,...]
+	[--properties 1,8,...] [--latency 0,10,...]
+	[--modes sequential,parallel,selective] [--iterations n] [--csv]
+*/
+
+#include <clInfo.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+std::atomic<std::int64_t> heapAllocations {0};
+std::atomic<std::int64_t> heapBytes {0};
+}
+
+// Count the allocations of the library, which is linked statically. Calls
+// made by the ICD loader and the fake ICD go to their own operator new. The
+// other forms of operator new and delete call these. They are not inlined, as
+// GCC warns about memory from operator new released with free otherwise
+////////////////////////////////////////////////////////////////////////////////
+__attribute__ ((noinline)) void* operator new (std::size_t size)
+{
+	++heapAllocations;
+	heapBytes += size;
+
+	if (void* p = std::malloc (size ? size : 1)) {
+		return p;
+	}
+
+	throw std::bad_alloc ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__attribute__ ((noinline)) void operator delete (void* p) noexcept
+{
+	std::free (p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+__attribute__ ((noinline)) void operator delete (void* p, std::size_t) noexcept
+{
+	std::free (p);
+}
+
+namespace {
+/**
+The properties gathered in selective mode, the first ones are used.
+*/
+const char* const selectableProperties [] = {
+	"CL_PLATFORM_NAME",
+	"CL_DEVICE_NAME",
+	"CL_DEVICE_TYPE",
+	"CL_DEVICE_VERSION",
+	"CL_DRIVER_VERSION",
+	"CL_DEVICE_VENDOR",
+	"CL_DEVICE_AVAILABLE",
+	"CL_DEVICE_GLOBAL_MEM_SIZE",
+	"CL_DEVICE_MAX_MEM_ALLOC_SIZE",
+	"CL_DEVICE_LOCAL_MEM_SIZE",
+	"CL_DEVICE_MAX_COMPUTE_UNITS",
+	"CL_DEVICE_MAX_CLOCK_FREQUENCY",
+	"CL_DEVICE_MAX_WORK_GROUP_SIZE",
+	"CL_DEVICE_MAX_WORK_ITEM_SIZES",
+	"CL_DEVICE_EXTENSIONS",
+	"CL_DEVICE_PROFILE",
+	"CL_DEVICE_OPENCL_C_VERSION",
+	"CL_DEVICE_ADDRESS_BITS",
+	"CL_DEVICE_ENDIAN_LITTLE",
+	"CL_DEVICE_ERROR_CORRECTION_SUPPORT",
+	"CL_DEVICE_COMPILER_AVAILABLE",
+	"CL_DEVICE_LINKER_AVAILABLE",
+	"CL_DEVICE_IMAGE_SUPPORT",
+	"CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE",
+	"CL_DEVICE_GLOBAL_MEM_CACHE_SIZE",
+	"CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE",
+	"CL_DEVICE_MAX_PARAMETER_SIZE",
+	"CL_DEVICE_MEM_BASE_ADDR_ALIGN",
+	"CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT",
+	"CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT",
+	"CL_DEVICE_SINGLE_FP_CONFIG",
+	"CL_DEVICE_DOUBLE_FP_CONFIG"
+};
+
+const int selectablePropertyCount =
+	sizeof (selectableProperties) / sizeof (selectableProperties [0]);
+
+enum class Mode
+{
+	Sequential,
+	Parallel,
+	Selective
+};
+
+const char* const modeNames [] = { "sequential", "parallel", "selective" };
+
+struct Configuration
+{
+	Mode	mode;
+	int		platforms;
+	int		devices;
+	int		properties;
+	int		latency;
+};
+
+/**
+Sent from the child process for every configuration. Times are in
+nanoseconds, all other values are per gather. The call counts are -1 if the
+fake ICD could not be found in the process.
+*/
+struct Measurement
+{
+	int				failed;
+	std::int64_t	minimum;
+	std::int64_t	median;
+	std::int64_t	calls;
+	std::int64_t	heapAllocations;
+	std::int64_t	heapBytes;
+	cliStatistics	statistics;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+std::vector<int> ParseList (const char* s)
+{
+	std::vector<int> result;
+
+	while (*s) {
+		char* end = nullptr;
+		const auto value = std::strtol (s, &end, 10);
+
+		if (end == s || value < 0) {
+			return {};
+		}
+
+		result.push_back (static_cast<int> (value));
+		s = (*end == ',') ? end + 1 : end;
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool WriteConfiguration (const char* path, const Configuration& c)
+{
+	auto file = std::fopen (path, "w");
+
+	if (file == nullptr) {
+		return false;
+	}
+
+	std::fprintf (file, "[platform]\ncount = %d\nlatency_us = %d\n\n"
+		"[device]\ncount = %d\n", c.platforms, c.latency, c.devices);
+
+	return std::fclose (file) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Measurement Measure (const Configuration& c, const int iterations)
+{
+	Measurement m = {};
+
+	std::vector<const char*> properties (selectableProperties,
+		selectableProperties + std::min (c.properties, selectablePropertyCount));
+	properties.push_back (nullptr);
+
+	cliGatherOptions options = {};
+
+	if (c.mode == Mode::Parallel) {
+		options.flags = CLI_GatherFlag_Parallel;
+	} else if (c.mode == Mode::Selective) {
+		options.flags = CLI_GatherFlag_SkipImageFormats;
+		options.properties = properties.data ();
+	}
+
+	// Loads the fake ICD, so neither the loader nor the configuration file
+	// are part of the measurement
+	cliInfo* info = nullptr;
+	if (cliInfo_Create (&info) != CLI_Success ||
+		cliInfo_GatherWithOptions (info, &options) != CLI_Success) {
+		m.failed = 1;
+		return m;
+	}
+	cliInfo_Destroy (info);
+
+	typedef unsigned long (*GetCallCountFunction)();
+	typedef void (*ResetCallCountFunction)();
+
+	GetCallCountFunction getCallCount = nullptr;
+	ResetCallCountFunction resetCallCount = nullptr;
+
+	if (auto library = ::dlopen (NIV_FAKE_OPENCL_LIBRARY, RTLD_LAZY | RTLD_NOLOAD)) {
+		getCallCount = reinterpret_cast<GetCallCountFunction> (
+			::dlsym (library, "fakeOpenCL_GetCallCount"));
+		resetCallCount = reinterpret_cast<ResetCallCountFunction> (
+			::dlsym (library, "fakeOpenCL_ResetCallCount"));
+	}
+
+	std::vector<std::int64_t> times;
+	m.calls = -1;
+
+	for (int i = 0; i < iterations; ++i) {
+		cliInfo_Create (&info);
+
+		if (resetCallCount) {
+			resetCallCount ();
+		}
+
+		heapAllocations = 0;
+		heapBytes = 0;
+
+		const auto start = std::chrono::steady_clock::now ();
+		const auto result = cliInfo_GatherWithOptions (info, &options);
+		const auto end = std::chrono::steady_clock::now ();
+
+		if (result != CLI_Success) {
+			m.failed = 1;
+			cliInfo_Destroy (info);
+			return m;
+		}
+
+		times.push_back (std::chrono::duration_cast<std::chrono::nanoseconds> (
+			end - start).count ());
+
+		// All gathers of a configuration are the same, keep the last
+		if (getCallCount) {
+			m.calls = static_cast<std::int64_t> (getCallCount ());
+		}
+
+		m.heapAllocations = heapAllocations;
+		m.heapBytes = heapBytes;
+		cliInfo_GetStatistics (info, &m.statistics);
+
+		cliInfo_Destroy (info);
+	}
+
+	std::sort (times.begin (), times.end ());
+	m.minimum = times.front ();
+	m.median = times [times.size () / 2];
+
+	return m;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Runs Measure in a child process, with the environment set up to use the fake
+ICD with the configuration c.
+*/
+bool MeasureInChild (const Configuration& c, const int iterations,
+	Measurement& m)
+{
+	char path [] = "/tmp/clInfoBenchXXXXXX";
+	const auto fd = ::mkstemp (path);
+
+	if (fd == -1) {
+		return false;
+	}
+	::close (fd);
+
+	int pipes [2];
+	if (! WriteConfiguration (path, c) || ::pipe (pipes) != 0) {
+		::unlink (path);
+		return false;
+	}
+
+	const auto pid = ::fork ();
+
+	if (pid == 0) {
+		::close (pipes [0]);
+
+		::setenv ("FAKE_OPENCL_CONFIG", path, 1);
+		::setenv ("OCL_ICD_VENDORS", NIV_FAKE_OPENCL_ICD, 1);
+		::unsetenv ("OCL_ICD_FILENAMES");
+		::unsetenv ("FAKE_OPENCL_REPLAY");
+
+		const auto result = Measure (c, iterations);
+		const auto written = ::write (pipes [1], &result, sizeof (result));
+
+		::_exit (written == sizeof (result) ? 0 : 1);
+	}
+
+	::close (pipes [1]);
+
+	bool success = false;
+
+	if (pid > 0) {
+		std::size_t offset = 0;
+		auto buffer = reinterpret_cast<char*> (&m);
+
+		while (offset < sizeof (m)) {
+			const auto count = ::read (pipes [0], buffer + offset,
+				sizeof (m) - offset);
+
+			if (count <= 0) {
+				break;
+			}
+
+			offset += count;
+		}
+
+		int status = 0;
+		::waitpid (pid, &status, 0);
+
+		success = offset == sizeof (m) && WIFEXITED (status) &&
+			WEXITSTATUS (status) == 0 && m.failed == 0;
+	}
+
+	::close (pipes [0]);
+	::unlink (path);
+
+	return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Report (const Configuration& c, const int iterations,
+	const Measurement& m, const bool csv)
+{
+	const auto devices = c.platforms * c.devices;
+	const auto callsPerDevice = (m.calls < 0 || devices == 0)
+		? -1.0 : static_cast<double> (m.calls) / devices;
+
+	if (csv) {
+		std::printf ("%s,%d,%d,%d,%d,%d,%.3f,%.3f,%lld,%.2f,%lld,%lld,%lld,%lld,%lld\n",
+			modeNames [static_cast<int> (c.mode)],
+			c.platforms, c.devices, c.properties, c.latency, iterations,
+			m.minimum / 1e6, m.median / 1e6,
+			static_cast<long long> (m.calls), callsPerDevice,
+			static_cast<long long> (m.heapAllocations),
+			static_cast<long long> (m.heapBytes),
+			static_cast<long long> (m.statistics.allocations),
+			static_cast<long long> (m.statistics.bytesAllocated),
+			static_cast<long long> (m.statistics.bytesReserved));
+	} else {
+		std::printf ("{\"mode\":\"%s\",\"platforms\":%d,\"devices\":%d,"
+			"\"properties\":%d,\"latency_us\":%d,\"iterations\":%d,"
+			"\"wall_ms_min\":%.3f,\"wall_ms_median\":%.3f,\"calls\":%lld,"
+			"\"calls_per_device\":%.2f,\"heap_allocations\":%lld,"
+			"\"heap_bytes\":%lld,\"pool_allocations\":%lld,"
+			"\"pool_bytes\":%lld,\"pool_reserved\":%lld}\n",
+			modeNames [static_cast<int> (c.mode)],
+			c.platforms, c.devices, c.properties, c.latency, iterations,
+			m.minimum / 1e6, m.median / 1e6,
+			static_cast<long long> (m.calls), callsPerDevice,
+			static_cast<long long> (m.heapAllocations),
+			static_cast<long long> (m.heapBytes),
+			static_cast<long long> (m.statistics.allocations),
+			static_cast<long long> (m.statistics.bytesAllocated),
+			static_cast<long long> (m.statistics.bytesReserved));
+	}
+
+	std::fflush (stdout);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AddConfigurations (std::vector<Configuration>& configurations,
+	const std::vector<Mode>& modes, const Configuration& base)
+{
+	for (const auto mode : modes) {
+		auto c = base;
+		c.mode = mode;
+		configurations.push_back (c);
+	}
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main (int argc, char* argv [])
+{
+	std::vector<int> platforms, devices, properties, latencies;
+	std::vector<Mode> modes;
+	int iterations = 5;
+	bool csv = false;
+
+	for (int i = 1; i < argc; ++i) {
+		std::vector<int>* list = nullptr;
+
+		if (::strcmp (argv [i], "--platforms") == 0) {
+			list = &platforms;
+		} else if (::strcmp (argv [i], "--devices") == 0) {
+			list = &devices;
+		} else if (::strcmp (argv [i], "--properties") == 0) {
+			list = &properties;
+		} else if (::strcmp (argv [i], "--latency") == 0) {
+			list = &latencies;
+		} else if (::strcmp (argv [i], "--modes") == 0 && (i + 1) < argc) {
+			const std::string names = std::string (",") + argv [++i] + ",";
+
+			for (int m = 0; m < 3; ++m) {
+				if (names.find (std::string (",") + modeNames [m] + ",") != std::string::npos) {
+					modes.push_back (static_cast<Mode> (m));
+				}
+			}
+
+			if (modes.empty ()) {
+				std::cerr << "Invalid modes '" << argv [i] << "'\n";
+				return 1;
+			}
+			continue;
+		} else if (::strcmp (argv [i], "--iterations") == 0 && (i + 1) < argc) {
+			iterations = std::max (1, std::atoi (argv [++i]));
+			continue;
+		} else if (::strcmp (argv [i], "--csv") == 0) {
+			csv = true;
+			continue;
+		} else {
+			std::cerr << "Unknown option '" << argv [i] << "'\n";
+			return 1;
+		}
+
+		if ((i + 1) >= argc || (*list = ParseList (argv [++i])).empty ()) {
+			std::cerr << "Invalid list for '" << argv [i - 1] << "'\n";
+			return 1;
+		}
+	}
+
+	if (modes.empty ()) {
+		modes = { Mode::Sequential, Mode::Parallel, Mode::Selective };
+	}
+
+	const Configuration base = { Mode::Sequential, 2, 8, 8, 0 };
+	std::vector<Configuration> configurations;
+
+	if (platforms.empty () && devices.empty () && properties.empty () &&
+		latencies.empty ()) {
+		for (const auto p : { 1, 2, 4, 8, 16 }) {
+			auto c = base;
+			c.platforms = p;
+			AddConfigurations (configurations, modes, c);
+		}
+
+		for (const auto d : { 1, 32, 128, 512 }) {
+			auto c = base;
+			c.devices = d;
+			AddConfigurations (configurations, modes, c);
+		}
+
+		// Only changes the selective gather
+		for (const auto p : { 1, 4, 16, selectablePropertyCount }) {
+			auto c = base;
+			c.properties = p;
+
+			if (std::find (modes.begin (), modes.end (), Mode::Selective) != modes.end ()) {
+				AddConfigurations (configurations, { Mode::Selective }, c);
+			}
+		}
+
+		for (const auto l : { 10, 100 }) {
+			auto c = base;
+			c.latency = l;
+			AddConfigurations (configurations, modes, c);
+		}
+	} else {
+		if (platforms.empty ()) { platforms.push_back (base.platforms); }
+		if (devices.empty ()) { devices.push_back (base.devices); }
+		if (properties.empty ()) { properties.push_back (base.properties); }
+		if (latencies.empty ()) { latencies.push_back (base.latency); }
+
+		for (const auto p : platforms) {
+			for (const auto d : devices) {
+				for (const auto n : properties) {
+					for (const auto l : latencies) {
+						AddConfigurations (configurations, modes,
+							{ Mode::Sequential, p, d, n, l });
+					}
+				}
+			}
+		}
+	}
+
+	if (csv) {
+		std::printf ("mode,platforms,devices,properties,latency_us,iterations,"
+			"wall_ms_min,wall_ms_median,calls,calls_per_device,"
+			"heap_allocations,heap_bytes,pool_allocations,pool_bytes,"
+			"pool_reserved\n");
+		std::fflush (stdout);
+	}
+
+	int result = 0;
+
+	for (const auto& c : configurations) {
+		Measurement m = {};
+
+		if (MeasureInChild (c, iterations, m)) {
+			Report (c, iterations, m, csv);
+		} else {
+			std::cerr << "Gather failed: " << modeNames [static_cast<int> (c.mode)]
+				<< ", " << c.platforms << " platforms, " << c.devices
+				<< " devices\n";
+			result = 1;
+		}
+	}
+
+	return result;
+}
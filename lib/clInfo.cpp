@@ -2,6 +2,7 @@
 // Licensed under the 3-clause BSD license
 
 #include "clInfo.h"
+#include "clInfoInternal.h"
 
 #include <iostream>
 #include <iomanip>
@@ -17,6 +18,22 @@
 #include <cassert>
 #include <algorithm>
 
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+	#include <cerrno>
+	#include <csignal>
+	#include <sys/mman.h>
+	#include <sys/wait.h>
+	#include <unistd.h>
+#endif
+
 #if _MSC_VER
 #pragma warning (disable: 4127)
 #endif
@@ -27,7 +44,10 @@
 	#include <CL/cl.h>
 #endif
 
-#define NIV_SAFE_CL(expr) do{const auto r = (expr); if (r != CL_SUCCESS) { std::cerr << #expr << " failed with error code " << r << "\n"; return nullptr; }}while(0)
+#include "clInfoExtensions.h"
+
+#define NIV_SAFE_CL_RETURN(expr, result) do{const auto r = (expr); if (r != CL_SUCCESS) { std::cerr << #expr << " failed with error code " << r << "\n"; return result; }}while(0)
+#define NIV_SAFE_CL(expr) NIV_SAFE_CL_RETURN(expr, nullptr)
 
 // Thanks, gnu_dev_major
 #ifdef major
@@ -38,49 +58,9 @@
 #undef minor
 #endif
 
-namespace {
-/**
-Simple memory pool.
-
-Allocates memory in blocks. Assumes all entries are POD types.
-*/
-template <int BlockSize = 1048576>
-struct Pool
-{
-public:
-	void* Allocate (int size)
-	{
-		if (size < 0 || size >= BlockSize) {
-			throw std::bad_alloc ();
-		}
-
-		if ((currentBlockOffset_ + size) > BlockSize) {
-			blocks_.emplace_back (std::vector<unsigned char> (BlockSize));
-
-			currentBlockOffset_ = 0;
-			currentBlock_ = &(blocks_.back ());
-		}
-
-		// Align everything to 8 byte
-		size = ((size + 7) / 8) * 8;
-		auto result = currentBlock_->data () + currentBlockOffset_;
-		currentBlockOffset_ += size;
-
-		return result;
-	}
-
-	template <typename T>
-	T* Allocate ()
-	{
-		return static_cast<T*> (this->Allocate (sizeof (T)));
-	}
-
-private:
-	std::list<std::vector<unsigned char>>	blocks_;
-	std::vector<unsigned char>*				currentBlock_ = nullptr;
-	int currentBlockOffset_ = BlockSize;
-};
+using namespace niv;
 
+namespace {
 struct Version
 {
 	int major = 0;
@@ -235,41 +215,8 @@ const char* ChannelDataTypeToString (cl_channel_type type)
 	}
 }
 
-////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateValue (Pool<>& pool, const char* value)
-{
-	auto v = pool.Allocate<cliValue> ();
-
-	const auto l = ::strlen (value);
-
-	// Pool will fail if this cast goes wrong
-	auto s = pool.Allocate (static_cast<int> (l) + 1);
-	::memcpy (s, value, l);
-	v->s = static_cast<const char*> (s);
-
-	return v;
-}
-
-////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateValue (Pool<>& pool, const std::int64_t value)
-{
-	auto v = pool.Allocate<cliValue> ();
-	v->i = value;
-	return v;
-}
-
-////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateValue (Pool<>& pool, const bool value)
-{
-	auto v = pool.Allocate<cliValue> ();
-	v->b = value;
-	return v;
-}
-
 #define NIV_VALUESTRING(v) v, #v
 
-typedef cliValue* (*CreateFunc)(Pool<>&, void*, std::size_t);
-
 template <typename T>
 struct PropertyFetcher
 {
@@ -292,13 +239,13 @@ struct PropertyFetcher
 };
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateChar (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateChar (Pool& pool, void* buffer, std::size_t)
 {
 	return CreateValue (pool, static_cast<const char*> (buffer));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateCharList (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateCharList (Pool& pool, void* buffer, std::size_t)
 {
 	char* p = static_cast<char*> (buffer);
 
@@ -339,28 +286,28 @@ cliValue* CreateCharList (Pool<>& pool, void* buffer, std::size_t)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateUInt (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateUInt (Pool& pool, void* buffer, std::size_t)
 {
 	return CreateValue (pool, static_cast<std::int64_t> (
 		*static_cast<const cl_uint*> (buffer)));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateULong (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateULong (Pool& pool, void* buffer, std::size_t)
 {
 	return CreateValue (pool, static_cast<std::int64_t> (
 		*static_cast<const cl_ulong*> (buffer)));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateSizeT (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateSizeT (Pool& pool, void* buffer, std::size_t)
 {
 	return CreateValue (pool, static_cast<std::int64_t> (
 		*static_cast<const std::size_t*> (buffer)));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateSizeTList (Pool<>& pool, void* buffer, std::size_t size)
+cliValue* CreateSizeTList (Pool& pool, void* buffer, std::size_t size)
 {
 	const std::size_t* entries = static_cast<const std::size_t*> (buffer);
 
@@ -383,7 +330,7 @@ cliValue* CreateSizeTList (Pool<>& pool, void* buffer, std::size_t size)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateBool (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateBool (Pool& pool, void* buffer, std::size_t)
 {
 	return CreateValue (pool, *static_cast<const cl_bool*> (buffer) != 0);
 }
@@ -397,7 +344,7 @@ struct BitfieldFetcher
 
 ////////////////////////////////////////////////////////////////////////////////
 template <typename T, int Size>
-cliValue* CreateBitfield (const T config, const BitfieldFetcher<T> (&fields)[Size], Pool<>& pool)
+cliValue* CreateBitfield (const T config, const BitfieldFetcher<T> (&fields)[Size], Pool& pool)
 {
 	cliValue* result = nullptr;
 	cliValue* lastValue = nullptr;
@@ -421,7 +368,7 @@ cliValue* CreateBitfield (const T config, const BitfieldFetcher<T> (&fields)[Siz
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateDeviceFPConfig (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateDeviceFPConfig (Pool& pool, void* buffer, std::size_t)
 {
 	const auto config = *static_cast<const cl_device_fp_config*> (buffer);
 
@@ -439,7 +386,7 @@ cliValue* CreateDeviceFPConfig (Pool<>& pool, void* buffer, std::size_t)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateDeviceExecCapabilities (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateDeviceExecCapabilities (Pool& pool, void* buffer, std::size_t)
 {
 	const auto config = *static_cast<const cl_device_exec_capabilities*> (buffer);
 
@@ -452,7 +399,7 @@ cliValue* CreateDeviceExecCapabilities (Pool<>& pool, void* buffer, std::size_t)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateDeviceMemCacheType (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateDeviceMemCacheType (Pool& pool, void* buffer, std::size_t)
 {
 	const auto config = *static_cast<const cl_device_mem_cache_type*> (buffer);
 
@@ -466,7 +413,7 @@ cliValue* CreateDeviceMemCacheType (Pool<>& pool, void* buffer, std::size_t)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateDeviceLocalMemType (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateDeviceLocalMemType (Pool& pool, void* buffer, std::size_t)
 {
 	const auto config = *static_cast<const cl_device_local_mem_type*> (buffer);
 
@@ -480,7 +427,7 @@ cliValue* CreateDeviceLocalMemType (Pool<>& pool, void* buffer, std::size_t)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateDeviceAffinityDomain (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateDeviceAffinityDomain (Pool& pool, void* buffer, std::size_t)
 {
 	const auto config = *static_cast<const cl_device_affinity_domain*> (buffer);
 
@@ -497,7 +444,7 @@ cliValue* CreateDeviceAffinityDomain (Pool<>& pool, void* buffer, std::size_t)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateDevicePartitionProperty (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateDevicePartitionProperty (Pool& pool, void* buffer, std::size_t)
 {
 	const auto config = *static_cast<const cl_device_partition_property*> (buffer);
 
@@ -511,7 +458,7 @@ cliValue* CreateDevicePartitionProperty (Pool<>& pool, void* buffer, std::size_t
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateCommandQueueProperties (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateCommandQueueProperties (Pool& pool, void* buffer, std::size_t)
 {
 	const auto config = *static_cast<const cl_command_queue_properties*> (buffer);
 
@@ -524,7 +471,7 @@ cliValue* CreateCommandQueueProperties (Pool<>& pool, void* buffer, std::size_t)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateDeviceType (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateDeviceType (Pool& pool, void* buffer, std::size_t)
 {
 	const auto config = *static_cast<const cl_device_type*> (buffer);
 
@@ -541,7 +488,7 @@ cliValue* CreateDeviceType (Pool<>& pool, void* buffer, std::size_t)
 
 #ifdef CL_VERSION_2_0
 ////////////////////////////////////////////////////////////////////////////////
-cliValue* CreateDeviceSVMCapabilities (Pool<>& pool, void* buffer, std::size_t)
+cliValue* CreateDeviceSVMCapabilities (Pool& pool, void* buffer, std::size_t)
 {
 	const auto config = *static_cast<const cl_device_svm_capabilities*> (buffer);
 
@@ -556,10 +503,273 @@ cliValue* CreateDeviceSVMCapabilities (Pool<>& pool, void* buffer, std::size_t)
 }
 #endif
 
+/**
+Receives the tree as it is gathered, in depth-first order.
+
+Properties must be consumed immediately, as they may be allocated from a
+scratch pool which is reset afterwards.
+*/
+struct Sink
+{
+	virtual ~Sink ()
+	{
+	}
+
+	/**
+	Returns the new node if the sink builds a tree, and nullptr otherwise.
+	*/
+	virtual cliNode* BeginNode (const char* name, const char* kind) = 0;
+	virtual void Property (cliProperty* property) = 0;
+	virtual void EndNode () = 0;
+};
+
+/**
+Builds a cliNode tree in a pool.
+*/
+class TreeSink final : public Sink
+{
+public:
+	explicit TreeSink (Pool& pool)
+	: pool_ (pool)
+	{
+	}
+
+	/**
+	Link the root node as the first child of parent as soon as it is
+	created, so the tree is reachable while it is being built.
+	*/
+	TreeSink (Pool& pool, cliNode* parent)
+	: pool_ (pool)
+	, parent_ (parent)
+	{
+	}
+
+	cliNode* BeginNode (const char* name, const char* kind) override
+	{
+		auto node = pool_.Allocate<cliNode> ();
+		node->name = name;
+		node->kind = kind;
+
+		if (stack_.empty ()) {
+			root_ = node;
+
+			if (parent_) {
+				parent_->firstChild = node;
+			}
+		} else {
+			auto& parent = stack_.back ();
+
+			if (parent.lastChild) {
+				parent.lastChild->next = node;
+			} else {
+				parent.node->firstChild = node;
+			}
+
+			parent.lastChild = node;
+		}
+
+		Level level = { node, nullptr, nullptr };
+		stack_.push_back (level);
+
+		return node;
+	}
+
+	void Property (cliProperty* property) override
+	{
+		auto& level = stack_.back ();
+
+		if (level.lastProperty) {
+			level.lastProperty->next = property;
+		} else {
+			level.node->firstProperty = property;
+		}
+
+		level.lastProperty = property;
+	}
+
+	void EndNode () override
+	{
+		stack_.pop_back ();
+	}
+
+	cliNode* GetRoot () const
+	{
+		return root_;
+	}
+
+private:
+	struct Level
+	{
+		cliNode*		node;
+		cliNode*		lastChild;
+		cliProperty*	lastProperty;
+	};
+
+	Pool&				pool_;
+	std::vector<Level>	stack_;
+	cliNode*			root_ = nullptr;
+	cliNode*			parent_ = nullptr;
+};
+
+/**
+Forwards the tree to the callbacks of cliInfo_GatherStream.
+*/
+class StreamSink final : public Sink
+{
+public:
+	StreamSink (Pool& scratch, const cliStreamCallbacks& callbacks,
+		void* userdata)
+	: scratch_ (scratch)
+	, callbacks_ (callbacks)
+	, userdata_ (userdata)
+	{
+	}
+
+	cliNode* BeginNode (const char* name, const char* kind) override
+	{
+		if (callbacks_.beginNode) {
+			callbacks_.beginNode (name, kind, userdata_);
+		}
+
+		return nullptr;
+	}
+
+	void Property (cliProperty* property) override
+	{
+		if (callbacks_.property) {
+			callbacks_.property (property, userdata_);
+		}
+
+		scratch_.Reset ();
+	}
+
+	void EndNode () override
+	{
+		if (callbacks_.endNode) {
+			callbacks_.endNode (userdata_);
+		}
+	}
+
+private:
+	Pool&						scratch_;
+	const cliStreamCallbacks&	callbacks_;
+	void*						userdata_;
+};
+
+/**
+Opens a node in a sink, and closes it when leaving the scope, also if the
+gather is aborted.
+*/
+class NodeScope
+{
+public:
+	NodeScope (Sink& sink, const char* name, const char* kind = nullptr)
+	: sink_ (sink)
+	, node_ (sink.BeginNode (name, kind))
+	{
+	}
+
+	~NodeScope ()
+	{
+		sink_.EndNode ();
+	}
+
+	NodeScope (const NodeScope&) = delete;
+	NodeScope& operator= (const NodeScope&) = delete;
+
+	cliNode* GetNode () const
+	{
+		return node_;
+	}
+
+private:
+	Sink&		sink_;
+	cliNode*	node_;
+};
+
+/**
+Thrown when a gather is cancelled through cliInfo_Cancel.
+*/
+struct GatherCancelled : public std::exception
+{
+	const char* what () const throw () override
+	{
+		return "Gather cancelled";
+	}
+};
+
+/**
+State shared by all stages of a gather.
+*/
+struct GatherContext
+{
+	GatherContext (Pool& pool, Sink& sink,
+		std::vector<PlatformEntry>* platforms)
+	: pool (pool)
+	, sink (sink)
+	, platforms (platforms)
+	{
+	}
+
+	/**
+	Throws GatherCancelled if cancellation was requested. Must be called
+	between driver calls.
+	*/
+	void CheckCancelled () const
+	{
+		if (cancel && cancel->load ()) {
+			throw GatherCancelled ();
+		}
+	}
+
+	bool Selects (const char* property) const
+	{
+		return filter == nullptr || filter->Selects (property);
+	}
+
+	void Report (const cliGatherEvent event, const cliNode* node,
+		const int platformIndex, const int platformCount,
+		const int deviceIndex = -1, const int deviceCount = 0) const
+	{
+		if (progress) {
+			cliGatherProgress p;
+			p.event = event;
+			p.node = node;
+			p.platformIndex = platformIndex;
+			p.platformCount = platformCount;
+			p.deviceIndex = deviceIndex;
+			p.deviceCount = deviceCount;
+
+			progress (p);
+		}
+	}
+
+	// Properties and values are allocated from here
+	Pool&						pool;
+	Sink&						sink;
+	// Filled with the gathered platforms and devices if not null
+	std::vector<PlatformEntry>*	platforms;
+
+	const std::atomic<bool>*	cancel = nullptr;
+	std::function<void (const cliGatherProgress&)>	progress;
+
+	// Gathers everything if null
+	const GatherFilter*			filter = nullptr;
+
+	const ClApi*				api = &GetLoaderApi ();
+
+	// If not null, the platforms are enumerated directly from the vendor
+	// ICDs instead of through the ICD loader, and the libraries are kept here
+	std::vector<std::shared_ptr<void>>*	libraries = nullptr;
+
+	// Set if api records the calls
+	Recorder*					recorder = nullptr;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 template <typename GetInfoFunction, typename CLObject, typename Info, typename CreateFunction>
 cliValue* GetValue (GetInfoFunction getInfoFunction, CLObject clObject, Info info,
-	Pool<>& pool, CreateFunction createFunction)
+	Pool& pool, CreateFunction createFunction)
 {
 	size_t size;
 	NIV_SAFE_CL (getInfoFunction (clObject, info, 0, nullptr, &size));
@@ -576,38 +786,68 @@ cliValue* GetValue (GetInfoFunction getInfoFunction, CLObject clObject, Info inf
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-template <typename F, typename P, typename Container>
-void GetProperties (Pool<>& pool, cliNode* cliNode, F f, P clObject,
-	const Container& container)
+template <typename F, typename P, typename Container, typename Observer>
+void GetProperties (const GatherContext& context, F f, P clObject,
+	const Container& container, Observer observer)
 {
-	auto lastProperty = cliNode->firstProperty;
-
-	// If the cliNode already has a property, skip until the end of the property
-	// list
-	while (lastProperty && lastProperty->next) {
-		lastProperty = lastProperty->next;
-	}
+	auto& pool = context.pool;
 
 	for (const auto info : container) {
+		if (! context.Selects (info.n)) {
+			continue;
+		}
+
+		context.CheckCancelled ();
+
 		auto property = pool.Allocate<cliProperty> ();
 		property->type = info.type;
 		property->name = info.n;
 		property->hint = info.h;
 		property->value = GetValue (f, clObject, info.info, pool, info.cf);
 
-		if (lastProperty) {
-			lastProperty->next = property;
-			lastProperty = lastProperty->next;
-		} else {
-			cliNode->firstProperty = property;
-			lastProperty = property;
+		observer (property);
+		context.sink.Property (property);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename F, typename P, typename Container>
+void GetProperties (const GatherContext& context, F f, P clObject,
+	const Container& container)
+{
+	GetProperties (context, f, clObject, container, [](const cliProperty*) {});
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cliProperty* FindProperty (const cliNode* node, const char* name)
+{
+	for (auto p = node->firstProperty; p; p = p->next) {
+		if (::strcmp (p->name, name) == 0) {
+			return p;
+		}
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool ContainsValue (const cliProperty* property, const char* value)
+{
+	for (auto v = property->value; v; v = v->next) {
+		if (::strcmp (v->s, value) == 0) {
+			return true;
 		}
 	}
+
+	return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliNode* GatherContextInfo (cl_context ctx, Pool<>& pool, const Version clVersion)
+bool GatherContextInfo (cl_context ctx, const GatherContext& context,
+	const Version clVersion)
 {
+	auto& pool = context.pool;
+
 	struct ImageType
 	{
 		cl_mem_object_type type;
@@ -636,115 +876,377 @@ cliNode* GatherContextInfo (cl_context ctx, Pool<>& pool, const Version clVersio
 	}
 #endif
 
-	auto imageFormatsNode = pool.Allocate<cliNode> ();
-	imageFormatsNode->name = "ImageFormats";
+	NodeScope imageFormatsScope (context.sink, "ImageFormats");
 
-	cliNode* lastImageFormatNode = nullptr;
 	for (const auto t : types) {
-		auto imageFormatNode = pool.Allocate <cliNode> ();
-		imageFormatNode->kind = t.n;
-		imageFormatNode->name = "ObjectType";
+		context.CheckCancelled ();
 
 		cl_uint numImageFormats;
-		NIV_SAFE_CL (clGetSupportedImageFormats (ctx, CL_MEM_READ_WRITE, t.type,
-			0, nullptr, &numImageFormats));
+		NIV_SAFE_CL_RETURN (context.api->GetSupportedImageFormats (ctx,
+			CL_MEM_READ_WRITE, t.type, 0, nullptr, &numImageFormats), false);
 
 		if (numImageFormats == 0) {
 			continue;
 		}
 
 		std::vector<cl_image_format> formats (numImageFormats);
-		NIV_SAFE_CL (clGetSupportedImageFormats (ctx, CL_MEM_READ_WRITE, t.type,
-			numImageFormats, formats.data (), 0));
+		NIV_SAFE_CL_RETURN (context.api->GetSupportedImageFormats (ctx,
+			CL_MEM_READ_WRITE, t.type, numImageFormats, formats.data (), 0), false);
+
+		NodeScope imageFormatScope (context.sink, "ObjectType", t.n);
 
-		cliNode* lastFormat = nullptr;
 		for (const auto format : formats) {
-			cliNode* formatcliNode = pool.Allocate<cliNode> ();
-			formatcliNode->name = "Format";
+			NodeScope formatScope (context.sink, "Format");
 
 			cliProperty* channelOrderProperty = pool.Allocate<cliProperty> ();
 			channelOrderProperty->name = "ChannelOrder";
 			channelOrderProperty->type = CLI_PropertyType_String;
 			channelOrderProperty->value = CreateValue (pool,
 				ChannelOrderToString (format.image_channel_order));
+			context.sink.Property (channelOrderProperty);
 
 			cliProperty* channelDataTypeProperty = pool.Allocate<cliProperty> ();
 			channelDataTypeProperty->name = "ChannelDataType";
 			channelDataTypeProperty->type = CLI_PropertyType_String;
 			channelDataTypeProperty->value = CreateValue (pool,
 				ChannelDataTypeToString (format.image_channel_data_type));
+			context.sink.Property (channelDataTypeProperty);
+		}
+	}
 
-			channelOrderProperty->next = channelDataTypeProperty;
-			formatcliNode->firstProperty = channelOrderProperty;
+	return true;
+}
 
-			if (lastFormat) {
-				lastFormat->next = formatcliNode;
-				lastFormat = lastFormat->next;
-			} else {
-				imageFormatNode->firstChild = formatcliNode;
-				lastFormat = formatcliNode;
-			}
+////////////////////////////////////////////////////////////////////////////////
+/**
+Query an integer device property of any width directly, without creating a
+property for it. Returns false if the driver does not support it.
+*/
+bool GetDeviceInteger (const ClApi& api, cl_device_id id,
+	const cl_device_info info, std::uint64_t& value)
+{
+	std::size_t size = 0;
+	if (api.GetDeviceInfo (id, info, 0, nullptr, &size) != CL_SUCCESS) {
+		return false;
+	}
+
+	if (size == sizeof (cl_uint)) {
+		cl_uint v;
+		if (api.GetDeviceInfo (id, info, size, &v, nullptr) != CL_SUCCESS) {
+			return false;
 		}
 
-		if (lastImageFormatNode) {
-			lastImageFormatNode->next = imageFormatNode;
-			lastImageFormatNode = lastImageFormatNode->next;
-		} else {
-			imageFormatsNode->firstChild = imageFormatNode;
-			lastImageFormatNode = imageFormatNode;
+		value = v;
+		return true;
+	} else if (size == sizeof (cl_ulong)) {
+		cl_ulong v;
+		if (api.GetDeviceInfo (id, info, size, &v, nullptr) != CL_SUCCESS) {
+			return false;
 		}
+
+		value = v;
+		return true;
 	}
 
-	return imageFormatsNode;
+	return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliNode* GatherDeviceInfo (cl_device_id id, Pool<>& pool)
+/**
+Number of FP32 lanes per streaming multiprocessor for a compute capability,
+or 0 if unknown.
+*/
+int GetCoresPerMultiprocessorNV (const int major, const int minor)
 {
-	// Unused properties
-	// {NIV_VALUESTRING (CL_DEVICE_PARENT_DEVICE), CreateChar, CLI_PropertyType_String},
-	// {NIV_VALUESTRING (CL_DEVICE_PLATFORM), CreateUInt, CLI_PropertyType_Int64},
+	switch (major) {
+	case 1: return 8;
+	case 2: return minor == 0 ? 32 : 48;
+	case 3: return 192;
+	case 5: return 128;
+	case 6: return minor == 0 ? 64 : 128;
+	case 7: return 64;
+	case 8: return minor == 0 ? 64 : 128;
+	case 9: return 128;
+	default: return 0;
+	}
+}
 
-	static const std::vector<PropertyFetcher<cl_device_info>> infos_CL_shared = {
-		{NIV_VALUESTRING (CL_DEVICE_ADDRESS_BITS), CreateUInt, CLI_PropertyType_Int64, "The default compute device address space size specified as an unsigned integer value in bits."},
-		{NIV_VALUESTRING (CL_DEVICE_AVAILABLE), CreateBool, CLI_PropertyType_Bool},
-		{NIV_VALUESTRING (CL_DEVICE_COMPILER_AVAILABLE), CreateBool, CLI_PropertyType_Bool},
-		{NIV_VALUESTRING (CL_DEVICE_DOUBLE_FP_CONFIG), CreateDeviceFPConfig, CLI_PropertyType_String},
-		{NIV_VALUESTRING (CL_DEVICE_ENDIAN_LITTLE), CreateBool, CLI_PropertyType_Bool},
-		{NIV_VALUESTRING (CL_DEVICE_ERROR_CORRECTION_SUPPORT), CreateBool, CLI_PropertyType_Bool},
-		{NIV_VALUESTRING (CL_DEVICE_EXECUTION_CAPABILITIES), CreateDeviceExecCapabilities, CLI_PropertyType_String},
-		{NIV_VALUESTRING (CL_DEVICE_EXTENSIONS), CreateCharList, CLI_PropertyType_String},
-		{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CACHE_SIZE), CreateULong, CLI_PropertyType_Int64, "Size of global memory cache in bytes."},
-		{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CACHE_TYPE), CreateDeviceMemCacheType, CLI_PropertyType_String},
-		{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE), CreateUInt, CLI_PropertyType_Int64, "Size of global memory cache line in bytes."},
-		{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_SIZE), CreateULong, CLI_PropertyType_Int64, "Size of global device memory in bytes."},
-		{NIV_VALUESTRING (CL_DEVICE_IMAGE2D_MAX_HEIGHT), CreateSizeT, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_IMAGE2D_MAX_WIDTH), CreateSizeT, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_IMAGE3D_MAX_DEPTH), CreateSizeT, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_IMAGE3D_MAX_HEIGHT), CreateSizeT, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_IMAGE3D_MAX_WIDTH), CreateSizeT, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_IMAGE_SUPPORT), CreateBool, CLI_PropertyType_Bool},
-		{NIV_VALUESTRING (CL_DEVICE_LOCAL_MEM_SIZE), CreateULong, CLI_PropertyType_Int64, "Size of local memory arena in bytes. The minimum value is 32 KB for devices that are not of type CL_DEVICE_TYPE_CUSTOM."},
-		{NIV_VALUESTRING (CL_DEVICE_LOCAL_MEM_TYPE), CreateDeviceLocalMemType, CLI_PropertyType_String, "Type of local memory supported. This can be set to CL_LOCAL implying dedicated local memory storage such as SRAM, or CL_GLOBAL. For custom devices, CL_NONE can also be returned indicating no local memory support."},
-		{NIV_VALUESTRING (CL_DEVICE_MAX_CLOCK_FREQUENCY), CreateUInt, CLI_PropertyType_Int64, "Maximum configured clock frequency of the device in MHz."},
-		{NIV_VALUESTRING (CL_DEVICE_MAX_COMPUTE_UNITS), CreateUInt, CLI_PropertyType_Int64, "The number of parallel compute units on the OpenCL device. A work-group executes on a single compute unit. The minimum value is 1."},
-		{NIV_VALUESTRING (CL_DEVICE_MAX_CONSTANT_ARGS), CreateUInt, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE), CreateULong, CLI_PropertyType_Int64, "Max size in bytes of a constant buffer allocation. The minimum value is 64 KB for devices that are not of type CL_DEVICE_TYPE_CUSTOM."},
-		{NIV_VALUESTRING (CL_DEVICE_MAX_MEM_ALLOC_SIZE), CreateULong, CLI_PropertyType_Int64, "Max size of memory object allocation in bytes. The minimum value is max (1/4th of CL_DEVICE_GLOBAL_MEM_SIZE, 128*1024*1024) for devices that are not of type CL_DEVICE_TYPE_CUSTOM."},
-		{NIV_VALUESTRING (CL_DEVICE_MAX_PARAMETER_SIZE), CreateSizeT, CLI_PropertyType_Int64, "Max size in bytes of the arguments that can be passed to a kernel. The minimum value is 1024 for devices that are not of type CL_DEVICE_TYPE_CUSTOM. For this minimum value, only a maximum of 128 arguments can be passed to a kernel."},
-		{NIV_VALUESTRING (CL_DEVICE_MAX_READ_IMAGE_ARGS), CreateUInt, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_MAX_SAMPLERS), CreateUInt, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_MAX_WORK_GROUP_SIZE), CreateSizeT, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS), CreateUInt, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_MAX_WORK_ITEM_SIZES), CreateSizeTList, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_MAX_WRITE_IMAGE_ARGS), CreateUInt, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_MEM_BASE_ADDR_ALIGN), CreateUInt, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_NAME), CreateChar, CLI_PropertyType_String},
-		{NIV_VALUESTRING (CL_DEVICE_OPENCL_C_VERSION), CreateChar, CLI_PropertyType_String},
-		{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR), CreateUInt, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT), CreateUInt, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT), CreateUInt, CLI_PropertyType_Int64},
-		{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG), CreateUInt, CLI_PropertyType_Int64},
+////////////////////////////////////////////////////////////////////////////////
+void AddMetric (const GatherContext& context, const char* name,
+	const std::int64_t value, const char* unit, const std::string& formula,
+	const bool estimate)
+{
+	auto& pool = context.pool;
+
+	NodeScope metricScope (context.sink, "Metric", name);
+
+	auto valueProperty = pool.Allocate<cliProperty> ();
+	valueProperty->name = "Value";
+	valueProperty->type = CLI_PropertyType_Int64;
+	valueProperty->value = CreateValue (pool, value);
+	context.sink.Property (valueProperty);
+
+	auto unitProperty = pool.Allocate<cliProperty> ();
+	unitProperty->name = "Unit";
+	unitProperty->type = CLI_PropertyType_String;
+	unitProperty->value = CreateValue (pool, unit);
+	context.sink.Property (unitProperty);
+
+	auto formulaProperty = pool.Allocate<cliProperty> ();
+	formulaProperty->name = "Formula";
+	formulaProperty->type = CLI_PropertyType_String;
+	formulaProperty->value = CreateValue (pool, formula.c_str ());
+	context.sink.Property (formulaProperty);
+
+	auto estimateProperty = pool.Allocate<cliProperty> ();
+	estimateProperty->name = "Estimate";
+	estimateProperty->type = CLI_PropertyType_Bool;
+	estimateProperty->value = CreateValue (pool, estimate);
+	context.sink.Property (estimateProperty);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+The device properties the derived metrics are computed from, 0 if unknown.
+*/
+struct DerivedInputs
+{
+	std::uint64_t	computeUnits = 0;
+	std::uint64_t	clock = 0;
+	std::uint64_t	widthFloat = 0;
+	std::uint64_t	workGroupSize = 0;
+	std::uint64_t	globalMemSize = 0;
+	std::uint64_t	maxAllocSize = 0;
+	std::uint64_t	globalCacheSize = 0;
+
+	std::uint64_t	simdPerComputeUnit = 0;
+	std::uint64_t	simdWidth = 0;
+	std::uint64_t	simdInstructionWidth = 0;
+	std::uint64_t	wavefrontWidth = 0;
+	std::uint64_t	memChannels = 0;
+
+	std::uint64_t	computeCapabilityMajor = 0;
+	std::uint64_t	computeCapabilityMinor = 0;
+	std::uint64_t	warpSize = 0;
+};
+
+struct DerivedInput
+{
+	cl_device_info					info;
+	const char*						name;
+	std::uint64_t DerivedInputs::*	member;
+};
+
+const DerivedInput derivedInputs_CL [] = {
+	{NIV_VALUESTRING (CL_DEVICE_MAX_COMPUTE_UNITS), &DerivedInputs::computeUnits},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_CLOCK_FREQUENCY), &DerivedInputs::clock},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_WORK_GROUP_SIZE), &DerivedInputs::workGroupSize},
+	{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_SIZE), &DerivedInputs::globalMemSize},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_MEM_ALLOC_SIZE), &DerivedInputs::maxAllocSize},
+	{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CACHE_SIZE), &DerivedInputs::globalCacheSize},
+#ifdef CL_VERSION_1_1
+	{NIV_VALUESTRING (CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT), &DerivedInputs::widthFloat},
+#endif
+};
+
+const DerivedInput derivedInputs_AMD [] = {
+	{NIV_VALUESTRING (CL_DEVICE_SIMD_PER_COMPUTE_UNIT_AMD), &DerivedInputs::simdPerComputeUnit},
+	{NIV_VALUESTRING (CL_DEVICE_SIMD_WIDTH_AMD), &DerivedInputs::simdWidth},
+	{NIV_VALUESTRING (CL_DEVICE_SIMD_INSTRUCTION_WIDTH_AMD), &DerivedInputs::simdInstructionWidth},
+	{NIV_VALUESTRING (CL_DEVICE_WAVEFRONT_WIDTH_AMD), &DerivedInputs::wavefrontWidth},
+	{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CHANNELS_AMD), &DerivedInputs::memChannels}
+};
+
+const DerivedInput derivedInputs_NV [] = {
+	{NIV_VALUESTRING (CL_DEVICE_COMPUTE_CAPABILITY_MAJOR_NV), &DerivedInputs::computeCapabilityMajor},
+	{NIV_VALUESTRING (CL_DEVICE_COMPUTE_CAPABILITY_MINOR_NV), &DerivedInputs::computeCapabilityMinor},
+	{NIV_VALUESTRING (CL_DEVICE_WARP_SIZE_NV), &DerivedInputs::warpSize}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Take the value of a gathered property if it is one of inputs.
+*/
+template <std::size_t Size>
+void ObserveDerivedInput (const cliProperty* property,
+	const DerivedInput (&inputs)[Size], DerivedInputs& d)
+{
+	if (property->value == nullptr) {
+		return;
+	}
+
+	for (const auto& input : inputs) {
+		if (::strcmp (property->name, input.name) == 0) {
+			d.*input.member = static_cast<std::uint64_t> (property->value->i);
+			return;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Query the inputs which were not gathered because options->properties does not
+select them. All other inputs were observed while gathering.
+*/
+template <std::size_t Size>
+void QueryDerivedInputs (cl_device_id id, const GatherContext& context,
+	const DerivedInput (&inputs)[Size], DerivedInputs& d)
+{
+	for (const auto& input : inputs) {
+		if (! context.Selects (input.name)) {
+			GetDeviceInteger (*context.api, id, input.info, d.*input.member);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Compute rough figures from the raw device properties, see
+CLI_GatherFlag_Derived.
+
+Peak throughput counts a fused multiply-add as two operations per lane and
+cycle at the maximum clock. Without vendor information, the lanes are the
+native vector width of each compute unit, which is about right for CPUs, but
+undercounts GPUs, which report a width of 1. The vendor extensions give the
+actual number of lanes per compute unit instead. Double and half precision
+are left out, as their rate relative to single precision differs between
+products of the same vendor, and no property reports it.
+*/
+void GatherDerivedInfo (const GatherContext& context, const DerivedInputs& d)
+{
+	context.CheckCancelled ();
+
+	NodeScope derivedScope (context.sink, "Derived");
+
+	// Lanes per compute unit, and how they were obtained
+	std::uint64_t lanes = d.widthFloat;
+	std::string lanesFormula = "CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT";
+
+	const auto coresNV = GetCoresPerMultiprocessorNV (
+		static_cast<int> (d.computeCapabilityMajor),
+		static_cast<int> (d.computeCapabilityMinor));
+
+	if (d.simdPerComputeUnit && d.simdWidth && d.simdInstructionWidth) {
+		lanes = d.simdPerComputeUnit * d.simdWidth * d.simdInstructionWidth;
+		lanesFormula = "CL_DEVICE_SIMD_PER_COMPUTE_UNIT_AMD * "
+			"CL_DEVICE_SIMD_WIDTH_AMD * CL_DEVICE_SIMD_INSTRUCTION_WIDTH_AMD";
+	} else if (coresNV > 0) {
+		lanes = static_cast<std::uint64_t> (coresNV);
+		lanesFormula = std::to_string (coresNV) + " (FP32 cores per "
+			"multiprocessor of compute capability " +
+			std::to_string (d.computeCapabilityMajor) + "." +
+			std::to_string (d.computeCapabilityMinor) + ")";
+	}
+
+	const std::string computeFormula = "CL_DEVICE_MAX_COMPUTE_UNITS * "
+		"CL_DEVICE_MAX_CLOCK_FREQUENCY * " + lanesFormula + " * 2";
+
+	// MHz times operations per cycle gives MFLOP/s
+	const auto peakSingle = d.computeUnits * d.clock * lanes * 2;
+
+	if (peakSingle > 0 && d.widthFloat > 0) {
+		AddMetric (context, "PeakSingleThroughput",
+			static_cast<std::int64_t> (peakSingle), "MFLOP/s",
+			computeFormula, true);
+	}
+
+	if (d.computeUnits > 0 && d.workGroupSize > 0) {
+		AddMetric (context, "MaxResidentWorkItems",
+			static_cast<std::int64_t> (d.computeUnits * d.workGroupSize),
+			"work-items", "CL_DEVICE_MAX_COMPUTE_UNITS * "
+			"CL_DEVICE_MAX_WORK_GROUP_SIZE", true);
+	}
+
+	if (d.globalMemSize > 0 && d.maxAllocSize > 0) {
+		AddMetric (context, "MaxAllocationFraction",
+			static_cast<std::int64_t> (d.maxAllocSize * 100 / d.globalMemSize),
+			"percent", "CL_DEVICE_MAX_MEM_ALLOC_SIZE * 100 / "
+			"CL_DEVICE_GLOBAL_MEM_SIZE", false);
+	}
+
+	if (d.computeUnits > 0 && d.globalCacheSize > 0) {
+		AddMetric (context, "GlobalCachePerComputeUnit",
+			static_cast<std::int64_t> (d.globalCacheSize / d.computeUnits),
+			"bytes", "CL_DEVICE_GLOBAL_MEM_CACHE_SIZE / "
+			"CL_DEVICE_MAX_COMPUTE_UNITS", true);
+	}
+
+	if (d.wavefrontWidth > 0) {
+		AddMetric (context, "WavefrontWidth",
+			static_cast<std::int64_t> (d.wavefrontWidth), "work-items",
+			"CL_DEVICE_WAVEFRONT_WIDTH_AMD", false);
+	}
+
+	if (d.warpSize > 0) {
+		AddMetric (context, "WarpSize",
+			static_cast<std::int64_t> (d.warpSize), "work-items",
+			"CL_DEVICE_WARP_SIZE_NV", false);
+	}
+
+	if (d.memChannels > 0) {
+		AddMetric (context, "MemoryChannels",
+			static_cast<std::int64_t> (d.memChannels), "channels",
+			"CL_DEVICE_GLOBAL_MEM_CHANNELS_AMD", false);
+	}
+}
+
+// The device properties which are re-queried by cliInfo_Refresh
+const PropertyFetcher<cl_device_info> infos_Volatile [] = {
+	{NIV_VALUESTRING (CL_DEVICE_AVAILABLE), CreateBool, CLI_PropertyType_Bool},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_CLOCK_FREQUENCY), CreateUInt, CLI_PropertyType_Int64},
+	{NIV_VALUESTRING (CL_DEVICE_GLOBAL_FREE_MEMORY_AMD), CreateSizeTList, CLI_PropertyType_Int64}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+cliNode* GatherDeviceInfo (cl_device_id id, const GatherContext& context,
+	DeviceEntry& entry)
+{
+	entry.id = id;
+
+	// Unused properties
+	// {NIV_VALUESTRING (CL_DEVICE_PARENT_DEVICE), CreateChar, CLI_PropertyType_String},
+	// {NIV_VALUESTRING (CL_DEVICE_PLATFORM), CreateUInt, CLI_PropertyType_Int64},
+
+	static const std::vector<PropertyFetcher<cl_device_info>> infos_CL_shared = {
+		{NIV_VALUESTRING (CL_DEVICE_ADDRESS_BITS), CreateUInt, CLI_PropertyType_Int64, "The default compute device address space size specified as an unsigned integer value in bits."},
+		{NIV_VALUESTRING (CL_DEVICE_AVAILABLE), CreateBool, CLI_PropertyType_Bool},
+		{NIV_VALUESTRING (CL_DEVICE_COMPILER_AVAILABLE), CreateBool, CLI_PropertyType_Bool},
+		{NIV_VALUESTRING (CL_DEVICE_DOUBLE_FP_CONFIG), CreateDeviceFPConfig, CLI_PropertyType_String},
+		{NIV_VALUESTRING (CL_DEVICE_ENDIAN_LITTLE), CreateBool, CLI_PropertyType_Bool},
+		{NIV_VALUESTRING (CL_DEVICE_ERROR_CORRECTION_SUPPORT), CreateBool, CLI_PropertyType_Bool},
+		{NIV_VALUESTRING (CL_DEVICE_EXECUTION_CAPABILITIES), CreateDeviceExecCapabilities, CLI_PropertyType_String},
+		{NIV_VALUESTRING (CL_DEVICE_EXTENSIONS), CreateCharList, CLI_PropertyType_String},
+		{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CACHE_SIZE), CreateULong, CLI_PropertyType_Int64, "Size of global memory cache in bytes."},
+		{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CACHE_TYPE), CreateDeviceMemCacheType, CLI_PropertyType_String},
+		{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE), CreateUInt, CLI_PropertyType_Int64, "Size of global memory cache line in bytes."},
+		{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_SIZE), CreateULong, CLI_PropertyType_Int64, "Size of global device memory in bytes."},
+		{NIV_VALUESTRING (CL_DEVICE_IMAGE2D_MAX_HEIGHT), CreateSizeT, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_IMAGE2D_MAX_WIDTH), CreateSizeT, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_IMAGE3D_MAX_DEPTH), CreateSizeT, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_IMAGE3D_MAX_HEIGHT), CreateSizeT, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_IMAGE3D_MAX_WIDTH), CreateSizeT, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_IMAGE_SUPPORT), CreateBool, CLI_PropertyType_Bool},
+		{NIV_VALUESTRING (CL_DEVICE_LOCAL_MEM_SIZE), CreateULong, CLI_PropertyType_Int64, "Size of local memory arena in bytes. The minimum value is 32 KB for devices that are not of type CL_DEVICE_TYPE_CUSTOM."},
+		{NIV_VALUESTRING (CL_DEVICE_LOCAL_MEM_TYPE), CreateDeviceLocalMemType, CLI_PropertyType_String, "Type of local memory supported. This can be set to CL_LOCAL implying dedicated local memory storage such as SRAM, or CL_GLOBAL. For custom devices, CL_NONE can also be returned indicating no local memory support."},
+		{NIV_VALUESTRING (CL_DEVICE_MAX_CLOCK_FREQUENCY), CreateUInt, CLI_PropertyType_Int64, "Maximum configured clock frequency of the device in MHz."},
+		{NIV_VALUESTRING (CL_DEVICE_MAX_COMPUTE_UNITS), CreateUInt, CLI_PropertyType_Int64, "The number of parallel compute units on the OpenCL device. A work-group executes on a single compute unit. The minimum value is 1."},
+		{NIV_VALUESTRING (CL_DEVICE_MAX_CONSTANT_ARGS), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE), CreateULong, CLI_PropertyType_Int64, "Max size in bytes of a constant buffer allocation. The minimum value is 64 KB for devices that are not of type CL_DEVICE_TYPE_CUSTOM."},
+		{NIV_VALUESTRING (CL_DEVICE_MAX_MEM_ALLOC_SIZE), CreateULong, CLI_PropertyType_Int64, "Max size of memory object allocation in bytes. The minimum value is max (1/4th of CL_DEVICE_GLOBAL_MEM_SIZE, 128*1024*1024) for devices that are not of type CL_DEVICE_TYPE_CUSTOM."},
+		{NIV_VALUESTRING (CL_DEVICE_MAX_PARAMETER_SIZE), CreateSizeT, CLI_PropertyType_Int64, "Max size in bytes of the arguments that can be passed to a kernel. The minimum value is 1024 for devices that are not of type CL_DEVICE_TYPE_CUSTOM. For this minimum value, only a maximum of 128 arguments can be passed to a kernel."},
+		{NIV_VALUESTRING (CL_DEVICE_MAX_READ_IMAGE_ARGS), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_MAX_SAMPLERS), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_MAX_WORK_GROUP_SIZE), CreateSizeT, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_MAX_WORK_ITEM_SIZES), CreateSizeTList, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_MAX_WRITE_IMAGE_ARGS), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_MEM_BASE_ADDR_ALIGN), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_NAME), CreateChar, CLI_PropertyType_String},
+		{NIV_VALUESTRING (CL_DEVICE_OPENCL_C_VERSION), CreateChar, CLI_PropertyType_String},
+		{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG), CreateUInt, CLI_PropertyType_Int64},
 		{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT), CreateUInt, CLI_PropertyType_Int64},
 		{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE), CreateUInt, CLI_PropertyType_Int64},
 		{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_HALF), CreateUInt, CLI_PropertyType_Int64},
@@ -834,16 +1336,14 @@ cliNode* GatherDeviceInfo (cl_device_id id, Pool<>& pool)
 		// {NIV_VALUESTRING (CL_DEVICE_TERMINATE_CAPABILITY_KHR), CreateDeviceTerminateCapability, CLI_PropertyType_String},
 	};
 #endif
-	auto deviceNode = pool.Allocate<cliNode> ();
-	deviceNode->name = "Device";
-
 	// Get OpenCL version
 	std::size_t versionSize;
-	NIV_SAFE_CL (clGetDeviceInfo (id, CL_DEVICE_VERSION, 0, nullptr, &versionSize));
+	NIV_SAFE_CL (context.api->GetDeviceInfo (id, CL_DEVICE_VERSION, 0, nullptr,
+		&versionSize));
 
 	std::string versionString;
 	versionString.resize (versionSize);
-	NIV_SAFE_CL (clGetDeviceInfo(id, CL_DEVICE_VERSION, versionSize,
+	NIV_SAFE_CL (context.api->GetDeviceInfo (id, CL_DEVICE_VERSION, versionSize,
 		// Ugly but safe
 		const_cast<char*> (versionString.data ()), nullptr));
 
@@ -884,149 +1384,1461 @@ cliNode* GatherDeviceInfo (cl_device_id id, Pool<>& pool)
 					return ::strcmp (a.n, b.n) < 0;
 	});
 
-	GetProperties (pool, deviceNode, clGetDeviceInfo, id, propertiesToFetch);
+	// Some properties are in the shared and the version specific lists, but
+	// every property must be gathered once, as the names are unique in the
+	// JSON and CBOR output
+	propertiesToFetch.erase (std::unique (propertiesToFetch.begin (),
+		propertiesToFetch.end (),
+		[](const PropertyFetcher<cl_device_info>& a,
+			const PropertyFetcher<cl_device_info>& b) {
+			return ::strcmp (a.n, b.n) == 0;
+		}), propertiesToFetch.end ());
+
+	NodeScope deviceScope (context.sink, "Device");
+	const auto deviceNode = deviceScope.GetNode ();
+
+	bool hasAmdAttributeQuery = false;
+	bool hasNvAttributeQuery = false;
+
+	// The derived metrics use the gathered values where possible
+	const bool derived = context.filter && context.filter->derived;
+	DerivedInputs derivedInputs;
+
+	GetProperties (context, context.api->GetDeviceInfo, id, propertiesToFetch,
+		[&] (const cliProperty* property) -> void {
+			if (::strcmp (property->name, "CL_DEVICE_EXTENSIONS") == 0) {
+				hasAmdAttributeQuery = ContainsValue (property,
+					"cl_amd_device_attribute_query");
+				hasNvAttributeQuery = ContainsValue (property,
+					"cl_nv_device_attribute_query");
+			}
+
+			if (derived) {
+				ObserveDerivedInput (property, derivedInputs_CL, derivedInputs);
+			}
+	});
+
+	// Vendor extensions, appended after the sorted core properties
+	static const std::vector<PropertyFetcher<cl_device_info>> infos_AMD = {
+		{NIV_VALUESTRING (CL_DEVICE_GLOBAL_FREE_MEMORY_AMD), CreateSizeTList, CLI_PropertyType_Int64, "Free global memory and largest free block in KiB."},
+		{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CHANNELS_AMD), CreateUInt, CLI_PropertyType_Int64, "Number of global memory channels."},
+		{NIV_VALUESTRING (CL_DEVICE_SIMD_PER_COMPUTE_UNIT_AMD), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_SIMD_WIDTH_AMD), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_SIMD_INSTRUCTION_WIDTH_AMD), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_WAVEFRONT_WIDTH_AMD), CreateUInt, CLI_PropertyType_Int64, "Number of work-items executed together."}
+	};
+
+	static const std::vector<PropertyFetcher<cl_device_info>> infos_NV = {
+		{NIV_VALUESTRING (CL_DEVICE_COMPUTE_CAPABILITY_MAJOR_NV), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_COMPUTE_CAPABILITY_MINOR_NV), CreateUInt, CLI_PropertyType_Int64},
+		{NIV_VALUESTRING (CL_DEVICE_WARP_SIZE_NV), CreateUInt, CLI_PropertyType_Int64, "Number of work-items executed together."}
+	};
+
+	const auto selectsAny = [&context] (
+		const std::vector<PropertyFetcher<cl_device_info>>& infos) -> bool {
+		for (const auto& info : infos) {
+			if (context.Selects (info.n)) {
+				return true;
+			}
+		}
+
+		return false;
+	};
+
+	// The extensions decide whether vendor properties can be queried, so get
+	// them even if they are not gathered
+	if (! context.Selects ("CL_DEVICE_EXTENSIONS") &&
+		(selectsAny (infos_AMD) || selectsAny (infos_NV) ||
+			derived)) {
+		cliProperty extensions = {};
+		extensions.value = GetValue (context.api->GetDeviceInfo, id,
+			static_cast<cl_device_info> (CL_DEVICE_EXTENSIONS), context.pool,
+			CreateCharList);
+
+		hasAmdAttributeQuery = ContainsValue (&extensions,
+			"cl_amd_device_attribute_query");
+		hasNvAttributeQuery = ContainsValue (&extensions,
+			"cl_nv_device_attribute_query");
+	}
+
+	if (hasAmdAttributeQuery) {
+		GetProperties (context, context.api->GetDeviceInfo, id, infos_AMD,
+			[&] (const cliProperty* property) -> void {
+				if (derived) {
+					ObserveDerivedInput (property, derivedInputs_AMD,
+						derivedInputs);
+				}
+		});
+	}
+
+	if (hasNvAttributeQuery) {
+		GetProperties (context, context.api->GetDeviceInfo, id, infos_NV,
+			[&] (const cliProperty* property) -> void {
+				if (derived) {
+					ObserveDerivedInput (property, derivedInputs_NV,
+						derivedInputs);
+				}
+		});
+	}
+
+	if (derived) {
+		QueryDerivedInputs (id, context, derivedInputs_CL, derivedInputs);
+
+		if (hasAmdAttributeQuery) {
+			QueryDerivedInputs (id, context, derivedInputs_AMD, derivedInputs);
+		}
+
+		if (hasNvAttributeQuery) {
+			QueryDerivedInputs (id, context, derivedInputs_NV, derivedInputs);
+		}
+
+		GatherDerivedInfo (context, derivedInputs);
+	}
+
+	entry.node = deviceNode;
+
+	// Only trees can be refreshed
+	if (deviceNode) {
+		for (const auto& info : infos_Volatile) {
+			if (auto property = FindProperty (deviceNode, info.n)) {
+				entry.volatileProperties.push_back ({info.info, info.cf, property});
+			}
+		}
+	}
+
+	if (context.filter && context.filter->skipImageFormats) {
+		return deviceNode;
+	}
 
 	cl_int result;
-	auto ctx = clCreateContext (nullptr, 1, &id, nullptr, nullptr, &result);
+	auto ctx = context.api->CreateContext (nullptr, 1, &id, nullptr, nullptr,
+		&result);
 
 	if (result == CL_SUCCESS) {
-		deviceNode->firstChild = GatherContextInfo (ctx, pool, version);
-	}
+		try {
+			GatherContextInfo (ctx, context, version);
+		} catch (...) {
+			context.api->ReleaseContext (ctx);
+			throw;
+		}
 
-	clReleaseContext (ctx);
+		context.api->ReleaseContext (ctx);
+	}
 
 	return deviceNode;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-cliNode* GatherOpenCLInfo (Pool<>& pool)
+/**
+Gather a single platform and its devices. icd is the ICD the platform was
+enumerated from directly, if any.
+*/
+bool GatherPlatformInfo (const GatherContext& context,
+	const cl_platform_id platformId, const IcdPlatform* icd,
+	const int platformIndex, const int platformCount)
 {
-	auto rootNode = pool.Allocate <cliNode> ();
-	rootNode->name = "Platforms";
+	NodeScope platformScope (context.sink, "Platform");
+
+	PlatformEntry* platformEntry = nullptr;
+	if (context.platforms) {
+		context.platforms->emplace_back ();
+		platformEntry = &context.platforms->back ();
+		platformEntry->id = platformId;
+		platformEntry->node = platformScope.GetNode ();
+	}
 
-	cl_uint numPlatforms;
-	NIV_SAFE_CL(clGetPlatformIDs (0, NULL, &numPlatforms));
+	static const std::vector<PropertyFetcher<cl_platform_info>> infos = {
+		{ NIV_VALUESTRING (CL_PLATFORM_PROFILE), CreateChar, CLI_PropertyType_String},
+		{ NIV_VALUESTRING (CL_PLATFORM_VERSION), CreateChar, CLI_PropertyType_String},
+		{ NIV_VALUESTRING (CL_PLATFORM_NAME), CreateChar, CLI_PropertyType_String},
+		{ NIV_VALUESTRING (CL_PLATFORM_VENDOR), CreateChar, CLI_PropertyType_String},
+		{ NIV_VALUESTRING (CL_PLATFORM_EXTENSIONS), CreateCharList, CLI_PropertyType_String}
+	};
 
-	if (numPlatforms <= 0) {
-		std::cerr << "Failed to find any OpenCL platform." << std::endl;
-		return nullptr;
-	}
+	GetProperties (context, context.api->GetPlatformInfo, platformId, infos);
 
-	std::vector<cl_platform_id> platformIds (numPlatforms);
-	NIV_SAFE_CL(clGetPlatformIDs (numPlatforms, platformIds.data (), nullptr));
+	if (icd) {
+		auto& pool = context.pool;
 
-	cliNode* lastPlatformNode = nullptr;
-	for (const auto platformId : platformIds) {
-		auto platformNode = pool.Allocate <cliNode> ();
+		if (! icd->icdFile.empty () && context.Selects ("IcdFile")) {
+			auto property = pool.Allocate<cliProperty> ();
+			property->name = "IcdFile";
+			property->type = CLI_PropertyType_String;
+			property->hint = "The ICD file naming the library of the platform.";
+			property->value = CreateValue (pool, icd->icdFile.c_str ());
+			context.sink.Property (property);
+		}
 
-		if (rootNode->firstChild) {
-			lastPlatformNode->next = platformNode;
-			lastPlatformNode = lastPlatformNode->next;
-		} else {
-			rootNode->firstChild = platformNode;
-			lastPlatformNode = platformNode;
+		if (context.Selects ("IcdLibrary")) {
+			auto property = pool.Allocate<cliProperty> ();
+			property->name = "IcdLibrary";
+			property->type = CLI_PropertyType_String;
+			property->hint = "The library the platform was loaded from.";
+			property->value = CreateValue (pool, icd->library.c_str ());
+			context.sink.Property (property);
 		}
+	}
 
-		platformNode->name = "Platform";
+	context.Report (CLI_GatherEvent_Platform, platformScope.GetNode (),
+		platformIndex, platformCount);
 
-		static const std::vector<PropertyFetcher<cl_platform_info>> infos = {
-			{ NIV_VALUESTRING (CL_PLATFORM_PROFILE), CreateChar, CLI_PropertyType_String},
-			{ NIV_VALUESTRING (CL_PLATFORM_VERSION), CreateChar, CLI_PropertyType_String},
-			{ NIV_VALUESTRING (CL_PLATFORM_NAME), CreateChar, CLI_PropertyType_String},
-			{ NIV_VALUESTRING (CL_PLATFORM_VENDOR), CreateChar, CLI_PropertyType_String},
-			{ NIV_VALUESTRING (CL_PLATFORM_EXTENSIONS), CreateCharList, CLI_PropertyType_String}
-		};
+	const auto deviceTypes = context.filter
+		? context.filter->deviceTypes : CL_DEVICE_TYPE_ALL;
 
-		GetProperties (pool, platformNode, clGetPlatformInfo, platformId, infos);
+	// Not finding a device of the requested types is not an error
+	cl_uint numDevices = 0;
+	const auto error = context.api->GetDeviceIDs (platformId, deviceTypes,
+		0, nullptr, &numDevices);
 
-		cl_uint numDevices;
-		NIV_SAFE_CL (clGetDeviceIDs (platformId, CL_DEVICE_TYPE_ALL,
-			0, nullptr, &numDevices));
-		std::vector<cl_device_id> deviceIds (numDevices);
-		NIV_SAFE_CL (clGetDeviceIDs (platformId, CL_DEVICE_TYPE_ALL,
-			numDevices, deviceIds.data (), 0));
+	if (error == CL_DEVICE_NOT_FOUND) {
+		numDevices = 0;
+	} else if (error != CL_SUCCESS) {
+		std::cerr << "clGetDeviceIDs failed with error code " << error << "\n";
+		return false;
+	}
 
-		cliNode* last = nullptr;
+	std::vector<cl_device_id> deviceIds (numDevices);
+	if (numDevices > 0) {
+		NIV_SAFE_CL_RETURN (context.api->GetDeviceIDs (platformId, deviceTypes,
+			numDevices, deviceIds.data (), 0), false);
+	}
 
-		auto devicesNode = pool.Allocate <cliNode> ();
-		devicesNode->name = "Devices";
-		platformNode->firstChild = devicesNode;
+	NodeScope devicesScope (context.sink, "Devices");
 
-		for (const auto deviceId : deviceIds) {
-			auto deviceNode = GatherDeviceInfo (deviceId, pool);
+	const auto deviceCount = static_cast<int> (numDevices);
 
-			if (last) {
-				last->next = deviceNode;
-				last = last->next;
-			} else {
-				devicesNode->firstChild = deviceNode;
-				last = deviceNode;
-			}
+	for (int deviceIndex = 0; deviceIndex < deviceCount; ++deviceIndex) {
+		context.CheckCancelled ();
+
+		DeviceEntry deviceEntry;
+		auto deviceNode = GatherDeviceInfo (deviceIds [deviceIndex],
+			context, deviceEntry);
+
+		if (platformEntry) {
+			platformEntry->devices.push_back (std::move (deviceEntry));
 		}
+
+		context.Report (CLI_GatherEvent_Device, deviceNode,
+			platformIndex, platformCount, deviceIndex, deviceCount);
 	}
 
-	return rootNode;
-}
+	return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-struct cliInfo
+/**
+Enumerate the platforms, either through the ICD loader, or directly if
+context.libraries is set. In the latter case, icds is filled as well.
+*/
+bool GetPlatformIds (const GatherContext& context,
+	std::vector<cl_platform_id>& platformIds, std::vector<IcdPlatform>& icds)
 {
-	Pool<>			pool;
-	struct cliNode*	root = nullptr;
-};
+#ifndef _WIN32
+	if (context.libraries) {
+		icds = EnumerateIcdPlatforms (*context.libraries);
+
+		for (const auto& icd : icds) {
+			platformIds.push_back (icd.id);
+		}
+
+		if (context.recorder) {
+			context.recorder->AddPlatforms (platformIds);
+		}
+
+		return true;
+	}
+#endif
+
+	cl_uint numPlatforms;
+	NIV_SAFE_CL_RETURN (context.api->GetPlatformIDs (0, NULL, &numPlatforms),
+		false);
+
+	platformIds.resize (numPlatforms);
+	if (numPlatforms > 0) {
+		NIV_SAFE_CL_RETURN (context.api->GetPlatformIDs (numPlatforms,
+			platformIds.data (), nullptr), false);
+	}
+
+	return true;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
-int cliInfo_Create (cliInfo** info)
+bool GatherOpenCLInfo (const GatherContext& context)
 {
-	if (info == nullptr) {
-		return CLI_Error;
+	std::vector<cl_platform_id> platformIds;
+	std::vector<IcdPlatform> icds;
+
+	if (! GetPlatformIds (context, platformIds, icds)) {
+		return false;
 	}
 
-	*info = new cliInfo;
+	if (platformIds.empty ()) {
+		std::cerr << "Failed to find any OpenCL platform." << std::endl;
+		return false;
+	}
 
-	return CLI_Success;
+	const auto platformCount = static_cast<int> (platformIds.size ());
+
+	NodeScope rootScope (context.sink, "Platforms");
+
+	for (int platformIndex = 0; platformIndex < platformCount; ++platformIndex) {
+		context.CheckCancelled ();
+
+		if (! GatherPlatformInfo (context, platformIds [platformIndex],
+			icds.empty () ? nullptr : &icds [platformIndex],
+			platformIndex, platformCount)) {
+			return false;
+		}
+	}
+
+	return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-int cliInfo_Gather (cliInfo* info)
+/**
+Check whether the set of platforms and devices is still the one we gathered.
+
+Platforms enumerated directly from the ICDs cannot be enumerated again
+without reloading the libraries, so only their devices are compared.
+*/
+bool IsTopologyUnchanged (const ClApi& api,
+	const std::vector<PlatformEntry>& platforms,
+	const cl_device_type deviceTypes)
 {
-	if (info->root) {
-		return CLI_Error;
+	if (api.GetPlatformIDs) {
+		cl_uint numPlatforms;
+		if (api.GetPlatformIDs (0, nullptr, &numPlatforms) != CL_SUCCESS) {
+			return platforms.empty ();
+		}
+
+		if (numPlatforms != platforms.size ()) {
+			return false;
+		}
+
+		std::vector<cl_platform_id> platformIds (numPlatforms);
+		if (api.GetPlatformIDs (numPlatforms, platformIds.data (), nullptr) != CL_SUCCESS) {
+			return false;
+		}
+
+		for (std::size_t i = 0; i < platforms.size (); ++i) {
+			if (platformIds [i] != platforms [i].id) {
+				return false;
+			}
+		}
 	}
 
-	try {
-		info->root = GatherOpenCLInfo (info->pool);
-	} catch (const std::exception&) {
-		return CLI_Error;
+	std::vector<cl_device_id> deviceIds;
+	for (std::size_t i = 0; i < platforms.size (); ++i) {
+		const auto& platform = platforms [i];
+
+		cl_uint numDevices = 0;
+		const auto error = api.GetDeviceIDs (platform.id, deviceTypes,
+			0, nullptr, &numDevices);
+
+		if (error != CL_SUCCESS && error != CL_DEVICE_NOT_FOUND) {
+			return false;
+		}
+
+		if (numDevices != platform.devices.size ()) {
+			return false;
+		}
+
+		if (numDevices == 0) {
+			continue;
+		}
+
+		deviceIds.resize (numDevices);
+		if (api.GetDeviceIDs (platform.id, deviceTypes,
+			numDevices, deviceIds.data (), nullptr) != CL_SUCCESS) {
+			return false;
+		}
+
+		for (std::size_t j = 0; j < deviceIds.size (); ++j) {
+			if (deviceIds [j] != platform.devices [j].id) {
+				return false;
+			}
+		}
 	}
 
-	return CLI_Success;
+	return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-int cliInfo_GetRoot (const cliInfo* info, cliNode** root)
+/**
+Overwrite the values of a property with freshly queried ones. Returns true if
+any value changed.
+
+If the number of values stays the same, this happens in place. Otherwise, the
+new values are copied into the pool.
+*/
+bool UpdateValues (Pool& pool, cliProperty* property, const cliValue* fresh)
 {
-	if (info == nullptr) {
-		return CLI_Error;
-	}
+	auto v = property->value;
+	auto f = fresh;
 
-	if (info->root == nullptr) {
-		return CLI_Error;
+	while (v && f) {
+		v = v->next;
+		f = f->next;
 	}
 
-	if (root == nullptr) {
-		return CLI_Error;
+	if (v == nullptr && f == nullptr) {
+		bool changed = false;
+
+		for (v = property->value, f = fresh; v; v = v->next, f = f->next) {
+			switch (property->type) {
+			case CLI_PropertyType_Bool:
+				changed = changed || v->b != f->b;
+				v->b = f->b;
+				break;
+
+			case CLI_PropertyType_Int64:
+				changed = changed || v->i != f->i;
+				v->i = f->i;
+				break;
+
+			case CLI_PropertyType_String:
+				// Volatile properties are never strings
+				assert (false);
+				break;
+			}
+		}
+
+		return changed;
 	}
 
-	*root = info->root;
+	cliValue* last = nullptr;
+	property->value = nullptr;
 
-	return CLI_Success;
+	for (f = fresh; f; f = f->next) {
+		auto value = pool.Allocate<cliValue> ();
+		value->i = f->i;
+
+		if (last) {
+			last->next = value;
+			last = value;
+		} else {
+			property->value = value;
+			last = value;
+		}
+	}
+
+	return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-int cliInfo_Destroy (cliInfo* info)
-{
+/**
+Re-query all volatile properties, and record the ones which changed in
+changes.
+*/
+void RefreshVolatileProperties (const ClApi& api, Pool& pool, Pool& scratch,
+	const std::vector<PlatformEntry>& platforms,
+	std::vector<cliPropertyChange>& changes)
+{
+	changes.clear ();
+
+	for (std::size_t i = 0; i < platforms.size (); ++i) {
+		const auto& platform = platforms [i];
+
+		for (std::size_t j = 0; j < platform.devices.size (); ++j) {
+			const auto& device = platform.devices [j];
+
+			for (const auto& p : device.volatileProperties) {
+				if (UpdateValues (pool, p.property, GetValue (api.GetDeviceInfo,
+					device.id, p.info, scratch, p.cf))) {
+					cliPropertyChange change;
+					change.platformIndex = static_cast<int> (i);
+					change.deviceIndex = static_cast<int> (j);
+					change.device = device.node;
+					change.property = p.property;
+
+					changes.push_back (change);
+				}
+			}
+		}
+	}
+
+	scratch.Reset ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Record all volatile properties of a freshly gathered tree in changes, so
+cliInfo_GetChanges reports their initial values.
+*/
+void ListVolatileProperties (const cliNode* root,
+	std::vector<cliPropertyChange>& changes)
+{
+	changes.clear ();
+
+	cliPropertyChange change;
+	change.platformIndex = 0;
+
+	for (auto platform = root->firstChild; platform;
+		platform = platform->next, ++change.platformIndex) {
+		for (auto devices = platform->firstChild; devices;
+			devices = devices->next) {
+			if (::strcmp (devices->name, "Devices") != 0) {
+				continue;
+			}
+
+			change.deviceIndex = 0;
+
+			for (auto device = devices->firstChild; device;
+				device = device->next, ++change.deviceIndex) {
+				change.device = device;
+
+				for (auto p = device->firstProperty; p; p = p->next) {
+					for (const auto& info : infos_Volatile) {
+						if (::strcmp (p->name, info.n) == 0) {
+							change.property = p;
+							changes.push_back (change);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+#ifndef _WIN32
+/**
+Shared between the parent and a child process gathering a single platform.
+The child allocates the tree from the memory following this header. The
+mapping is created before forking, so it is at the same address in both
+processes, and the pointers written by the child are valid in the parent as
+well. Strings which are not allocated from the pool, like property names, are
+part of the executable image, which is also at the same address.
+*/
+struct IsolatedPlatform
+{
+	enum Status
+	{
+		Status_Running,
+		Status_Succeeded,
+		Status_Failed
+	};
+
+	// -1 until the child has enumerated the platforms
+	std::atomic<int>	platformCount;
+	std::atomic<int>	status;
+
+	// The platform node is linked in as the first child
+	cliNode				parent;
+};
+
+// Address space only, pages are committed when the child touches them
+const std::size_t IsolatedRegionSize = 256 << 20;
+
+struct IsolatedChild
+{
+	pid_t					pid;
+	std::shared_ptr<void>	region;
+
+	int		waitStatus = 0;
+	bool	timedOut = false;
+
+	IsolatedPlatform* GetShared () const
+	{
+		return static_cast<IsolatedPlatform*> (region.get ());
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<void> CreateSharedRegion (const std::size_t size)
+{
+	auto region = ::mmap (nullptr, size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (region == MAP_FAILED) {
+		throw std::bad_alloc ();
+	}
+
+	return std::shared_ptr<void> (region, [size] (void* p) -> void {
+		::munmap (p, size);
+	});
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Entry point of the child process. Gathers one platform into the shared region
+and exits without running any destructors or atexit handlers of the parent.
+*/
+void RunIsolatedPlatform (IsolatedPlatform* shared, const int platformIndex,
+	const GatherFilter& filter, const bool directIcd)
+{
+	int status = IsolatedPlatform::Status_Failed;
+
+	try {
+		Pool pool (shared + 1, IsolatedRegionSize - sizeof (IsolatedPlatform));
+		TreeSink sink (pool, &shared->parent);
+		GatherContext context (pool, sink, nullptr);
+		context.filter = &filter;
+
+		// Never unloaded, the process exits right after the gather
+		std::vector<std::shared_ptr<void>> libraries;
+		if (directIcd) {
+			context.api = &GetDispatchApi ();
+			context.libraries = &libraries;
+		}
+
+		std::vector<cl_platform_id> platformIds;
+		std::vector<IcdPlatform> icds;
+		if (! GetPlatformIds (context, platformIds, icds)) {
+			platformIds.clear ();
+		}
+
+		const auto platformCount = static_cast<int> (platformIds.size ());
+		shared->platformCount = platformCount;
+
+		if (platformIndex < platformCount) {
+			if (GatherPlatformInfo (context, platformIds [platformIndex],
+				icds.empty () ? nullptr : &icds [platformIndex],
+				platformIndex, platformCount)) {
+				status = IsolatedPlatform::Status_Succeeded;
+			}
+		}
+	} catch (...) {
+	}
+
+	shared->status = status;
+
+	std::cerr.flush ();
+	::_exit (0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+IsolatedChild StartIsolatedPlatform (const int platformIndex,
+	const GatherFilter& filter, const bool directIcd)
+{
+	IsolatedChild child;
+	child.region = CreateSharedRegion (IsolatedRegionSize);
+
+	auto shared = new (child.region.get ()) IsolatedPlatform;
+	shared->platformCount = -1;
+	shared->status = IsolatedPlatform::Status_Running;
+
+	// Anything still buffered would be written twice otherwise
+	std::cout.flush ();
+	std::cerr.flush ();
+
+	child.pid = ::fork ();
+
+	if (child.pid == 0) {
+		RunIsolatedPlatform (shared, platformIndex, filter, directIcd);
+	} else if (child.pid < 0) {
+		throw std::runtime_error ("Could not create a process");
+	}
+
+	return child;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Wait until all children have exited, or done returns true. Children are killed
+if the timeout passes or cancellation is requested; GatherCancelled is thrown
+in the latter case once they have been reaped.
+*/
+void WaitForChildren (std::vector<IsolatedChild>& children,
+	const std::chrono::steady_clock::time_point* deadline,
+	const std::atomic<bool>* cancel,
+	const std::function<bool ()>& done = nullptr)
+{
+	bool killed = false;
+
+	for (;;) {
+		bool running = false;
+
+		for (auto& child : children) {
+			if (child.pid <= 0) {
+				continue;
+			}
+
+			int status = 0;
+			const auto r = ::waitpid (child.pid, &status, WNOHANG);
+
+			if (r == child.pid) {
+				child.waitStatus = status;
+				child.pid = 0;
+			} else if (r < 0 && errno != EINTR) {
+				child.pid = 0;
+			} else {
+				running = true;
+			}
+		}
+
+		if (! running) {
+			break;
+		}
+
+		if (done && done ()) {
+			return;
+		}
+
+		const bool cancelled = cancel && cancel->load ();
+
+		if (! killed && (cancelled ||
+			(deadline && std::chrono::steady_clock::now () >= *deadline))) {
+			for (auto& child : children) {
+				if (child.pid > 0) {
+					::kill (child.pid, SIGKILL);
+					child.timedOut = ! cancelled;
+				}
+			}
+
+			killed = true;
+		}
+
+		std::this_thread::sleep_for (std::chrono::milliseconds (1));
+	}
+
+	if (cancel && cancel->load ()) {
+		throw GatherCancelled ();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const char* SignalToString (const int signal)
+{
+	switch (signal) {
+	case SIGSEGV: return "SIGSEGV";
+	case SIGBUS: return "SIGBUS";
+	case SIGILL: return "SIGILL";
+	case SIGFPE: return "SIGFPE";
+	case SIGABRT: return "SIGABRT";
+	case SIGKILL: return "SIGKILL";
+	case SIGTERM: return "SIGTERM";
+	case SIGTRAP: return "SIGTRAP";
+	case SIGSYS: return "SIGSYS";
+	default: return "Unknown signal";
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void AppendProperty (Pool& pool, cliNode* node, const char* name,
+	const cliPropertyType type, const T value)
+{
+	auto property = pool.Allocate<cliProperty> ();
+	property->name = name;
+	property->type = type;
+	property->value = CreateValue (pool, value);
+
+	auto last = &node->firstProperty;
+	while (*last) {
+		last = &(*last)->next;
+	}
+
+	*last = property;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Take over the platform node gathered by a child, and record how the child
+terminated if it did not succeed.
+*/
+cliNode* MergeIsolatedPlatform (Pool& pool, const IsolatedChild& child)
+{
+	const auto shared = child.GetShared ();
+	auto node = shared->parent.firstChild;
+
+	if (node == nullptr) {
+		node = pool.Allocate<cliNode> ();
+		node->name = "Platform";
+	}
+
+	if (child.timedOut) {
+		AppendProperty (pool, node, "GatherStatus", CLI_PropertyType_String,
+			"Timeout");
+	} else if (WIFSIGNALED (child.waitStatus)) {
+		const auto signal = WTERMSIG (child.waitStatus);
+
+		AppendProperty (pool, node, "GatherStatus", CLI_PropertyType_String,
+			"Crashed");
+		AppendProperty (pool, node, "Signal", CLI_PropertyType_Int64,
+			static_cast<std::int64_t> (signal));
+		AppendProperty (pool, node, "SignalName", CLI_PropertyType_String,
+			SignalToString (signal));
+	} else if (shared->status != IsolatedPlatform::Status_Succeeded) {
+		AppendProperty (pool, node, "GatherStatus", CLI_PropertyType_String,
+			"Failed");
+	}
+
+	return node;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Gather every platform in its own process. The first process also enumerates
+the platforms; as soon as it has done so, the remaining platforms are started
+in parallel.
+
+Returns the root node, or nullptr if there are no platforms.
+*/
+cliNode* GatherIsolated (cliInfo* info,
+	const std::function<void (const cliGatherProgress&)>& progress)
+{
+	std::chrono::steady_clock::time_point deadline;
+	if (info->timeout > 0) {
+		deadline = std::chrono::steady_clock::now () +
+			std::chrono::milliseconds (info->timeout);
+	}
+
+	const auto deadlinePointer = info->timeout > 0 ? &deadline : nullptr;
+
+	const bool directIcd = (info->flags & CLI_GatherFlag_DirectIcd) != 0;
+
+	std::vector<IsolatedChild> children;
+	children.push_back (StartIsolatedPlatform (0, info->filter, directIcd));
+
+	const auto first = children.front ().GetShared ();
+	WaitForChildren (children, deadlinePointer, &info->cancel,
+		[first] () -> bool {
+			return first->platformCount >= 0;
+		});
+
+	// If the first process died while enumerating, there is nothing more to
+	// learn from starting the others; still record its fate
+	const auto platformCount = std::max<int> (first->platformCount, 1);
+
+	for (int i = 1; i < platformCount; ++i) {
+		children.push_back (StartIsolatedPlatform (i, info->filter, directIcd));
+	}
+
+	WaitForChildren (children, deadlinePointer, &info->cancel);
+
+	if (first->platformCount == 0) {
+		std::cerr << "Failed to find any OpenCL platform." << std::endl;
+		return nullptr;
+	}
+
+	auto root = info->pool.Allocate<cliNode> ();
+	root->name = "Platforms";
+
+	cliNode* last = nullptr;
+	for (int i = 0; i < platformCount; ++i) {
+		auto node = MergeIsolatedPlatform (info->pool, children [i]);
+		info->regions.push_back (children [i].region);
+
+		if (last) {
+			last->next = node;
+		} else {
+			root->firstChild = node;
+		}
+
+		last = node;
+
+		if (progress) {
+			cliGatherProgress p;
+			p.event = CLI_GatherEvent_Platform;
+			p.node = node;
+			p.platformIndex = i;
+			p.platformCount = platformCount;
+			p.deviceIndex = -1;
+			p.deviceCount = 0;
+
+			progress (p);
+		}
+	}
+
+	return root;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Gather the platforms on several threads, each of which allocates from its own
+pool in info->pools, and link them into one tree. The tree and info->platforms
+are in the same order as for a sequential gather. Returns the root, or nullptr
+if the gather failed.
+*/
+cliNode* GatherParallel (cliInfo* info, const GatherContext& context)
+{
+	std::vector<cl_platform_id> platformIds;
+	std::vector<IcdPlatform> icds;
+
+	if (! GetPlatformIds (context, platformIds, icds)) {
+		return nullptr;
+	}
+
+	if (platformIds.empty ()) {
+		std::cerr << "Failed to find any OpenCL platform." << std::endl;
+		return nullptr;
+	}
+
+	const auto platformCount = static_cast<int> (platformIds.size ());
+
+	/**
+	The result of gathering one platform.
+	*/
+	struct Slot
+	{
+		cliNode*					node = nullptr;
+		std::vector<PlatformEntry>	entries;
+		bool						succeeded = false;
+		std::exception_ptr			error;
+	};
+
+	std::vector<Slot> slots (platformCount);
+
+	// Most of the time is spent waiting for the driver, so use more threads
+	// than there are cores
+	const auto threadCount = std::min (platformCount,
+		static_cast<int> (std::max (4u, std::thread::hardware_concurrency ())));
+
+	// The callback is not required to be reentrant
+	std::mutex progressMutex;
+	std::function<void (const cliGatherProgress&)> progress;
+	if (context.progress) {
+		progress = [&] (const cliGatherProgress& p) -> void {
+			std::lock_guard<std::mutex> lock (progressMutex);
+			context.progress (p);
+		};
+	}
+
+	std::atomic<int> nextPlatform {0};
+
+	const auto worker = [&] (Pool& pool) -> void {
+		for (;;) {
+			const int platformIndex = nextPlatform++;
+			if (platformIndex >= platformCount) {
+				return;
+			}
+
+			auto& slot = slots [platformIndex];
+
+			try {
+				TreeSink sink (pool);
+				GatherContext platformContext (pool, sink, &slot.entries);
+				platformContext.cancel = context.cancel;
+				platformContext.progress = progress;
+				platformContext.filter = context.filter;
+				platformContext.api = context.api;
+
+				slot.succeeded = GatherPlatformInfo (platformContext,
+					platformIds [platformIndex],
+					icds.empty () ? nullptr : &icds [platformIndex],
+					platformIndex, platformCount);
+				slot.node = sink.GetRoot ();
+			} catch (...) {
+				slot.error = std::current_exception ();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+
+	try {
+		for (int i = 0; i < threadCount; ++i) {
+			info->pools.emplace_back (new Pool);
+			threads.emplace_back (worker, std::ref (*info->pools.back ()));
+		}
+	} catch (...) {
+		// Let the threads which did start finish their current platform
+		nextPlatform = platformCount;
+
+		for (auto& thread : threads) {
+			thread.join ();
+		}
+
+		throw;
+	}
+
+	for (auto& thread : threads) {
+		thread.join ();
+	}
+
+	for (const auto& slot : slots) {
+		if (slot.error) {
+			std::rethrow_exception (slot.error);
+		}
+	}
+
+	for (const auto& slot : slots) {
+		if (! slot.succeeded) {
+			return nullptr;
+		}
+	}
+
+	auto root = info->pool.Allocate<cliNode> ();
+	root->name = "Platforms";
+
+	cliNode* last = nullptr;
+	for (auto& slot : slots) {
+		if (last) {
+			last->next = slot.node;
+		} else {
+			root->firstChild = slot.node;
+		}
+
+		last = slot.node;
+
+		for (auto& entry : slot.entries) {
+			info->platforms.push_back (std::move (entry));
+		}
+	}
+
+	return root;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Gather a tree into the pool of info, and set the root on success.
+
+The pool is reset if the gather fails.
+*/
+void GatherTree (cliInfo* info,
+	const std::function<void (const cliGatherProgress&)>& progress)
+{
+	TreeSink sink (info->pool);
+	GatherContext context (info->pool, sink, &info->platforms);
+	context.cancel = &info->cancel;
+	context.filter = &info->filter;
+	context.progress = progress;
+	context.api = info->api;
+
+	if (info->flags & CLI_GatherFlag_DirectIcd) {
+		context.libraries = &info->libraries;
+	}
+
+	std::unique_ptr<Recorder> recorder;
+	const auto recordFile = info->recordFile;
+	info->recordFile.clear ();
+
+	if (! recordFile.empty ()) {
+		recorder.reset (new Recorder (*context.api));
+		context.api = &recorder->GetApi ();
+		context.recorder = recorder.get ();
+	}
+
+	try {
+#ifndef _WIN32
+		if (info->flags & CLI_GatherFlag_Isolate) {
+			info->root = GatherIsolated (info, progress);
+		} else
+#endif
+		if (info->flags & CLI_GatherFlag_Parallel) {
+			info->root = GatherParallel (info, context);
+		} else if (GatherOpenCLInfo (context)) {
+			info->root = sink.GetRoot ();
+		}
+
+		if (recorder && ! recorder->Save (recordFile.c_str ())) {
+			std::cerr << "Could not write the recording '" << recordFile
+				<< "'" << std::endl;
+			info->root = nullptr;
+		}
+	} catch (...) {
+		// The calls up to a failure are the interesting ones
+		if (recorder) {
+			recorder->Save (recordFile.c_str ());
+		}
+
+		info->platforms.clear ();
+		info->regions.clear ();
+		info->pools.clear ();
+		info->libraries.clear ();
+		info->pool.Reset ();
+		throw;
+	}
+
+	if (info->root == nullptr) {
+		info->platforms.clear ();
+		info->regions.clear ();
+		info->pools.clear ();
+		info->libraries.clear ();
+		info->pool.Reset ();
+	} else {
+		ListVolatileProperties (info->root, info->changes);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Store the options in info for the next gather. Returns false if they are not
+supported.
+*/
+bool SetGatherOptions (cliInfo* info, const cliGatherOptions* options)
+{
+	info->flags = options ? options->flags : 0;
+	info->timeout = options ? options->timeout : 0;
+	info->filter = CreateGatherFilter (options);
+	info->api = (info->flags & CLI_GatherFlag_DirectIcd)
+		? &GetDispatchApi () : &GetLoaderApi ();
+	info->recordFile = (options && options->recordFile) ? options->recordFile : "";
+
+	// The calls are made in the child processes
+	if ((info->flags & CLI_GatherFlag_Isolate) && ! info->recordFile.empty ()) {
+		return false;
+	}
+
+#ifdef _WIN32
+	if (info->flags & (CLI_GatherFlag_Isolate | CLI_GatherFlag_DirectIcd)) {
+		return false;
+	}
+#endif
+
+	return true;
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_Create (cliInfo** info)
+{
+	if (info == nullptr) {
+		return CLI_Error;
+	}
+
+	*info = new cliInfo;
+
+	return CLI_Success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_Gather (cliInfo* info)
+{
+	return cliInfo_GatherWithOptions (info, nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_GatherWithOptions (cliInfo* info, const cliGatherOptions* options)
+{
+	if (info->root || info->busy) {
+		return CLI_Error;
+	}
+
+	if (! SetGatherOptions (info, options)) {
+		return CLI_Error;
+	}
+
+	info->cancel = false;
+
+	try {
+		GatherTree (info, nullptr);
+	} catch (const std::exception&) {
+		return CLI_Error;
+	}
+
+	return CLI_Success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_GatherStream (const cliGatherOptions* options,
+	const cliStreamCallbacks* callbacks, void* userdata)
+{
+	if (callbacks == nullptr) {
+		return CLI_Error;
+	}
+
+	if (options && (options->flags & CLI_GatherFlag_Isolate)) {
+		return CLI_Error;
+	}
+
+#ifdef _WIN32
+	if (options && (options->flags & CLI_GatherFlag_DirectIcd)) {
+		return CLI_Error;
+	}
+#endif
+
+	// Values are only needed until the property callback returns, so a small
+	// scratch pool is enough regardless of the number of devices
+	Pool scratch (65536);
+	StreamSink sink (scratch, *callbacks, userdata);
+	GatherContext context (scratch, sink, nullptr);
+
+	const auto filter = CreateGatherFilter (options);
+	context.filter = &filter;
+
+	std::vector<std::shared_ptr<void>> libraries;
+	if (options && (options->flags & CLI_GatherFlag_DirectIcd)) {
+		context.api = &GetDispatchApi ();
+		context.libraries = &libraries;
+	}
+
+	try {
+		std::unique_ptr<Recorder> recorder;
+		if (options && options->recordFile) {
+			recorder.reset (new Recorder (*context.api));
+			context.api = &recorder->GetApi ();
+			context.recorder = recorder.get ();
+		}
+
+		auto result = GatherOpenCLInfo (context);
+
+		if (recorder && ! recorder->Save (options->recordFile)) {
+			result = false;
+		}
+
+		return result ? CLI_Success : CLI_Error;
+	} catch (const std::exception&) {
+		return CLI_Error;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_GatherAsync (cliInfo* info, const cliGatherOptions* options,
+	cliGatherCallback callback, void* userdata)
+{
+	if (info == nullptr || callback == nullptr) {
+		return CLI_Error;
+	}
+
+	if (info->root || info->busy) {
+		return CLI_Error;
+	}
+
+	// A previous gather may have been cancelled or failed; its worker has
+	// finished already, but must be joined before we can start a new one.
+	// When called from its final callback, the worker does not touch info
+	// anymore, and is left to finish on its own
+	if (info->worker.joinable ()) {
+		if (info->worker.get_id () == std::this_thread::get_id ()) {
+			info->worker.detach ();
+		} else {
+			info->worker.join ();
+		}
+	}
+
+	if (! SetGatherOptions (info, options)) {
+		return CLI_Error;
+	}
+
+	const int flags = info->flags;
+
+	info->cancel = false;
+	info->busy = true;
+
+	try {
+		info->worker = std::thread ([=] () -> void {
+			std::function<void (const cliGatherProgress&)> progress;
+
+			if (flags & CLI_GatherFlag_ReportProgress) {
+				progress = [=] (const cliGatherProgress& p) -> void {
+					callback (info, &p, userdata);
+				};
+			}
+
+			cliGatherProgress result;
+			result.event = CLI_GatherEvent_Failed;
+			result.node = nullptr;
+			result.platformIndex = -1;
+			result.deviceIndex = -1;
+			result.deviceCount = 0;
+
+			try {
+				GatherTree (info, progress);
+
+				if (info->root) {
+					result.event = CLI_GatherEvent_Completed;
+					result.node = info->root;
+				}
+			} catch (const GatherCancelled&) {
+				result.event = CLI_GatherEvent_Cancelled;
+			} catch (const std::exception&) {
+				result.event = CLI_GatherEvent_Failed;
+			}
+
+			// Isolated gathers do not fill info->platforms, so count the
+			// nodes instead
+			result.platformCount = 0;
+			if (info->root) {
+				for (auto p = info->root->firstChild; p; p = p->next) {
+					++result.platformCount;
+				}
+			}
+
+			// Cleared first, so the gather can be started again from the
+			// callback, or from a thread it wakes up
+			info->busy = false;
+
+			callback (info, &result, userdata);
+		});
+	} catch (const std::exception&) {
+		info->busy = false;
+		return CLI_Error;
+	}
+
+	return CLI_Success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_Cancel (cliInfo* info)
+{
+	if (info == nullptr) {
+		return CLI_Error;
+	}
+
+	info->cancel = true;
+
+	return CLI_Success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_Wait (cliInfo* info)
+{
+	if (info == nullptr) {
+		return CLI_Error;
+	}
+
+	if (info->worker.joinable ()) {
+		if (info->worker.get_id () == std::this_thread::get_id ()) {
+			return CLI_Error;
+		}
+
+		info->worker.join ();
+	}
+
+	return CLI_Success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_Refresh (cliInfo* info, int* topologyChanged)
+{
+	if (info == nullptr) {
+		return CLI_Error;
+	}
+
+	if (info->root == nullptr) {
+		return CLI_Error;
+	}
+
+	if (info->busy || info->loaded) {
+		return CLI_Error;
+	}
+
+	try {
+		if (! (info->flags & CLI_GatherFlag_Isolate) &&
+			IsTopologyUnchanged (*info->api, info->platforms,
+				info->filter.deviceTypes)) {
+			RefreshVolatileProperties (*info->api, info->pool, info->scratch,
+				info->platforms, info->changes);
+
+			if (topologyChanged) {
+				*topologyChanged = 0;
+			}
+		} else {
+			info->root = nullptr;
+			info->platforms.clear ();
+			info->regions.clear ();
+			info->pools.clear ();
+			info->libraries.clear ();
+			info->changes.clear ();
+			info->pool.Reset ();
+
+			info->cancel = false;
+			GatherTree (info, nullptr);
+
+			if (topologyChanged) {
+				*topologyChanged = 1;
+			}
+		}
+	} catch (const std::exception&) {
+		return CLI_Error;
+	}
+
+	return info->root ? CLI_Success : CLI_Error;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_GetChanges (const cliInfo* info,
+	const cliPropertyChange** changes, int* count)
+{
+	if (info == nullptr || changes == nullptr || count == nullptr) {
+		return CLI_Error;
+	}
+
+	if (info->root == nullptr) {
+		return CLI_Error;
+	}
+
+	*changes = info->changes.data ();
+	*count = static_cast<int> (info->changes.size ());
+
+	return CLI_Success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_GetVolatileProperties (const char* const** properties, int* count)
+{
+	if (properties == nullptr || count == nullptr) {
+		return CLI_Error;
+	}
+
+	static const auto names = [] () -> std::vector<const char*> {
+		std::vector<const char*> result;
+		for (const auto& info : infos_Volatile) {
+			result.push_back (info.n);
+		}
+
+		return result;
+	} ();
+
+	*properties = names.data ();
+	*count = static_cast<int> (names.size ());
+
+	return CLI_Success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_GetRoot (const cliInfo* info, cliNode** root)
+{
+	if (info == nullptr) {
+		return CLI_Error;
+	}
+
+	if (info->root == nullptr) {
+		return CLI_Error;
+	}
+
+	if (root == nullptr) {
+		return CLI_Error;
+	}
+
+	*root = info->root;
+
+	return CLI_Success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_GetStatistics (const cliInfo* info, cliStatistics* statistics)
+{
+	if (info == nullptr || statistics == nullptr) {
+		return CLI_Error;
+	}
+
+	std::size_t allocations = info->pool.GetAllocations ();
+	std::size_t bytesAllocated = info->pool.GetBytesAllocated ();
+	std::size_t bytesReserved = info->pool.GetBytesReserved ();
+
+	for (const auto& pool : info->pools) {
+		allocations += pool->GetAllocations ();
+		bytesAllocated += pool->GetBytesAllocated ();
+		bytesReserved += pool->GetBytesReserved ();
+	}
+
+	statistics->allocations = static_cast<int64_t> (allocations);
+	statistics->bytesAllocated = static_cast<int64_t> (bytesAllocated);
+	statistics->bytesReserved = static_cast<int64_t> (bytesReserved);
+
+	return CLI_Success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_Destroy (cliInfo* info)
+{
+	if (info == nullptr) {
+		return CLI_Error;
+	}
+
+	if (info->worker.joinable ()) {
+		// Destroying from within the completion callback would deadlock
+		if (info->worker.get_id () == std::this_thread::get_id ()) {
+			return CLI_Error;
+		}
+
+		info->cancel = true;
+		info->worker.join ();
+	}
+
 	delete info;
 
 	return CLI_Success;
@@ -74,7 +74,187 @@ enum cliStatus
 	CLI_Error
 };
 
+enum cliGatherFlags
+{
+	/**
+	Invoke the callback passed to cliInfo_GatherAsync for every platform and
+	device, not only once the gather has finished.
+	*/
+	CLI_GatherFlag_ReportProgress = 1,
+
+	/**
+	Gather each platform in a separate child process, so a driver crashing
+	or hanging inside the OpenCL API cannot take down the caller. Only
+	CLI_GatherEvent_Platform is reported in this mode, once the platform has
+	been gathered completely. Not supported on Windows.
+
+	If the process of a platform does not finish successfully, its platform
+	node holds whatever was gathered up to that point, plus a 'GatherStatus'
+	property which is one of "Crashed", "Failed" or "Timeout". For crashes,
+	the 'Signal' and 'SignalName' properties hold the signal which terminated
+	the process.
+	*/
+	CLI_GatherFlag_Isolate = 2,
+
+	/**
+	Do not create a context per device to query the supported image formats.
+	The devices have no 'ImageFormats' node in this case.
+	*/
+	CLI_GatherFlag_SkipImageFormats = 4,
+
+	/**
+	Add a 'Derived' node to every device, with one 'Metric' child per figure
+	computed from the raw properties, like the estimated peak throughput.
+	The kind of a metric is its name, and it has these properties:
+
+	- Value: the figure as an integer, in Unit
+	- Unit: for instance "MFLOP/s" or "percent"
+	- Formula: how Value was computed from the device properties
+	- Estimate: true if Value is a rough upper bound rather than exact
+
+	Vendor properties like CL_DEVICE_WAVEFRONT_WIDTH_AMD or
+	CL_DEVICE_WARP_SIZE_NV refine the figures where they are available.
+	Metrics whose inputs cannot be queried are left out. The properties the
+	metrics need are queried even if options->properties does not select
+	them. The metrics are computed once, and not updated by cliInfo_Refresh.
+	*/
+	CLI_GatherFlag_Derived = 8,
+
+	/**
+	Do not use the OpenCL ICD loader, which initializes every vendor driver
+	one after the other before returning the first platform. Instead, find
+	the vendor ICDs like the loader does, load them in parallel, and get
+	their platforms through clIcdGetPlatformIDsKHR. A driver which fails to
+	load is skipped.
+
+	The ICDs are the libraries listed in OCL_ICD_FILENAMES, or else named by
+	the .icd files in OCL_ICD_VENDORS, or else in /etc/OpenCL/vendors. Every
+	platform gets an 'IcdLibrary' property with the library it was loaded
+	from, and unless it came from OCL_ICD_FILENAMES, an 'IcdFile' property
+	with the .icd file naming it. Not supported on Windows.
+	*/
+	CLI_GatherFlag_DirectIcd = 16,
+
+	/**
+	Gather the platforms on several threads at once, which is faster if
+	there are several platforms and their drivers are slow to respond. The
+	result is the same as for a sequential gather. With
+	CLI_GatherFlag_ReportProgress, the callback may be invoked from any of
+	these threads, but never concurrently. Ignored by cliInfo_GatherStream
+	and with CLI_GatherFlag_Isolate, which gathers the platforms in parallel
+	already.
+	*/
+	CLI_GatherFlag_Parallel = 32
+};
+
+/**
+Options for a gather. A zero-initialized structure selects the default
+behavior.
+*/
+struct cliGatherOptions
+{
+	/* Combination of cliGatherFlags */
+	int	flags;
+
+	/*
+	With CLI_GatherFlag_Isolate, the time in milliseconds after which the
+	processes still running are killed, and their platforms are reported as
+	"Timeout". 0 waits indefinitely.
+	*/
+	int	timeout;
+
+	/*
+	If not null, a null-terminated list of the names of the platform and
+	device properties to gather. All other properties are skipped, which
+	saves the driver calls to query them. The platform and device nodes are
+	still created.
+	*/
+	const char* const*	properties;
+
+	/*
+	Combination of CL_DEVICE_TYPE_* bits. If not 0, only devices of these
+	types are gathered.
+	*/
+	uint64_t	deviceTypes;
+
+	/*
+	If not null, every platform, device and image format query of the gather
+	is recorded to this file, with the exact bytes the driver returned and
+	the time each call took. The FakeOpenCL implementation in tools replays
+	such a file in place of a driver. The file is written even if the gather
+	fails, and if it cannot be written, the gather fails. Only the gather
+	itself is recorded, not cliInfo_Refresh. Not supported with
+	CLI_GatherFlag_Isolate.
+	*/
+	const char*	recordFile;
+};
+
+enum cliGatherEvent
+{
+	/* The properties of a platform have been gathered */
+	CLI_GatherEvent_Platform,
+	/* A device has been gathered completely */
+	CLI_GatherEvent_Device,
+
+	/* The gather finished, node is the root of the tree */
+	CLI_GatherEvent_Completed,
+	CLI_GatherEvent_Cancelled,
+	CLI_GatherEvent_Failed
+};
+
+/**
+Describes the progress of an asynchronous gather.
+
+For CLI_GatherEvent_Platform and CLI_GatherEvent_Device, node is the platform
+or device node which was just filled in. The rest of the tree is still being
+modified at this point, so only this node and its descendants may be
+inspected. deviceIndex is -1 for platform events.
+*/
+struct cliGatherProgress
+{
+	enum cliGatherEvent		event;
+	const struct cliNode*	node;
+
+	int	platformIndex;
+	int	platformCount;
+	int	deviceIndex;
+	int	deviceCount;
+};
+
 struct cliInfo;
+
+typedef void (*cliGatherCallback) (struct cliInfo* info,
+	const struct cliGatherProgress* progress, void* userdata);
+
+/**
+Callbacks for cliInfo_GatherStream. Any of them may be null.
+
+Nodes are reported in depth-first order: beginNode, followed by the properties
+of the node, followed by its children, followed by endNode. The name and kind
+strings remain valid, but the property passed to the property callback
+including its values is only valid until the callback returns.
+*/
+struct cliStreamCallbacks
+{
+	void (*beginNode) (const char* name, const char* kind, void* userdata);
+	void (*property) (const struct cliProperty* property, void* userdata);
+	void (*endNode) (void* userdata);
+};
+
+/**
+A property which was changed by cliInfo_Refresh. device is the device node
+holding the property, which is the deviceIndex-th device of the
+platformIndex-th platform.
+*/
+struct cliPropertyChange
+{
+	int	platformIndex;
+	int	deviceIndex;
+
+	const struct cliNode*		device;
+	const struct cliProperty*	property;
+};
+
 /*
 These functions return CLI_Success if everything worked fine.
 */
@@ -96,6 +276,149 @@ tree.
 */
 int cliInfo_Gather (struct cliInfo* info);
 
+/**
+Same as cliInfo_Gather, with options. options may be null.
+*/
+int cliInfo_GatherWithOptions (struct cliInfo* info,
+	const struct cliGatherOptions* options);
+
+/**
+Gather the OpenCL information on a worker thread owned by the library.
+
+Returns immediately. The callback is invoked from the worker thread exactly
+once with one of CLI_GatherEvent_Completed, CLI_GatherEvent_Cancelled or
+CLI_GatherEvent_Failed, and additionally for each platform and device if
+CLI_GatherFlag_ReportProgress is set. options may be null.
+
+Once the final callback has been invoked, GetRoot() can be used. If the gather
+was cancelled or failed, it may be started again, also from within the final
+callback. No other function except cliInfo_Cancel and cliInfo_Wait must be
+called on this object while the gather is running.
+*/
+int cliInfo_GatherAsync (struct cliInfo* info,
+	const struct cliGatherOptions* options,
+	cliGatherCallback callback, void* userdata);
+
+/**
+Gather the OpenCL information without building a tree.
+
+The callbacks are invoked as the values are returned by the driver. Memory use
+is constant, independent of the number of platforms and devices. No cliInfo
+object is required. options may be null; CLI_GatherFlag_Isolate is not
+supported.
+*/
+int cliInfo_GatherStream (const struct cliGatherOptions* options,
+	const struct cliStreamCallbacks* callbacks, void* userdata);
+
+/**
+Request cancellation of a running gather.
+
+The gather stops before the next driver call. It is safe to call this from any
+thread. A blocking driver call cannot be interrupted, so the final callback may
+still take a while.
+*/
+int cliInfo_Cancel (struct cliInfo* info);
+
+/**
+Block until a gather started with cliInfo_GatherAsync has finished.
+
+Must not be called from the callback.
+*/
+int cliInfo_Wait (struct cliInfo* info);
+
+/**
+Refresh the dynamic properties of already gathered information.
+
+This re-queries only properties which can change at run-time, like
+CL_DEVICE_AVAILABLE, CL_DEVICE_MAX_CLOCK_FREQUENCY and vendor specific free
+memory counters, and updates them in place. Nodes and properties obtained
+earlier remain valid.
+
+If platforms or devices were added or removed since the last call, the whole
+tree is gathered again, reusing the memory of the previous one. In this case,
+all nodes/properties obtained previously become invalid, and GetRoot() must be
+called again. topologyChanged is set to 1 if this happened, and 0 otherwise.
+It may be null. Information gathered with CLI_GatherFlag_Isolate is always
+gathered again, as the driver must not be called from this process.
+
+Must be called after a successful Gather().
+*/
+int cliInfo_Refresh (struct cliInfo* info, int* topologyChanged);
+
+/**
+Get the properties whose values were changed by the last call to
+cliInfo_Refresh, in tree order. changes points to count entries, and remains
+valid until the next call to cliInfo_Refresh. After a gather, and after a
+refresh which gathered the tree again because the topology changed, all
+properties which can be refreshed are listed with their initial values.
+*/
+int cliInfo_GetChanges (const struct cliInfo* info,
+	const struct cliPropertyChange** changes, int* count);
+
+/**
+Get the names of the device properties which cliInfo_Refresh re-queries.
+properties points to count names, which remain valid for the lifetime of the
+program. This does not depend on the gathered information, so options can
+select these properties before gathering.
+*/
+int cliInfo_GetVolatileProperties (const char* const** properties, int* count);
+
+/**
+Save the gathered information to a file in a compact binary format.
+
+If reference is not null, only the nodes and properties which differ from the
+reference are stored. Snapshots of similar machines are thus very small when
+saved against a common reference, for instance a snapshot of the typical
+configuration. The same reference must be passed to cliInfo_Load. reference
+may itself be loaded from a snapshot.
+*/
+int cliInfo_Save (const struct cliInfo* info, const struct cliInfo* reference,
+	const char* filename);
+
+/**
+Load information saved with cliInfo_Save into an empty cliInfo object, in place
+of calling Gather().
+
+reference must be the one used to save the snapshot, or null if none was used.
+The loaded tree is independent of the reference, which may be destroyed
+afterwards. Loaded information cannot be refreshed.
+*/
+int cliInfo_Load (struct cliInfo* info, const struct cliInfo* reference,
+	const char* filename);
+
+/**
+Load the XML output of the command line tool (OpenCLInfo -x) into an empty
+cliInfo object, in place of calling Gather().
+
+The file is parsed while it is read, and the tree is built directly, so large
+files are not held in memory. The unescaped output of older versions is
+accepted as well. The output does not contain hints, so they are null. Loaded
+information cannot be refreshed.
+*/
+int cliInfo_LoadXml (struct cliInfo* info, const char* filename);
+
+/**
+Load the JSON output of the command line tool (OpenCLInfo -j) into an empty
+cliInfo object, in place of calling Gather(). Works like cliInfo_LoadXml.
+
+Older versions of the tool wrote invalid JSON, with properties written as
+"name" = value, children not enclosed in an array, and a closing brace missing
+for every node. This is accepted as well. It does not contain the kind of
+nodes, so kind is null for trees loaded from it.
+
+JSON has no types, so the type of a property is derived from its values.
+Properties without values are strings.
+*/
+int cliInfo_LoadJson (struct cliInfo* info, const char* filename);
+
+/**
+Load a file written by cliInfo_Save, or the XML or JSON output of the command
+line tool, detecting the format from the first character of the file.
+reference is only used for snapshots, see cliInfo_Load.
+*/
+int cliInfo_LoadFile (struct cliInfo* info, const struct cliInfo* reference,
+	const char* filename);
+
 /**
 Get the root node. The root is a 'Platforms' node, with one 'Platform' node
 for each discovered platform. A platform node contains properties describing
@@ -104,14 +427,182 @@ describing each device.
 */
 int cliInfo_GetRoot (const struct cliInfo* info, struct cliNode** root);
 
+/**
+Memory used by the tree of a cliInfo object.
+*/
+struct cliStatistics
+{
+	/* Allocations made for the nodes, properties and values */
+	int64_t	allocations;
+	/* Bytes handed out by these allocations, including alignment */
+	int64_t	bytesAllocated;
+	/* Bytes held for the tree, which is at least bytesAllocated */
+	int64_t	bytesReserved;
+};
+
+/**
+Get the memory used by the tree of info. The platforms gathered with
+CLI_GatherFlag_Isolate are held in memory shared with the child processes,
+which is not included.
+*/
+int cliInfo_GetStatistics (const struct cliInfo* info,
+	struct cliStatistics* statistics);
+
 /**
 Release a cliInfo object.
 
 This destroys the underlying tree as well; that is, all nodes/properties
-obtained from this info object will be invalid afterwards.
+obtained from this info object will be invalid afterwards. A running
+asynchronous gather is cancelled and waited for. Must not be called from the
+callback.
 */
 int cliInfo_Destroy (struct cliInfo* info);
 
+/**
+Criteria for cliInfo_RankDevices. Devices which do not meet the requirements
+are left out. The others get a score, which is the sum of the weights, each
+multiplied by how well the device does in this respect, from 0 to 1.
+*/
+struct cliRankCriteria
+{
+	/*
+	Combination of CL_DEVICE_TYPE_* bits. Devices of one of these types get
+	typeWeight, the others nothing.
+	*/
+	uint64_t	deviceTypes;
+	double		typeWeight;
+
+	/*
+	Compute units times the maximum clock frequency, and the global memory
+	size, relative to the best device.
+	*/
+	double		computeWeight;
+	double		memoryWeight;
+
+	/* Null-terminated list of extensions a device must support, or null */
+	const char* const*	requiredExtensions;
+
+	/* The OpenCL version a device must support at least, 0.0 for any */
+	int			minimumMajorVersion;
+	int			minimumMinorVersion;
+};
+
+/**
+A device ranked by cliInfo_RankDevices, which is the deviceIndex-th device of
+the platformIndex-th platform.
+*/
+struct cliRankedDevice
+{
+	int	platformIndex;
+	int	deviceIndex;
+
+	const struct cliNode*	device;
+
+	/*
+	The cl_device_id of the device, or null if the information was loaded,
+	or gathered with CLI_GatherFlag_Isolate.
+	*/
+	void*	id;
+
+	double	score;
+};
+
+/**
+Rank the devices which meet the requirements of criteria, the best first.
+Devices with the same score remain in tree order. Devices whose
+CL_DEVICE_AVAILABLE is false are left out.
+
+If info has not been gathered yet, it is gathered, but only the properties
+the criteria need are fetched, and no image formats, which is much faster
+than a full gather.
+
+count must point to the number of entries in devices, and is set to the number
+of ranked devices. If that is larger, only the best ones are written, so
+devices may be null to query the count.
+*/
+int cliInfo_RankDevices (struct cliInfo* info,
+	const struct cliRankCriteria* criteria, struct cliRankedDevice* devices,
+	int* count);
+
+/**
+Requirements on a device, compiled from a manifest with
+cliRequirements_Compile.
+*/
+struct cliRequirements;
+
+/**
+The result of evaluating requirements for one device, which is the
+deviceIndex-th device of the platformIndex-th platform.
+*/
+struct cliRequirementsResult
+{
+	int	platformIndex;
+	int	deviceIndex;
+
+	const struct cliNode*	device;
+
+	/*
+	Null if the device meets all requirements. Otherwise, the first
+	requirement it does not meet as written in the manifest, and its line
+	number, counting from 1. The text is owned by the requirements.
+	*/
+	const char*	failedRequirement;
+	int			failedLine;
+};
+
+/**
+Compile a manifest of requirements, which has one requirement per line. Empty
+lines and text following '#' are ignored. A requirement is one of:
+
+	NAME				the device or its platform has the property NAME; for
+						booleans, it must also be true
+	NAME op value		a value of the property NAME compares to value, where
+						op is one of = != < <= > >= and ~ (contains).
+						Integers are compared as numbers, and may end in K, M,
+						G or T to multiply them by powers of 1024. For strings,
+						= also accepts a value ending in '_' followed by value,
+						so CL_DEVICE_TYPE = GPU matches CL_DEVICE_TYPE_GPU.
+						Values containing '#' must be quoted.
+	extension NAME		the extension is listed in CL_DEVICE_EXTENSIONS or
+						CL_PLATFORM_EXTENSIONS
+	image TYPE ORDER DATATYPE
+						the device supports the image format, for instance
+						image Image2D RGBA float. Any of them may be '*'.
+						TYPE must be '*' for trees loaded from the JSON of
+						older versions, which does not contain it.
+
+If the manifest is malformed, CLI_Error is returned, and if error is not null,
+a message describing the problem is written to it, truncated to errorSize
+bytes including the terminating null. Otherwise, requirements must be
+released with cliRequirements_Destroy.
+*/
+int cliRequirements_Compile (const char* manifest,
+	struct cliRequirements** requirements, char* error, int errorSize);
+
+/**
+Same as cliRequirements_Compile, with the manifest read from a file.
+*/
+int cliRequirements_CompileFile (const char* filename,
+	struct cliRequirements** requirements, char* error, int errorSize);
+
+/**
+Evaluate the requirements for all devices of a gathered or loaded cliInfo
+object, in tree order.
+
+count must point to the number of entries in results, and is set to the number
+of devices. If that is larger, only the first entries are written, so results
+may be null to query the count. The requirements are not modified, so they
+can be evaluated on several threads at once.
+*/
+int cliRequirements_Evaluate (const struct cliRequirements* requirements,
+	const struct cliInfo* info, struct cliRequirementsResult* results,
+	int* count);
+
+/**
+Release compiled requirements.
+*/
+int cliRequirements_Destroy (struct cliRequirements* requirements);
+
 #ifdef __cplusplus
 }
 #endif
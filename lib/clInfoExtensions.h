@@ -0,0 +1,49 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#ifndef NIV_CLINFO_EXTENSIONS_H_DCB89DE5FEF4602B6C8CAE7998075E51DAB977C8
+#define NIV_CLINFO_EXTENSIONS_H_DCB89DE5FEF4602B6C8CAE7998075E51DAB977C8
+
+/*
+Vendor extension constants from cl_ext.h, which is not shipped by every SDK.
+Shared with tools/FakeOpenCL, which must answer the same queries. Include it
+after the OpenCL headers.
+*/
+
+#ifndef CL_DEVICE_GLOBAL_FREE_MEMORY_AMD
+#define CL_DEVICE_GLOBAL_FREE_MEMORY_AMD 0x4039
+#endif
+
+#ifndef CL_DEVICE_GLOBAL_MEM_CHANNELS_AMD
+#define CL_DEVICE_GLOBAL_MEM_CHANNELS_AMD 0x4044
+#endif
+
+#ifndef CL_DEVICE_SIMD_PER_COMPUTE_UNIT_AMD
+#define CL_DEVICE_SIMD_PER_COMPUTE_UNIT_AMD 0x4040
+#endif
+
+#ifndef CL_DEVICE_SIMD_WIDTH_AMD
+#define CL_DEVICE_SIMD_WIDTH_AMD 0x4041
+#endif
+
+#ifndef CL_DEVICE_SIMD_INSTRUCTION_WIDTH_AMD
+#define CL_DEVICE_SIMD_INSTRUCTION_WIDTH_AMD 0x4042
+#endif
+
+#ifndef CL_DEVICE_WAVEFRONT_WIDTH_AMD
+#define CL_DEVICE_WAVEFRONT_WIDTH_AMD 0x4043
+#endif
+
+#ifndef CL_DEVICE_COMPUTE_CAPABILITY_MAJOR_NV
+#define CL_DEVICE_COMPUTE_CAPABILITY_MAJOR_NV 0x4000
+#endif
+
+#ifndef CL_DEVICE_COMPUTE_CAPABILITY_MINOR_NV
+#define CL_DEVICE_COMPUTE_CAPABILITY_MINOR_NV 0x4001
+#endif
+
+#ifndef CL_DEVICE_WARP_SIZE_NV
+#define CL_DEVICE_WARP_SIZE_NV 0x4003
+#endif
+
+#endif
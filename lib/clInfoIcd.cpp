@@ -0,0 +1,386 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "clInfo.h"
+#include "clInfoInternal.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+	#include <dirent.h>
+	#include <dlfcn.h>
+	#include <sys/stat.h>
+#endif
+
+using namespace niv;
+
+namespace {
+/**
+The start of the dispatch table of the Khronos ICD extension, see cl_icd.h.
+Every object created by an ICD starts with a pointer to it. Only the entries
+used by the gather are typed.
+*/
+struct Dispatch
+{
+	void*	clGetPlatformIDs;
+	decltype (ClApi::GetPlatformInfo)	clGetPlatformInfo;
+	decltype (ClApi::GetDeviceIDs)		clGetDeviceIDs;
+	decltype (ClApi::GetDeviceInfo)		clGetDeviceInfo;
+	decltype (ClApi::CreateContext)		clCreateContext;
+	void*	clCreateContextFromType;
+	void*	clRetainContext;
+	decltype (ClApi::ReleaseContext)	clReleaseContext;
+	void*	clGetContextInfo;
+	void*	clCreateCommandQueue;
+	void*	clRetainCommandQueue;
+	void*	clReleaseCommandQueue;
+	void*	clGetCommandQueueInfo;
+	void*	clSetCommandQueueProperty;
+	void*	clCreateBuffer;
+	void*	clCreateImage2D;
+	void*	clCreateImage3D;
+	void*	clRetainMemObject;
+	void*	clReleaseMemObject;
+	decltype (ClApi::GetSupportedImageFormats)	clGetSupportedImageFormats;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+const Dispatch* GetDispatch (T object)
+{
+	return *reinterpret_cast<const Dispatch* const*> (object);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL DispatchGetPlatformInfo (cl_platform_id platform,
+	cl_platform_info info, std::size_t size, void* value, std::size_t* sizeRet)
+{
+	if (platform == nullptr) {
+		return CL_INVALID_PLATFORM;
+	}
+
+	return GetDispatch (platform)->clGetPlatformInfo (platform, info, size,
+		value, sizeRet);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL DispatchGetDeviceIDs (cl_platform_id platform,
+	cl_device_type type, cl_uint numEntries, cl_device_id* devices,
+	cl_uint* numDevices)
+{
+	if (platform == nullptr) {
+		return CL_INVALID_PLATFORM;
+	}
+
+	return GetDispatch (platform)->clGetDeviceIDs (platform, type, numEntries,
+		devices, numDevices);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL DispatchGetDeviceInfo (cl_device_id device,
+	cl_device_info info, std::size_t size, void* value, std::size_t* sizeRet)
+{
+	if (device == nullptr) {
+		return CL_INVALID_DEVICE;
+	}
+
+	return GetDispatch (device)->clGetDeviceInfo (device, info, size, value,
+		sizeRet);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_context CL_API_CALL DispatchCreateContext (
+	const cl_context_properties* properties, cl_uint numDevices,
+	const cl_device_id* devices,
+	void (CL_CALLBACK* notify) (const char*, const void*, std::size_t, void*),
+	void* userdata, cl_int* error)
+{
+	if (numDevices == 0 || devices == nullptr || devices [0] == nullptr) {
+		if (error) {
+			*error = CL_INVALID_VALUE;
+		}
+
+		return nullptr;
+	}
+
+	return GetDispatch (devices [0])->clCreateContext (properties, numDevices,
+		devices, notify, userdata, error);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL DispatchReleaseContext (cl_context context)
+{
+	if (context == nullptr) {
+		return CL_INVALID_CONTEXT;
+	}
+
+	return GetDispatch (context)->clReleaseContext (context);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL DispatchGetSupportedImageFormats (cl_context context,
+	cl_mem_flags flags, cl_mem_object_type type, cl_uint numEntries,
+	cl_image_format* formats, cl_uint* numFormats)
+{
+	if (context == nullptr) {
+		return CL_INVALID_CONTEXT;
+	}
+
+	return GetDispatch (context)->clGetSupportedImageFormats (context, flags,
+		type, numEntries, formats, numFormats);
+}
+
+#ifndef _WIN32
+typedef cl_int (CL_API_CALL* IcdGetPlatformIDsFunction) (cl_uint,
+	cl_platform_id*, cl_uint*);
+typedef void* (CL_API_CALL* GetExtensionFunctionAddressFunction) (const char*);
+
+/**
+A vendor library to load, and what was found in it.
+*/
+struct Icd
+{
+	std::string	icdFile;
+	std::string	library;
+
+	std::shared_ptr<void>		handle;
+	std::vector<cl_platform_id>	platforms;
+	std::string					error;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+bool IsDirectory (const char* path)
+{
+	struct stat s;
+	return ::stat (path, &s) == 0 && S_ISDIR (s.st_mode);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+The first line of an .icd file is the name or path of the library.
+*/
+bool ReadIcdFile (const std::string& path, Icd& icd)
+{
+	std::ifstream file (path);
+	std::string line;
+
+	if (! std::getline (file, line)) {
+		return false;
+	}
+
+	while (! line.empty () && std::isspace (static_cast<unsigned char> (line.back ()))) {
+		line.pop_back ();
+	}
+
+	if (line.empty ()) {
+		return false;
+	}
+
+	icd.icdFile = path;
+	icd.library = line;
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::vector<Icd> FindIcds ()
+{
+	std::vector<Icd> result;
+
+	if (const auto filenames = std::getenv ("OCL_ICD_FILENAMES")) {
+		std::string list = filenames;
+		std::size_t start = 0;
+
+		while (start <= list.size ()) {
+			auto end = list.find (':', start);
+			if (end == std::string::npos) {
+				end = list.size ();
+			}
+
+			if (end > start) {
+				Icd icd;
+				icd.library = list.substr (start, end - start);
+				result.push_back (icd);
+			}
+
+			start = end + 1;
+		}
+
+		return result;
+	}
+
+	const char* vendors = std::getenv ("OCL_ICD_VENDORS");
+	if (vendors == nullptr || *vendors == '\0') {
+		vendors = "/etc/OpenCL/vendors";
+	}
+
+	if (! IsDirectory (vendors)) {
+		Icd icd;
+		if (ReadIcdFile (vendors, icd)) {
+			result.push_back (icd);
+		}
+
+		return result;
+	}
+
+	std::vector<std::string> files;
+
+	if (auto dir = ::opendir (vendors)) {
+		while (auto entry = ::readdir (dir)) {
+			const std::string name = entry->d_name;
+
+			if (name.size () > 4 &&
+				name.compare (name.size () - 4, 4, ".icd") == 0) {
+				files.push_back (std::string (vendors) + "/" + name);
+			}
+		}
+
+		::closedir (dir);
+	}
+
+	// readdir returns the files in no particular order
+	std::sort (files.begin (), files.end ());
+
+	for (const auto& file : files) {
+		Icd icd;
+		if (ReadIcdFile (file, icd)) {
+			result.push_back (icd);
+		}
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoadIcd (Icd& icd)
+{
+	const auto handle = ::dlopen (icd.library.c_str (), RTLD_NOW | RTLD_LOCAL);
+
+	if (handle == nullptr) {
+		const auto error = ::dlerror ();
+		icd.error = error ? error : "dlopen failed";
+		return;
+	}
+
+	icd.handle.reset (handle, [] (void* h) -> void { ::dlclose (h); });
+
+	auto getPlatformIDs = reinterpret_cast<IcdGetPlatformIDsFunction> (
+		::dlsym (handle, "clIcdGetPlatformIDsKHR"));
+
+	// Some ICDs only return it through the extension mechanism
+	if (getPlatformIDs == nullptr) {
+		const auto getAddress = reinterpret_cast<GetExtensionFunctionAddressFunction> (
+			::dlsym (handle, "clGetExtensionFunctionAddress"));
+
+		if (getAddress) {
+			getPlatformIDs = reinterpret_cast<IcdGetPlatformIDsFunction> (
+				getAddress ("clIcdGetPlatformIDsKHR"));
+		}
+	}
+
+	if (getPlatformIDs == nullptr) {
+		icd.error = "clIcdGetPlatformIDsKHR not found";
+		return;
+	}
+
+	cl_uint count = 0;
+	if (getPlatformIDs (0, nullptr, &count) != CL_SUCCESS || count == 0) {
+		icd.error = "no platforms";
+		return;
+	}
+
+	icd.platforms.resize (count);
+	if (getPlatformIDs (count, icd.platforms.data (), nullptr) != CL_SUCCESS) {
+		icd.platforms.clear ();
+		icd.error = "clIcdGetPlatformIDsKHR failed";
+	}
+}
+#endif
+}
+
+namespace niv {
+////////////////////////////////////////////////////////////////////////////////
+const ClApi& GetLoaderApi ()
+{
+	static const ClApi api = {
+		clGetPlatformIDs,
+		clGetPlatformInfo,
+		clGetDeviceIDs,
+		clGetDeviceInfo,
+		clCreateContext,
+		clReleaseContext,
+		clGetSupportedImageFormats
+	};
+
+	return api;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const ClApi& GetDispatchApi ()
+{
+	static const ClApi api = {
+		nullptr,
+		DispatchGetPlatformInfo,
+		DispatchGetDeviceIDs,
+		DispatchGetDeviceInfo,
+		DispatchCreateContext,
+		DispatchReleaseContext,
+		DispatchGetSupportedImageFormats
+	};
+
+	return api;
+}
+
+#ifndef _WIN32
+////////////////////////////////////////////////////////////////////////////////
+std::vector<IcdPlatform> EnumerateIcdPlatforms (
+	std::vector<std::shared_ptr<void>>& libraries)
+{
+	auto icds = FindIcds ();
+
+	// Initializing a driver can take a while, so do all of them at once.
+	// Each thread only touches its own entry.
+	std::vector<std::thread> threads;
+	for (auto& icd : icds) {
+		threads.emplace_back (LoadIcd, std::ref (icd));
+	}
+
+	for (auto& thread : threads) {
+		thread.join ();
+	}
+
+	std::vector<IcdPlatform> result;
+
+	for (const auto& icd : icds) {
+		if (! icd.error.empty ()) {
+			std::cerr << "Skipping ICD " << icd.library << ": " << icd.error
+				<< "\n";
+		}
+
+		if (icd.handle) {
+			libraries.push_back (icd.handle);
+		}
+
+		for (const auto id : icd.platforms) {
+			IcdPlatform platform;
+			platform.id = id;
+			platform.icdFile = icd.icdFile;
+			platform.library = icd.library;
+
+			result.push_back (platform);
+		}
+	}
+
+	return result;
+}
+#endif
+}
@@ -0,0 +1,1118 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "clInfo.h"
+#include "clInfoInternal.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+Loaders for the XML and JSON output of the command line tool.
+
+The input is read in blocks and parsed as it is read, and the nodes, properties
+and values are created in the pool of the cliInfo right away. There is no
+intermediate document, so the memory used is the size of the resulting tree,
+plus one block of input. Strings are interned, as the same names and values
+occur for every device.
+
+Both parsers accept the output of all versions of the tool. Older versions did
+not escape anything, so the XML parser keeps '&' and '<' which do not start an
+entity or a closing tag as they are. Their JSON output was not valid JSON
+either, and looked like this:
+
+	{ "Platforms" : {"Properties" : {}, "Children" : { "Platform" : {
+		"Properties" : "CL_PLATFORM_NAME" = "...","CL_X" = [1,2],
+		"Children" : {}}}
+
+That is, properties were written as "name" = value without an enclosing
+object, children were not enclosed in an array, and every node lacked its
+outer closing brace. The JSON parser decides per node which dialect it reads,
+based on the syntax of the properties and children. Strings in the old dialect
+are not unescaped, and end at a quote followed by ',', ']' or '}'.
+*/
+
+namespace {
+struct ImportError : public std::runtime_error
+{
+	explicit ImportError (const std::string& what)
+	: std::runtime_error (what)
+	{
+	}
+};
+
+/**
+Limits the nesting depth, so malformed files cannot exhaust the stack.
+*/
+struct DepthGuard
+{
+	explicit DepthGuard (int& depth)
+	: depth (depth)
+	{
+		if (++depth > 64) {
+			throw ImportError ("Nesting too deep");
+		}
+	}
+
+	~DepthGuard ()
+	{
+		--depth;
+	}
+
+	int& depth;
+};
+
+/**
+A set of characters, for scanning runs of characters at once.
+*/
+class CharacterSet
+{
+public:
+	/**
+	Contains the characters of chars, or all others if complement is set.
+	*/
+	explicit CharacterSet (const char* chars, const bool complement = false)
+	{
+		std::fill (contains_, contains_ + 256, complement);
+
+		for (; *chars; ++chars) {
+			contains_ [static_cast<unsigned char> (*chars)] = ! complement;
+		}
+	}
+
+	bool Contains (const int c) const
+	{
+		return c >= 0 && contains_ [c];
+	}
+
+private:
+	bool	contains_ [256];
+};
+
+/**
+Reads a file in blocks. Only the current block is kept in memory, so only
+small lookaheads are possible.
+*/
+class Input
+{
+public:
+	explicit Input (std::FILE* file)
+	: file_ (file)
+	, buffer_ (65536)
+	{
+	}
+
+	/**
+	Get the next character without consuming it, or -1 at the end of the
+	input.
+	*/
+	int Peek ()
+	{
+		if (position_ == end_ && ! Fill (1)) {
+			return -1;
+		}
+
+		return static_cast<unsigned char> (buffer_ [position_]);
+	}
+
+	int Get ()
+	{
+		const auto c = Peek ();
+
+		if (c >= 0) {
+			++position_;
+		}
+
+		return c;
+	}
+
+	/**
+	Check whether the input continues with s, without consuming it.
+	*/
+	template <std::size_t N>
+	bool LooksAt (const char (&s)[N])
+	{
+		const auto length = N - 1;
+
+		if (end_ - position_ < length && ! Fill (length)) {
+			return false;
+		}
+
+		return ::memcmp (buffer_.data () + position_, s, length) == 0;
+	}
+
+	/**
+	Consume s if the input continues with it.
+	*/
+	template <std::size_t N>
+	bool Consume (const char (&s)[N])
+	{
+		if (LooksAt (s)) {
+			position_ += N - 1;
+			return true;
+		}
+
+		return false;
+	}
+
+	void SkipSpaces ()
+	{
+		for (;;) {
+			const auto c = Peek ();
+
+			if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+				++position_;
+			} else {
+				break;
+			}
+		}
+	}
+
+	/**
+	Append characters to s until one which is in stop is found. Returns that
+	character, which is not consumed, or -1 at the end of the input.
+	*/
+	int ReadUntil (std::string& s, const CharacterSet& stop)
+	{
+		for (;;) {
+			if (position_ == end_ && ! Fill (1)) {
+				return -1;
+			}
+
+			const auto start = position_;
+			while (position_ < end_ &&
+				! stop.Contains (static_cast<unsigned char> (buffer_ [position_]))) {
+				++position_;
+			}
+
+			s.append (buffer_.data () + start, position_ - start);
+
+			if (position_ < end_) {
+				return static_cast<unsigned char> (buffer_ [position_]);
+			}
+		}
+	}
+
+	[[noreturn]] void Fail (const char* message) const
+	{
+		throw ImportError (std::string (message) + " at offset " +
+			std::to_string (consumed_ + position_));
+	}
+
+private:
+	/**
+	Make sure at least count characters are available. Returns false if the
+	input ends before.
+	*/
+	bool Fill (const std::size_t count)
+	{
+		const auto remaining = end_ - position_;
+		::memmove (buffer_.data (), buffer_.data () + position_, remaining);
+		consumed_ += position_;
+		position_ = 0;
+		end_ = remaining;
+
+		while (end_ < count) {
+			const auto read = std::fread (buffer_.data () + end_, 1,
+				buffer_.size () - end_, file_);
+
+			if (read == 0) {
+				if (std::ferror (file_)) {
+					throw ImportError ("Could not read the input");
+				}
+
+				return false;
+			}
+
+			end_ += read;
+		}
+
+		return true;
+	}
+
+	std::FILE*			file_;
+	std::vector<char>	buffer_;
+	std::size_t			position_ = 0;
+	std::size_t			end_ = 0;
+
+	// Number of characters before the buffer, for error messages
+	std::size_t			consumed_ = 0;
+};
+
+/**
+Creates the parts of the tree in a pool.
+*/
+class TreeBuilder
+{
+public:
+	explicit TreeBuilder (niv::Pool& pool)
+	: pool_ (pool)
+	{
+	}
+
+	/**
+	Get a copy of s in the pool. Equal strings share the copy.
+	*/
+	const char* Intern (const std::string& s)
+	{
+		const auto it = strings_.find (s);
+
+		if (it != strings_.end ()) {
+			return it->second;
+		}
+
+		auto copy = static_cast<char*> (pool_.Allocate (
+			static_cast<int> (s.size ()) + 1));
+		::memcpy (copy, s.data (), s.size ());
+
+		strings_.emplace (s, copy);
+		return copy;
+	}
+
+	cliNode* CreateNode (const char* name)
+	{
+		auto node = pool_.Allocate<cliNode> ();
+		node->name = name;
+		return node;
+	}
+
+	cliProperty* CreateProperty (const char* name)
+	{
+		auto property = pool_.Allocate<cliProperty> ();
+		property->name = name;
+		return property;
+	}
+
+	cliValue* CreateValue ()
+	{
+		return pool_.Allocate<cliValue> ();
+	}
+
+private:
+	niv::Pool&	pool_;
+	std::unordered_map<std::string, const char*>	strings_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+bool ParseInt64 (const std::string& s, std::int64_t& result)
+{
+	if (s.empty ()) {
+		return false;
+	}
+
+	errno = 0;
+	char* end = nullptr;
+	result = std::strtoll (s.c_str (), &end, 10);
+
+	return errno == 0 && *end == '\0';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void AppendUtf8 (std::string& s, const std::uint32_t c)
+{
+	if (c < 0x80) {
+		s += static_cast<char> (c);
+	} else if (c < 0x800) {
+		s += static_cast<char> (0xC0 | (c >> 6));
+		s += static_cast<char> (0x80 | (c & 0x3F));
+	} else if (c < 0x10000) {
+		s += static_cast<char> (0xE0 | (c >> 12));
+		s += static_cast<char> (0x80 | ((c >> 6) & 0x3F));
+		s += static_cast<char> (0x80 | (c & 0x3F));
+	} else {
+		s += static_cast<char> (0xF0 | (c >> 18));
+		s += static_cast<char> (0x80 | ((c >> 12) & 0x3F));
+		s += static_cast<char> (0x80 | ((c >> 6) & 0x3F));
+		s += static_cast<char> (0x80 | (c & 0x3F));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Add a value to a property. All values of a property must have the same type.
+*/
+void AppendValue (cliProperty* property, cliValue**& tail, cliValue* value,
+	const cliPropertyType type, Input& input)
+{
+	if (property->value == nullptr) {
+		property->type = type;
+	} else if (property->type != type) {
+		input.Fail ("Values of different types");
+	}
+
+	*tail = value;
+	tail = &value->next;
+}
+
+/**
+Parses both the current JSON output and the one of older versions, see above.
+*/
+class JsonReader
+{
+public:
+	JsonReader (Input& input, TreeBuilder& builder)
+	: input_ (input)
+	, builder_ (builder)
+	{
+	}
+
+	cliNode* Read ()
+	{
+		input_.Consume ("\xEF\xBB\xBF");
+
+		const auto root = ReadNode ();
+
+		input_.SkipSpaces ();
+		if (input_.Peek () >= 0) {
+			input_.Fail ("Unexpected data after the root node");
+		}
+
+		return root;
+	}
+
+private:
+	void Expect (const char c)
+	{
+		input_.SkipSpaces ();
+
+		if (input_.Get () != c) {
+			const char message [] = { 'E', 'x', 'p', 'e', 'c', 't', 'e', 'd', ' ',
+				'\'', c, '\'', '\0' };
+			input_.Fail (message);
+		}
+	}
+
+	bool Consume (const char c)
+	{
+		input_.SkipSpaces ();
+
+		if (input_.Peek () == c) {
+			input_.Get ();
+			return true;
+		}
+
+		return false;
+	}
+
+	/**
+	Read a string into scratch_. legacy strings are not unescaped.
+	*/
+	void ReadString (const bool legacy)
+	{
+		static const CharacterSet stops ("\"\\");
+		static const CharacterSet quote ("\"");
+
+		Expect ('"');
+		scratch_.clear ();
+
+		for (;;) {
+			const auto c = input_.ReadUntil (scratch_, legacy ? quote : stops);
+			input_.Get ();
+
+			if (c < 0) {
+				input_.Fail ("Unterminated string");
+			} else if (c == '"') {
+				if (! legacy) {
+					return;
+				}
+
+				const auto next = input_.Peek ();
+				if (next == ',' || next == ']' || next == '}' || next < 0) {
+					return;
+				}
+
+				scratch_ += '"';
+			} else {
+				ReadEscape ();
+			}
+		}
+	}
+
+	void ReadEscape ()
+	{
+		const auto c = input_.Get ();
+
+		switch (c) {
+		case '"': scratch_ += '"'; break;
+		case '\\': scratch_ += '\\'; break;
+		case '/': scratch_ += '/'; break;
+		case 'b': scratch_ += '\b'; break;
+		case 'f': scratch_ += '\f'; break;
+		case 'n': scratch_ += '\n'; break;
+		case 'r': scratch_ += '\r'; break;
+		case 't': scratch_ += '\t'; break;
+
+		case 'u':
+			{
+				auto code = ReadHex4 ();
+
+				// Characters outside the BMP are escaped as surrogate pairs
+				if (code >= 0xD800 && code < 0xDC00 && input_.Consume ("\\u")) {
+					const auto low = ReadHex4 ();
+
+					if (low < 0xDC00 || low >= 0xE000) {
+						input_.Fail ("Invalid surrogate pair");
+					}
+
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				}
+
+				AppendUtf8 (scratch_, code);
+			}
+			break;
+
+		default:
+			input_.Fail ("Invalid escape sequence");
+		}
+	}
+
+	std::uint32_t ReadHex4 ()
+	{
+		std::uint32_t result = 0;
+
+		for (int i = 0; i < 4; ++i) {
+			const auto c = input_.Get ();
+			result <<= 4;
+
+			if (c >= '0' && c <= '9') {
+				result |= c - '0';
+			} else if (c >= 'a' && c <= 'f') {
+				result |= c - 'a' + 10;
+			} else if (c >= 'A' && c <= 'F') {
+				result |= c - 'A' + 10;
+			} else {
+				input_.Fail ("Invalid escape sequence");
+			}
+		}
+
+		return result;
+	}
+
+	const char* ReadName ()
+	{
+		ReadString (false);
+		return builder_.Intern (scratch_);
+	}
+
+	cliNode* ReadNode ()
+	{
+		DepthGuard guard (depth_);
+
+		Expect ('{');
+		const auto node = builder_.CreateNode (ReadName ());
+		Expect (':');
+		Expect ('{');
+
+		bool legacy = false;
+
+		if (! Consume ('}')) {
+			// Set if the name of the next member was already read while
+			// reading the properties
+			const char* key = nullptr;
+
+			for (;;) {
+				if (key == nullptr) {
+					key = ReadName ();
+				}
+
+				Expect (':');
+
+				if (::strcmp (key, "Kind") == 0) {
+					node->kind = ReadName ();
+					key = nullptr;
+				} else if (::strcmp (key, "Properties") == 0) {
+					key = ReadProperties (node);
+				} else if (::strcmp (key, "Children") == 0) {
+					legacy = ReadChildren (node);
+					key = nullptr;
+				} else {
+					input_.Fail ("Unknown member");
+				}
+
+				if (key == nullptr && ! Consume (',')) {
+					break;
+				}
+			}
+
+			Expect ('}');
+		}
+
+		if (! legacy) {
+			Expect ('}');
+		}
+
+		return node;
+	}
+
+	/**
+	Read the properties of a node. Properties in the old dialect are followed
+	directly by the next member of the node, and its name is returned.
+	*/
+	const char* ReadProperties (cliNode* node)
+	{
+		auto tail = &node->firstProperty;
+
+		if (Consume ('{')) {
+			if (Consume ('}')) {
+				return nullptr;
+			}
+
+			do {
+				const auto property = builder_.CreateProperty (ReadName ());
+				Expect (':');
+				ReadValues (property, false);
+
+				*tail = property;
+				tail = &property->next;
+			} while (Consume (','));
+
+			Expect ('}');
+			return nullptr;
+		}
+
+		for (;;) {
+			const auto name = ReadName ();
+
+			if (! Consume ('=')) {
+				return name;
+			}
+
+			const auto property = builder_.CreateProperty (name);
+			ReadValues (property, true);
+
+			*tail = property;
+			tail = &property->next;
+
+			if (! Consume (',')) {
+				return nullptr;
+			}
+		}
+	}
+
+	/**
+	Read the children of a node. Returns true if they are in the old dialect.
+	*/
+	bool ReadChildren (cliNode* node)
+	{
+		auto tail = &node->firstChild;
+
+		if (Consume ('[')) {
+			if (! Consume (']')) {
+				do {
+					*tail = ReadNode ();
+					tail = &(*tail)->next;
+				} while (Consume (','));
+
+				Expect (']');
+			}
+
+			return false;
+		}
+
+		input_.SkipSpaces ();
+
+		if (input_.Consume ("{}")) {
+			return true;
+		}
+
+		do {
+			*tail = ReadNode ();
+			tail = &(*tail)->next;
+		} while (Consume (','));
+
+		return true;
+	}
+
+	void ReadValues (cliProperty* property, const bool legacy)
+	{
+		// Without values, the type is unknown
+		property->type = CLI_PropertyType_String;
+		auto tail = &property->value;
+
+		if (Consume ('[')) {
+			if (! Consume (']')) {
+				do {
+					ReadValue (property, tail, legacy);
+				} while (Consume (','));
+
+				Expect (']');
+			}
+		} else {
+			ReadValue (property, tail, legacy);
+		}
+	}
+
+	void ReadValue (cliProperty* property, cliValue**& tail, const bool legacy)
+	{
+		static const CharacterSet numberCharacters ("-0123456789", true);
+
+		input_.SkipSpaces ();
+
+		const auto c = input_.Peek ();
+		const auto value = builder_.CreateValue ();
+
+		if (c == '"') {
+			ReadString (legacy);
+			value->s = builder_.Intern (scratch_);
+			AppendValue (property, tail, value, CLI_PropertyType_String, input_);
+		} else if (input_.Consume ("true")) {
+			value->b = true;
+			AppendValue (property, tail, value, CLI_PropertyType_Bool, input_);
+		} else if (input_.Consume ("false")) {
+			value->b = false;
+			AppendValue (property, tail, value, CLI_PropertyType_Bool, input_);
+		} else {
+			scratch_.clear ();
+			input_.ReadUntil (scratch_, numberCharacters);
+
+			if (! ParseInt64 (scratch_, value->i)) {
+				input_.Fail ("Expected a value");
+			}
+
+			AppendValue (property, tail, value, CLI_PropertyType_Int64, input_);
+		}
+	}
+
+	Input&			input_;
+	TreeBuilder&	builder_;
+	std::string		scratch_;
+	int				depth_ = 0;
+};
+
+/**
+Parses the XML output. Only the elements written by the tool are understood,
+but whitespace between elements, an XML declaration and comments are skipped.
+*/
+class XmlReader
+{
+public:
+	XmlReader (Input& input, TreeBuilder& builder)
+	: input_ (input)
+	, builder_ (builder)
+	{
+	}
+
+	cliNode* Read ()
+	{
+		input_.Consume ("\xEF\xBB\xBF");
+		SkipMisc ();
+
+		const auto root = ReadNode ();
+
+		SkipMisc ();
+		if (input_.Peek () >= 0) {
+			input_.Fail ("Unexpected data after the root element");
+		}
+
+		return root;
+	}
+
+private:
+	/**
+	Skip whitespace, declarations and comments.
+	*/
+	void SkipMisc ()
+	{
+		for (;;) {
+			input_.SkipSpaces ();
+
+			if (input_.Consume ("<?")) {
+				SkipPast ("?>");
+			} else if (input_.Consume ("<!--")) {
+				SkipPast ("-->");
+			} else {
+				break;
+			}
+		}
+	}
+
+	template <std::size_t N>
+	void SkipPast (const char (&end)[N])
+	{
+		while (! input_.Consume (end)) {
+			if (input_.Get () < 0) {
+				input_.Fail ("Unexpected end of input");
+			}
+		}
+	}
+
+	void Expect (const char c)
+	{
+		input_.SkipSpaces ();
+
+		if (input_.Get () != c) {
+			const char message [] = { 'E', 'x', 'p', 'e', 'c', 't', 'e', 'd', ' ',
+				'\'', c, '\'', '\0' };
+			input_.Fail (message);
+		}
+	}
+
+	/**
+	Read an element or attribute name into scratch_.
+	*/
+	void ReadName ()
+	{
+		static const CharacterSet nameCharacters (
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_-.:",
+			true);
+
+		input_.SkipSpaces ();
+		scratch_.clear ();
+		input_.ReadUntil (scratch_, nameCharacters);
+
+		if (scratch_.empty ()) {
+			input_.Fail ("Expected a name");
+		}
+	}
+
+	/**
+	Append the text up to the next character in stop to scratch_, replacing
+	entities. Returns the character, which is not consumed.
+	*/
+	int ReadText (const CharacterSet& stop)
+	{
+		static const CharacterSet entityCharacters (
+			"#ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+			true);
+
+		for (;;) {
+			const auto c = input_.ReadUntil (scratch_, stop);
+
+			if (c != '&') {
+				return c;
+			}
+
+			input_.Get ();
+			entity_.clear ();
+			input_.ReadUntil (entity_, entityCharacters);
+
+			// Older versions did not escape anything, so unknown entities are
+			// kept as they are
+			if (input_.Peek () != ';' || ! AppendEntity ()) {
+				scratch_ += '&';
+				scratch_ += entity_;
+				continue;
+			}
+
+			input_.Get ();
+		}
+	}
+
+	bool AppendEntity ()
+	{
+		static const struct
+		{
+			const char*	name;
+			char		c;
+		} entities [] = {
+			{ "lt", '<' },
+			{ "gt", '>' },
+			{ "amp", '&' },
+			{ "quot", '"' },
+			{ "apos", '\'' }
+		};
+
+		for (const auto& entity : entities) {
+			if (entity_ == entity.name) {
+				scratch_ += entity.c;
+				return true;
+			}
+		}
+
+		if (entity_.size () < 2 || entity_ [0] != '#') {
+			return false;
+		}
+
+		const bool hex = entity_ [1] == 'x';
+		char* end = nullptr;
+		const auto code = std::strtoul (entity_.c_str () + (hex ? 2 : 1), &end,
+			hex ? 16 : 10);
+
+		if (*end != '\0' || code == 0 || code > 0x10FFFF) {
+			return false;
+		}
+
+		AppendUtf8 (scratch_, static_cast<std::uint32_t> (code));
+		return true;
+	}
+
+	/**
+	Read the value of an attribute into scratch_.
+	*/
+	void ReadAttributeValue ()
+	{
+		static const CharacterSet doubleQuote ("\"&");
+		static const CharacterSet singleQuote ("'&");
+
+		input_.SkipSpaces ();
+		const auto quote = input_.Get ();
+
+		if (quote != '"' && quote != '\'') {
+			input_.Fail ("Expected an attribute value");
+		}
+
+		scratch_.clear ();
+		if (ReadText (quote == '"' ? doubleQuote : singleQuote) < 0) {
+			input_.Fail ("Unterminated attribute value");
+		}
+
+		input_.Get ();
+	}
+
+	/**
+	Read the attributes of an element, and the end of the start tag. Returns
+	false if the element is empty, as in <Name/>.
+	*/
+	template <typename Attribute>
+	bool ReadAttributes (Attribute attribute)
+	{
+		for (;;) {
+			input_.SkipSpaces ();
+
+			if (input_.Consume (">")) {
+				return true;
+			} else if (input_.Consume ("/>")) {
+				return false;
+			}
+
+			ReadName ();
+			const auto name = builder_.Intern (scratch_);
+			Expect ('=');
+			ReadAttributeValue ();
+			attribute (name);
+		}
+	}
+
+	/**
+	Read the end tag of name, after the '</' has been consumed.
+	*/
+	void ReadEndTag (const char* name)
+	{
+		ReadName ();
+
+		if (scratch_ != name) {
+			input_.Fail ("Mismatched end tag");
+		}
+
+		Expect ('>');
+	}
+
+	cliNode* ReadNode ()
+	{
+		DepthGuard guard (depth_);
+
+		Expect ('<');
+		ReadName ();
+
+		const auto node = builder_.CreateNode (builder_.Intern (scratch_));
+
+		const bool hasContent = ReadAttributes ([this, node] (const char* name) -> void {
+			if (::strcmp (name, "Kind") == 0) {
+				node->kind = builder_.Intern (scratch_);
+			}
+		});
+
+		if (! hasContent) {
+			return node;
+		}
+
+		auto propertyTail = &node->firstProperty;
+		auto childTail = &node->firstChild;
+
+		for (;;) {
+			SkipMisc ();
+
+			if (input_.Consume ("</")) {
+				ReadEndTag (node->name);
+				return node;
+			} else if (input_.LooksAt ("<Property ") || input_.LooksAt ("<Property>")) {
+				*propertyTail = ReadProperty ();
+				propertyTail = &(*propertyTail)->next;
+			} else if (input_.Peek () == '<') {
+				*childTail = ReadNode ();
+				childTail = &(*childTail)->next;
+			} else {
+				input_.Fail ("Expected an element");
+			}
+		}
+	}
+
+	cliProperty* ReadProperty ()
+	{
+		static const CharacterSet valueStops ("<&");
+
+		input_.Consume ("<Property");
+
+		const auto property = builder_.CreateProperty (nullptr);
+		property->type = CLI_PropertyType_String;
+
+		const bool hasContent = ReadAttributes ([this, property] (const char* name) -> void {
+			if (::strcmp (name, "Name") == 0) {
+				property->name = builder_.Intern (scratch_);
+			} else if (::strcmp (name, "Type") == 0) {
+				if (scratch_ == "int64") {
+					property->type = CLI_PropertyType_Int64;
+				} else if (scratch_ == "bool") {
+					property->type = CLI_PropertyType_Bool;
+				} else if (scratch_ == "string") {
+					property->type = CLI_PropertyType_String;
+				} else {
+					input_.Fail ("Unknown property type");
+				}
+			}
+		});
+
+		if (property->name == nullptr) {
+			input_.Fail ("Property without a name");
+		}
+
+		if (! hasContent) {
+			return property;
+		}
+
+		auto tail = &property->value;
+
+		for (;;) {
+			SkipMisc ();
+
+			if (input_.Consume ("</Property>")) {
+				return property;
+			} else if (input_.Consume ("<Value/>")) {
+				scratch_.clear ();
+			} else if (input_.Consume ("<Value>")) {
+				scratch_.clear ();
+
+				for (;;) {
+					if (ReadText (valueStops) < 0) {
+						input_.Fail ("Unterminated value");
+					}
+
+					if (input_.Consume ("</Value>")) {
+						break;
+					}
+
+					// An unescaped '<' written by older versions
+					scratch_ += static_cast<char> (input_.Get ());
+				}
+			} else {
+				input_.Fail ("Expected a value");
+			}
+
+			const auto value = builder_.CreateValue ();
+
+			switch (property->type) {
+			case CLI_PropertyType_Int64:
+				if (! ParseInt64 (scratch_, value->i)) {
+					input_.Fail ("Invalid integer");
+				}
+				break;
+
+			case CLI_PropertyType_Bool:
+				if (scratch_ == "true") {
+					value->b = true;
+				} else if (scratch_ == "false") {
+					value->b = false;
+				} else {
+					input_.Fail ("Invalid boolean");
+				}
+				break;
+
+			case CLI_PropertyType_String:
+				value->s = builder_.Intern (scratch_);
+				break;
+			}
+
+			*tail = value;
+			tail = &value->next;
+		}
+	}
+
+	Input&			input_;
+	TreeBuilder&	builder_;
+	std::string		scratch_;
+	std::string		entity_;
+	int				depth_ = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename Reader>
+int Import (cliInfo* info, const char* filename)
+{
+	if (info == nullptr || info->root || info->busy || filename == nullptr) {
+		return CLI_Error;
+	}
+
+	try {
+		niv::FileCloser file (std::fopen (filename, "rb"));
+		if (file.file == nullptr) {
+			return CLI_Error;
+		}
+
+		Input input (file.file);
+		TreeBuilder builder (info->pool);
+		Reader reader (input, builder);
+
+		info->root = reader.Read ();
+		info->loaded = true;
+	} catch (const std::exception&) {
+		info->root = nullptr;
+		info->pool.Reset ();
+		return CLI_Error;
+	}
+
+	return CLI_Success;
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_LoadXml (cliInfo* info, const char* filename)
+{
+	return Import<XmlReader> (info, filename);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_LoadJson (cliInfo* info, const char* filename)
+{
+	return Import<JsonReader> (info, filename);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_LoadFile (cliInfo* info, const cliInfo* reference,
+	const char* filename)
+{
+	if (filename == nullptr) {
+		return CLI_Error;
+	}
+
+	int first = EOF;
+
+	{
+		niv::FileCloser file (std::fopen (filename, "rb"));
+		if (file.file == nullptr) {
+			return CLI_Error;
+		}
+
+		// Skip whitespace and a byte order mark
+		do {
+			first = std::fgetc (file.file);
+		} while (first == ' ' || first == '\t' || first == '\r' || first == '\n' ||
+			first == 0xEF || first == 0xBB || first == 0xBF);
+	}
+
+	switch (first) {
+	case '<':
+		return cliInfo_LoadXml (info, filename);
+
+	case '{':
+		return cliInfo_LoadJson (info, filename);
+
+	default:
+		return cliInfo_Load (info, reference, filename);
+	}
+}
@@ -0,0 +1,476 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#ifndef NIV_CLINFO_INTERNAL_H_6A0C1F7E5D2B4B8E9C3A17F04E2D6B59C8A1E3F2
+#define NIV_CLINFO_INTERNAL_H_6A0C1F7E5D2B4B8E9C3A17F04E2D6B59C8A1E3F2
+
+/*
+Declarations shared by the translation units of the library. Not installed,
+and not part of the public API.
+*/
+
+#include "clInfo.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __APPLE__
+	#include <OpenCL/cl.h>
+#else
+	#include <CL/cl.h>
+#endif
+
+namespace niv {
+/**
+Simple memory pool.
+
+Allocates memory in blocks. Assumes all entries are POD types.
+*/
+struct Pool
+{
+public:
+	explicit Pool (const int blockSize = 1048576)
+	: blockSize_ (blockSize)
+	{
+	}
+
+	/**
+	Allocate from a fixed, zero-initialized region instead, for instance
+	memory shared with another process. The region is not owned by the pool.
+	*/
+	Pool (void* region, const std::size_t regionSize)
+	: blockSize_ (0)
+	, region_ (static_cast<unsigned char*> (region))
+	, regionSize_ (regionSize)
+	{
+	}
+
+	Pool (const Pool&) = delete;
+	Pool& operator= (const Pool&) = delete;
+
+	void* Allocate (int size)
+	{
+		if (region_) {
+			return AllocateFromRegion (size);
+		}
+
+		if (size < 0 || size >= blockSize_) {
+			throw std::bad_alloc ();
+		}
+
+		if ((currentBlockOffset_ + size) > blockSize_) {
+			// Reuse blocks left over from before the last Reset () first
+			auto next = (currentBlock_ == blocks_.end ())
+				? blocks_.begin () : std::next (currentBlock_);
+
+			if (next == blocks_.end ()) {
+				blocks_.emplace_back (std::vector<unsigned char> (blockSize_));
+				next = std::prev (blocks_.end ());
+			}
+
+			currentBlockOffset_ = 0;
+			currentBlock_ = next;
+		}
+
+		// Align everything to 8 byte
+		size = ((size + 7) / 8) * 8;
+		auto result = currentBlock_->data () + currentBlockOffset_;
+		currentBlockOffset_ += size;
+
+		++allocations_;
+		bytesAllocated_ += static_cast<std::size_t> (size);
+
+		return result;
+	}
+
+	template <typename T>
+	T* Allocate ()
+	{
+		return static_cast<T*> (this->Allocate (sizeof (T)));
+	}
+
+	/**
+	The number of allocations and bytes handed out since the last Reset (),
+	including the alignment.
+	*/
+	std::size_t GetAllocations () const
+	{
+		return allocations_;
+	}
+
+	std::size_t GetBytesAllocated () const
+	{
+		return bytesAllocated_;
+	}
+
+	/**
+	The memory held by the pool, in bytes.
+	*/
+	std::size_t GetBytesReserved () const
+	{
+		return region_ ? regionSize_
+			: blocks_.size () * static_cast<std::size_t> (blockSize_);
+	}
+
+	/**
+	Release all allocations, but keep the blocks around for reuse.
+
+	Memory handed out after a reset is zero-initialized, just like fresh
+	memory.
+	*/
+	void Reset ()
+	{
+		allocations_ = 0;
+		bytesAllocated_ = 0;
+
+		if (region_) {
+			std::fill (region_, region_ + regionOffset_, 0);
+			regionOffset_ = 0;
+			return;
+		}
+
+		if (currentBlock_ == blocks_.end ()) {
+			return;
+		}
+
+		for (auto it = blocks_.begin (); it != currentBlock_; ++it) {
+			std::fill (it->begin (), it->end (), 0);
+		}
+
+		std::fill (currentBlock_->begin (), currentBlock_->begin () +
+			std::min (currentBlockOffset_, blockSize_), 0);
+
+		currentBlock_ = blocks_.end ();
+		currentBlockOffset_ = blockSize_;
+	}
+
+private:
+	void* AllocateFromRegion (int size)
+	{
+		if (size < 0 || static_cast<std::size_t> (size) > regionSize_ - regionOffset_) {
+			throw std::bad_alloc ();
+		}
+
+		auto result = region_ + regionOffset_;
+		const auto end = std::min (regionSize_,
+			regionOffset_ + ((static_cast<std::size_t> (size) + 7) / 8) * 8);
+
+		++allocations_;
+		bytesAllocated_ += end - regionOffset_;
+		regionOffset_ = end;
+
+		return result;
+	}
+
+	typedef std::list<std::vector<unsigned char>> BlockList;
+
+	int					blockSize_;
+	BlockList			blocks_;
+	BlockList::iterator	currentBlock_ = blocks_.end ();
+	int currentBlockOffset_ = blockSize_;
+
+	unsigned char*		region_ = nullptr;
+	std::size_t			regionSize_ = 0;
+	std::size_t			regionOffset_ = 0;
+
+	std::size_t			allocations_ = 0;
+	std::size_t			bytesAllocated_ = 0;
+};
+
+/**
+Closes a FILE on scope exit.
+*/
+struct FileCloser
+{
+	explicit FileCloser (std::FILE* file)
+	: file (file)
+	{
+	}
+
+	~FileCloser ()
+	{
+		if (file) {
+			std::fclose (file);
+		}
+	}
+
+	FileCloser (const FileCloser&) = delete;
+	FileCloser& operator= (const FileCloser&) = delete;
+
+	std::FILE* file;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+inline cliValue* CreateValue (Pool& pool, const char* value)
+{
+	auto v = pool.Allocate<cliValue> ();
+
+	const auto l = ::strlen (value);
+
+	// Pool will fail if this cast goes wrong
+	auto s = pool.Allocate (static_cast<int> (l) + 1);
+	::memcpy (s, value, l);
+	v->s = static_cast<const char*> (s);
+
+	return v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline cliValue* CreateValue (Pool& pool, const std::int64_t value)
+{
+	auto v = pool.Allocate<cliValue> ();
+	v->i = value;
+	return v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+inline cliValue* CreateValue (Pool& pool, const bool value)
+{
+	auto v = pool.Allocate<cliValue> ();
+	v->b = value;
+	return v;
+}
+
+typedef cliValue* (*CreateFunc)(Pool&, void*, std::size_t);
+
+/**
+The OpenCL entry points used by a gather. They are called through this table
+instead of directly, so a gather can bypass the ICD loader the library is
+linked against.
+*/
+struct ClApi
+{
+	cl_int (CL_API_CALL* GetPlatformIDs) (cl_uint, cl_platform_id*, cl_uint*);
+	cl_int (CL_API_CALL* GetPlatformInfo) (cl_platform_id, cl_platform_info,
+		std::size_t, void*, std::size_t*);
+	cl_int (CL_API_CALL* GetDeviceIDs) (cl_platform_id, cl_device_type,
+		cl_uint, cl_device_id*, cl_uint*);
+	cl_int (CL_API_CALL* GetDeviceInfo) (cl_device_id, cl_device_info,
+		std::size_t, void*, std::size_t*);
+	cl_context (CL_API_CALL* CreateContext) (const cl_context_properties*,
+		cl_uint, const cl_device_id*,
+		void (CL_CALLBACK*) (const char*, const void*, std::size_t, void*),
+		void*, cl_int*);
+	cl_int (CL_API_CALL* ReleaseContext) (cl_context);
+	cl_int (CL_API_CALL* GetSupportedImageFormats) (cl_context, cl_mem_flags,
+		cl_mem_object_type, cl_uint, cl_image_format*, cl_uint*);
+};
+
+/**
+The functions of the OpenCL library the library is linked against.
+*/
+const ClApi& GetLoaderApi ();
+
+/**
+Calls through the dispatch table at the start of every object created by an
+ICD, like the ICD loader does. GetPlatformIDs is null, use
+EnumerateIcdPlatforms instead.
+*/
+const ClApi& GetDispatchApi ();
+
+/**
+A platform enumerated directly from a vendor ICD.
+*/
+struct IcdPlatform
+{
+	cl_platform_id	id;
+
+	// The .icd file naming the library, empty if the library was named
+	// directly by OCL_ICD_FILENAMES
+	std::string		icdFile;
+	std::string		library;
+};
+
+/**
+Records the driver calls of a gather, see cliGatherOptions::recordFile.
+
+GetApi returns a table which forwards to the wrapped one, and records every
+call with its arguments, the exact bytes returned, and how long it took. The
+table is shared, so only one recorder can exist at a time; the constructor
+waits until the previous one has been destroyed. Must be destroyed on the
+thread which created it.
+*/
+class Recorder
+{
+public:
+	explicit Recorder (const ClApi& api);
+	~Recorder ();
+
+	Recorder (const Recorder&) = delete;
+	Recorder& operator= (const Recorder&) = delete;
+
+	const ClApi& GetApi () const;
+
+	/**
+	Record platforms which were not enumerated through the wrapped table,
+	as if clGetPlatformIDs had returned them.
+	*/
+	void AddPlatforms (const std::vector<cl_platform_id>& platforms);
+
+	/**
+	Write the calls recorded so far. Returns false if the file could not be
+	written.
+	*/
+	bool Save (const char* filename) const;
+
+	struct State;
+
+private:
+	std::unique_ptr<State>	state_;
+};
+
+#ifndef _WIN32
+/**
+Find the vendor ICDs like the ICD loader does, and enumerate their platforms
+through clIcdGetPlatformIDsKHR, without initializing any other ICD.
+
+The ICDs are the libraries listed in OCL_ICD_FILENAMES, separated by ':', or
+else the libraries named by the .icd files in OCL_ICD_VENDORS, which is a
+directory or a single file, or else in /etc/OpenCL/vendors. The libraries are
+loaded in parallel, and the platforms returned in the order of the file names.
+ICDs which fail to load are reported on stderr and skipped.
+
+The library handles are added to libraries, and must be kept until the
+platforms are no longer used.
+*/
+std::vector<IcdPlatform> EnumerateIcdPlatforms (
+	std::vector<std::shared_ptr<void>>& libraries);
+#endif
+
+/**
+A property which can change while the device is in use, and is thus re-queried
+by cliInfo_Refresh.
+*/
+struct VolatileProperty
+{
+	cl_device_info	info;
+	CreateFunc		cf;
+	cliProperty*	property;
+};
+
+struct DeviceEntry
+{
+	cl_device_id					id;
+	cliNode*						node;
+	std::vector<VolatileProperty>	volatileProperties;
+};
+
+struct PlatformEntry
+{
+	cl_platform_id				id;
+	cliNode*					node;
+	std::vector<DeviceEntry>	devices;
+};
+
+/**
+Selects what is gathered, see cliGatherOptions. A default constructed filter
+selects everything.
+*/
+struct GatherFilter
+{
+	bool Selects (const char* property) const
+	{
+		if (! filterProperties) {
+			return true;
+		}
+
+		for (const auto& p : properties) {
+			if (p == property) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool						filterProperties = false;
+	std::vector<std::string>	properties;
+
+	cl_device_type				deviceTypes = CL_DEVICE_TYPE_ALL;
+	bool						skipImageFormats = false;
+	bool						derived = false;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+inline GatherFilter CreateGatherFilter (const cliGatherOptions* options)
+{
+	GatherFilter filter;
+
+	if (options == nullptr) {
+		return filter;
+	}
+
+	if (options->properties) {
+		filter.filterProperties = true;
+
+		for (auto p = options->properties; *p; ++p) {
+			filter.properties.push_back (*p);
+		}
+	}
+
+	if (options->deviceTypes) {
+		filter.deviceTypes = static_cast<cl_device_type> (options->deviceTypes);
+	}
+
+	filter.skipImageFormats = (options->flags & CLI_GatherFlag_SkipImageFormats) != 0;
+	filter.derived = (options->flags & CLI_GatherFlag_Derived) != 0;
+
+	return filter;
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+struct cliInfo
+{
+	niv::Pool		pool;
+	struct cliNode*	root = nullptr;
+
+	std::vector<niv::PlatformEntry>	platforms;
+
+	// Properties changed by the last cliInfo_Refresh
+	std::vector<cliPropertyChange>	changes;
+
+	// Holds the short-lived values created while refreshing
+	niv::Pool		scratch {65536};
+
+	// Set if the tree was loaded from a snapshot, and cannot be refreshed
+	bool			loaded = false;
+
+	// Options of the last gather, used again by cliInfo_Refresh
+	int				flags = 0;
+	int				timeout = 0;
+	niv::GatherFilter	filter;
+
+	// Shared memory holding the platforms gathered by child processes, for
+	// CLI_GatherFlag_Isolate. The nodes are linked into the tree directly.
+	std::vector<std::shared_ptr<void>>	regions;
+
+	// The pools of the threads of CLI_GatherFlag_Parallel, which hold the
+	// nodes of the platforms they gathered
+	std::vector<std::unique_ptr<niv::Pool>>	pools;
+
+	// The vendor libraries loaded for CLI_GatherFlag_DirectIcd, which must
+	// stay loaded while the platforms are refreshed
+	std::vector<std::shared_ptr<void>>	libraries;
+	const niv::ClApi*	api = &niv::GetLoaderApi ();
+
+	// Set by the options, and cleared once the gather has been recorded, so
+	// a gather triggered by cliInfo_Refresh is not recorded again
+	std::string			recordFile;
+
+	std::thread			worker;
+	std::atomic<bool>	cancel {false};
+	std::atomic<bool>	busy {false};
+};
+
+#endif
@@ -0,0 +1,241 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "clInfoPredicate.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace niv {
+namespace {
+////////////////////////////////////////////////////////////////////////////////
+void SkipSpaces (const char*& p, const char* end)
+{
+	while (p != end && (*p == ' ' || *p == '\t')) {
+		++p;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Parse an integer, optionally followed by K, M, G or T for KiB, MiB, GiB and
+TiB.
+*/
+bool ParseInteger (const std::string& s, std::int64_t& result)
+{
+	if (s.empty ()) {
+		return false;
+	}
+
+	errno = 0;
+	char* end = nullptr;
+	result = std::strtoll (s.c_str (), &end, 0);
+
+	if (errno != 0 || end == s.c_str ()) {
+		return false;
+	}
+
+	int shift = 0;
+	switch (std::toupper (static_cast<unsigned char> (*end))) {
+	case 'K': shift = 10; break;
+	case 'M': shift = 20; break;
+	case 'G': shift = 30; break;
+	case 'T': shift = 40; break;
+	}
+
+	if (shift > 0) {
+		++end;
+
+		const auto limit = std::numeric_limits<std::int64_t>::max () >> shift;
+		if (result > limit || result < -limit) {
+			return false;
+		}
+
+		result *= static_cast<std::int64_t> (1) << shift;
+	}
+
+	return *end == '\0';
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool IsNameCharacter (const char c)
+{
+	return std::isalnum (static_cast<unsigned char> (c)) || c == '_';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const char* ParsePredicate (const char*& p, const char* end,
+	const char* terminators, PropertyPredicate& predicate)
+{
+	predicate = PropertyPredicate ();
+
+	const auto nameStart = p;
+	while (p != end && IsNameCharacter (*p)) {
+		++p;
+	}
+
+	predicate.property.assign (nameStart, p);
+
+	if (predicate.property.empty ()) {
+		return "Expected a property name";
+	}
+
+	SkipSpaces (p, end);
+
+	static const struct
+	{
+		const char*			text;
+		PredicateOperator	op;
+	} operators [] = {
+		// Longer operators first, so <= is not parsed as <
+		{ "!=", PredicateOperator_NotEqual },
+		{ "<=", PredicateOperator_LessEqual },
+		{ ">=", PredicateOperator_GreaterEqual },
+		{ "=", PredicateOperator_Equal },
+		{ "<", PredicateOperator_Less },
+		{ ">", PredicateOperator_Greater },
+		{ "~", PredicateOperator_Contains }
+	};
+
+	for (const auto& o : operators) {
+		const auto length = ::strlen (o.text);
+
+		if (static_cast<std::size_t> (end - p) >= length &&
+			::strncmp (p, o.text, length) == 0) {
+			predicate.op = o.op;
+			p += length;
+			break;
+		}
+	}
+
+	if (predicate.op == PredicateOperator_Exists) {
+		return nullptr;
+	}
+
+	SkipSpaces (p, end);
+
+	if (p != end && *p == '"') {
+		const auto start = ++p;
+		while (p != end && *p != '"') {
+			++p;
+		}
+
+		if (p == end) {
+			return "Unterminated string";
+		}
+
+		predicate.value.assign (start, p);
+		++p;
+	} else {
+		const auto start = p;
+		while (p != end && ! ::strchr (terminators, *p)) {
+			++p;
+		}
+
+		auto valueEnd = p;
+		while (valueEnd > start && (valueEnd [-1] == ' ' || valueEnd [-1] == '\t')) {
+			--valueEnd;
+		}
+
+		predicate.value.assign (start, valueEnd);
+
+		if (predicate.value.empty ()) {
+			return "Expected a value";
+		}
+	}
+
+	predicate.isNumber = ParseInteger (predicate.value, predicate.number);
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool ApplyOperator (const int order, const PredicateOperator op)
+{
+	switch (op) {
+	case PredicateOperator_Equal: return order == 0;
+	case PredicateOperator_NotEqual: return order != 0;
+	case PredicateOperator_Less: return order < 0;
+	case PredicateOperator_LessEqual: return order <= 0;
+	case PredicateOperator_Greater: return order > 0;
+	case PredicateOperator_GreaterEqual: return order >= 0;
+	default: return false;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool EqualsEnumValue (const char* value, const std::string& expected)
+{
+	if (expected == value) {
+		return true;
+	}
+
+	const auto length = ::strlen (value);
+	return length > expected.size () &&
+		value [length - expected.size () - 1] == '_' &&
+		expected == value + (length - expected.size ());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool MatchesPredicate (const cliProperty* property,
+	const PropertyPredicate& predicate)
+{
+	if (property == nullptr) {
+		return false;
+	}
+
+	if (predicate.op == PredicateOperator_Exists) {
+		if (property->type != CLI_PropertyType_Bool) {
+			return true;
+		}
+
+		for (auto v = property->value; v; v = v->next) {
+			if (v->b) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// != holds if no value is equal
+	const auto op = predicate.op == PredicateOperator_NotEqual
+		? PredicateOperator_Equal : predicate.op;
+
+	bool found = false;
+
+	for (auto v = property->value; v && ! found; v = v->next) {
+		switch (property->type) {
+		case CLI_PropertyType_Int64:
+			if (predicate.isNumber && op != PredicateOperator_Contains) {
+				found = ApplyOperator ((v->i > predicate.number) -
+					(v->i < predicate.number), op);
+			}
+			break;
+
+		case CLI_PropertyType_Bool:
+			if (op == PredicateOperator_Equal) {
+				found = predicate.value == (v->b ? "true" : "false");
+			}
+			break;
+
+		case CLI_PropertyType_String:
+			if (op == PredicateOperator_Equal) {
+				found = EqualsEnumValue (v->s, predicate.value);
+			} else if (op == PredicateOperator_Contains) {
+				found = ::strstr (v->s, predicate.value.c_str ()) != nullptr;
+			} else {
+				found = ApplyOperator (::strcmp (v->s, predicate.value.c_str ()),
+					op);
+			}
+			break;
+		}
+	}
+
+	return predicate.op == PredicateOperator_NotEqual ? ! found : found;
+}
+}
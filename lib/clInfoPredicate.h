@@ -0,0 +1,80 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#ifndef NIV_CLINFO_PREDICATE_H_167E51E70E3479507DF10932075BCCAE02C8E298
+#define NIV_CLINFO_PREDICATE_H_167E51E70E3479507DF10932075BCCAE02C8E298
+
+/*
+Property predicates, as used by requirement manifests, the queries of the
+command line tool and the fleet index. Shared by the library and the tools,
+and not part of the C API.
+*/
+
+#include "clInfo.h"
+
+#include <cstdint>
+#include <string>
+
+namespace niv {
+enum PredicateOperator
+{
+	PredicateOperator_Exists,
+	PredicateOperator_Equal,
+	PredicateOperator_NotEqual,
+	PredicateOperator_Less,
+	PredicateOperator_LessEqual,
+	PredicateOperator_Greater,
+	PredicateOperator_GreaterEqual,
+	PredicateOperator_Contains
+};
+
+/**
+NAME, or NAME op value, where op is one of = != < <= > >= and ~ (contains).
+*/
+struct PropertyPredicate
+{
+	std::string			property;
+	PredicateOperator	op = PredicateOperator_Exists;
+	std::string			value;
+
+	// Set if value is an integer, for comparing integer properties
+	bool				isNumber = false;
+	std::int64_t		number = 0;
+};
+
+bool IsNameCharacter (char c);
+
+/**
+Parse a predicate starting at p, which must point at a name character, and
+advance p past it. Without an operator, p is left after the spaces following
+the name. Values can be quoted; otherwise, they end at end or at any of the
+characters in terminators, and trailing spaces are removed. Integers may end
+in K, M, G or T to multiply them by powers of 1024.
+
+Returns null on success. Otherwise, returns the error message, and p points
+at the error.
+*/
+const char* ParsePredicate (const char*& p, const char* end,
+	const char* terminators, PropertyPredicate& predicate);
+
+/**
+Apply op to the result of a three-way comparison.
+*/
+bool ApplyOperator (int order, PredicateOperator op);
+
+/**
+Compare a string to the value of an = predicate. This also accepts a value
+ending in '_' followed by expected, so CL_DEVICE_TYPE_GPU matches GPU.
+*/
+bool EqualsEnumValue (const char* value, const std::string& expected);
+
+/**
+Check whether a property matches a predicate. Integers are compared as
+numbers, and for properties with several values, one of them has to match,
+or none of them for !=. A missing property, that is null, never matches.
+*/
+bool MatchesPredicate (const cliProperty* property,
+	const PropertyPredicate& predicate);
+}
+
+#endif
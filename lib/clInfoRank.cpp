@@ -0,0 +1,312 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "clInfo.h"
+#include "clInfoInternal.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+/**
+The values of a device which are used for ranking.
+*/
+struct Candidate
+{
+	cliRankedDevice	device;
+
+	std::uint64_t	type;
+	double			compute;
+	double			memory;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+const cliNode* FindChild (const cliNode* node, const char* name)
+{
+	for (auto c = node->firstChild; c; c = c->next) {
+		if (::strcmp (c->name, name) == 0) {
+			return c;
+		}
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const cliProperty* FindProperty (const cliNode* node, const char* name)
+{
+	for (auto p = node->firstProperty; p; p = p->next) {
+		if (::strcmp (p->name, name) == 0) {
+			return p;
+		}
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::int64_t GetInt (const cliNode* node, const char* name)
+{
+	const auto p = FindProperty (node, name);
+
+	if (p && p->type == CLI_PropertyType_Int64 && p->value) {
+		return p->value->i;
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+The device type is a string like CL_DEVICE_TYPE_GPU when gathered, and may
+hold several types.
+*/
+std::uint64_t GetDeviceType (const cliNode* device)
+{
+	static const struct
+	{
+		const char*		name;
+		std::uint64_t	bit;
+	} types [] = {
+		{ "CL_DEVICE_TYPE_DEFAULT", CL_DEVICE_TYPE_DEFAULT },
+		{ "CL_DEVICE_TYPE_CPU", CL_DEVICE_TYPE_CPU },
+		{ "CL_DEVICE_TYPE_GPU", CL_DEVICE_TYPE_GPU },
+		{ "CL_DEVICE_TYPE_ACCELERATOR", CL_DEVICE_TYPE_ACCELERATOR },
+#ifdef CL_VERSION_1_2
+		{ "CL_DEVICE_TYPE_CUSTOM", CL_DEVICE_TYPE_CUSTOM }
+#endif
+	};
+
+	const auto p = FindProperty (device, "CL_DEVICE_TYPE");
+	if (p == nullptr) {
+		return 0;
+	}
+
+	std::uint64_t result = 0;
+
+	for (auto v = p->value; v; v = v->next) {
+		if (p->type == CLI_PropertyType_Int64) {
+			result |= static_cast<std::uint64_t> (v->i);
+			continue;
+		}
+
+		if (p->type != CLI_PropertyType_String) {
+			continue;
+		}
+
+		for (const auto& t : types) {
+			if (::strcmp (v->s, t.name) == 0) {
+				result |= t.bit;
+			}
+		}
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool MeetsRequirements (const cliNode* platform, const cliNode* device,
+	const cliRankCriteria& criteria)
+{
+	const auto available = FindProperty (device, "CL_DEVICE_AVAILABLE");
+	if (available && available->type == CLI_PropertyType_Bool &&
+		available->value && ! available->value->b) {
+		return false;
+	}
+
+	if (criteria.minimumMajorVersion > 0 || criteria.minimumMinorVersion > 0) {
+		const auto version = FindProperty (device, "CL_DEVICE_VERSION");
+		int major = 0, minor = 0;
+
+		// "OpenCL <major>.<minor> <vendor-specific information>"
+		if (version == nullptr || version->type != CLI_PropertyType_String ||
+			version->value == nullptr ||
+			std::sscanf (version->value->s, "OpenCL %d.%d", &major, &minor) != 2) {
+			return false;
+		}
+
+		if (major < criteria.minimumMajorVersion ||
+			(major == criteria.minimumMajorVersion &&
+				minor < criteria.minimumMinorVersion)) {
+			return false;
+		}
+	}
+
+	if (criteria.requiredExtensions) {
+		const auto deviceExtensions = FindProperty (device, "CL_DEVICE_EXTENSIONS");
+		const auto platformExtensions = FindProperty (platform,
+			"CL_PLATFORM_EXTENSIONS");
+
+		const auto contains = [] (const cliProperty* p, const char* name) -> bool {
+			if (p == nullptr || p->type != CLI_PropertyType_String) {
+				return false;
+			}
+
+			for (auto v = p->value; v; v = v->next) {
+				if (::strcmp (v->s, name) == 0) {
+					return true;
+				}
+			}
+
+			return false;
+		};
+
+		for (auto e = criteria.requiredExtensions; *e; ++e) {
+			if (! contains (deviceExtensions, *e) &&
+				! contains (platformExtensions, *e)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Gather only the properties needed to rank by criteria.
+*/
+int GatherForRanking (cliInfo* info, const cliRankCriteria& criteria)
+{
+	// The name identifies the device for the caller
+	std::vector<const char*> properties = {
+		"CL_DEVICE_NAME", "CL_DEVICE_AVAILABLE"
+	};
+
+	if (criteria.typeWeight != 0) {
+		properties.push_back ("CL_DEVICE_TYPE");
+	}
+
+	if (criteria.computeWeight != 0) {
+		properties.push_back ("CL_DEVICE_MAX_COMPUTE_UNITS");
+		properties.push_back ("CL_DEVICE_MAX_CLOCK_FREQUENCY");
+	}
+
+	if (criteria.memoryWeight != 0) {
+		properties.push_back ("CL_DEVICE_GLOBAL_MEM_SIZE");
+	}
+
+	if (criteria.requiredExtensions) {
+		properties.push_back ("CL_DEVICE_EXTENSIONS");
+		properties.push_back ("CL_PLATFORM_EXTENSIONS");
+	}
+
+	if (criteria.minimumMajorVersion > 0 || criteria.minimumMinorVersion > 0) {
+		properties.push_back ("CL_DEVICE_VERSION");
+	}
+
+	properties.push_back (nullptr);
+
+	cliGatherOptions options = {};
+	options.flags = CLI_GatherFlag_SkipImageFormats;
+	options.properties = properties.data ();
+
+	return cliInfo_GatherWithOptions (info, &options);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void* FindDeviceId (const cliInfo* info, const cliNode* device)
+{
+	for (const auto& platform : info->platforms) {
+		for (const auto& entry : platform.devices) {
+			if (entry.node == device) {
+				return entry.id;
+			}
+		}
+	}
+
+	return nullptr;
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_RankDevices (cliInfo* info, const cliRankCriteria* criteria,
+	cliRankedDevice* devices, int* count)
+{
+	if (info == nullptr || criteria == nullptr || count == nullptr ||
+		*count < 0 || info->busy) {
+		return CLI_Error;
+	}
+
+	if (info->root == nullptr &&
+		GatherForRanking (info, *criteria) != CLI_Success) {
+		return CLI_Error;
+	}
+
+	try {
+		std::vector<Candidate> candidates;
+		double bestCompute = 0;
+		double bestMemory = 0;
+
+		int platformIndex = 0;
+		for (auto platform = info->root->firstChild; platform;
+			platform = platform->next, ++platformIndex) {
+			const auto devicesNode = FindChild (platform, "Devices");
+
+			if (devicesNode == nullptr) {
+				continue;
+			}
+
+			int deviceIndex = 0;
+			for (auto device = devicesNode->firstChild; device;
+				device = device->next, ++deviceIndex) {
+				if (! MeetsRequirements (platform, device, *criteria)) {
+					continue;
+				}
+
+				Candidate c;
+				c.device.platformIndex = platformIndex;
+				c.device.deviceIndex = deviceIndex;
+				c.device.device = device;
+				c.device.id = FindDeviceId (info, device);
+				c.device.score = 0;
+				c.type = GetDeviceType (device);
+				c.compute = static_cast<double> (
+					GetInt (device, "CL_DEVICE_MAX_COMPUTE_UNITS")) *
+					static_cast<double> (GetInt (device, "CL_DEVICE_MAX_CLOCK_FREQUENCY"));
+				c.memory = static_cast<double> (
+					GetInt (device, "CL_DEVICE_GLOBAL_MEM_SIZE"));
+
+				bestCompute = std::max (bestCompute, c.compute);
+				bestMemory = std::max (bestMemory, c.memory);
+
+				candidates.push_back (c);
+			}
+		}
+
+		for (auto& c : candidates) {
+			auto& score = c.device.score;
+
+			if (c.type & criteria->deviceTypes) {
+				score += criteria->typeWeight;
+			}
+
+			if (bestCompute > 0) {
+				score += criteria->computeWeight * c.compute / bestCompute;
+			}
+
+			if (bestMemory > 0) {
+				score += criteria->memoryWeight * c.memory / bestMemory;
+			}
+		}
+
+		std::stable_sort (candidates.begin (), candidates.end (),
+			[] (const Candidate& a, const Candidate& b) -> bool {
+				return a.device.score > b.device.score;
+		});
+
+		const auto capacity = devices ? static_cast<std::size_t> (*count) : 0;
+
+		for (std::size_t i = 0; i < candidates.size () && i < capacity; ++i) {
+			devices [i] = candidates [i].device;
+		}
+
+		*count = static_cast<int> (candidates.size ());
+	} catch (const std::exception&) {
+		return CLI_Error;
+	}
+
+	return CLI_Success;
+}
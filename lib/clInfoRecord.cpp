@@ -0,0 +1,425 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "clInfo.h"
+#include "clInfoInternal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*
+Recording file format. All integers are unsigned LEB128 varints unless noted
+otherwise; signed values are zig-zag encoded first.
+
+	magic			"CLIR"
+	version			byte, currently 1
+	sizeofSizeT		byte, the size of size_t on the recording machine
+	records			until the end of the file
+
+A record describes one call:
+
+	call			byte, a RecordedCall
+	flags			byte, combination of RecordFlags
+	object			the platform or device the call was made for, 0 for
+					clGetPlatformIDs
+	param			the info code, the device type for clGetDeviceIDs,
+					the image type for clGetSupportedImageFormats
+	memFlags		only for clGetSupportedImageFormats
+	requested		the size of the buffer in bytes, or the number of
+					entries, or the number of devices for clCreateContext
+	result			signed, the error code
+	duration		nanoseconds spent in the driver
+	returned		only if RecordFlag_HasSize is set; the size or count the
+					driver returned
+	payloadSize		followed by payloadSize bytes
+
+Platforms and devices are identified by the order in which they were first
+returned, starting at 1. The payload of clGetPlatformIDs and clGetDeviceIDs is
+the list of object numbers, one varint each. For all other calls, it is what
+the driver wrote into the buffer of the caller, byte for byte: the first
+'returned' bytes or entries if the size was requested, the whole buffer
+otherwise. Values which hold handles, like CL_DEVICE_PLATFORM, are thus stored
+as the handle values of the recording process.
+*/
+
+namespace {
+const char RecordingMagic [4] = {'C', 'L', 'I', 'R'};
+const int RecordingVersion = 1;
+
+enum RecordedCall
+{
+	RecordedCall_GetPlatformIDs = 1,
+	RecordedCall_GetPlatformInfo = 2,
+	RecordedCall_GetDeviceIDs = 3,
+	RecordedCall_GetDeviceInfo = 4,
+	RecordedCall_CreateContext = 5,
+	RecordedCall_GetSupportedImageFormats = 6
+};
+
+enum RecordFlags
+{
+	// The caller passed a buffer for the value
+	RecordFlag_HasValue = 1,
+	// The caller asked for the size or count
+	RecordFlag_HasSize = 2
+};
+
+typedef std::chrono::steady_clock Clock;
+
+////////////////////////////////////////////////////////////////////////////////
+void AppendVarint (std::vector<unsigned char>& buffer, std::uint64_t value)
+{
+	while (value >= 0x80) {
+		buffer.push_back (static_cast<unsigned char> (value | 0x80));
+		value >>= 7;
+	}
+
+	buffer.push_back (static_cast<unsigned char> (value));
+}
+
+/**
+The recorder whose table is in use. Guarded by the mutex, which the recorder
+holds while it exists.
+*/
+std::mutex recorderMutex;
+niv::Recorder::State* current = nullptr;
+}
+
+namespace niv {
+struct Recorder::State
+{
+	explicit State (const ClApi& api)
+	: api (api)
+	, lock (recorderMutex)
+	{
+	}
+
+	/**
+	The number of an object, assigned when it is seen for the first time.
+	*/
+	std::uint64_t GetObject (const void* object)
+	{
+		if (object == nullptr) {
+			return 0;
+		}
+
+		const auto it = objects.find (object);
+		if (it != objects.end ()) {
+			return it->second;
+		}
+
+		const auto number = static_cast<std::uint64_t> (objects.size () + 1);
+		objects [object] = number;
+
+		return number;
+	}
+
+	void Record (const RecordedCall call, const void* object,
+		const std::uint64_t param, const std::uint64_t requested,
+		const bool hasValue, const std::uint64_t* returned, const cl_int result,
+		const Clock::duration elapsed, const void* payload,
+		const std::size_t payloadSize, const cl_mem_flags* memFlags = nullptr)
+	{
+		const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds> (
+			elapsed).count ();
+
+		data.push_back (static_cast<unsigned char> (call));
+		data.push_back (static_cast<unsigned char> (
+			(hasValue ? RecordFlag_HasValue : 0) |
+			(returned ? RecordFlag_HasSize : 0)));
+		AppendVarint (data, GetObject (object));
+		AppendVarint (data, param);
+
+		if (memFlags) {
+			AppendVarint (data, *memFlags);
+		}
+
+		AppendVarint (data, requested);
+		AppendVarint (data, (static_cast<std::uint64_t> (result) << 1) ^
+			static_cast<std::uint64_t> (static_cast<std::int64_t> (result) >> 63));
+		AppendVarint (data, static_cast<std::uint64_t> (std::max<std::int64_t> (
+			duration, 0)));
+
+		if (returned) {
+			AppendVarint (data, *returned);
+		}
+
+		AppendVarint (data, payloadSize);
+
+		const auto bytes = static_cast<const unsigned char*> (payload);
+		data.insert (data.end (), bytes, bytes + payloadSize);
+	}
+
+	template <typename T>
+	void RecordObjects (const RecordedCall call, const void* object,
+		const std::uint64_t param, const cl_uint numEntries, const T* entries,
+		const cl_uint* count, const cl_int result, const Clock::duration elapsed)
+	{
+		std::vector<unsigned char> payload;
+
+		if (entries && result == CL_SUCCESS) {
+			const auto n = count ? std::min (numEntries, *count) : numEntries;
+
+			for (cl_uint i = 0; i < n; ++i) {
+				AppendVarint (payload, GetObject (entries [i]));
+			}
+		}
+
+		const std::uint64_t returned = count ? *count : 0;
+		Record (call, object, param, numEntries, entries != nullptr,
+			count ? &returned : nullptr, result, elapsed, payload.data (),
+			payload.size ());
+	}
+
+	void RecordInfo (const RecordedCall call, const void* object,
+		const std::uint64_t param, const std::size_t size, const void* value,
+		const std::size_t* sizeRet, const cl_int result,
+		const Clock::duration elapsed)
+	{
+		std::size_t payloadSize = 0;
+
+		if (value && result == CL_SUCCESS) {
+			payloadSize = sizeRet ? std::min (size, *sizeRet) : size;
+		}
+
+		const std::uint64_t returned = sizeRet ? *sizeRet : 0;
+		Record (call, object, param, size, value != nullptr,
+			sizeRet ? &returned : nullptr, result, elapsed, value, payloadSize);
+	}
+
+	const ClApi&	api;
+	std::unique_lock<std::mutex>	lock;
+
+	// Guards the members below, as a gather may call from several threads
+	std::mutex		mutex;
+
+	std::vector<unsigned char>	data;
+	std::unordered_map<const void*, std::uint64_t>	objects;
+
+	// The device each context was created for, as the image formats are
+	// recorded per device
+	std::unordered_map<cl_context, cl_device_id>	contexts;
+};
+}
+
+namespace {
+using namespace niv;
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL RecordGetPlatformIDs (cl_uint numEntries,
+	cl_platform_id* platforms, cl_uint* numPlatforms)
+{
+	const auto start = Clock::now ();
+	const auto result = current->api.GetPlatformIDs (numEntries, platforms,
+		numPlatforms);
+	const auto elapsed = Clock::now () - start;
+
+	std::lock_guard<std::mutex> lock (current->mutex);
+
+	current->RecordObjects (RecordedCall_GetPlatformIDs, nullptr, 0,
+		numEntries, platforms, numPlatforms, result, elapsed);
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL RecordGetPlatformInfo (cl_platform_id platform,
+	cl_platform_info info, std::size_t size, void* value, std::size_t* sizeRet)
+{
+	const auto start = Clock::now ();
+	const auto result = current->api.GetPlatformInfo (platform, info, size,
+		value, sizeRet);
+	const auto elapsed = Clock::now () - start;
+
+	std::lock_guard<std::mutex> lock (current->mutex);
+
+	current->RecordInfo (RecordedCall_GetPlatformInfo, platform, info, size,
+		value, sizeRet, result, elapsed);
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL RecordGetDeviceIDs (cl_platform_id platform,
+	cl_device_type type, cl_uint numEntries, cl_device_id* devices,
+	cl_uint* numDevices)
+{
+	const auto start = Clock::now ();
+	const auto result = current->api.GetDeviceIDs (platform, type, numEntries,
+		devices, numDevices);
+	const auto elapsed = Clock::now () - start;
+
+	std::lock_guard<std::mutex> lock (current->mutex);
+
+	current->RecordObjects (RecordedCall_GetDeviceIDs, platform, type,
+		numEntries, devices, numDevices, result, elapsed);
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL RecordGetDeviceInfo (cl_device_id device,
+	cl_device_info info, std::size_t size, void* value, std::size_t* sizeRet)
+{
+	const auto start = Clock::now ();
+	const auto result = current->api.GetDeviceInfo (device, info, size, value,
+		sizeRet);
+	const auto elapsed = Clock::now () - start;
+
+	std::lock_guard<std::mutex> lock (current->mutex);
+
+	current->RecordInfo (RecordedCall_GetDeviceInfo, device, info, size,
+		value, sizeRet, result, elapsed);
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_context CL_API_CALL RecordCreateContext (
+	const cl_context_properties* properties, cl_uint numDevices,
+	const cl_device_id* devices,
+	void (CL_CALLBACK* notify) (const char*, const void*, std::size_t, void*),
+	void* userdata, cl_int* error)
+{
+	// The error is needed for the record even if the caller ignores it
+	cl_int result = CL_SUCCESS;
+
+	const auto start = Clock::now ();
+	const auto context = current->api.CreateContext (properties, numDevices,
+		devices, notify, userdata, &result);
+
+	if (error) {
+		*error = result;
+	}
+
+	const auto device = (numDevices > 0 && devices) ? devices [0] : nullptr;
+	const auto elapsed = Clock::now () - start;
+
+	std::lock_guard<std::mutex> lock (current->mutex);
+
+	if (context) {
+		current->contexts [context] = device;
+	}
+
+	current->Record (RecordedCall_CreateContext, device, 0, numDevices, false,
+		nullptr, result, elapsed, nullptr, 0);
+
+	return context;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL RecordReleaseContext (cl_context context)
+{
+	{
+		std::lock_guard<std::mutex> lock (current->mutex);
+		current->contexts.erase (context);
+	}
+
+	return current->api.ReleaseContext (context);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL RecordGetSupportedImageFormats (cl_context context,
+	cl_mem_flags flags, cl_mem_object_type type, cl_uint numEntries,
+	cl_image_format* formats, cl_uint* numFormats)
+{
+	const auto start = Clock::now ();
+	const auto result = current->api.GetSupportedImageFormats (context, flags,
+		type, numEntries, formats, numFormats);
+	const auto elapsed = Clock::now () - start;
+
+	std::lock_guard<std::mutex> lock (current->mutex);
+
+	const auto it = current->contexts.find (context);
+	const auto device = (it == current->contexts.end ()) ? nullptr : it->second;
+
+	std::size_t payloadSize = 0;
+	if (formats && result == CL_SUCCESS) {
+		payloadSize = sizeof (cl_image_format) *
+			(numFormats ? std::min (numEntries, *numFormats) : numEntries);
+	}
+
+	const std::uint64_t returned = numFormats ? *numFormats : 0;
+	current->Record (RecordedCall_GetSupportedImageFormats, device, type,
+		numEntries, formats != nullptr, numFormats ? &returned : nullptr,
+		result, elapsed, formats, payloadSize, &flags);
+
+	return result;
+}
+}
+
+namespace niv {
+////////////////////////////////////////////////////////////////////////////////
+Recorder::Recorder (const ClApi& api)
+: state_ (new State (api))
+{
+	current = state_.get ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Recorder::~Recorder ()
+{
+	current = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const ClApi& Recorder::GetApi () const
+{
+	static const ClApi api = {
+		RecordGetPlatformIDs,
+		RecordGetPlatformInfo,
+		RecordGetDeviceIDs,
+		RecordGetDeviceInfo,
+		RecordCreateContext,
+		RecordReleaseContext,
+		RecordGetSupportedImageFormats
+	};
+
+	static const ClApi dispatchApi = {
+		nullptr,
+		RecordGetPlatformInfo,
+		RecordGetDeviceIDs,
+		RecordGetDeviceInfo,
+		RecordCreateContext,
+		RecordReleaseContext,
+		RecordGetSupportedImageFormats
+	};
+
+	// Platforms are enumerated elsewhere if the wrapped table cannot
+	return state_->api.GetPlatformIDs ? api : dispatchApi;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Recorder::AddPlatforms (const std::vector<cl_platform_id>& platforms)
+{
+	const auto count = static_cast<cl_uint> (platforms.size ());
+
+	state_->RecordObjects (RecordedCall_GetPlatformIDs, nullptr, 0, count,
+		platforms.data (), &count, CL_SUCCESS, Clock::duration::zero ());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Recorder::Save (const char* filename) const
+{
+	FileCloser file (std::fopen (filename, "wb"));
+
+	if (file.file == nullptr) {
+		return false;
+	}
+
+	unsigned char header [6];
+	std::copy (RecordingMagic, RecordingMagic + 4, header);
+	header [4] = RecordingVersion;
+	header [5] = sizeof (std::size_t);
+
+	const auto& data = state_->data;
+
+	return std::fwrite (header, 1, sizeof (header), file.file) == sizeof (header) &&
+		std::fwrite (data.data (), 1, data.size (), file.file) == data.size () &&
+		std::fflush (file.file) == 0;
+}
+}
@@ -0,0 +1,512 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "clInfo.h"
+#include "clInfoInternal.h"
+#include "clInfoPredicate.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+Requirements are compiled into a list which is checked in the order of the
+manifest. The property names used by all requirements are sorted, so while
+evaluating, a single pass over the properties of a device and its platform,
+with a binary search per property, finds everything the requirements look at.
+No memory is allocated per device.
+*/
+
+namespace {
+enum RequirementKind
+{
+	RequirementKind_Property,
+	RequirementKind_Extension,
+	RequirementKind_ImageFormat
+};
+
+struct Requirement
+{
+	RequirementKind			kind;
+
+	std::string				text;
+	int						line;
+
+	// The predicate, and the index of its property in the sorted names of all
+	// properties
+	niv::PropertyPredicate	predicate;
+	int						slot;
+
+	// The name of the extension
+	std::string				extension;
+
+	// For image formats, empty strings match any
+	std::string				objectType;
+	std::string				channelOrder;
+	std::string				channelDataType;
+};
+
+struct CompileError : public std::runtime_error
+{
+	explicit CompileError (const std::string& what)
+	: std::runtime_error (what)
+	{
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+void SkipSpaces (const char*& p, const char* end)
+{
+	while (p != end && (*p == ' ' || *p == '\t')) {
+		++p;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+[[noreturn]] void Fail (const char* message, const int line)
+{
+	throw CompileError ("Line " + std::to_string (line) + ": " + message);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string ParseWord (const char*& p, const char* end)
+{
+	const auto start = p;
+	while (p != end && *p != ' ' && *p != '\t') {
+		++p;
+	}
+
+	return std::string (start, p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool ContainsString (const cliProperty* property, const std::string& s)
+{
+	if (property == nullptr || property->type != CLI_PropertyType_String) {
+		return false;
+	}
+
+	for (auto v = property->value; v; v = v->next) {
+		if (s == v->s) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const char* GetString (const cliNode* node, const char* name)
+{
+	for (auto p = node->firstProperty; p; p = p->next) {
+		if (p->type == CLI_PropertyType_String && p->value &&
+			::strcmp (p->name, name) == 0) {
+			return p->value->s;
+		}
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool MatchesPattern (const std::string& pattern, const char* value)
+{
+	return pattern.empty () || (value && pattern == value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool SupportsImageFormat (const cliNode* device, const Requirement& requirement)
+{
+	for (auto formats = device->firstChild; formats; formats = formats->next) {
+		if (::strcmp (formats->name, "ImageFormats") != 0) {
+			continue;
+		}
+
+		for (auto type = formats->firstChild; type; type = type->next) {
+			if (! MatchesPattern (requirement.objectType, type->kind)) {
+				continue;
+			}
+
+			for (auto format = type->firstChild; format; format = format->next) {
+				if (MatchesPattern (requirement.channelOrder,
+						GetString (format, "ChannelOrder")) &&
+					MatchesPattern (requirement.channelDataType,
+						GetString (format, "ChannelDataType"))) {
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const cliNode* FindChild (const cliNode* node, const char* name)
+{
+	for (auto c = node->firstChild; c; c = c->next) {
+		if (::strcmp (c->name, name) == 0) {
+			return c;
+		}
+	}
+
+	return nullptr;
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+struct cliRequirements
+{
+	std::vector<Requirement>	requirements;
+
+	// Sorted names of all properties used by the requirements
+	std::vector<std::string>	names;
+
+	// Slots of the extension lists, or -1 if no extension is required
+	int							deviceExtensions = -1;
+	int							platformExtensions = -1;
+
+	int FindSlot (const char* name) const
+	{
+		auto first = 0;
+		auto last = static_cast<int> (names.size ());
+
+		while (first < last) {
+			const auto middle = (first + last) / 2;
+			const auto order = ::strcmp (names [middle].c_str (), name);
+
+			if (order == 0) {
+				return middle;
+			} else if (order < 0) {
+				first = middle + 1;
+			} else {
+				last = middle;
+			}
+		}
+
+		return -1;
+	}
+
+	void AddProperties (const cliNode* node, const cliProperty** slots) const
+	{
+		for (auto p = node->firstProperty; p; p = p->next) {
+			const auto slot = FindSlot (p->name);
+
+			if (slot >= 0) {
+				slots [slot] = p;
+			}
+		}
+	}
+
+	/**
+	Find the first requirement the device does not meet, or null.
+	*/
+	const Requirement* Check (const cliNode* platform, const cliNode* device,
+		const cliProperty** slots) const
+	{
+		std::fill (slots, slots + names.size (), nullptr);
+
+		// Device properties take precedence
+		AddProperties (platform, slots);
+		AddProperties (device, slots);
+
+		for (const auto& r : requirements) {
+			bool met = false;
+
+			switch (r.kind) {
+			case RequirementKind_Property:
+				met = niv::MatchesPredicate (slots [r.slot], r.predicate);
+				break;
+
+			case RequirementKind_Extension:
+				met = ContainsString (slots [deviceExtensions], r.extension) ||
+					ContainsString (slots [platformExtensions], r.extension);
+				break;
+
+			case RequirementKind_ImageFormat:
+				met = SupportsImageFormat (device, r);
+				break;
+			}
+
+			if (! met) {
+				return &r;
+			}
+		}
+
+		return nullptr;
+	}
+};
+
+namespace {
+////////////////////////////////////////////////////////////////////////////////
+Requirement ParseRequirement (const char* p, const char* end, const int line)
+{
+	Requirement r;
+	r.kind = RequirementKind_Property;
+	r.text.assign (p, end);
+	r.line = line;
+	r.slot = -1;
+
+	const auto nameStart = p;
+	while (p != end && niv::IsNameCharacter (*p)) {
+		++p;
+	}
+
+	const std::string name (nameStart, p);
+
+	if (name.empty ()) {
+		Fail ("Expected a property name, 'extension' or 'image'", line);
+	}
+
+	SkipSpaces (p, end);
+
+	if (name == "extension") {
+		r.kind = RequirementKind_Extension;
+		r.extension = ParseWord (p, end);
+
+		if (r.extension.empty ()) {
+			Fail ("Expected an extension name", line);
+		}
+	} else if (name == "image") {
+		r.kind = RequirementKind_ImageFormat;
+
+		std::string* parts [] = { &r.objectType, &r.channelOrder,
+			&r.channelDataType };
+
+		for (auto part : parts) {
+			SkipSpaces (p, end);
+			*part = ParseWord (p, end);
+
+			if (part->empty ()) {
+				Fail ("Expected an object type, channel order and data type",
+					line);
+			}
+
+			if (*part == "*") {
+				part->clear ();
+			}
+		}
+	} else {
+		p = nameStart;
+
+		if (const auto message = niv::ParsePredicate (p, end, "", r.predicate)) {
+			Fail (message, line);
+		}
+
+		if (r.predicate.op == niv::PredicateOperator_Exists && p != end) {
+			Fail ("Expected an operator", line);
+		}
+	}
+
+	SkipSpaces (p, end);
+
+	if (p != end) {
+		Fail ("Unexpected text after the requirement", line);
+	}
+
+	return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Compile (const char* manifest, cliRequirements& requirements)
+{
+	int line = 1;
+
+	for (auto p = manifest; *p; ++line) {
+		auto end = p;
+		bool quoted = false;
+
+		// The requirement ends at a comment or the end of the line
+		while (*end && *end != '\n' && (quoted || *end != '#')) {
+			if (*end == '"') {
+				quoted = ! quoted;
+			}
+
+			++end;
+		}
+
+		auto next = end;
+		while (*next && *next != '\n') {
+			++next;
+		}
+
+		if (*next == '\n') {
+			++next;
+		}
+
+		SkipSpaces (p, end);
+
+		while (end > p && std::isspace (static_cast<unsigned char> (end [-1]))) {
+			--end;
+		}
+
+		if (p != end) {
+			requirements.requirements.push_back (ParseRequirement (p, end, line));
+		}
+
+		p = next;
+	}
+
+	auto& names = requirements.names;
+
+	for (auto& r : requirements.requirements) {
+		if (r.kind == RequirementKind_Property) {
+			names.push_back (r.predicate.property);
+		} else if (r.kind == RequirementKind_Extension) {
+			names.push_back ("CL_DEVICE_EXTENSIONS");
+			names.push_back ("CL_PLATFORM_EXTENSIONS");
+		}
+	}
+
+	std::sort (names.begin (), names.end ());
+	names.erase (std::unique (names.begin (), names.end ()), names.end ());
+
+	for (auto& r : requirements.requirements) {
+		if (r.kind == RequirementKind_Property) {
+			r.slot = requirements.FindSlot (r.predicate.property.c_str ());
+		} else if (r.kind == RequirementKind_Extension) {
+			requirements.deviceExtensions =
+				requirements.FindSlot ("CL_DEVICE_EXTENSIONS");
+			requirements.platformExtensions =
+				requirements.FindSlot ("CL_PLATFORM_EXTENSIONS");
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void SetError (char* error, const int errorSize, const char* message)
+{
+	if (error && errorSize > 0) {
+		std::snprintf (error, static_cast<std::size_t> (errorSize), "%s", message);
+	}
+}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliRequirements_Compile (const char* manifest,
+	cliRequirements** requirements, char* error, int errorSize)
+{
+	if (manifest == nullptr || requirements == nullptr) {
+		return CLI_Error;
+	}
+
+	*requirements = nullptr;
+
+	try {
+		std::unique_ptr<cliRequirements> result (new cliRequirements);
+		Compile (manifest, *result);
+		*requirements = result.release ();
+	} catch (const CompileError& e) {
+		SetError (error, errorSize, e.what ());
+		return CLI_Error;
+	} catch (const std::exception&) {
+		SetError (error, errorSize, "Out of memory");
+		return CLI_Error;
+	}
+
+	return CLI_Success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliRequirements_CompileFile (const char* filename,
+	cliRequirements** requirements, char* error, int errorSize)
+{
+	if (filename == nullptr || requirements == nullptr) {
+		return CLI_Error;
+	}
+
+	*requirements = nullptr;
+
+	std::string manifest;
+
+	{
+		niv::FileCloser file (std::fopen (filename, "rb"));
+		if (file.file == nullptr) {
+			SetError (error, errorSize, "Could not open the manifest");
+			return CLI_Error;
+		}
+
+		char buffer [4096];
+		std::size_t read;
+		while ((read = std::fread (buffer, 1, sizeof (buffer), file.file)) > 0) {
+			manifest.append (buffer, read);
+		}
+
+		if (std::ferror (file.file)) {
+			SetError (error, errorSize, "Could not read the manifest");
+			return CLI_Error;
+		}
+	}
+
+	return cliRequirements_Compile (manifest.c_str (), requirements, error,
+		errorSize);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliRequirements_Evaluate (const cliRequirements* requirements,
+	const cliInfo* info, cliRequirementsResult* results, int* count)
+{
+	if (requirements == nullptr || info == nullptr || info->root == nullptr ||
+		info->busy || count == nullptr || *count < 0) {
+		return CLI_Error;
+	}
+
+	const auto capacity = results ? *count : 0;
+	int deviceCount = 0;
+
+	// Small manifests need no allocation
+	const cliProperty* fixedSlots [32];
+	std::vector<const cliProperty*> dynamicSlots;
+	auto slots = fixedSlots;
+
+	if (requirements->names.size () > 32) {
+		dynamicSlots.resize (requirements->names.size ());
+		slots = dynamicSlots.data ();
+	}
+
+	int platformIndex = 0;
+	for (auto platform = info->root->firstChild; platform;
+		platform = platform->next, ++platformIndex) {
+		const auto devices = FindChild (platform, "Devices");
+
+		if (devices == nullptr) {
+			continue;
+		}
+
+		int deviceIndex = 0;
+		for (auto device = devices->firstChild; device;
+			device = device->next, ++deviceIndex, ++deviceCount) {
+			if (deviceCount >= capacity) {
+				continue;
+			}
+
+			const auto failed = requirements->Check (platform, device, slots);
+
+			auto& result = results [deviceCount];
+			result.platformIndex = platformIndex;
+			result.deviceIndex = deviceIndex;
+			result.device = device;
+			result.failedRequirement = failed ? failed->text.c_str () : nullptr;
+			result.failedLine = failed ? failed->line : 0;
+		}
+	}
+
+	*count = deviceCount;
+
+	return CLI_Success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliRequirements_Destroy (cliRequirements* requirements)
+{
+	if (requirements == nullptr) {
+		return CLI_Error;
+	}
+
+	delete requirements;
+
+	return CLI_Success;
+}
@@ -0,0 +1,1044 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+#include "clInfo.h"
+#include "clInfoInternal.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+Snapshot file format. All integers are unsigned LEB128 varints unless noted
+otherwise; signed values are zig-zag encoded first.
+
+	magic			"CLIS"
+	version			byte, currently 1
+	flags			byte, 1 if the tree is delta-encoded
+	referenceHash	8 bytes little endian, only present for delta snapshots
+	stringCount		followed by stringCount (length, bytes) pairs
+	root			a node record, or a delta record for delta snapshots
+
+A node record stores a complete subtree:
+
+	name			string index
+	kind			optional string, see below
+	propertyCount	followed by the property records
+	childCount		followed by the child node records
+
+A property record:
+
+	name			string index
+	hint			optional string
+	type			byte, a cliPropertyType
+	valueCount		followed by the values; Int64 as signed varint, Bool
+					as a byte, String as a string index
+
+Optional strings are stored as a byte which is 0 for null, or 1 followed by the
+string index.
+
+A delta record describes a node relative to a node in the reference snapshot
+with the same name and kind. It consists of a list of property operations,
+followed by a list of child operations. Each list starts with the number of
+operations. An operation starts with (count << 2 | opcode):
+
+	0	copy		start index follows, copies count consecutive entries
+					from the reference node
+	1	literal		count property or node records follow
+	2	patch		child operations only, count is 1; a reference child
+					index follows, and then a delta record for that child
+
+Nodes and properties which are identical to the reference thus take a few
+bytes per run instead of being stored again.
+*/
+
+namespace {
+const char SnapshotMagic [4] = {'C', 'L', 'I', 'S'};
+const int SnapshotVersion = 1;
+
+enum SnapshotFlags
+{
+	SnapshotFlag_Delta = 1
+};
+
+enum Operation
+{
+	Operation_Copy = 0,
+	Operation_Literal = 1,
+	Operation_Patch = 2
+};
+
+struct SnapshotError : public std::runtime_error
+{
+	explicit SnapshotError (const char* what)
+	: std::runtime_error (what)
+	{
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+bool Equal (const char* a, const char* b)
+{
+	if (a == b) {
+		return true;
+	}
+
+	if (a == nullptr || b == nullptr) {
+		return false;
+	}
+
+	return ::strcmp (a, b) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Equal (const cliProperty* a, const cliProperty* b)
+{
+	if (a->type != b->type || ! Equal (a->name, b->name) ||
+		! Equal (a->hint, b->hint)) {
+		return false;
+	}
+
+	auto va = a->value;
+	auto vb = b->value;
+
+	for (; va && vb; va = va->next, vb = vb->next) {
+		switch (a->type) {
+		case CLI_PropertyType_Int64:
+			if (va->i != vb->i) {
+				return false;
+			}
+			break;
+
+		case CLI_PropertyType_Bool:
+			if (va->b != vb->b) {
+				return false;
+			}
+			break;
+
+		case CLI_PropertyType_String:
+			if (! Equal (va->s, vb->s)) {
+				return false;
+			}
+			break;
+		}
+	}
+
+	return va == nullptr && vb == nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Equal (const cliNode* a, const cliNode* b)
+{
+	if (! Equal (a->name, b->name) || ! Equal (a->kind, b->kind)) {
+		return false;
+	}
+
+	auto pa = a->firstProperty;
+	auto pb = b->firstProperty;
+
+	for (; pa && pb; pa = pa->next, pb = pb->next) {
+		if (! Equal (pa, pb)) {
+			return false;
+		}
+	}
+
+	if (pa || pb) {
+		return false;
+	}
+
+	auto ca = a->firstChild;
+	auto cb = b->firstChild;
+
+	for (; ca && cb; ca = ca->next, cb = cb->next) {
+		if (! Equal (ca, cb)) {
+			return false;
+		}
+	}
+
+	return ca == nullptr && cb == nullptr;
+}
+
+/**
+64-bit FNV-1a, used to check that a delta snapshot is loaded with the
+reference it was created against.
+*/
+class Hash
+{
+public:
+	void Add (const void* data, std::size_t size)
+	{
+		auto p = static_cast<const unsigned char*> (data);
+		for (std::size_t i = 0; i < size; ++i) {
+			hash_ = (hash_ ^ p [i]) * 0x100000001b3ULL;
+		}
+	}
+
+	void Add (const char* s)
+	{
+		if (s) {
+			Add (s, ::strlen (s) + 1);
+		} else {
+			Add ("", 1);
+		}
+	}
+
+	void Add (const cliNode* node)
+	{
+		Add (node->name);
+		Add (node->kind);
+
+		for (auto p = node->firstProperty; p; p = p->next) {
+			Add (p->name);
+			Add (p->hint);
+			Add (&p->type, sizeof (p->type));
+
+			for (auto v = p->value; v; v = v->next) {
+				switch (p->type) {
+				case CLI_PropertyType_Int64: Add (&v->i, sizeof (v->i)); break;
+				case CLI_PropertyType_Bool: Add (&v->b, sizeof (v->b)); break;
+				case CLI_PropertyType_String: Add (v->s); break;
+				}
+			}
+
+			// Separates the values of consecutive properties
+			Add ("\xff", 1);
+		}
+
+		for (auto c = node->firstChild; c; c = c->next) {
+			Add (c);
+		}
+
+		Add ("\xfe", 1);
+	}
+
+	std::uint64_t Get () const
+	{
+		return hash_;
+	}
+
+private:
+	std::uint64_t hash_ = 0xcbf29ce484222325ULL;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+std::vector<const T*> ToVector (const T* first)
+{
+	std::vector<const T*> result;
+	for (auto it = first; it; it = it->next) {
+		result.push_back (it);
+	}
+	return result;
+}
+
+/**
+Serializes a tree into memory. Strings are interned into a table which is
+written in front of the tree.
+*/
+class Writer
+{
+public:
+	void WriteNode (const cliNode* node)
+	{
+		WriteString (node->name);
+		WriteOptionalString (node->kind);
+
+		WriteVarint (Count (node->firstProperty));
+		for (auto p = node->firstProperty; p; p = p->next) {
+			WriteProperty (p);
+		}
+
+		WriteVarint (Count (node->firstChild));
+		for (auto c = node->firstChild; c; c = c->next) {
+			WriteNode (c);
+		}
+	}
+
+	/**
+	Write node as a delta record against reference. Both must have the same
+	name and kind.
+	*/
+	void WriteDelta (const cliNode* node, const cliNode* reference)
+	{
+		WritePropertyDelta (ToVector (node->firstProperty),
+			ToVector (reference->firstProperty));
+		WriteChildDelta (ToVector (node->firstChild),
+			ToVector (reference->firstChild));
+	}
+
+	void Save (std::FILE* file, const std::uint64_t* referenceHash) const
+	{
+		std::vector<unsigned char> header;
+		header.insert (header.end (), SnapshotMagic, SnapshotMagic + 4);
+		header.push_back (SnapshotVersion);
+		header.push_back (referenceHash ? SnapshotFlag_Delta : 0);
+
+		if (referenceHash) {
+			for (int i = 0; i < 8; ++i) {
+				header.push_back (static_cast<unsigned char> (
+					*referenceHash >> (i * 8)));
+			}
+		}
+
+		AppendVarint (header, strings_.size ());
+		for (const auto& s : strings_) {
+			AppendVarint (header, s.size ());
+			header.insert (header.end (), s.begin (), s.end ());
+		}
+
+		if (std::fwrite (header.data (), 1, header.size (), file) != header.size () ||
+			std::fwrite (data_.data (), 1, data_.size (), file) != data_.size ()) {
+			throw SnapshotError ("Could not write snapshot");
+		}
+	}
+
+private:
+	struct Op
+	{
+		Operation		operation;
+		std::size_t		start;
+		std::size_t		count;
+		// The node to write for patch operations
+		const cliNode*	node;
+	};
+
+	template <typename T>
+	static std::size_t Count (const T* first)
+	{
+		std::size_t result = 0;
+		for (auto it = first; it; it = it->next) {
+			++result;
+		}
+		return result;
+	}
+
+	static void AppendVarint (std::vector<unsigned char>& buffer, std::uint64_t value)
+	{
+		while (value >= 0x80) {
+			buffer.push_back (static_cast<unsigned char> (value | 0x80));
+			value >>= 7;
+		}
+
+		buffer.push_back (static_cast<unsigned char> (value));
+	}
+
+	void WriteVarint (std::uint64_t value)
+	{
+		AppendVarint (data_, value);
+	}
+
+	void WriteString (const char* s)
+	{
+		std::string str (s ? s : "");
+		auto it = stringIndices_.find (str);
+
+		if (it == stringIndices_.end ()) {
+			it = stringIndices_.insert (std::make_pair (str, strings_.size ())).first;
+			strings_.push_back (str);
+		}
+
+		WriteVarint (it->second);
+	}
+
+	void WriteOptionalString (const char* s)
+	{
+		if (s) {
+			data_.push_back (1);
+			WriteString (s);
+		} else {
+			data_.push_back (0);
+		}
+	}
+
+	void WriteProperty (const cliProperty* property)
+	{
+		WriteString (property->name);
+		WriteOptionalString (property->hint);
+		data_.push_back (static_cast<unsigned char> (property->type));
+
+		WriteVarint (Count (property->value));
+		for (auto v = property->value; v; v = v->next) {
+			switch (property->type) {
+			case CLI_PropertyType_Int64:
+				WriteVarint ((static_cast<std::uint64_t> (v->i) << 1) ^
+					static_cast<std::uint64_t> (v->i >> 63));
+				break;
+
+			case CLI_PropertyType_Bool:
+				data_.push_back (v->b ? 1 : 0);
+				break;
+
+			case CLI_PropertyType_String:
+				WriteString (v->s);
+				break;
+			}
+		}
+	}
+
+	void WriteOp (const Op& op)
+	{
+		WriteVarint ((op.count << 2) | op.operation);
+
+		if (op.operation != Operation_Literal) {
+			WriteVarint (op.start);
+		}
+	}
+
+	/**
+	Append an entry to the operation list, extending the last copy or literal
+	run if possible. match is the index in the reference, or -1 for a literal.
+	*/
+	static void Extend (std::vector<Op>& ops, const std::ptrdiff_t match)
+	{
+		if (match >= 0) {
+			if (! ops.empty () && ops.back ().operation == Operation_Copy &&
+				ops.back ().start + ops.back ().count == static_cast<std::size_t> (match)) {
+				++ops.back ().count;
+			} else {
+				ops.push_back ({Operation_Copy, static_cast<std::size_t> (match), 1, nullptr});
+			}
+		} else {
+			if (! ops.empty () && ops.back ().operation == Operation_Literal) {
+				++ops.back ().count;
+			} else {
+				ops.push_back ({Operation_Literal, 0, 1, nullptr});
+			}
+		}
+	}
+
+	void WritePropertyDelta (const std::vector<const cliProperty*>& properties,
+		const std::vector<const cliProperty*>& reference)
+	{
+		std::unordered_multimap<std::string, std::size_t> byName;
+		for (std::size_t i = 0; i < reference.size (); ++i) {
+			byName.insert (std::make_pair (reference [i]->name, i));
+		}
+
+		std::vector<Op> ops;
+		std::vector<const cliProperty*> literals;
+		std::ptrdiff_t last = -1;
+
+		for (const auto property : properties) {
+			std::ptrdiff_t match = -1;
+
+			// Fast path, the properties are usually in the same order
+			if (last + 1 < static_cast<std::ptrdiff_t> (reference.size ()) &&
+				Equal (property, reference [last + 1])) {
+				match = last + 1;
+			} else {
+				const auto range = byName.equal_range (property->name);
+				for (auto it = range.first; it != range.second; ++it) {
+					if (Equal (property, reference [it->second])) {
+						match = it->second;
+						break;
+					}
+				}
+			}
+
+			Extend (ops, match);
+
+			if (match < 0) {
+				literals.push_back (property);
+			} else {
+				last = match;
+			}
+		}
+
+		WriteVarint (ops.size ());
+
+		auto literal = literals.begin ();
+		for (const auto& op : ops) {
+			WriteOp (op);
+
+			if (op.operation == Operation_Literal) {
+				for (std::size_t i = 0; i < op.count; ++i) {
+					WriteProperty (*literal++);
+				}
+			}
+		}
+	}
+
+	void WriteChildDelta (const std::vector<const cliNode*>& children,
+		const std::vector<const cliNode*>& reference)
+	{
+		std::unordered_multimap<std::string, std::size_t> byKey;
+		for (std::size_t i = 0; i < reference.size (); ++i) {
+			byKey.insert (std::make_pair (Key (reference [i]), i));
+		}
+
+		std::vector<bool> used (reference.size (), false);
+		std::vector<Op> ops;
+		std::vector<const cliNode*> literals;
+		std::ptrdiff_t last = -1;
+
+		for (const auto child : children) {
+			std::ptrdiff_t match = -1;
+			std::ptrdiff_t patch = -1;
+
+			if (last + 1 < static_cast<std::ptrdiff_t> (reference.size ()) &&
+				! used [last + 1] && Equal (child, reference [last + 1])) {
+				match = last + 1;
+			} else {
+				const auto range = byKey.equal_range (Key (child));
+
+				std::ptrdiff_t fallback = -1;
+
+				for (auto it = range.first; it != range.second; ++it) {
+					const auto index = static_cast<std::ptrdiff_t> (it->second);
+
+					if (fallback < 0 || index < fallback) {
+						fallback = index;
+					}
+
+					if (used [index]) {
+						continue;
+					}
+
+					if (Equal (child, reference [index])) {
+						match = index;
+						break;
+					}
+
+					// Patch against the first unused node of the same kind,
+					// which keeps the n-th device aligned with the n-th
+					// device of the reference
+					if (patch < 0 || index < patch) {
+						patch = index;
+					}
+				}
+
+				// Additional nodes, like an extra device, are still very
+				// similar to one which is already used
+				if (match < 0 && patch < 0) {
+					patch = fallback;
+				}
+			}
+
+			if (match >= 0) {
+				used [match] = true;
+				last = match;
+				Extend (ops, match);
+			} else if (patch >= 0) {
+				used [patch] = true;
+				ops.push_back ({Operation_Patch, static_cast<std::size_t> (patch), 1, child});
+			} else {
+				Extend (ops, -1);
+				literals.push_back (child);
+			}
+		}
+
+		WriteVarint (ops.size ());
+
+		auto literal = literals.begin ();
+		for (const auto& op : ops) {
+			WriteOp (op);
+
+			if (op.operation == Operation_Literal) {
+				for (std::size_t i = 0; i < op.count; ++i) {
+					WriteNode (*literal++);
+				}
+			} else if (op.operation == Operation_Patch) {
+				WriteDelta (op.node, reference [op.start]);
+			}
+		}
+	}
+
+	static std::string Key (const cliNode* node)
+	{
+		std::string result (node->name ? node->name : "");
+
+		if (node->kind) {
+			result.push_back ('\0');
+			result.append (node->kind);
+		}
+
+		return result;
+	}
+
+	std::vector<unsigned char>	data_;
+	std::vector<std::string>	strings_;
+	std::unordered_map<std::string, std::size_t>	stringIndices_;
+};
+
+/**
+Rebuilds a tree from a snapshot in a pool. Everything, including the parts
+copied from the reference, is allocated from the pool, so the result does not
+depend on the reference.
+*/
+class Reader
+{
+public:
+	Reader (niv::Pool& pool, const std::vector<unsigned char>& data)
+	: pool_ (pool)
+	, data_ (data)
+	{
+	}
+
+	cliNode* Load (const cliNode* reference)
+	{
+		if (data_.size () < 6 || ::memcmp (data_.data (), SnapshotMagic, 4) != 0) {
+			throw SnapshotError ("Not a snapshot");
+		}
+
+		if (data_ [4] != SnapshotVersion) {
+			throw SnapshotError ("Unsupported snapshot version");
+		}
+
+		const bool delta = (data_ [5] & SnapshotFlag_Delta) != 0;
+		offset_ = 6;
+
+		if (delta) {
+			if (reference == nullptr) {
+				throw SnapshotError ("Snapshot requires a reference");
+			}
+
+			std::uint64_t hash = 0;
+			for (int i = 0; i < 8; ++i) {
+				hash |= static_cast<std::uint64_t> (ReadByte ()) << (i * 8);
+			}
+
+			Hash referenceHash;
+			referenceHash.Add (reference);
+
+			if (hash != referenceHash.Get ()) {
+				throw SnapshotError ("Snapshot was created with a different reference");
+			}
+		}
+
+		const auto stringCount = ReadCount ();
+		strings_.resize (stringCount);
+
+		for (auto& s : strings_) {
+			const auto length = ReadCount ();
+			auto str = static_cast<char*> (pool_.Allocate (
+				static_cast<int> (length) + 1));
+			::memcpy (str, &data_ [offset_], length);
+			offset_ += length;
+			s = str;
+		}
+
+		auto root = delta ? ReadDelta (reference) : ReadNode ();
+
+		if (offset_ != data_.size ()) {
+			throw SnapshotError ("Trailing data in snapshot");
+		}
+
+		return root;
+	}
+
+private:
+	/**
+	Limits the nesting depth, so corrupted files cannot exhaust the stack.
+	*/
+	struct DepthGuard
+	{
+		explicit DepthGuard (int& depth)
+		: depth (depth)
+		{
+			if (++depth > 64) {
+				throw SnapshotError ("Snapshot nesting too deep");
+			}
+		}
+
+		~DepthGuard ()
+		{
+			--depth;
+		}
+
+		int& depth;
+	};
+
+	unsigned char ReadByte ()
+	{
+		if (offset_ >= data_.size ()) {
+			throw SnapshotError ("Truncated snapshot");
+		}
+
+		return data_ [offset_++];
+	}
+
+	std::uint64_t ReadVarint ()
+	{
+		std::uint64_t result = 0;
+
+		for (int shift = 0; shift < 64; shift += 7) {
+			const auto b = ReadByte ();
+			result |= static_cast<std::uint64_t> (b & 0x7F) << shift;
+
+			if ((b & 0x80) == 0) {
+				return result;
+			}
+		}
+
+		throw SnapshotError ("Invalid varint in snapshot");
+	}
+
+	/**
+	Read a count or length, which must fit into the remaining data, as every
+	entry takes at least one byte. Guards against allocating huge amounts of
+	memory for corrupted files.
+	*/
+	std::size_t ReadCount ()
+	{
+		const auto result = ReadVarint ();
+
+		if (result > data_.size () - offset_) {
+			throw SnapshotError ("Invalid count in snapshot");
+		}
+
+		return static_cast<std::size_t> (result);
+	}
+
+	const char* ReadString ()
+	{
+		const auto index = ReadVarint ();
+
+		if (index >= strings_.size ()) {
+			throw SnapshotError ("Invalid string index in snapshot");
+		}
+
+		return strings_ [static_cast<std::size_t> (index)];
+	}
+
+	const char* ReadOptionalString ()
+	{
+		return ReadByte () ? ReadString () : nullptr;
+	}
+
+	cliProperty* ReadProperty ()
+	{
+		auto property = pool_.Allocate<cliProperty> ();
+		property->name = ReadString ();
+		property->hint = ReadOptionalString ();
+
+		const auto type = ReadByte ();
+		if (type > CLI_PropertyType_String) {
+			throw SnapshotError ("Invalid property type in snapshot");
+		}
+
+		property->type = static_cast<cliPropertyType> (type);
+
+		cliValue* last = nullptr;
+		const auto count = ReadCount ();
+
+		for (std::size_t i = 0; i < count; ++i) {
+			auto value = pool_.Allocate<cliValue> ();
+
+			switch (property->type) {
+			case CLI_PropertyType_Int64:
+			{
+				const auto v = ReadVarint ();
+				value->i = static_cast<std::int64_t> ((v >> 1) ^ (~(v & 1) + 1));
+				break;
+			}
+
+			case CLI_PropertyType_Bool:
+				value->b = ReadByte () != 0;
+				break;
+
+			case CLI_PropertyType_String:
+				value->s = ReadString ();
+				break;
+			}
+
+			Link (property->value, last, value);
+		}
+
+		return property;
+	}
+
+	cliNode* ReadNode ()
+	{
+		DepthGuard guard (depth_);
+
+		auto node = pool_.Allocate<cliNode> ();
+		node->name = ReadString ();
+		node->kind = ReadOptionalString ();
+
+		cliProperty* lastProperty = nullptr;
+		const auto propertyCount = ReadCount ();
+		for (std::size_t i = 0; i < propertyCount; ++i) {
+			Link (node->firstProperty, lastProperty, ReadProperty ());
+		}
+
+		cliNode* lastChild = nullptr;
+		const auto childCount = ReadCount ();
+		for (std::size_t i = 0; i < childCount; ++i) {
+			Link (node->firstChild, lastChild, ReadNode ());
+		}
+
+		return node;
+	}
+
+	cliNode* ReadDelta (const cliNode* reference)
+	{
+		DepthGuard guard (depth_);
+
+		auto node = pool_.Allocate<cliNode> ();
+		node->name = CopyString (reference->name);
+		node->kind = CopyString (reference->kind);
+
+		const auto referenceProperties = ToVector (reference->firstProperty);
+		cliProperty* lastProperty = nullptr;
+
+		const auto propertyOps = ReadCount ();
+		for (std::size_t i = 0; i < propertyOps; ++i) {
+			const auto op = ReadVarint ();
+			const auto count = op >> 2;
+
+			switch (op & 3) {
+			case Operation_Copy:
+			{
+				const auto start = ReadVarint ();
+				CheckRange (start, count, referenceProperties.size ());
+
+				for (std::size_t j = 0; j < count; ++j) {
+					Link (node->firstProperty, lastProperty,
+						CopyProperty (referenceProperties [start + j]));
+				}
+				break;
+			}
+
+			case Operation_Literal:
+				CheckRange (0, count, data_.size () - offset_);
+
+				for (std::size_t j = 0; j < count; ++j) {
+					Link (node->firstProperty, lastProperty, ReadProperty ());
+				}
+				break;
+
+			default:
+				throw SnapshotError ("Invalid operation in snapshot");
+			}
+		}
+
+		const auto referenceChildren = ToVector (reference->firstChild);
+		cliNode* lastChild = nullptr;
+
+		const auto childOps = ReadCount ();
+		for (std::size_t i = 0; i < childOps; ++i) {
+			const auto op = ReadVarint ();
+			const auto count = op >> 2;
+
+			switch (op & 3) {
+			case Operation_Copy:
+			{
+				const auto start = ReadVarint ();
+				CheckRange (start, count, referenceChildren.size ());
+
+				for (std::size_t j = 0; j < count; ++j) {
+					Link (node->firstChild, lastChild,
+						CopyNode (referenceChildren [start + j]));
+				}
+				break;
+			}
+
+			case Operation_Literal:
+				CheckRange (0, count, data_.size () - offset_);
+
+				for (std::size_t j = 0; j < count; ++j) {
+					Link (node->firstChild, lastChild, ReadNode ());
+				}
+				break;
+
+			case Operation_Patch:
+			{
+				const auto index = ReadVarint ();
+				CheckRange (index, 1, referenceChildren.size ());
+
+				Link (node->firstChild, lastChild,
+					ReadDelta (referenceChildren [index]));
+				break;
+			}
+
+			default:
+				throw SnapshotError ("Invalid operation in snapshot");
+			}
+		}
+
+		return node;
+	}
+
+	static void CheckRange (const std::uint64_t start, const std::uint64_t count,
+		const std::size_t size)
+	{
+		if (start > size || count > size - start) {
+			throw SnapshotError ("Invalid reference range in snapshot");
+		}
+	}
+
+	const char* CopyString (const char* s)
+	{
+		if (s == nullptr) {
+			return nullptr;
+		}
+
+		auto it = copiedStrings_.find (s);
+		if (it != copiedStrings_.end ()) {
+			return it->second;
+		}
+
+		const auto length = ::strlen (s);
+		auto str = static_cast<char*> (pool_.Allocate (static_cast<int> (length) + 1));
+		::memcpy (str, s, length);
+
+		copiedStrings_ [s] = str;
+		return str;
+	}
+
+	cliProperty* CopyProperty (const cliProperty* source)
+	{
+		auto property = pool_.Allocate<cliProperty> ();
+		property->name = CopyString (source->name);
+		property->hint = CopyString (source->hint);
+		property->type = source->type;
+
+		cliValue* last = nullptr;
+		for (auto v = source->value; v; v = v->next) {
+			auto value = pool_.Allocate<cliValue> ();
+
+			if (source->type == CLI_PropertyType_String) {
+				value->s = CopyString (v->s);
+			} else {
+				value->i = v->i;
+			}
+
+			Link (property->value, last, value);
+		}
+
+		return property;
+	}
+
+	cliNode* CopyNode (const cliNode* source)
+	{
+		auto node = pool_.Allocate<cliNode> ();
+		node->name = CopyString (source->name);
+		node->kind = CopyString (source->kind);
+
+		cliProperty* lastProperty = nullptr;
+		for (auto p = source->firstProperty; p; p = p->next) {
+			Link (node->firstProperty, lastProperty, CopyProperty (p));
+		}
+
+		cliNode* lastChild = nullptr;
+		for (auto c = source->firstChild; c; c = c->next) {
+			Link (node->firstChild, lastChild, CopyNode (c));
+		}
+
+		return node;
+	}
+
+	template <typename T>
+	static void Link (T*& first, T*& last, T* item)
+	{
+		if (last) {
+			last->next = item;
+		} else {
+			first = item;
+		}
+
+		last = item;
+	}
+
+	niv::Pool&							pool_;
+	const std::vector<unsigned char>&	data_;
+	std::size_t							offset_ = 0;
+	int									depth_ = 0;
+
+	std::vector<const char*>	strings_;
+	std::unordered_map<const char*, const char*>	copiedStrings_;
+};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_Save (const cliInfo* info, const cliInfo* reference,
+	const char* filename)
+{
+	if (info == nullptr || info->root == nullptr || info->busy ||
+		filename == nullptr) {
+		return CLI_Error;
+	}
+
+	if (reference && (reference->root == nullptr || reference->busy)) {
+		return CLI_Error;
+	}
+
+	try {
+		Writer writer;
+		std::uint64_t referenceHash = 0;
+
+		if (reference && Equal (info->root->name, reference->root->name) &&
+			Equal (info->root->kind, reference->root->kind)) {
+			Hash hash;
+			hash.Add (reference->root);
+			referenceHash = hash.Get ();
+
+			writer.WriteDelta (info->root, reference->root);
+		} else if (reference) {
+			return CLI_Error;
+		} else {
+			writer.WriteNode (info->root);
+		}
+
+		niv::FileCloser file (std::fopen (filename, "wb"));
+		if (file.file == nullptr) {
+			return CLI_Error;
+		}
+
+		writer.Save (file.file, reference ? &referenceHash : nullptr);
+
+		if (std::fflush (file.file) != 0) {
+			return CLI_Error;
+		}
+	} catch (const std::exception&) {
+		return CLI_Error;
+	}
+
+	return CLI_Success;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cliInfo_Load (cliInfo* info, const cliInfo* reference, const char* filename)
+{
+	if (info == nullptr || info->root || info->busy || filename == nullptr) {
+		return CLI_Error;
+	}
+
+	if (reference && (reference->root == nullptr || reference->busy)) {
+		return CLI_Error;
+	}
+
+	try {
+		std::vector<unsigned char> data;
+
+		{
+			niv::FileCloser file (std::fopen (filename, "rb"));
+			if (file.file == nullptr) {
+				return CLI_Error;
+			}
+
+			unsigned char buffer [65536];
+			std::size_t read;
+			while ((read = std::fread (buffer, 1, sizeof (buffer), file.file)) > 0) {
+				data.insert (data.end (), buffer, buffer + read);
+			}
+
+			if (std::ferror (file.file)) {
+				return CLI_Error;
+			}
+		}
+
+		Reader reader (info->pool, data);
+		info->root = reader.Load (reference ? reference->root : nullptr);
+		info->loaded = true;
+	} catch (const std::exception&) {
+		info->root = nullptr;
+		info->pool.Reset ();
+		return CLI_Error;
+	}
+
+	return CLI_Success;
+}
@@ -0,0 +1,1782 @@
+// Matthäus G. Chajdas
+// Licensed under the 3-clause BSD license
+
+/*
+A fake OpenCL implementation for testing without drivers.
+
+It can be used as an ICD, by pointing the ICD loader at it (for instance, with
+OCL_ICD_VENDORS), or directly in place of libOpenCL.so, for instance through
+LD_PRELOAD. The platforms and devices it reports are read from the file named
+by the FAKE_OPENCL_CONFIG environment variable, or replayed from a recording
+named by FAKE_OPENCL_REPLAY; see README.md in this directory.
+*/
+
+#ifdef __APPLE__
+	#include <OpenCL/cl.h>
+#else
+	#include <CL/cl.h>
+#endif
+
+#include "clInfoExtensions.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifndef CL_PLATFORM_ICD_SUFFIX_KHR
+#define CL_PLATFORM_ICD_SUFFIX_KHR 0x0920
+#endif
+
+#ifndef CL_PLATFORM_NOT_FOUND_KHR
+#define CL_PLATFORM_NOT_FOUND_KHR -1001
+#endif
+
+#if defined(_WIN32)
+	#define NIV_FAKE_EXPORT extern "C" __declspec(dllexport)
+#else
+	#define NIV_FAKE_EXPORT extern "C" __attribute__ ((visibility ("default")))
+#endif
+
+#define NIV_VALUESTRING(v) v, #v
+
+namespace {
+enum class Kind
+{
+	String,
+	StringList,
+	UInt,
+	ULong,
+	SizeT,
+	SizeTList,
+	Bool,
+	Bitfield,
+	Enum,
+	PartitionList
+};
+
+struct InfoDescription
+{
+	cl_uint		code;
+	const char*	name;
+	Kind		kind;
+	// nullptr if the query is not supported by default
+	const char*	defaultValue;
+};
+
+const InfoDescription platformInfos [] = {
+	{NIV_VALUESTRING (CL_PLATFORM_PROFILE), Kind::String, "FULL_PROFILE"},
+	{NIV_VALUESTRING (CL_PLATFORM_VERSION), Kind::String, "OpenCL 1.2 Fake"},
+	{NIV_VALUESTRING (CL_PLATFORM_NAME), Kind::String, "Fake Platform"},
+	{NIV_VALUESTRING (CL_PLATFORM_VENDOR), Kind::String, "Fake Vendor"},
+	{NIV_VALUESTRING (CL_PLATFORM_EXTENSIONS), Kind::StringList, "cl_khr_icd"},
+	{NIV_VALUESTRING (CL_PLATFORM_ICD_SUFFIX_KHR), Kind::String, "FAKE"}
+};
+
+const InfoDescription deviceInfos [] = {
+	{NIV_VALUESTRING (CL_DEVICE_TYPE), Kind::Bitfield, "CL_DEVICE_TYPE_GPU"},
+	{NIV_VALUESTRING (CL_DEVICE_VENDOR_ID), Kind::UInt, "65535"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_COMPUTE_UNITS), Kind::UInt, "16"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS), Kind::UInt, "3"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_WORK_GROUP_SIZE), Kind::SizeT, "1024"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_WORK_ITEM_SIZES), Kind::SizeTList, "1024 1024 64"},
+	{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_CLOCK_FREQUENCY), Kind::UInt, "1500"},
+	{NIV_VALUESTRING (CL_DEVICE_ADDRESS_BITS), Kind::UInt, "64"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_READ_IMAGE_ARGS), Kind::UInt, "128"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_WRITE_IMAGE_ARGS), Kind::UInt, "8"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_MEM_ALLOC_SIZE), Kind::ULong, "2147483648"},
+	{NIV_VALUESTRING (CL_DEVICE_IMAGE2D_MAX_WIDTH), Kind::SizeT, "16384"},
+	{NIV_VALUESTRING (CL_DEVICE_IMAGE2D_MAX_HEIGHT), Kind::SizeT, "16384"},
+	{NIV_VALUESTRING (CL_DEVICE_IMAGE3D_MAX_WIDTH), Kind::SizeT, "2048"},
+	{NIV_VALUESTRING (CL_DEVICE_IMAGE3D_MAX_HEIGHT), Kind::SizeT, "2048"},
+	{NIV_VALUESTRING (CL_DEVICE_IMAGE3D_MAX_DEPTH), Kind::SizeT, "2048"},
+	{NIV_VALUESTRING (CL_DEVICE_IMAGE_SUPPORT), Kind::Bool, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_PARAMETER_SIZE), Kind::SizeT, "4352"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_SAMPLERS), Kind::UInt, "32"},
+	{NIV_VALUESTRING (CL_DEVICE_MEM_BASE_ADDR_ALIGN), Kind::UInt, "4096"},
+	{NIV_VALUESTRING (CL_DEVICE_MIN_DATA_TYPE_ALIGN_SIZE), Kind::UInt, "128"},
+	{NIV_VALUESTRING (CL_DEVICE_SINGLE_FP_CONFIG), Kind::Bitfield, "CL_FP_DENORM | CL_FP_INF_NAN | CL_FP_ROUND_TO_NEAREST | CL_FP_FMA"},
+	{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CACHE_TYPE), Kind::Enum, "CL_READ_WRITE_CACHE"},
+	{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE), Kind::UInt, "128"},
+	{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CACHE_SIZE), Kind::ULong, "262144"},
+	{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_SIZE), Kind::ULong, "8589934592"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE), Kind::ULong, "65536"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_CONSTANT_ARGS), Kind::UInt, "9"},
+	{NIV_VALUESTRING (CL_DEVICE_LOCAL_MEM_TYPE), Kind::Enum, "CL_LOCAL"},
+	{NIV_VALUESTRING (CL_DEVICE_LOCAL_MEM_SIZE), Kind::ULong, "49152"},
+	{NIV_VALUESTRING (CL_DEVICE_ERROR_CORRECTION_SUPPORT), Kind::Bool, "0"},
+	{NIV_VALUESTRING (CL_DEVICE_PROFILING_TIMER_RESOLUTION), Kind::SizeT, "1000"},
+	{NIV_VALUESTRING (CL_DEVICE_ENDIAN_LITTLE), Kind::Bool, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_AVAILABLE), Kind::Bool, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_COMPILER_AVAILABLE), Kind::Bool, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_EXECUTION_CAPABILITIES), Kind::Bitfield, "CL_EXEC_KERNEL"},
+	{NIV_VALUESTRING (CL_DEVICE_QUEUE_PROPERTIES), Kind::Bitfield, "CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE | CL_QUEUE_PROFILING_ENABLE"},
+	{NIV_VALUESTRING (CL_DEVICE_NAME), Kind::String, "Fake Device"},
+	{NIV_VALUESTRING (CL_DEVICE_VENDOR), Kind::String, "Fake Vendor"},
+	{NIV_VALUESTRING (CL_DRIVER_VERSION), Kind::String, "1.0"},
+	{NIV_VALUESTRING (CL_DEVICE_PROFILE), Kind::String, "FULL_PROFILE"},
+	{NIV_VALUESTRING (CL_DEVICE_VERSION), Kind::String, "OpenCL 1.2 Fake"},
+	{NIV_VALUESTRING (CL_DEVICE_EXTENSIONS), Kind::StringList, "cl_khr_global_int32_base_atomics cl_khr_global_int32_extended_atomics cl_khr_fp64"},
+	{NIV_VALUESTRING (CL_DEVICE_DOUBLE_FP_CONFIG), Kind::Bitfield, "CL_FP_DENORM | CL_FP_INF_NAN | CL_FP_ROUND_TO_NEAREST | CL_FP_ROUND_TO_ZERO | CL_FP_ROUND_TO_INF | CL_FP_FMA"},
+	{NIV_VALUESTRING (CL_DEVICE_PREFERRED_VECTOR_WIDTH_HALF), Kind::UInt, "0"},
+	{NIV_VALUESTRING (CL_DEVICE_HOST_UNIFIED_MEMORY), Kind::Bool, "0"},
+	{NIV_VALUESTRING (CL_DEVICE_NATIVE_VECTOR_WIDTH_CHAR), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_NATIVE_VECTOR_WIDTH_SHORT), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_NATIVE_VECTOR_WIDTH_INT), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_NATIVE_VECTOR_WIDTH_LONG), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_NATIVE_VECTOR_WIDTH_DOUBLE), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_NATIVE_VECTOR_WIDTH_HALF), Kind::UInt, "0"},
+	{NIV_VALUESTRING (CL_DEVICE_OPENCL_C_VERSION), Kind::String, "OpenCL C 1.2 "},
+	{NIV_VALUESTRING (CL_DEVICE_LINKER_AVAILABLE), Kind::Bool, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_BUILT_IN_KERNELS), Kind::StringList, ""},
+	{NIV_VALUESTRING (CL_DEVICE_IMAGE_MAX_BUFFER_SIZE), Kind::SizeT, "134217728"},
+	{NIV_VALUESTRING (CL_DEVICE_IMAGE_MAX_ARRAY_SIZE), Kind::SizeT, "2048"},
+	{NIV_VALUESTRING (CL_DEVICE_PARTITION_MAX_SUB_DEVICES), Kind::UInt, "0"},
+	{NIV_VALUESTRING (CL_DEVICE_PARTITION_PROPERTIES), Kind::PartitionList, "0"},
+	{NIV_VALUESTRING (CL_DEVICE_PARTITION_AFFINITY_DOMAIN), Kind::Bitfield, "0"},
+	{NIV_VALUESTRING (CL_DEVICE_PARTITION_TYPE), Kind::PartitionList, "0"},
+	{NIV_VALUESTRING (CL_DEVICE_REFERENCE_COUNT), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_PREFERRED_INTEROP_USER_SYNC), Kind::Bool, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_PRINTF_BUFFER_SIZE), Kind::SizeT, "1048576"},
+	{NIV_VALUESTRING (CL_DEVICE_IMAGE_PITCH_ALIGNMENT), Kind::UInt, "32"},
+	{NIV_VALUESTRING (CL_DEVICE_IMAGE_BASE_ADDRESS_ALIGNMENT), Kind::UInt, "4096"},
+#ifdef CL_VERSION_2_0
+	{NIV_VALUESTRING (CL_DEVICE_MAX_READ_WRITE_IMAGE_ARGS), Kind::UInt, "64"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_GLOBAL_VARIABLE_SIZE), Kind::SizeT, "65536"},
+	{NIV_VALUESTRING (CL_DEVICE_QUEUE_ON_DEVICE_PROPERTIES), Kind::Bitfield, "CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE | CL_QUEUE_PROFILING_ENABLE"},
+	{NIV_VALUESTRING (CL_DEVICE_QUEUE_ON_DEVICE_PREFERRED_SIZE), Kind::UInt, "16384"},
+	{NIV_VALUESTRING (CL_DEVICE_QUEUE_ON_DEVICE_MAX_SIZE), Kind::UInt, "262144"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_ON_DEVICE_QUEUES), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_ON_DEVICE_EVENTS), Kind::UInt, "1024"},
+	{NIV_VALUESTRING (CL_DEVICE_SVM_CAPABILITIES), Kind::Bitfield, "CL_DEVICE_SVM_COARSE_GRAIN_BUFFER"},
+	{NIV_VALUESTRING (CL_DEVICE_GLOBAL_VARIABLE_PREFERRED_TOTAL_SIZE), Kind::SizeT, "65536"},
+	{NIV_VALUESTRING (CL_DEVICE_MAX_PIPE_ARGS), Kind::UInt, "16"},
+	{NIV_VALUESTRING (CL_DEVICE_PIPE_MAX_ACTIVE_RESERVATIONS), Kind::UInt, "1"},
+	{NIV_VALUESTRING (CL_DEVICE_PIPE_MAX_PACKET_SIZE), Kind::UInt, "1024"},
+	{NIV_VALUESTRING (CL_DEVICE_PREFERRED_PLATFORM_ATOMIC_ALIGNMENT), Kind::UInt, "0"},
+	{NIV_VALUESTRING (CL_DEVICE_PREFERRED_GLOBAL_ATOMIC_ALIGNMENT), Kind::UInt, "0"},
+	{NIV_VALUESTRING (CL_DEVICE_PREFERRED_LOCAL_ATOMIC_ALIGNMENT), Kind::UInt, "0"},
+#endif
+	// Vendor extensions, not reported unless configured
+	{NIV_VALUESTRING (CL_DEVICE_GLOBAL_FREE_MEMORY_AMD), Kind::SizeTList, nullptr},
+	{NIV_VALUESTRING (CL_DEVICE_GLOBAL_MEM_CHANNELS_AMD), Kind::UInt, nullptr},
+	{NIV_VALUESTRING (CL_DEVICE_SIMD_PER_COMPUTE_UNIT_AMD), Kind::UInt, nullptr},
+	{NIV_VALUESTRING (CL_DEVICE_SIMD_WIDTH_AMD), Kind::UInt, nullptr},
+	{NIV_VALUESTRING (CL_DEVICE_SIMD_INSTRUCTION_WIDTH_AMD), Kind::UInt, nullptr},
+	{NIV_VALUESTRING (CL_DEVICE_WAVEFRONT_WIDTH_AMD), Kind::UInt, nullptr},
+	{NIV_VALUESTRING (CL_DEVICE_COMPUTE_CAPABILITY_MAJOR_NV), Kind::UInt, nullptr},
+	{NIV_VALUESTRING (CL_DEVICE_COMPUTE_CAPABILITY_MINOR_NV), Kind::UInt, nullptr},
+	{NIV_VALUESTRING (CL_DEVICE_WARP_SIZE_NV), Kind::UInt, nullptr}
+};
+
+struct Symbol
+{
+	cl_ulong	value;
+	const char*	name;
+};
+
+const Symbol symbols [] = {
+	{NIV_VALUESTRING (CL_DEVICE_TYPE_DEFAULT)},
+	{NIV_VALUESTRING (CL_DEVICE_TYPE_CPU)},
+	{NIV_VALUESTRING (CL_DEVICE_TYPE_GPU)},
+	{NIV_VALUESTRING (CL_DEVICE_TYPE_ACCELERATOR)},
+	{NIV_VALUESTRING (CL_DEVICE_TYPE_CUSTOM)},
+	{NIV_VALUESTRING (CL_FP_DENORM)},
+	{NIV_VALUESTRING (CL_FP_INF_NAN)},
+	{NIV_VALUESTRING (CL_FP_ROUND_TO_NEAREST)},
+	{NIV_VALUESTRING (CL_FP_ROUND_TO_ZERO)},
+	{NIV_VALUESTRING (CL_FP_ROUND_TO_INF)},
+	{NIV_VALUESTRING (CL_FP_FMA)},
+	{NIV_VALUESTRING (CL_FP_SOFT_FLOAT)},
+	{NIV_VALUESTRING (CL_EXEC_KERNEL)},
+	{NIV_VALUESTRING (CL_EXEC_NATIVE_KERNEL)},
+	{NIV_VALUESTRING (CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)},
+	{NIV_VALUESTRING (CL_QUEUE_PROFILING_ENABLE)},
+	{NIV_VALUESTRING (CL_NONE)},
+	{NIV_VALUESTRING (CL_READ_ONLY_CACHE)},
+	{NIV_VALUESTRING (CL_READ_WRITE_CACHE)},
+	{NIV_VALUESTRING (CL_LOCAL)},
+	{NIV_VALUESTRING (CL_GLOBAL)},
+	{NIV_VALUESTRING (CL_DEVICE_PARTITION_EQUALLY)},
+	{NIV_VALUESTRING (CL_DEVICE_PARTITION_BY_COUNTS)},
+	{NIV_VALUESTRING (CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN)},
+	{NIV_VALUESTRING (CL_DEVICE_AFFINITY_DOMAIN_NUMA)},
+	{NIV_VALUESTRING (CL_DEVICE_AFFINITY_DOMAIN_L4_CACHE)},
+	{NIV_VALUESTRING (CL_DEVICE_AFFINITY_DOMAIN_L3_CACHE)},
+	{NIV_VALUESTRING (CL_DEVICE_AFFINITY_DOMAIN_L2_CACHE)},
+	{NIV_VALUESTRING (CL_DEVICE_AFFINITY_DOMAIN_L1_CACHE)},
+	{NIV_VALUESTRING (CL_DEVICE_AFFINITY_DOMAIN_NEXT_PARTITIONABLE)},
+#ifdef CL_VERSION_2_0
+	{NIV_VALUESTRING (CL_DEVICE_SVM_COARSE_GRAIN_BUFFER)},
+	{NIV_VALUESTRING (CL_DEVICE_SVM_FINE_GRAIN_BUFFER)},
+	{NIV_VALUESTRING (CL_DEVICE_SVM_FINE_GRAIN_SYSTEM)},
+	{NIV_VALUESTRING (CL_DEVICE_SVM_ATOMICS)},
+#endif
+	{NIV_VALUESTRING (CL_R)},
+	{NIV_VALUESTRING (CL_A)},
+	{NIV_VALUESTRING (CL_RG)},
+	{NIV_VALUESTRING (CL_RA)},
+	{NIV_VALUESTRING (CL_RGB)},
+	{NIV_VALUESTRING (CL_RGBA)},
+	{NIV_VALUESTRING (CL_BGRA)},
+	{NIV_VALUESTRING (CL_ARGB)},
+	{NIV_VALUESTRING (CL_INTENSITY)},
+	{NIV_VALUESTRING (CL_LUMINANCE)},
+	{NIV_VALUESTRING (CL_SNORM_INT8)},
+	{NIV_VALUESTRING (CL_SNORM_INT16)},
+	{NIV_VALUESTRING (CL_UNORM_INT8)},
+	{NIV_VALUESTRING (CL_UNORM_INT16)},
+	{NIV_VALUESTRING (CL_SIGNED_INT8)},
+	{NIV_VALUESTRING (CL_SIGNED_INT16)},
+	{NIV_VALUESTRING (CL_SIGNED_INT32)},
+	{NIV_VALUESTRING (CL_UNSIGNED_INT8)},
+	{NIV_VALUESTRING (CL_UNSIGNED_INT16)},
+	{NIV_VALUESTRING (CL_UNSIGNED_INT32)},
+	{NIV_VALUESTRING (CL_HALF_FLOAT)},
+	{NIV_VALUESTRING (CL_FLOAT)}
+};
+
+struct ObjectType
+{
+	cl_mem_object_type	type;
+	const char*			name;
+};
+
+const ObjectType objectTypes [] = {
+	{CL_MEM_OBJECT_IMAGE1D, "Image1D"},
+	{CL_MEM_OBJECT_IMAGE2D, "Image2D"},
+	{CL_MEM_OBJECT_IMAGE3D, "Image3D"},
+	{CL_MEM_OBJECT_IMAGE1D_BUFFER, "Image1DBuffer"},
+	{CL_MEM_OBJECT_IMAGE1D_ARRAY, "Image1DArray"},
+	{CL_MEM_OBJECT_IMAGE2D_ARRAY, "Image2DArray"}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+bool ParseSymbol (const std::string& s, cl_ulong& value)
+{
+	for (const auto& symbol : symbols) {
+		if (s == symbol.name) {
+			value = symbol.value;
+			return true;
+		}
+	}
+
+	char* end = nullptr;
+	value = std::strtoull (s.c_str (), &end, 0);
+
+	return end && *end == '\0' && !s.empty ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::vector<std::string> Split (const std::string& s, const char* separators)
+{
+	std::vector<std::string> result;
+	std::string::size_type start = 0;
+
+	for (;;) {
+		start = s.find_first_not_of (separators, start);
+
+		if (start == std::string::npos) {
+			return result;
+		}
+
+		const auto end = s.find_first_of (separators, start);
+		result.push_back (s.substr (start, end - start));
+
+		if (end == std::string::npos) {
+			return result;
+		}
+
+		start = end;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string Trim (const std::string& s)
+{
+	const auto start = s.find_first_not_of (" \t\r\n");
+
+	if (start == std::string::npos) {
+		return std::string ();
+	}
+
+	const auto end = s.find_last_not_of (" \t\r\n");
+	return s.substr (start, end - start + 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void Append (std::vector<unsigned char>& buffer, const T value)
+{
+	const auto offset = buffer.size ();
+	buffer.resize (offset + sizeof (T));
+	std::memcpy (buffer.data () + offset, &value, sizeof (T));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Encode a value from the configuration file into the raw bytes the OpenCL API
+returns for a query of the given kind.
+*/
+bool Encode (const Kind kind, const std::string& value,
+	std::vector<unsigned char>& result)
+{
+	result.clear ();
+
+	switch (kind) {
+	case Kind::String:
+	case Kind::StringList:
+		result.assign (value.begin (), value.end ());
+		result.push_back ('\0');
+		return true;
+
+	case Kind::Bitfield:
+	case Kind::Enum:
+	case Kind::UInt:
+	case Kind::ULong:
+	case Kind::SizeT:
+	case Kind::Bool:
+	{
+		cl_ulong combined = 0;
+		for (const auto& token : Split (value, " \t|")) {
+			cl_ulong v;
+			if (! ParseSymbol (token, v)) {
+				return false;
+			}
+
+			combined |= v;
+		}
+
+		switch (kind) {
+		case Kind::Bitfield: Append<cl_bitfield> (result, combined); break;
+		case Kind::ULong: Append<cl_ulong> (result, combined); break;
+		case Kind::SizeT: Append<std::size_t> (result, static_cast<std::size_t> (combined)); break;
+		case Kind::Bool: Append<cl_bool> (result, combined ? CL_TRUE : CL_FALSE); break;
+		default: Append<cl_uint> (result, static_cast<cl_uint> (combined)); break;
+		}
+
+		return true;
+	}
+
+	case Kind::SizeTList:
+	case Kind::PartitionList:
+		for (const auto& token : Split (value, " \t,")) {
+			cl_ulong v;
+			if (! ParseSymbol (token, v)) {
+				return false;
+			}
+
+			if (kind == Kind::SizeTList) {
+				Append<std::size_t> (result, static_cast<std::size_t> (v));
+			} else {
+				Append<cl_device_partition_property> (result,
+					static_cast<cl_device_partition_property> (v));
+			}
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+/**
+Behavior injected into a query or entry point.
+*/
+enum class Fault
+{
+	None,
+	Fail,
+	Hang,
+	Crash
+};
+
+/**
+Settings shared by platforms and devices. Devices inherit the settings of
+their platform unless they override them.
+*/
+struct Object
+{
+	std::unordered_map<cl_uint, std::vector<unsigned char>>	values;
+	std::unordered_set<cl_uint>								unsupported;
+
+	// Keyed by info code or entry point name
+	std::unordered_map<cl_uint, Fault>		infoFaults;
+	std::unordered_map<std::string, Fault>	callFaults;
+
+	std::chrono::microseconds	latency {0};
+};
+}
+
+struct _cl_device_id;
+
+struct _cl_platform_id
+{
+	void*	dispatch;
+
+	Object	settings;
+	std::vector<_cl_device_id*>	devices;
+
+	// The number of the object in a replayed recording
+	std::uint64_t	recorded = 0;
+};
+
+struct _cl_device_id
+{
+	void*	dispatch;
+
+	Object	settings;
+	std::uint64_t	recorded = 0;
+	cl_platform_id	platform;
+	std::vector<std::vector<cl_image_format>>	imageFormats;
+};
+
+struct _cl_context
+{
+	void*	dispatch;
+
+	cl_device_id	device;
+	std::atomic<int>	referenceCount;
+};
+
+namespace {
+////////////////////////////////////////////////////////////////////////////////
+std::vector<cl_image_format> DefaultImageFormats ()
+{
+	static const cl_channel_order orders [] = { CL_R, CL_RG, CL_RGBA, CL_BGRA };
+	static const cl_channel_type types [] = {
+		CL_UNORM_INT8, CL_UNORM_INT16, CL_SIGNED_INT32, CL_UNSIGNED_INT32,
+		CL_HALF_FLOAT, CL_FLOAT };
+
+	std::vector<cl_image_format> result;
+	for (const auto order : orders) {
+		for (const auto type : types) {
+			result.push_back ({order, type});
+		}
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Generate count formats by cycling through all channel orders and types. Used to
+simulate devices with very long format lists.
+*/
+std::vector<cl_image_format> SyntheticImageFormats (const std::size_t count)
+{
+	std::vector<cl_image_format> result;
+	result.reserve (count);
+
+	cl_uint i = 0;
+	while (result.size () < count) {
+		const cl_channel_order order = CL_R + (i % 10);
+		const cl_channel_type type = CL_SNORM_INT8 + ((i / 10) % 15);
+		result.push_back ({order, type});
+		++i;
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool ReadVarint (const std::vector<unsigned char>& data, std::size_t& offset,
+	std::uint64_t& value)
+{
+	value = 0;
+
+	for (int shift = 0; shift < 64 && offset < data.size (); shift += 7) {
+		const auto b = data [offset++];
+		value |= static_cast<std::uint64_t> (b & 0x7F) << shift;
+
+		if ((b & 0x80) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+Serves the responses recorded with cliGatherOptions::recordFile, see
+lib/clInfoRecord.cpp for the format.
+
+The calls for the same query of the same object are replayed in the order they
+were recorded; once all of them have been used, the last one is repeated. If
+the value is requested, but the next recorded call only asked for the size, the
+value of another call of the same query is used. Queries which were not
+recorded fail with CL_INVALID_VALUE.
+*/
+class Replay
+{
+public:
+	enum Call
+	{
+		Call_GetPlatformIDs = 1,
+		Call_GetPlatformInfo = 2,
+		Call_GetDeviceIDs = 3,
+		Call_GetDeviceInfo = 4,
+		Call_CreateContext = 5,
+		Call_GetSupportedImageFormats = 6
+	};
+
+	/**
+	Load a recording, and create the objects it refers to. Returns false
+	if the file is not a valid recording.
+	*/
+	bool Load (const char* filename, void* dispatch);
+
+	const std::vector<cl_platform_id>& GetPlatforms () const
+	{
+		return platforms_;
+	}
+
+	bool IsRecorded (const Call call, const std::uint64_t object,
+		const cl_uint param) const
+	{
+		return calls_.find ({call, object, param, 0}) != calls_.end ();
+	}
+
+	cl_int GetPlatformIDs (cl_uint numEntries, cl_platform_id* platforms,
+		cl_uint* numPlatforms);
+	cl_int GetInfo (Call call, std::uint64_t object, cl_uint param,
+		std::size_t paramValueSize, void* paramValue,
+		std::size_t* paramValueSizeRet);
+	cl_int GetDeviceIDs (cl_platform_id platform, cl_device_type deviceType,
+		cl_uint numEntries, cl_device_id* devices, cl_uint* numDevices);
+	cl_int CreateContext (cl_device_id device);
+	cl_int GetSupportedImageFormats (cl_device_id device, cl_mem_flags flags,
+		cl_mem_object_type type, cl_uint numEntries, cl_image_format* formats,
+		cl_uint* numFormats);
+
+private:
+	struct Record
+	{
+		cl_int			result = CL_SUCCESS;
+		bool			hasValue = false;
+		bool			hasSize = false;
+		std::uint64_t	returned = 0;
+		std::chrono::nanoseconds		duration {0};
+		std::vector<unsigned char>		payload;
+		// The payload of clGetPlatformIDs and clGetDeviceIDs
+		std::vector<std::uint64_t>		objects;
+	};
+
+	struct Key
+	{
+		int				call;
+		std::uint64_t	object;
+		std::uint64_t	param;
+		std::uint64_t	memFlags;
+
+		bool operator< (const Key& other) const
+		{
+			return std::tie (call, object, param, memFlags) <
+				std::tie (other.call, other.object, other.param, other.memFlags);
+		}
+	};
+
+	struct Records
+	{
+		std::vector<Record>	records;
+		std::size_t			next = 0;
+	};
+
+	const Record* Next (const Key& key, bool wantsValue);
+
+	std::map<Key, Records>	calls_;
+	std::mutex				mutex_;
+	bool					timing_ = false;
+
+	std::vector<cl_platform_id>	platforms_;
+	std::unordered_map<std::uint64_t, cl_platform_id>	platformObjects_;
+	std::unordered_map<std::uint64_t, cl_device_id>		deviceObjects_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+bool Replay::Load (const char* filename, void* dispatch)
+{
+	std::ifstream file (filename, std::ios::binary);
+	const std::vector<unsigned char> data ((std::istreambuf_iterator<char> (file)),
+		std::istreambuf_iterator<char> ());
+
+	if (data.size () < 6 || std::memcmp (data.data (), "CLIR", 4) != 0 ||
+		data [4] != 1) {
+		return false;
+	}
+
+	if (data [5] != sizeof (std::size_t)) {
+		std::cerr << "FAKE_OPENCL_REPLAY: recorded with a different size_t, "
+			"sizes will be wrong" << std::endl;
+	}
+
+	const auto timing = std::getenv ("FAKE_OPENCL_REPLAY_TIMING");
+	timing_ = timing && *timing && std::strcmp (timing, "0") != 0;
+
+	std::size_t offset = 6;
+	bool valid = true;
+
+	const auto readByte = [&] () -> unsigned char {
+		if (offset >= data.size ()) {
+			valid = false;
+			return 0;
+		}
+
+		return data [offset++];
+	};
+
+	const auto readVarint = [&] () -> std::uint64_t {
+		std::uint64_t result = 0;
+		valid = valid && ReadVarint (data, offset, result);
+		return result;
+	};
+
+	while (valid && offset < data.size ()) {
+		Key key;
+		key.call = readByte ();
+		const auto flags = readByte ();
+		key.object = readVarint ();
+		key.param = readVarint ();
+		key.memFlags = (key.call == Call_GetSupportedImageFormats)
+			? readVarint () : 0;
+
+		Record record;
+		readVarint (); // The size of the buffer of the caller
+		const auto result = readVarint ();
+		record.result = static_cast<cl_int> (static_cast<std::int64_t> (
+			(result >> 1) ^ (0 - (result & 1))));
+		record.duration = std::chrono::nanoseconds (readVarint ());
+		record.hasValue = (flags & 1) != 0;
+		record.hasSize = (flags & 2) != 0;
+
+		if (record.hasSize) {
+			record.returned = readVarint ();
+		}
+
+		const auto payloadSize = readVarint ();
+		if (! valid || payloadSize > data.size () - offset) {
+			return false;
+		}
+
+		record.payload.assign (data.begin () + offset,
+			data.begin () + offset + payloadSize);
+		offset += payloadSize;
+
+		if (key.call == Call_GetPlatformIDs || key.call == Call_GetDeviceIDs) {
+			std::size_t p = 0;
+			std::uint64_t object;
+
+			while (p < record.payload.size ()) {
+				if (! ReadVarint (record.payload, p, object)) {
+					return false;
+				}
+
+				record.objects.push_back (object);
+			}
+
+			record.payload.clear ();
+		}
+
+		// Create the objects when they are returned for the first time
+		for (const auto object : record.objects) {
+			if (key.call == Call_GetPlatformIDs &&
+				platformObjects_.find (object) == platformObjects_.end ()) {
+				auto platform = new _cl_platform_id;
+				platform->dispatch = dispatch;
+				platform->recorded = object;
+
+				platformObjects_ [object] = platform;
+				platforms_.push_back (platform);
+			} else if (key.call == Call_GetDeviceIDs &&
+				deviceObjects_.find (object) == deviceObjects_.end ()) {
+				auto device = new _cl_device_id;
+				device->dispatch = dispatch;
+				device->recorded = object;
+
+				const auto platform = platformObjects_.find (key.object);
+				device->platform = (platform == platformObjects_.end ())
+					? nullptr : platform->second;
+
+				deviceObjects_ [object] = device;
+			}
+		}
+
+		calls_ [key].records.push_back (std::move (record));
+	}
+
+	return valid;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const Replay::Record* Replay::Next (const Key& key, const bool wantsValue)
+{
+	const Record* result = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock (mutex_);
+
+		auto it = calls_.find (key);
+		if (it == calls_.end ()) {
+			return nullptr;
+		}
+
+		auto& records = it->second;
+		result = &records.records [std::min (records.next,
+			records.records.size () - 1)];
+		++records.next;
+
+		if (wantsValue && ! result->hasValue && result->result == CL_SUCCESS) {
+			for (const auto& record : records.records) {
+				if (record.hasValue && record.result == CL_SUCCESS) {
+					result = &record;
+					break;
+				}
+			}
+		}
+	}
+
+	if (timing_) {
+		std::this_thread::sleep_for (result->duration);
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int Replay::GetPlatformIDs (cl_uint numEntries, cl_platform_id* platforms,
+	cl_uint* numPlatforms)
+{
+	const auto record = Next ({Call_GetPlatformIDs, 0, 0, 0}, platforms != nullptr);
+
+	if (record == nullptr) {
+		return CL_PLATFORM_NOT_FOUND_KHR;
+	}
+
+	if (record->result != CL_SUCCESS) {
+		return record->result;
+	}
+
+	if (platforms) {
+		for (cl_uint i = 0; i < numEntries && i < record->objects.size (); ++i) {
+			platforms [i] = platformObjects_ [record->objects [i]];
+		}
+	}
+
+	if (numPlatforms) {
+		*numPlatforms = static_cast<cl_uint> (record->hasSize
+			? record->returned : record->objects.size ());
+	}
+
+	return CL_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int Replay::GetInfo (const Call call, const std::uint64_t object,
+	const cl_uint param, std::size_t paramValueSize, void* paramValue,
+	std::size_t* paramValueSizeRet)
+{
+	const auto record = Next ({call, object, param, 0}, paramValue != nullptr);
+
+	if (record == nullptr) {
+		return CL_INVALID_VALUE;
+	}
+
+	if (record->result != CL_SUCCESS) {
+		return record->result;
+	}
+
+	const auto size = record->hasSize ? record->returned : record->payload.size ();
+
+	if (paramValue) {
+		if (! record->hasValue || paramValueSize < size) {
+			return CL_INVALID_VALUE;
+		}
+
+		std::memcpy (paramValue, record->payload.data (),
+			std::min (paramValueSize, record->payload.size ()));
+	}
+
+	if (paramValueSizeRet) {
+		*paramValueSizeRet = static_cast<std::size_t> (size);
+	}
+
+	return CL_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int Replay::GetDeviceIDs (cl_platform_id platform, cl_device_type deviceType,
+	cl_uint numEntries, cl_device_id* devices, cl_uint* numDevices)
+{
+	const auto record = Next ({Call_GetDeviceIDs, platform->recorded, deviceType, 0},
+		devices != nullptr);
+
+	if (record == nullptr) {
+		return CL_DEVICE_NOT_FOUND;
+	}
+
+	if (record->result != CL_SUCCESS) {
+		return record->result;
+	}
+
+	if (devices) {
+		for (cl_uint i = 0; i < numEntries && i < record->objects.size (); ++i) {
+			devices [i] = deviceObjects_ [record->objects [i]];
+		}
+	}
+
+	if (numDevices) {
+		*numDevices = static_cast<cl_uint> (record->hasSize
+			? record->returned : record->objects.size ());
+	}
+
+	return CL_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int Replay::CreateContext (cl_device_id device)
+{
+	const auto record = Next ({Call_CreateContext, device->recorded, 0, 0}, false);
+
+	return record ? record->result : CL_INVALID_VALUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int Replay::GetSupportedImageFormats (cl_device_id device,
+	cl_mem_flags flags, cl_mem_object_type type, cl_uint numEntries,
+	cl_image_format* formats, cl_uint* numFormats)
+{
+	const auto record = Next ({Call_GetSupportedImageFormats, device->recorded,
+		type, flags}, formats != nullptr);
+
+	if (record == nullptr) {
+		return CL_INVALID_VALUE;
+	}
+
+	if (record->result != CL_SUCCESS) {
+		return record->result;
+	}
+
+	const auto recorded = record->payload.size () / sizeof (cl_image_format);
+
+	if (formats) {
+		if (! record->hasValue) {
+			return CL_INVALID_VALUE;
+		}
+
+		std::memcpy (formats, record->payload.data (),
+			std::min<std::size_t> (numEntries, recorded) * sizeof (cl_image_format));
+	}
+
+	if (numFormats) {
+		*numFormats = static_cast<cl_uint> (record->hasSize
+			? record->returned : recorded);
+	}
+
+	return CL_SUCCESS;
+}
+
+/**
+The fake implementation. Configured once, on first use.
+*/
+class Implementation
+{
+public:
+	static Implementation& Get ()
+	{
+		static Implementation instance;
+		return instance;
+	}
+
+	const std::vector<cl_platform_id>& GetPlatforms () const
+	{
+		return platforms_;
+	}
+
+	bool IsValid (const cl_platform_id platform) const
+	{
+		return validPlatforms_.count (platform) != 0;
+	}
+
+	/**
+	The encoded default value of a query, or nullptr if it is not supported
+	by default. Encoded once, so the calls are not slowed down by parsing.
+	*/
+	const std::vector<unsigned char>* GetDefault (const InfoDescription* info) const
+	{
+		const auto it = defaults_.find (info);
+		return (it == defaults_.end ()) ? nullptr : &it->second;
+	}
+
+	/**
+	The recording being replayed, or nullptr if the platforms are configured
+	instead.
+	*/
+	Replay* GetReplay () const
+	{
+		return replay_.get ();
+	}
+
+	void CountCall ()
+	{
+		++callCount_;
+	}
+
+	unsigned long GetCallCount () const
+	{
+		return callCount_;
+	}
+
+	void ResetCallCount ()
+	{
+		callCount_ = 0;
+	}
+
+	void* dispatch [256] = {};
+
+private:
+	Implementation ();
+
+	void Load (std::istream& config);
+
+	std::vector<cl_platform_id>	platforms_;
+	std::unordered_set<cl_platform_id>	validPlatforms_;
+	std::unordered_map<const InfoDescription*, std::vector<unsigned char>>	defaults_;
+	std::atomic<unsigned long>	callCount_ {0};
+
+	std::unique_ptr<Replay>		replay_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+InfoDescription const* FindInfo (const InfoDescription* begin,
+	const InfoDescription* end, const std::string& name)
+{
+	for (auto it = begin; it != end; ++it) {
+		if (name == it->name) {
+			return it;
+		}
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+InfoDescription const* FindInfo (const InfoDescription* begin,
+	const InfoDescription* end, const cl_uint code)
+{
+	for (auto it = begin; it != end; ++it) {
+		if (code == it->code) {
+			return it;
+		}
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Error (const int line, const std::string& message)
+{
+	std::cerr << "FAKE_OPENCL_CONFIG:" << line << ": " << message << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Apply one "key = value" line to a platform or device section.
+*/
+void Configure (Object& object, const InfoDescription* infosBegin,
+	const InfoDescription* infosEnd, const std::string& key,
+	const std::string& value, const int line)
+{
+	if (key == "latency_us") {
+		object.latency = std::chrono::microseconds (std::atoll (value.c_str ()));
+		return;
+	}
+
+	if (key == "fail" || key == "hang" || key == "crash") {
+		const auto fault = (key == "fail") ? Fault::Fail
+			: ((key == "hang") ? Fault::Hang : Fault::Crash);
+
+		for (const auto& target : Split (value, " \t,")) {
+			if (target.compare (0, 3, "CL_") == 0) {
+				const auto info = FindInfo (infosBegin, infosEnd, target);
+
+				if (info == nullptr) {
+					Error (line, "unknown query '" + target + "'");
+					continue;
+				}
+
+				object.infoFaults [info->code] = fault;
+			} else {
+				object.callFaults [target] = fault;
+			}
+		}
+
+		return;
+	}
+
+	if (key == "unsupported") {
+		for (const auto& target : Split (value, " \t,")) {
+			if (const auto info = FindInfo (infosBegin, infosEnd, target)) {
+				object.unsupported.insert (info->code);
+			} else {
+				Error (line, "unknown query '" + target + "'");
+			}
+		}
+
+		return;
+	}
+
+	const auto info = FindInfo (infosBegin, infosEnd, key);
+	if (info == nullptr) {
+		Error (line, "unknown key '" + key + "'");
+		return;
+	}
+
+	if (! Encode (info->kind, value, object.values [info->code])) {
+		Error (line, "invalid value '" + value + "' for " + key);
+		object.values.erase (info->code);
+	}
+
+	object.unsupported.erase (info->code);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_mem_object_type ParseObjectType (const std::string& name)
+{
+	for (const auto& t : objectTypes) {
+		if (name == t.name) {
+			return t.type;
+		}
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::size_t ObjectTypeIndex (const cl_mem_object_type type)
+{
+	for (std::size_t i = 0; i < sizeof (objectTypes) / sizeof (objectTypes [0]); ++i) {
+		if (objectTypes [i].type == type) {
+			return i;
+		}
+	}
+
+	return static_cast<std::size_t> (-1);
+}
+
+struct DeviceSection
+{
+	int			count = 1;
+	Object		settings;
+
+	bool		defaultImageFormats = true;
+	std::size_t	syntheticImageFormats = 0;
+	std::vector<std::pair<cl_mem_object_type, cl_image_format>>	imageFormats;
+};
+
+struct PlatformSection
+{
+	int			count = 1;
+	Object		settings;
+	std::vector<DeviceSection>	devices;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+void Implementation::Load (std::istream& config)
+{
+	std::vector<PlatformSection> sections;
+
+	const auto platformInfosEnd = platformInfos +
+		sizeof (platformInfos) / sizeof (platformInfos [0]);
+	const auto deviceInfosEnd = deviceInfos +
+		sizeof (deviceInfos) / sizeof (deviceInfos [0]);
+
+	std::string l;
+	int line = 0;
+	bool inDevice = false;
+
+	while (std::getline (config, l)) {
+		++line;
+
+		const auto comment = l.find ('#');
+		if (comment != std::string::npos) {
+			l.erase (comment);
+		}
+
+		l = Trim (l);
+
+		if (l.empty ()) {
+			continue;
+		}
+
+		if (l == "[platform]") {
+			sections.emplace_back ();
+			inDevice = false;
+			continue;
+		} else if (l == "[device]") {
+			if (sections.empty ()) {
+				sections.emplace_back ();
+			}
+
+			sections.back ().devices.emplace_back ();
+			inDevice = true;
+			continue;
+		}
+
+		const auto separator = l.find ('=');
+		if (separator == std::string::npos || sections.empty ()) {
+			Error (line, "expected 'key = value' inside a section");
+			continue;
+		}
+
+		const auto key = Trim (l.substr (0, separator));
+		const auto value = Trim (l.substr (separator + 1));
+
+		if (inDevice) {
+			auto& device = sections.back ().devices.back ();
+
+			if (key == "count") {
+				device.count = std::atoi (value.c_str ());
+			} else if (key == "image_formats") {
+				if (value == "none") {
+					device.defaultImageFormats = false;
+				} else if (value == "default") {
+					device.defaultImageFormats = true;
+				} else {
+					device.defaultImageFormats = false;
+					device.syntheticImageFormats = std::strtoul (
+						value.c_str (), nullptr, 10);
+				}
+			} else if (key == "image_format") {
+				// image_format = Image2D CL_RGBA CL_FLOAT
+				const auto tokens = Split (value, " \t");
+				cl_ulong order, type;
+				const auto objectType = tokens.size () == 3
+					? ParseObjectType (tokens [0]) : 0;
+
+				if (objectType == 0 || ! ParseSymbol (tokens [1], order) ||
+					! ParseSymbol (tokens [2], type)) {
+					Error (line, "invalid image format '" + value + "'");
+					continue;
+				}
+
+				device.defaultImageFormats = false;
+				cl_image_format format;
+				format.image_channel_order = static_cast<cl_channel_order> (order);
+				format.image_channel_data_type = static_cast<cl_channel_type> (type);
+				device.imageFormats.push_back (std::make_pair (objectType, format));
+			} else {
+				Configure (device.settings, deviceInfos, deviceInfosEnd,
+					key, value, line);
+			}
+		} else {
+			auto& platform = sections.back ();
+
+			if (key == "count") {
+				platform.count = std::atoi (value.c_str ());
+			} else {
+				Configure (platform.settings, platformInfos, platformInfosEnd,
+					key, value, line);
+			}
+		}
+	}
+
+	if (sections.empty ()) {
+		sections.emplace_back ();
+	}
+
+	for (auto& section : sections) {
+		if (section.devices.empty ()) {
+			section.devices.emplace_back ();
+		}
+
+		for (int i = 0; i < section.count; ++i) {
+			auto platform = new _cl_platform_id;
+			platform->dispatch = dispatch;
+			platform->settings = section.settings;
+
+			for (const auto& deviceSection : section.devices) {
+				for (int j = 0; j < deviceSection.count; ++j) {
+					auto device = new _cl_device_id;
+					device->dispatch = dispatch;
+					device->platform = platform;
+					device->settings = deviceSection.settings;
+
+					// Inherit from the platform
+					if (device->settings.latency.count () == 0) {
+						device->settings.latency = platform->settings.latency;
+					}
+
+					for (const auto& fault : platform->settings.callFaults) {
+						device->settings.callFaults.insert (fault);
+					}
+
+					device->imageFormats.resize (
+						sizeof (objectTypes) / sizeof (objectTypes [0]));
+
+					if (deviceSection.defaultImageFormats) {
+						for (auto& formats : device->imageFormats) {
+							formats = DefaultImageFormats ();
+						}
+					} else if (deviceSection.syntheticImageFormats) {
+						for (auto& formats : device->imageFormats) {
+							formats = SyntheticImageFormats (
+								deviceSection.syntheticImageFormats);
+						}
+					}
+
+					for (const auto& format : deviceSection.imageFormats) {
+						device->imageFormats [ObjectTypeIndex (format.first)]
+							.push_back (format.second);
+					}
+
+					platform->devices.push_back (device);
+				}
+			}
+
+			platforms_.push_back (platform);
+			validPlatforms_.insert (platform);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+Simulate driver behavior: count the call, wait for the configured latency and
+trigger any injected fault. Returns CL_SUCCESS if the call should proceed.
+*/
+cl_int Enter (const Object& object, const char* entryPoint,
+	const cl_uint info = 0)
+{
+	auto& implementation = Implementation::Get ();
+	implementation.CountCall ();
+
+	if (object.latency.count () > 0) {
+		std::this_thread::sleep_for (object.latency);
+	}
+
+	auto fault = Fault::None;
+
+	const auto callFault = object.callFaults.find (entryPoint);
+	if (callFault != object.callFaults.end ()) {
+		fault = callFault->second;
+	}
+
+	if (info) {
+		const auto infoFault = object.infoFaults.find (info);
+		if (infoFault != object.infoFaults.end ()) {
+			fault = infoFault->second;
+		}
+	}
+
+	switch (fault) {
+	case Fault::None:
+		return CL_SUCCESS;
+
+	case Fault::Fail:
+		return CL_INVALID_VALUE;
+
+	case Fault::Hang:
+		for (;;) {
+			std::this_thread::sleep_for (std::chrono::hours (1));
+		}
+
+	case Fault::Crash:
+		std::raise (SIGSEGV);
+		std::abort ();
+	}
+
+	return CL_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int ReturnInfo (const void* data, const std::size_t size,
+	std::size_t paramValueSize, void* paramValue, std::size_t* paramValueSizeRet)
+{
+	if (paramValue) {
+		if (paramValueSize < size) {
+			return CL_INVALID_VALUE;
+		}
+
+		std::memcpy (paramValue, data, size);
+	}
+
+	if (paramValueSizeRet) {
+		*paramValueSizeRet = size;
+	}
+
+	return CL_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int ReturnObjectInfo (const Object& object, const Object* parent,
+	const InfoDescription* infosBegin, const InfoDescription* infosEnd,
+	const cl_uint param, std::size_t paramValueSize, void* paramValue,
+	std::size_t* paramValueSizeRet)
+{
+	const auto info = FindInfo (infosBegin, infosEnd, param);
+
+	if (info == nullptr || object.unsupported.count (param)) {
+		return CL_INVALID_VALUE;
+	}
+
+	const std::vector<unsigned char>* value = nullptr;
+
+	auto it = object.values.find (param);
+	if (it != object.values.end ()) {
+		value = &it->second;
+	} else if (parent) {
+		it = parent->values.find (param);
+
+		if (it != parent->values.end ()) {
+			value = &it->second;
+		}
+	}
+
+	if (value == nullptr) {
+		value = Implementation::Get ().GetDefault (info);
+	}
+
+	if (value == nullptr) {
+		return CL_INVALID_VALUE;
+	}
+
+	return ReturnInfo (value->data (), value->size (),
+		paramValueSize, paramValue, paramValueSizeRet);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL FakeGetPlatformIDs (cl_uint numEntries,
+	cl_platform_id* platforms, cl_uint* numPlatforms)
+{
+	const auto& all = Implementation::Get ().GetPlatforms ();
+	Implementation::Get ().CountCall ();
+
+	if ((platforms == nullptr && numPlatforms == nullptr) ||
+		(platforms && numEntries == 0)) {
+		return CL_INVALID_VALUE;
+	}
+
+	if (const auto replay = Implementation::Get ().GetReplay ()) {
+		return replay->GetPlatformIDs (numEntries, platforms, numPlatforms);
+	}
+
+	if (all.empty ()) {
+		return CL_PLATFORM_NOT_FOUND_KHR;
+	}
+
+	if (numPlatforms) {
+		*numPlatforms = static_cast<cl_uint> (all.size ());
+	}
+
+	if (platforms) {
+		for (cl_uint i = 0; i < numEntries && i < all.size (); ++i) {
+			platforms [i] = all [i];
+		}
+	}
+
+	return CL_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL FakeGetPlatformInfo (cl_platform_id platform,
+	cl_platform_info param, std::size_t paramValueSize, void* paramValue,
+	std::size_t* paramValueSizeRet)
+{
+	const auto& implementation = Implementation::Get ();
+
+	// Without a loader, a null platform selects the first one
+	if (platform == nullptr && ! implementation.GetPlatforms ().empty ()) {
+		platform = implementation.GetPlatforms ().front ();
+	}
+
+	if (! implementation.IsValid (platform)) {
+		return CL_INVALID_PLATFORM;
+	}
+
+	// The ICD loader queries the platforms itself, for instance for
+	// CL_PLATFORM_ICD_SUFFIX_KHR, which the recording may not contain. Those
+	// are answered with the default values.
+	const auto replay = implementation.GetReplay ();
+	if (replay && replay->IsRecorded (Replay::Call_GetPlatformInfo,
+		platform->recorded, param)) {
+		Implementation::Get ().CountCall ();
+		return replay->GetInfo (Replay::Call_GetPlatformInfo, platform->recorded,
+			param, paramValueSize, paramValue, paramValueSizeRet);
+	}
+
+	const auto r = Enter (platform->settings, "clGetPlatformInfo", param);
+	if (r != CL_SUCCESS) {
+		return r;
+	}
+
+	return ReturnObjectInfo (platform->settings, nullptr, platformInfos,
+		platformInfos + sizeof (platformInfos) / sizeof (platformInfos [0]),
+		param, paramValueSize, paramValue, paramValueSizeRet);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_device_type GetDeviceType (const cl_device_id device)
+{
+	cl_device_type type = 0;
+	ReturnObjectInfo (device->settings, &device->platform->settings, deviceInfos,
+		deviceInfos + sizeof (deviceInfos) / sizeof (deviceInfos [0]),
+		CL_DEVICE_TYPE, sizeof (type), &type, nullptr);
+	return type;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL FakeGetDeviceIDs (cl_platform_id platform,
+	cl_device_type deviceType, cl_uint numEntries, cl_device_id* devices,
+	cl_uint* numDevices)
+{
+	if (! Implementation::Get ().IsValid (platform)) {
+		return CL_INVALID_PLATFORM;
+	}
+
+	if (const auto replay = Implementation::Get ().GetReplay ()) {
+		Implementation::Get ().CountCall ();
+		return replay->GetDeviceIDs (platform, deviceType, numEntries, devices,
+			numDevices);
+	}
+
+	const auto r = Enter (platform->settings, "clGetDeviceIDs");
+	if (r != CL_SUCCESS) {
+		return r;
+	}
+
+	if ((devices == nullptr && numDevices == nullptr) ||
+		(devices && numEntries == 0)) {
+		return CL_INVALID_VALUE;
+	}
+
+	cl_uint count = 0;
+	for (const auto device : platform->devices) {
+		if (deviceType == CL_DEVICE_TYPE_ALL ||
+			(GetDeviceType (device) & deviceType)) {
+			if (devices && count < numEntries) {
+				devices [count] = device;
+			}
+
+			++count;
+		}
+	}
+
+	if (numDevices) {
+		*numDevices = count;
+	}
+
+	return count ? CL_SUCCESS : CL_DEVICE_NOT_FOUND;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL FakeGetDeviceInfo (cl_device_id device,
+	cl_device_info param, std::size_t paramValueSize, void* paramValue,
+	std::size_t* paramValueSizeRet)
+{
+	if (device == nullptr) {
+		return CL_INVALID_DEVICE;
+	}
+
+	if (const auto replay = Implementation::Get ().GetReplay ()) {
+		Implementation::Get ().CountCall ();
+		return replay->GetInfo (Replay::Call_GetDeviceInfo, device->recorded,
+			param, paramValueSize, paramValue, paramValueSizeRet);
+	}
+
+	const auto r = Enter (device->settings, "clGetDeviceInfo", param);
+	if (r != CL_SUCCESS) {
+		return r;
+	}
+
+	if (param == CL_DEVICE_PLATFORM) {
+		return ReturnInfo (&device->platform, sizeof (cl_platform_id),
+			paramValueSize, paramValue, paramValueSizeRet);
+	}
+
+	if (param == CL_DEVICE_PARENT_DEVICE) {
+		const cl_device_id parent = nullptr;
+		return ReturnInfo (&parent, sizeof (cl_device_id),
+			paramValueSize, paramValue, paramValueSizeRet);
+	}
+
+	return ReturnObjectInfo (device->settings, &device->platform->settings,
+		deviceInfos, deviceInfos + sizeof (deviceInfos) / sizeof (deviceInfos [0]),
+		param, paramValueSize, paramValue, paramValueSizeRet);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_context CL_API_CALL FakeCreateContext (const cl_context_properties*,
+	cl_uint numDevices, const cl_device_id* devices,
+	void (CL_CALLBACK*)(const char*, const void*, std::size_t, void*), void*,
+	cl_int* errcodeRet)
+{
+	cl_int r = CL_INVALID_VALUE;
+
+	if (numDevices == 1 && devices && devices [0]) {
+		if (const auto replay = Implementation::Get ().GetReplay ()) {
+			Implementation::Get ().CountCall ();
+			r = replay->CreateContext (devices [0]);
+		} else {
+			r = Enter (devices [0]->settings, "clCreateContext");
+		}
+	}
+
+	if (errcodeRet) {
+		*errcodeRet = r;
+	}
+
+	if (r != CL_SUCCESS) {
+		return nullptr;
+	}
+
+	auto context = new _cl_context;
+	context->dispatch = Implementation::Get ().dispatch;
+	context->device = devices [0];
+	context->referenceCount = 1;
+
+	return context;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL FakeRetainContext (cl_context context)
+{
+	if (context == nullptr) {
+		return CL_INVALID_CONTEXT;
+	}
+
+	++context->referenceCount;
+
+	return CL_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL FakeReleaseContext (cl_context context)
+{
+	if (context == nullptr) {
+		return CL_INVALID_CONTEXT;
+	}
+
+	if (--context->referenceCount == 0) {
+		delete context;
+	}
+
+	return CL_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL FakeGetSupportedImageFormats (cl_context context,
+	cl_mem_flags flags, cl_mem_object_type type, cl_uint numEntries,
+	cl_image_format* formats, cl_uint* numFormats)
+{
+	if (context == nullptr) {
+		return CL_INVALID_CONTEXT;
+	}
+
+	if (const auto replay = Implementation::Get ().GetReplay ()) {
+		Implementation::Get ().CountCall ();
+		return replay->GetSupportedImageFormats (context->device, flags, type,
+			numEntries, formats, numFormats);
+	}
+
+	const auto r = Enter (context->device->settings, "clGetSupportedImageFormats");
+	if (r != CL_SUCCESS) {
+		return r;
+	}
+
+	const auto index = ObjectTypeIndex (type);
+	if (index == static_cast<std::size_t> (-1)) {
+		return CL_INVALID_VALUE;
+	}
+
+	const auto& supported = context->device->imageFormats [index];
+
+	if (numFormats) {
+		*numFormats = static_cast<cl_uint> (supported.size ());
+	}
+
+	if (formats) {
+		for (cl_uint i = 0; i < numEntries && i < supported.size (); ++i) {
+			formats [i] = supported [i];
+		}
+	}
+
+	return CL_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cl_int CL_API_CALL FakeIcdGetPlatformIDs (cl_uint numEntries,
+	cl_platform_id* platforms, cl_uint* numPlatforms)
+{
+	return FakeGetPlatformIDs (numEntries, platforms, numPlatforms);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void* CL_API_CALL FakeGetExtensionFunctionAddress (const char* name)
+{
+	if (name && std::strcmp (name, "clIcdGetPlatformIDsKHR") == 0) {
+		return reinterpret_cast<void*> (&FakeIcdGetPlatformIDs);
+	}
+
+	return nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Implementation::Implementation ()
+{
+	// Indices into the Khronos ICD dispatch table, see cl_icd.h
+	dispatch [0] = reinterpret_cast<void*> (&FakeGetPlatformIDs);
+	dispatch [1] = reinterpret_cast<void*> (&FakeGetPlatformInfo);
+	dispatch [2] = reinterpret_cast<void*> (&FakeGetDeviceIDs);
+	dispatch [3] = reinterpret_cast<void*> (&FakeGetDeviceInfo);
+	dispatch [4] = reinterpret_cast<void*> (&FakeCreateContext);
+	dispatch [6] = reinterpret_cast<void*> (&FakeRetainContext);
+	dispatch [7] = reinterpret_cast<void*> (&FakeReleaseContext);
+	dispatch [19] = reinterpret_cast<void*> (&FakeGetSupportedImageFormats);
+	dispatch [65] = reinterpret_cast<void*> (&FakeGetExtensionFunctionAddress);
+
+	for (const auto& info : platformInfos) {
+		Encode (info.kind, info.defaultValue, defaults_ [&info]);
+	}
+
+	for (const auto& info : deviceInfos) {
+		if (info.defaultValue) {
+			Encode (info.kind, info.defaultValue, defaults_ [&info]);
+		}
+	}
+
+	if (const auto path = std::getenv ("FAKE_OPENCL_REPLAY")) {
+		replay_.reset (new Replay);
+
+		if (! replay_->Load (path, dispatch)) {
+			std::cerr << "Could not load FAKE_OPENCL_REPLAY file '"
+				<< path << "'" << std::endl;
+		}
+
+		platforms_ = replay_->GetPlatforms ();
+		validPlatforms_.insert (platforms_.begin (), platforms_.end ());
+	} else if (const auto path = std::getenv ("FAKE_OPENCL_CONFIG")) {
+		std::ifstream config (path);
+
+		if (! config) {
+			std::cerr << "Could not open FAKE_OPENCL_CONFIG file '"
+				<< path << "'" << std::endl;
+		}
+
+		Load (config);
+	} else {
+		std::istringstream config ("[platform]\n[device]\n");
+		Load (config);
+	}
+}
+}
+
+/*
+The ICD entry points, used when loaded through an ICD loader.
+*/
+NIV_FAKE_EXPORT cl_int CL_API_CALL clIcdGetPlatformIDsKHR (cl_uint numEntries,
+	cl_platform_id* platforms, cl_uint* numPlatforms)
+{
+	return FakeIcdGetPlatformIDs (numEntries, platforms, numPlatforms);
+}
+
+NIV_FAKE_EXPORT void* CL_API_CALL clGetExtensionFunctionAddress (const char* name)
+{
+	return FakeGetExtensionFunctionAddress (name);
+}
+
+/*
+The regular entry points, used when this library replaces libOpenCL.so.
+*/
+NIV_FAKE_EXPORT cl_int CL_API_CALL clGetPlatformIDs (cl_uint numEntries,
+	cl_platform_id* platforms, cl_uint* numPlatforms)
+{
+	return FakeGetPlatformIDs (numEntries, platforms, numPlatforms);
+}
+
+NIV_FAKE_EXPORT cl_int CL_API_CALL clGetPlatformInfo (cl_platform_id platform,
+	cl_platform_info param, std::size_t paramValueSize, void* paramValue,
+	std::size_t* paramValueSizeRet)
+{
+	return FakeGetPlatformInfo (platform, param, paramValueSize, paramValue,
+		paramValueSizeRet);
+}
+
+NIV_FAKE_EXPORT cl_int CL_API_CALL clGetDeviceIDs (cl_platform_id platform,
+	cl_device_type deviceType, cl_uint numEntries, cl_device_id* devices,
+	cl_uint* numDevices)
+{
+	return FakeGetDeviceIDs (platform, deviceType, numEntries, devices,
+		numDevices);
+}
+
+NIV_FAKE_EXPORT cl_int CL_API_CALL clGetDeviceInfo (cl_device_id device,
+	cl_device_info param, std::size_t paramValueSize, void* paramValue,
+	std::size_t* paramValueSizeRet)
+{
+	return FakeGetDeviceInfo (device, param, paramValueSize, paramValue,
+		paramValueSizeRet);
+}
+
+NIV_FAKE_EXPORT cl_context CL_API_CALL clCreateContext (
+	const cl_context_properties* properties, cl_uint numDevices,
+	const cl_device_id* devices,
+	void (CL_CALLBACK* notify)(const char*, const void*, std::size_t, void*),
+	void* userData, cl_int* errcodeRet)
+{
+	return FakeCreateContext (properties, numDevices, devices, notify, userData,
+		errcodeRet);
+}
+
+NIV_FAKE_EXPORT cl_int CL_API_CALL clRetainContext (cl_context context)
+{
+	return FakeRetainContext (context);
+}
+
+NIV_FAKE_EXPORT cl_int CL_API_CALL clReleaseContext (cl_context context)
+{
+	return FakeReleaseContext (context);
+}
+
+NIV_FAKE_EXPORT cl_int CL_API_CALL clGetSupportedImageFormats (
+	cl_context context, cl_mem_flags flags, cl_mem_object_type type,
+	cl_uint numEntries, cl_image_format* formats, cl_uint* numFormats)
+{
+	return FakeGetSupportedImageFormats (context, flags, type, numEntries,
+		formats, numFormats);
+}
+
+/*
+Statistics for benchmarks, obtain with dlsym.
+*/
+NIV_FAKE_EXPORT unsigned long fakeOpenCL_GetCallCount ()
+{
+	return Implementation::Get ().GetCallCount ();
+}
+
+NIV_FAKE_EXPORT void fakeOpenCL_ResetCallCount ()
+{
+	Implementation::Get ().ResetCallCount ();
+}
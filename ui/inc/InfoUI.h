@@ -23,6 +23,17 @@ public slots:
 	void PlatformSelected (const int index);
 	void DeviceSelected (const int index);
 
+signals:
+	// Emitted from the gather worker thread
+	void GatherProgress (const int platformIndex, const int platformCount,
+		const int deviceIndex, const int deviceCount);
+	void GatherFinished (const int event);
+
+private slots:
+	void OnGatherProgress (const int platformIndex, const int platformCount,
+		const int deviceIndex, const int deviceCount);
+	void OnGatherFinished (const int event);
+
 private:
 	Ui::InfoUI ui_;
 
@@ -67,20 +67,34 @@ InfoUI::InfoUI ()
 	connect (ui_.deviceList, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
 		this, &InfoUI::DeviceSelected);
 
-	cliInfo_Create (&cliInfo_);
-	cliInfo_Gather (cliInfo_);
+	connect (this, &InfoUI::GatherProgress, this, &InfoUI::OnGatherProgress,
+		Qt::QueuedConnection);
+	connect (this, &InfoUI::GatherFinished, this, &InfoUI::OnGatherFinished,
+		Qt::QueuedConnection);
 
-	cliNode* root;
-	cliInfo_GetRoot (cliInfo_, &root);
+	statusBar ()->showMessage ("Querying OpenCL platforms ...");
 
-	int itemCount = 0;
-	for (auto n = root->firstChild; n; n = n->next) {
-		ui_.platformList->addItem (GetPlatformName (n),
-			QVariant::fromValue (reinterpret_cast<std::intptr_t> (n)));
-		++itemCount;
-	}
+	cliGatherOptions options = {};
+	options.flags = CLI_GatherFlag_ReportProgress;
 
-	statusBar ()->showMessage (QString ("Found %1 platform(s)").arg (itemCount));
+	cliInfo_Create (&cliInfo_);
+	cliInfo_GatherAsync (cliInfo_, &options,
+		[](cliInfo*, const cliGatherProgress* progress, void* userdata) -> void {
+			auto self = static_cast<InfoUI*> (userdata);
+
+			switch (progress->event) {
+			case CLI_GatherEvent_Platform:
+			case CLI_GatherEvent_Device:
+				emit self->GatherProgress (progress->platformIndex,
+					progress->platformCount, progress->deviceIndex,
+					progress->deviceCount);
+				break;
+
+			default:
+				emit self->GatherFinished (progress->event);
+				break;
+			}
+		}, this);
 
 	connect (ui_.actionAbout, &QAction::triggered, [this]() -> void {
 		QMessageBox::about (this, "About OpenCL info viewer",
@@ -98,6 +112,42 @@ InfoUI::~InfoUI ()
 	cliInfo_Destroy (cliInfo_);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void InfoUI::OnGatherProgress (const int platformIndex, const int platformCount,
+	const int deviceIndex, const int deviceCount)
+{
+	if (deviceIndex == -1) {
+		statusBar ()->showMessage (QString ("Querying platform %1/%2 ...")
+			.arg (platformIndex + 1).arg (platformCount));
+	} else {
+		statusBar ()->showMessage (QString ("Querying platform %1/%2, device %3/%4 ...")
+			.arg (platformIndex + 1).arg (platformCount)
+			.arg (deviceIndex + 1).arg (deviceCount));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void InfoUI::OnGatherFinished (const int event)
+{
+	cliInfo_Wait (cliInfo_);
+
+	cliNode* root;
+	if (event != CLI_GatherEvent_Completed ||
+		cliInfo_GetRoot (cliInfo_, &root) != CLI_Success) {
+		statusBar ()->showMessage ("Failed to obtain OpenCL information");
+		return;
+	}
+
+	int itemCount = 0;
+	for (auto n = root->firstChild; n; n = n->next) {
+		ui_.platformList->addItem (GetPlatformName (n),
+			QVariant::fromValue (reinterpret_cast<std::intptr_t> (n)));
+		++itemCount;
+	}
+
+	statusBar ()->showMessage (QString ("Found %1 platform(s)").arg (itemCount));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 QTreeWidgetItem* ToTree (const cliProperty* p)
 {